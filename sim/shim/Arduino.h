@@ -0,0 +1,246 @@
+/**
+ * @file Arduino.h
+ * @brief Arduino mínimo para a simulação no PC (env:native)
+ *
+ * Só o que o firmware usa: String, Print/Stream, HardwareSerial, tempo e
+ * pinos. O tempo é virtual (sim_clock.h): millis()/micros() avançam com
+ * delay(), com a transmissão no barramento simulado e com as esperas ativas
+ * por bytes, de modo que um ciclo de 1 s roda em microssegundos de CPU.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Sem ARDUINO definido o ArduinoJson não usa String/Stream/Print; liga os adaptadores
+#define ARDUINOJSON_ENABLE_ARDUINO_STRING 1
+#define ARDUINOJSON_ENABLE_ARDUINO_STREAM 1
+#define ARDUINOJSON_ENABLE_ARDUINO_PRINT 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define F(text) (text)
+#define PROGMEM
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define lowByte(w) ((uint8_t)((w) & 0xFF))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+inline uint16_t makeWord(uint8_t high, uint8_t low) {
+    return (uint16_t)((high << 8) | low);
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+
+// ==================== STRING ====================
+
+class String {
+public:
+    String(const char* text = "") : _s(text ? text : "") {}
+    String(const std::string& text) : _s(text) {}
+    String(const String& other) : _s(other._s) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(unsigned char value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(int value, unsigned char base = 10) { fromSigned(value, base); }
+    explicit String(unsigned int value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(long value, unsigned char base = 10) { fromSigned(value, base); }
+    explicit String(unsigned long value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(long long value, unsigned char base = 10) { fromSigned(value, base); }
+    explicit String(unsigned long long value, unsigned char base = 10) { fromUnsigned(value, base); }
+    explicit String(float value, unsigned int decimals = 2) { fromDouble(value, decimals); }
+    explicit String(double value, unsigned int decimals = 2) { fromDouble(value, decimals); }
+
+    String& operator=(const String& other) { _s = other._s; return *this; }
+    String& operator=(const char* text) { _s = text ? text : ""; return *this; }
+
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    const char* c_str() const { return _s.c_str(); }
+    bool isEmpty() const { return _s.empty(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+
+    bool concat(const String& other) { _s += other._s; return true; }
+    bool concat(const char* text) { if (text) _s += text; return true; }
+    bool concat(const char* text, unsigned int length) { _s.append(text, length); return true; }
+    bool concat(char c) { _s += c; return true; }
+
+    String& operator+=(const String& other) { _s += other._s; return *this; }
+    String& operator+=(const char* text) { if (text) _s += text; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    String& operator+=(int value) { _s += String(value)._s; return *this; }
+    String& operator+=(unsigned int value) { _s += String(value)._s; return *this; }
+    String& operator+=(long value) { _s += String(value)._s; return *this; }
+    String& operator+=(unsigned long value) { _s += String(value)._s; return *this; }
+    String& operator+=(float value) { _s += String(value)._s; return *this; }
+    String& operator+=(double value) { _s += String(value)._s; return *this; }
+
+    bool operator==(const String& other) const { return _s == other._s; }
+    bool operator==(const char* text) const { return _s == (text ? text : ""); }
+    bool operator!=(const String& other) const { return _s != other._s; }
+    bool operator!=(const char* text) const { return !(*this == text); }
+    bool operator<(const String& other) const { return _s < other._s; }
+    bool equals(const String& other) const { return _s == other._s; }
+    bool equalsIgnoreCase(const String& other) const;
+
+    char charAt(unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+    void setCharAt(unsigned int index, char c) { if (index < _s.size()) _s[index] = c; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return _s[index]; }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(_s.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return position(_s.find(text._s, from)); }
+    int lastIndexOf(char c) const { return position(_s.rfind(c)); }
+    int lastIndexOf(const String& text) const { return position(_s.rfind(text._s)); }
+    bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+
+    String substring(unsigned int from) const { return from >= _s.size() ? String() : String(_s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void replace(const String& find, const String& replacement);
+    void replace(char find, char replacement) { std::replace(_s.begin(), _s.end(), find, replacement); }
+    void remove(unsigned int index) { if (index < _s.size()) _s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < _s.size()) _s.erase(index, count); }
+    void toLowerCase() { for (size_t k = 0; k < _s.size(); k++) _s[k] = (char)tolower((unsigned char)_s[k]); }
+    void toUpperCase() { for (size_t k = 0; k < _s.size(); k++) _s[k] = (char)toupper((unsigned char)_s[k]); }
+    void trim();
+
+    long toInt() const { return atol(_s.c_str()); }
+    float toFloat() const { return (float)atof(_s.c_str()); }
+    double toDouble() const { return atof(_s.c_str()); }
+
+private:
+    std::string _s;
+
+    static int position(size_t found) { return found == std::string::npos ? -1 : (int)found; }
+    void fromSigned(long long value, unsigned char base);
+    void fromUnsigned(unsigned long long value, unsigned char base);
+    void fromDouble(double value, unsigned int decimals);
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, char b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, int b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, unsigned int b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, long b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, unsigned long b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, float b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, double b) { String r(a); r += b; return r; }
+
+// ==================== PRINT / STREAM ====================
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* text) { return text ? write((const uint8_t*)text, strlen(text)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(const char* text) { return write(text); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(int value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(unsigned int value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(unsigned long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(long long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(unsigned long long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+    size_t print(double value, int decimals = 2) { return print(String(value, (unsigned int)decimals)); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& value) { return print(value) + println(); }
+    template <typename T> size_t println(const T& value, int format) { return print(value, format) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeoutMs) { _timeoutMs = timeoutMs; }
+    unsigned long getTimeout() const { return _timeoutMs; }
+    size_t readBytes(uint8_t* buffer, size_t length);
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+
+protected:
+    unsigned long _timeoutMs = 1000;
+};
+
+// ==================== REDE ====================
+
+class IPAddress {
+public:
+    IPAddress() : _value(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _value(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t value) : _value(value) {}
+    uint8_t operator[](int index) const { return (_value >> (8 * index)) & 0xFF; }
+    operator uint32_t() const { return _value; }
+    bool fromString(const char* text);
+    bool fromString(const String& text) { return fromString(text.c_str()); }
+    String toString() const;
+
+private:
+    uint32_t _value;
+};
+
+#include "HardwareSerial.h"
+
+#endif // SIM_ARDUINO_H
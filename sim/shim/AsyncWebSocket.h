@@ -0,0 +1,50 @@
+/**
+ * @file AsyncWebSocket.h
+ * @brief WebSocket simulado: sem clientes (o console sai pelo Serial)
+ */
+
+#ifndef SIM_ASYNC_WEBSOCKET_H
+#define SIM_ASYNC_WEBSOCKET_H
+
+#include "Arduino.h"
+
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+
+#define WS_TEXT 0x01
+#define WS_BINARY 0x02
+
+typedef struct {
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+} AwsFrameInfo;
+
+class AsyncWebSocket;
+
+class AsyncWebSocketClient {
+public:
+    uint32_t id() const { return 0; }
+    IPAddress remoteIP() const { return IPAddress(); }
+    void text(const char* message) { (void)message; }
+    void text(const String& message) { (void)message; }
+};
+
+typedef void (*AwsEventHandler)(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type,
+                                void* arg, uint8_t* data, size_t len);
+
+class AsyncWebSocket {
+public:
+    explicit AsyncWebSocket(const char* url) { (void)url; }
+    void onEvent(AwsEventHandler handler) { (void)handler; }
+    size_t count() const { return 0; }
+    void textAll(const char* message) { (void)message; }
+    void textAll(const String& message) { (void)message; }
+    void cleanupClients() {}
+};
+
+#endif // SIM_ASYNC_WEBSOCKET_H
@@ -0,0 +1,21 @@
+/**
+ * @file ESP.h
+ * @brief Informações do chip (valores fixos na simulação)
+ */
+
+#ifndef SIM_ESP_H
+#define SIM_ESP_H
+
+#include "Arduino.h"
+
+class EspClass {
+public:
+    uint32_t getHeapSize() { return 327680; }
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif // SIM_ESP_H
@@ -0,0 +1,85 @@
+/**
+ * @file FS.h
+ * @brief Sistema de arquivos do ESP32 sobre um diretório do PC
+ *
+ * Os caminhos do firmware ("/history/...") são relativos à raiz definida em
+ * simFsSetRoot() (sim_main.cpp cria uma por execução).
+ */
+
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include "Arduino.h"
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Diretório do PC usado como raiz do LittleFS
+ */
+void simFsSetRoot(const char* root);
+const char* simFsRoot();
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+public:
+    File() {}
+
+    size_t write(uint8_t value) override { return write(&value, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t read(uint8_t* buffer, size_t size);
+    void flush() override;
+
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const { return (bool)_file || _directory; }
+    const char* name() const;
+    const char* path() const { return _path.c_str(); }
+    bool isDirectory() const { return _directory; }
+    File openNextFile(const char* mode = "r");
+    void rewindDirectory() { _nextEntry = 0; }
+    time_t getLastWrite() { return 0; }
+
+private:
+    friend class FS;
+    std::shared_ptr<FILE> _file;
+    std::string _path;
+    bool _directory = false;
+    std::vector<std::string> _entries;
+    size_t _nextEntry = 0;
+};
+
+class FS {
+public:
+    File open(const char* path, const char* mode = "r", bool create = false);
+    File open(const String& path, const char* mode = "r", bool create = false) { return open(path.c_str(), mode, create); }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+    bool mkdir(const char* path);
+    bool mkdir(const String& path) { return mkdir(path.c_str()); }
+    bool rmdir(const char* path);
+    bool rmdir(const String& path) { return rmdir(path.c_str()); }
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // SIM_FS_H
@@ -0,0 +1,108 @@
+/**
+ * @file HardwareSerial.h
+ * @brief UART simulada: cada porta pode ser ligada a um SerialPortModel
+ *
+ * Sem modelo, a escrita vai para stdout (Serial, com eco habilitado) ou é
+ * descartada, e a leitura não tem bytes. O barramento simulado (sim_bus.h)
+ * se liga ao Serial2.
+ */
+
+#ifndef SIM_HARDWARE_SERIAL_H
+#define SIM_HARDWARE_SERIAL_H
+
+#include "Arduino.h"
+
+#define SERIAL_5N1 0x8000010
+#define SERIAL_6N1 0x8000014
+#define SERIAL_7N1 0x8000018
+#define SERIAL_8N1 0x800001c
+#define SERIAL_5N2 0x8000030
+#define SERIAL_6N2 0x8000034
+#define SERIAL_7N2 0x8000038
+#define SERIAL_8N2 0x800003c
+#define SERIAL_5E1 0x8000012
+#define SERIAL_6E1 0x8000016
+#define SERIAL_7E1 0x800001a
+#define SERIAL_8E1 0x800001e
+#define SERIAL_5E2 0x8000032
+#define SERIAL_6E2 0x8000036
+#define SERIAL_7E2 0x800003a
+#define SERIAL_8E2 0x800003e
+#define SERIAL_5O1 0x8000013
+#define SERIAL_6O1 0x8000017
+#define SERIAL_7O1 0x800001b
+#define SERIAL_8O1 0x800001f
+#define SERIAL_5O2 0x8000033
+#define SERIAL_6O2 0x8000037
+#define SERIAL_7O2 0x800003b
+#define SERIAL_8O2 0x800003f
+
+/**
+ * @brief Bits por caractere de uma configuração SERIAL_* (start + dados + paridade + stop)
+ */
+uint8_t serialConfigCharBits(uint32_t config);
+
+/**
+ * @brief Lado do "fio" de uma UART simulada
+ */
+class SerialPortModel {
+public:
+    virtual ~SerialPortModel() {}
+    virtual void portBegin(unsigned long baud, uint32_t config) = 0;
+    virtual size_t portWrite(const uint8_t* buffer, size_t size) = 0;
+    virtual void portFlush() = 0;                 // Espera o fim da transmissão
+    virtual int portAvailable() = 0;
+    virtual int portRead() = 0;
+    virtual int portPeek() = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(int uartNumber) : _uart(uartNumber) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1,
+               bool invert = false, unsigned long timeoutMs = 20000UL, uint8_t rxfifoFullThrhd = 112);
+    void end() { _started = false; }
+    void updateBaudRate(unsigned long baud);
+    unsigned long baudRate() const { return _baud; }
+    operator bool() const { return _started; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t value) override { return write(&value, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+    int availableForWrite() { return 128; }
+
+    void onReceive(void (*callback)(void), bool onlyOnTimeout = false) { (void)callback; (void)onlyOnTimeout; }
+    bool setRxFIFOFull(uint8_t fifoBytes) { (void)fifoBytes; return true; }
+    bool setRxTimeout(uint8_t symbols) { (void)symbols; return true; }
+    size_t setRxBufferSize(size_t size) { return size; }
+    size_t setTxBufferSize(size_t size) { return size; }
+
+    /**
+     * @brief Liga a porta a um modelo (nullptr desliga)
+     */
+    void attach(SerialPortModel* model) { _model = model; }
+
+    /**
+     * @brief Escreve o que for transmitido em stdout (console da simulação)
+     */
+    void setEcho(bool echo) { _echo = echo; }
+
+private:
+    int _uart;
+    bool _started = false;
+    bool _echo = false;
+    unsigned long _baud = 0;
+    uint32_t _config = SERIAL_8N1;
+    SerialPortModel* _model = nullptr;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+#endif // SIM_HARDWARE_SERIAL_H
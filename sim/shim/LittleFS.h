@@ -0,0 +1,23 @@
+/**
+ * @file LittleFS.h
+ * @brief LittleFS simulado (diretório do PC, ver FS.h)
+ */
+
+#ifndef SIM_LITTLEFS_H
+#define SIM_LITTLEFS_H
+
+#include "FS.h"
+
+class LittleFSFS : public fs::FS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = "spiffs");
+    void end() {}
+    bool format() { return false; }
+    size_t totalBytes() { return 1536 * 1024; }
+    size_t usedBytes();
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // SIM_LITTLEFS_H
@@ -0,0 +1,287 @@
+/**
+ * @file ModbusMaster.cpp
+ * @brief ModbusMaster simulado (mesmo protocolo e temporização da biblioteca 2.0.1)
+ */
+
+#include "ModbusMaster.h"
+
+static const uint8_t kReadCoils = 0x01;
+static const uint8_t kReadDiscreteInputs = 0x02;
+static const uint8_t kReadHoldingRegisters = 0x03;
+static const uint8_t kReadInputRegisters = 0x04;
+static const uint8_t kWriteSingleCoil = 0x05;
+static const uint8_t kWriteSingleRegister = 0x06;
+static const uint8_t kWriteMultipleCoils = 0x0F;
+static const uint8_t kWriteMultipleRegisters = 0x10;
+
+static uint16_t crc16Update(uint16_t crc, uint8_t value) {
+    crc ^= value;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+    }
+    return crc;
+}
+
+ModbusMaster::ModbusMaster()
+    : _serial(nullptr), _slave(0), _readAddress(0), _readQty(0), _writeAddress(0), _writeQty(0),
+      _responseLength(0), _idle(nullptr), _preTransmission(nullptr), _postTransmission(nullptr) {
+    memset(_responseBuffer, 0, sizeof(_responseBuffer));
+    memset(_transmitBuffer, 0, sizeof(_transmitBuffer));
+}
+
+void ModbusMaster::begin(uint8_t slave, Stream& serial) {
+    _slave = slave;
+    _serial = &serial;
+}
+
+void ModbusMaster::idle(void (*callback)()) {
+    _idle = callback;
+}
+
+void ModbusMaster::preTransmission(void (*callback)()) {
+    _preTransmission = callback;
+}
+
+void ModbusMaster::postTransmission(void (*callback)()) {
+    _postTransmission = callback;
+}
+
+uint16_t ModbusMaster::getResponseBuffer(uint8_t index) {
+    return index < ku8MaxBufferSize ? _responseBuffer[index] : 0xFFFF;
+}
+
+void ModbusMaster::clearResponseBuffer() {
+    memset(_responseBuffer, 0, sizeof(_responseBuffer));
+}
+
+uint8_t ModbusMaster::setTransmitBuffer(uint8_t index, uint16_t value) {
+    if (index >= ku8MaxBufferSize) {
+        return ku8MBIllegalDataAddress;
+    }
+    _transmitBuffer[index] = value;
+    return ku8MBSuccess;
+}
+
+void ModbusMaster::clearTransmitBuffer() {
+    memset(_transmitBuffer, 0, sizeof(_transmitBuffer));
+}
+
+uint8_t ModbusMaster::readCoils(uint16_t readAddress, uint16_t bitQty) {
+    _readAddress = readAddress;
+    _readQty = bitQty;
+    return transaction(kReadCoils);
+}
+
+uint8_t ModbusMaster::readDiscreteInputs(uint16_t readAddress, uint16_t bitQty) {
+    _readAddress = readAddress;
+    _readQty = bitQty;
+    return transaction(kReadDiscreteInputs);
+}
+
+uint8_t ModbusMaster::readHoldingRegisters(uint16_t readAddress, uint16_t readQty) {
+    _readAddress = readAddress;
+    _readQty = readQty;
+    return transaction(kReadHoldingRegisters);
+}
+
+uint8_t ModbusMaster::readInputRegisters(uint16_t readAddress, uint8_t readQty) {
+    _readAddress = readAddress;
+    _readQty = readQty;
+    return transaction(kReadInputRegisters);
+}
+
+uint8_t ModbusMaster::writeSingleCoil(uint16_t writeAddress, uint8_t state) {
+    _writeAddress = writeAddress;
+    _writeQty = state ? 0xFF00 : 0x0000;
+    return transaction(kWriteSingleCoil);
+}
+
+uint8_t ModbusMaster::writeSingleRegister(uint16_t writeAddress, uint16_t writeValue) {
+    _writeAddress = writeAddress;
+    _writeQty = 0;
+    _transmitBuffer[0] = writeValue;
+    return transaction(kWriteSingleRegister);
+}
+
+uint8_t ModbusMaster::writeMultipleCoils(uint16_t writeAddress, uint16_t bitQty) {
+    _writeAddress = writeAddress;
+    _writeQty = bitQty;
+    return transaction(kWriteMultipleCoils);
+}
+
+uint8_t ModbusMaster::writeMultipleRegisters(uint16_t writeAddress, uint16_t writeQty) {
+    _writeAddress = writeAddress;
+    _writeQty = writeQty;
+    return transaction(kWriteMultipleRegisters);
+}
+
+uint8_t ModbusMaster::transaction(uint8_t function) {
+    uint8_t adu[256];
+    uint16_t size = 0;
+    uint8_t status = ku8MBSuccess;
+
+    if (_serial == nullptr) {
+        return ku8MBResponseTimedOut;
+    }
+
+    adu[size++] = _slave;
+    adu[size++] = function;
+    switch (function) {
+        case kReadCoils:
+        case kReadDiscreteInputs:
+        case kReadHoldingRegisters:
+        case kReadInputRegisters:
+            adu[size++] = highByte(_readAddress);
+            adu[size++] = lowByte(_readAddress);
+            adu[size++] = highByte(_readQty);
+            adu[size++] = lowByte(_readQty);
+            break;
+        case kWriteSingleCoil:
+            adu[size++] = highByte(_writeAddress);
+            adu[size++] = lowByte(_writeAddress);
+            adu[size++] = highByte(_writeQty);
+            adu[size++] = lowByte(_writeQty);
+            break;
+        case kWriteSingleRegister:
+            adu[size++] = highByte(_writeAddress);
+            adu[size++] = lowByte(_writeAddress);
+            adu[size++] = highByte(_transmitBuffer[0]);
+            adu[size++] = lowByte(_transmitBuffer[0]);
+            break;
+        case kWriteMultipleCoils: {
+            adu[size++] = highByte(_writeAddress);
+            adu[size++] = lowByte(_writeAddress);
+            adu[size++] = highByte(_writeQty);
+            adu[size++] = lowByte(_writeQty);
+            // Bits empacotados nas palavras do buffer de transmissão, byte baixo primeiro
+            uint8_t byteCount = (uint8_t)((_writeQty + 7) / 8);
+            adu[size++] = byteCount;
+            for (uint8_t k = 0; k < byteCount; k++) {
+                uint16_t value = _transmitBuffer[k / 2];
+                adu[size++] = (k % 2) ? highByte(value) : lowByte(value);
+            }
+            break;
+        }
+        case kWriteMultipleRegisters:
+            adu[size++] = highByte(_writeAddress);
+            adu[size++] = lowByte(_writeAddress);
+            adu[size++] = highByte(_writeQty);
+            adu[size++] = lowByte(_writeQty);
+            adu[size++] = (uint8_t)(_writeQty * 2);
+            for (uint16_t k = 0; k < _writeQty && k < ku8MaxBufferSize; k++) {
+                adu[size++] = highByte(_transmitBuffer[k]);
+                adu[size++] = lowByte(_transmitBuffer[k]);
+            }
+            break;
+        default:
+            return ku8MBIllegalFunction;
+    }
+
+    uint16_t crc = 0xFFFF;
+    for (uint16_t k = 0; k < size; k++) {
+        crc = crc16Update(crc, adu[k]);
+    }
+    adu[size++] = lowByte(crc);
+    adu[size++] = highByte(crc);
+
+    // Descarta bytes atrasados antes de transmitir
+    while (_serial->read() != -1) {
+    }
+
+    if (_preTransmission) {
+        _preTransmission();
+    }
+    _serial->write(adu, size);
+    _serial->flush();
+    if (_postTransmission) {
+        _postTransmission();
+    }
+
+    size = 0;
+    uint16_t bytesLeft = 8;
+    uint32_t startTime = millis();
+    while (bytesLeft && status == ku8MBSuccess) {
+        if (_serial->available()) {
+            adu[size++] = (uint8_t)_serial->read();
+            bytesLeft--;
+        } else if (_idle) {
+            _idle();
+        }
+
+        // Cabeçalho recebido: confere e calcula o restante
+        if (size == 5) {
+            if (adu[0] != _slave) {
+                status = ku8MBInvalidSlaveID;
+                break;
+            }
+            if ((adu[1] & 0x7F) != function) {
+                status = ku8MBInvalidFunction;
+                break;
+            }
+            if (adu[1] & 0x80) {
+                status = adu[2];
+                break;
+            }
+            switch (adu[1]) {
+                case kReadCoils:
+                case kReadDiscreteInputs:
+                case kReadHoldingRegisters:
+                case kReadInputRegisters:
+                    bytesLeft = adu[2];
+                    break;
+                case kWriteSingleCoil:
+                case kWriteSingleRegister:
+                case kWriteMultipleCoils:
+                case kWriteMultipleRegisters:
+                    bytesLeft = 3;
+                    break;
+            }
+        }
+        if ((millis() - startTime) > ku16MBResponseTimeout) {
+            status = ku8MBResponseTimedOut;
+        }
+    }
+
+    if (status == ku8MBSuccess && size >= 5) {
+        crc = 0xFFFF;
+        for (uint16_t k = 0; k < size - 2; k++) {
+            crc = crc16Update(crc, adu[k]);
+        }
+        if (lowByte(crc) != adu[size - 2] || highByte(crc) != adu[size - 1]) {
+            status = ku8MBInvalidCRC;
+        }
+    }
+
+    if (status == ku8MBSuccess) {
+        switch (adu[1]) {
+            case kReadCoils:
+            case kReadDiscreteInputs: {
+                // Bytes de bits em palavras, byte baixo primeiro
+                uint8_t k;
+                for (k = 0; k < (adu[2] >> 1); k++) {
+                    if (k < ku8MaxBufferSize) {
+                        _responseBuffer[k] = makeWord(adu[2 * k + 4], adu[2 * k + 3]);
+                    }
+                    _responseLength = k;
+                }
+                if (adu[2] % 2) {
+                    if (k < ku8MaxBufferSize) {
+                        _responseBuffer[k] = makeWord(0, adu[2 * k + 3]);
+                    }
+                    _responseLength = k + 1;
+                }
+                break;
+            }
+            case kReadHoldingRegisters:
+            case kReadInputRegisters:
+                for (uint8_t k = 0; k < (adu[2] >> 1); k++) {
+                    if (k < ku8MaxBufferSize) {
+                        _responseBuffer[k] = makeWord(adu[2 * k + 3], adu[2 * k + 4]);
+                    }
+                    _responseLength = k;
+                }
+                break;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file ModbusMaster.h
+ * @brief ModbusMaster para a simulação no PC (mesma interface da biblioteca 2.0.1)
+ *
+ * Monta e envia os quadros pelo Stream recebido em begin() e interpreta a
+ * resposta com as mesmas regras da biblioteca: descarta bytes pendentes antes
+ * de transmitir, espera até ku16MBResponseTimeout (2 s, fixo) e confere
+ * endereço, função, exceção e CRC. Assim o ciclo do firmware vê no barramento
+ * simulado os mesmos tempos e erros que veria no real.
+ */
+
+#ifndef SIM_MODBUS_MASTER_H
+#define SIM_MODBUS_MASTER_H
+
+#include "Arduino.h"
+
+class ModbusMaster {
+public:
+    ModbusMaster();
+
+    void begin(uint8_t slave, Stream& serial);
+    void idle(void (*callback)());
+    void preTransmission(void (*callback)());
+    void postTransmission(void (*callback)());
+
+    static const uint8_t ku8MBIllegalFunction = 0x01;
+    static const uint8_t ku8MBIllegalDataAddress = 0x02;
+    static const uint8_t ku8MBIllegalDataValue = 0x03;
+    static const uint8_t ku8MBSlaveDeviceFailure = 0x04;
+    static const uint8_t ku8MBSuccess = 0x00;
+    static const uint8_t ku8MBInvalidSlaveID = 0xE0;
+    static const uint8_t ku8MBInvalidFunction = 0xE1;
+    static const uint8_t ku8MBResponseTimedOut = 0xE2;
+    static const uint8_t ku8MBInvalidCRC = 0xE3;
+
+    uint16_t getResponseBuffer(uint8_t index);
+    void clearResponseBuffer();
+    uint8_t setTransmitBuffer(uint8_t index, uint16_t value);
+    void clearTransmitBuffer();
+
+    uint8_t readCoils(uint16_t readAddress, uint16_t bitQty);
+    uint8_t readDiscreteInputs(uint16_t readAddress, uint16_t bitQty);
+    uint8_t readHoldingRegisters(uint16_t readAddress, uint16_t readQty);
+    uint8_t readInputRegisters(uint16_t readAddress, uint8_t readQty);
+    uint8_t writeSingleCoil(uint16_t writeAddress, uint8_t state);
+    uint8_t writeSingleRegister(uint16_t writeAddress, uint16_t writeValue);
+    uint8_t writeMultipleCoils(uint16_t writeAddress, uint16_t bitQty);
+    uint8_t writeMultipleRegisters(uint16_t writeAddress, uint16_t writeQty);
+
+private:
+    static const uint8_t ku8MaxBufferSize = 64;
+    static const uint16_t ku16MBResponseTimeout = 2000;
+
+    Stream* _serial;
+    uint8_t _slave;
+    uint16_t _readAddress;
+    uint16_t _readQty;
+    uint16_t _writeAddress;
+    uint16_t _writeQty;
+    uint16_t _responseBuffer[ku8MaxBufferSize];
+    uint16_t _transmitBuffer[ku8MaxBufferSize];
+    uint8_t _responseLength;
+    void (*_idle)();
+    void (*_preTransmission)();
+    void (*_postTransmission)();
+
+    uint8_t transaction(uint8_t function);
+};
+
+#endif // SIM_MODBUS_MASTER_H
@@ -0,0 +1,30 @@
+/**
+ * @file Preferences.h
+ * @brief NVS simulado: cada chave é um arquivo em <raiz>/.nvs/<namespace>/
+ */
+
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include "Arduino.h"
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end() { _open = false; }
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    String getString(const char* key, const String& defaultValue = String());
+
+private:
+    std::string _dir;
+    bool _open = false;
+    bool _readOnly = false;
+
+    std::string keyPath(const char* key) const { return _dir + "/" + key; }
+};
+
+#endif // SIM_PREFERENCES_H
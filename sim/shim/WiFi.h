@@ -0,0 +1,29 @@
+/**
+ * @file WiFi.h
+ * @brief WiFi simulado: sempre desconectado (a simulação não tem rede)
+ */
+
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+class WiFiClass {
+public:
+    wl_status_t status() { return WL_DISCONNECTED; }
+    IPAddress localIP() { return IPAddress(); }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    int8_t RSSI() { return 0; }
+};
+
+extern WiFiClass WiFi;
+
+#endif // SIM_WIFI_H
@@ -0,0 +1,14 @@
+/**
+ * @file WiFiUdp.h
+ * @brief UDP simulado (só o tipo; o NTP não roda na simulação)
+ */
+
+#ifndef SIM_WIFI_UDP_H
+#define SIM_WIFI_UDP_H
+
+#include "Arduino.h"
+
+class WiFiUDP {
+};
+
+#endif // SIM_WIFI_UDP_H
@@ -0,0 +1,235 @@
+/**
+ * @file arduino_shim.cpp
+ * @brief Implementação do Arduino simulado (String, Print, tempo, pinos)
+ */
+
+#include "Arduino.h"
+#include "ESP.h"
+#include "WiFi.h"
+#include "esp_timer.h"
+#include "sim_clock.h"
+#include <stdarg.h>
+#include <random>
+
+EspClass ESP;
+WiFiClass WiFi;
+
+// ==================== TEMPO ====================
+
+unsigned long millis() {
+    return (unsigned long)(uint32_t)(simNowUs() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)(uint32_t)simNowUs();
+}
+
+int64_t esp_timer_get_time() {
+    return simNowUs();
+}
+
+void delay(unsigned long ms) {
+    simAdvanceUs((int64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    simAdvanceUs(us);
+}
+
+void yield() {
+    simIdlePoll(0);
+}
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2, const char* server3) {
+    (void)gmtOffsetSec;
+    (void)daylightOffsetSec;
+    (void)server1;
+    (void)server2;
+    (void)server3;
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms) {
+    (void)info;
+    (void)ms;
+    return false;
+}
+
+// ==================== PINOS ====================
+
+static uint8_t s_pins[64];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < sizeof(s_pins)) {
+        s_pins[pin] = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < sizeof(s_pins) ? s_pins[pin] : LOW;
+}
+
+// ==================== ALEATÓRIOS ====================
+
+static std::mt19937 s_random(1);
+
+void randomSeed(unsigned long seed) {
+    s_random.seed((uint32_t)seed);
+}
+
+long random(long howBig) {
+    return howBig <= 0 ? 0 : (long)(s_random() % (unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig) {
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+void EspClass::restart() {
+    fprintf(stderr, "[Sim] ESP.restart() chamado; encerrando\n");
+    exit(3);
+}
+
+// ==================== STRING ====================
+
+bool String::equalsIgnoreCase(const String& other) const {
+    if (_s.size() != other._s.size()) {
+        return false;
+    }
+    for (size_t k = 0; k < _s.size(); k++) {
+        if (tolower((unsigned char)_s[k]) != tolower((unsigned char)other._s[k])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+        std::swap(from, to);
+    }
+    if (from >= _s.size()) {
+        return String();
+    }
+    return String(_s.substr(from, to - from));
+}
+
+void String::replace(const String& find, const String& replacement) {
+    if (find._s.empty()) {
+        return;
+    }
+    size_t at = 0;
+    while ((at = _s.find(find._s, at)) != std::string::npos) {
+        _s.replace(at, find._s.size(), replacement._s);
+        at += replacement._s.size();
+    }
+}
+
+void String::trim() {
+    size_t begin = 0;
+    size_t end = _s.size();
+    while (begin < end && isspace((unsigned char)_s[begin])) {
+        begin++;
+    }
+    while (end > begin && isspace((unsigned char)_s[end - 1])) {
+        end--;
+    }
+    _s = _s.substr(begin, end - begin);
+}
+
+void String::fromSigned(long long value, unsigned char base) {
+    if (base == 10) {
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), "%lld", value);
+        _s = buffer;
+        return;
+    }
+    fromUnsigned((unsigned long long)value, base);
+}
+
+void String::fromUnsigned(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) {
+        base = 10;
+    }
+    char buffer[66];
+    int at = sizeof(buffer) - 1;
+    buffer[at] = '\0';
+    do {
+        unsigned digit = (unsigned)(value % base);
+        buffer[--at] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value > 0 && at > 0);
+    _s = &buffer[at];
+}
+
+void String::fromDouble(double value, unsigned int decimals) {
+    if (isnan(value)) {
+        _s = "nan";
+    } else if (isinf(value)) {
+        _s = value > 0 ? "inf" : "-inf";
+    } else {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+        _s = buffer;
+    }
+}
+
+// ==================== PRINT / STREAM ====================
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    for (size_t k = 0; k < size; k++) {
+        written += write(buffer[k]);
+    }
+    return written;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write((const uint8_t*)buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    int64_t startUs = simNowUs();
+    while (count < length) {
+        int value = read();
+        if (value < 0) {
+            if (simNowUs() - startUs >= (int64_t)_timeoutMs * 1000) {
+                break;
+            }
+            simIdlePoll(0);
+            continue;
+        }
+        buffer[count++] = (uint8_t)value;
+    }
+    return count;
+}
+
+// ==================== REDE ====================
+
+bool IPAddress::fromString(const char* text) {
+    unsigned a, b, c, d;
+    if (text == nullptr || sscanf(text, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return false;
+    }
+    *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+    return true;
+}
+
+String IPAddress::toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+}
@@ -0,0 +1,13 @@
+/**
+ * @file esp_timer.h
+ * @brief Temporizador de µs do ESP-IDF sobre o relógio virtual
+ */
+
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time();
+
+#endif // SIM_ESP_TIMER_H
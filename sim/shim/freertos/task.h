@@ -0,0 +1,15 @@
+/**
+ * @file task.h
+ * @brief Tarefas simuladas (vTaskDelay avança o relógio virtual)
+ */
+
+#ifndef SIM_FREERTOS_TASK_H
+#define SIM_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+#endif // SIM_FREERTOS_TASK_H
@@ -0,0 +1,64 @@
+/**
+ * @file freertos_shim.cpp
+ * @brief FreeRTOS simulado (uma tarefa, relógio virtual)
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sim_clock.h"
+
+// Contador de posse: ajuda a achar take/give desbalanceados na simulação
+struct SimSemaphore {
+    int depth;
+};
+
+void vTaskDelay(TickType_t ticks) {
+    simAdvanceUs((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(simNowUs() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    static int s_loopTask;
+    return &s_loopTask;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new SimSemaphore{0};
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return new SimSemaphore{0};
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    (void)ticks;
+    if (semaphore == nullptr) {
+        return pdFALSE;
+    }
+    static_cast<SimSemaphore*>(semaphore)->depth++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore == nullptr || static_cast<SimSemaphore*>(semaphore)->depth <= 0) {
+        return pdFALSE;
+    }
+    static_cast<SimSemaphore*>(semaphore)->depth--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return xSemaphoreTake(semaphore, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    return xSemaphoreGive(semaphore);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete static_cast<SimSemaphore*>(semaphore);
+}
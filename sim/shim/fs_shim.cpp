@@ -0,0 +1,288 @@
+/**
+ * @file fs_shim.cpp
+ * @brief LittleFS e Preferences simulados sobre um diretório do PC
+ */
+
+#include "FS.h"
+#include "LittleFS.h"
+#include "Preferences.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LittleFSFS LittleFS;
+
+static std::string s_root = ".";
+
+void simFsSetRoot(const char* root) {
+    s_root = root;
+}
+
+const char* simFsRoot() {
+    return s_root.c_str();
+}
+
+static std::string hostPath(const std::string& path) {
+    if (path.empty() || path[0] != '/') {
+        return s_root + "/" + path;
+    }
+    return s_root + path;
+}
+
+static bool isHostDirectory(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+namespace fs {
+
+// ==================== FILE ====================
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    return _file ? fwrite(buffer, 1, size, _file.get()) : 0;
+}
+
+int File::available() {
+    if (!_file) {
+        return 0;
+    }
+    long at = ftell(_file.get());
+    return at < 0 ? 0 : (int)(size() - (size_t)at);
+}
+
+int File::read() {
+    if (!_file) {
+        return -1;
+    }
+    int value = fgetc(_file.get());
+    return value == EOF ? -1 : value;
+}
+
+int File::peek() {
+    if (!_file) {
+        return -1;
+    }
+    int value = fgetc(_file.get());
+    if (value == EOF) {
+        return -1;
+    }
+    ungetc(value, _file.get());
+    return value;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return _file ? fread(buffer, 1, size, _file.get()) : 0;
+}
+
+void File::flush() {
+    if (_file) {
+        fflush(_file.get());
+    }
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+    return _file && fseek(_file.get(), (long)position, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!_file) {
+        return 0;
+    }
+    long at = ftell(_file.get());
+    return at < 0 ? 0 : (size_t)at;
+}
+
+size_t File::size() const {
+    if (!_file) {
+        return 0;
+    }
+    fflush(_file.get());
+    struct stat info;
+    return fstat(fileno(_file.get()), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+void File::close() {
+    _file.reset();
+    _directory = false;
+    _entries.clear();
+}
+
+const char* File::name() const {
+    size_t slash = _path.rfind('/');
+    return slash == std::string::npos ? _path.c_str() : _path.c_str() + slash + 1;
+}
+
+File File::openNextFile(const char* mode) {
+    if (!_directory || _nextEntry >= _entries.size()) {
+        return File();
+    }
+    std::string child = (_path == "/" ? "" : _path) + "/" + _entries[_nextEntry++];
+    return LittleFS.open(child.c_str(), mode);
+}
+
+// ==================== FS ====================
+
+File FS::open(const char* path, const char* mode, bool create) {
+    (void)create;
+    File file;
+    file._path = path;
+    std::string full = hostPath(path);
+
+    if (isHostDirectory(full)) {
+        DIR* dir = opendir(full.c_str());
+        if (dir) {
+            struct dirent* entry;
+            while ((entry = readdir(dir)) != nullptr) {
+                if (entry->d_name[0] != '.') {
+                    file._entries.push_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+            file._directory = true;
+        }
+        return file;
+    }
+
+    std::string hostMode = mode;
+    if (hostMode.find('b') == std::string::npos) {
+        hostMode += "b";
+    }
+    FILE* handle = fopen(full.c_str(), hostMode.c_str());
+    if (handle) {
+        file._file.reset(handle, fclose);
+    }
+    return file;
+}
+
+bool FS::exists(const char* path) {
+    struct stat info;
+    return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return ::unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char* path) {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+} // namespace fs
+
+// ==================== LITTLEFS ====================
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    (void)formatOnFail;
+    (void)basePath;
+    (void)maxOpenFiles;
+    (void)partitionLabel;
+    return isHostDirectory(s_root);
+}
+
+// Soma dos tamanhos dos arquivos (sem a sobrecarga de blocos do LittleFS real)
+static size_t directoryBytes(const std::string& path) {
+    size_t total = 0;
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return 0;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string child = path + "/" + entry->d_name;
+        struct stat info;
+        if (stat(child.c_str(), &info) != 0) {
+            continue;
+        }
+        total += S_ISDIR(info.st_mode) ? directoryBytes(child) : (size_t)info.st_size;
+    }
+    closedir(dir);
+    return total;
+}
+
+size_t LittleFSFS::usedBytes() {
+    return directoryBytes(s_root);
+}
+
+// ==================== PREFERENCES ====================
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+    (void)partitionLabel;
+    std::string nvs = s_root + "/.nvs";
+    ::mkdir(nvs.c_str(), 0755);
+    _dir = nvs + "/" + name;
+    ::mkdir(_dir.c_str(), 0755);
+    _readOnly = readOnly;
+    _open = isHostDirectory(_dir);
+    return _open;
+}
+
+bool Preferences::clear() {
+    if (!_open || _readOnly) {
+        return false;
+    }
+    DIR* dir = opendir(_dir.c_str());
+    if (!dir) {
+        return false;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] != '.') {
+            ::unlink((_dir + "/" + entry->d_name).c_str());
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    return _open && !_readOnly && ::unlink(keyPath(key).c_str()) == 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    struct stat info;
+    return _open && stat(keyPath(key).c_str(), &info) == 0;
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    if (!_open || _readOnly) {
+        return 0;
+    }
+    FILE* handle = fopen(keyPath(key).c_str(), "wb");
+    if (!handle) {
+        return 0;
+    }
+    size_t length = strlen(value);
+    size_t written = fwrite(value, 1, length, handle);
+    fclose(handle);
+    return written == length ? length : 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+    if (!_open) {
+        return defaultValue;
+    }
+    FILE* handle = fopen(keyPath(key).c_str(), "rb");
+    if (!handle) {
+        return defaultValue;
+    }
+    std::string value;
+    char buffer[1024];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), handle)) > 0) {
+        value.append(buffer, count);
+    }
+    fclose(handle);
+    return String(value);
+}
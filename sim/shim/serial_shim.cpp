@@ -0,0 +1,69 @@
+/**
+ * @file serial_shim.cpp
+ * @brief Implementação das UARTs simuladas
+ */
+
+#include "HardwareSerial.h"
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+
+uint8_t serialConfigCharBits(uint32_t config) {
+    uint8_t dataBits = 5 + ((config >> 2) & 0x03);
+    uint8_t parityBits = (config & 0x03) >= 2 ? 1 : 0;
+    uint8_t stopBits = ((config >> 4) & 0x03) == 0x03 ? 2 : 1;
+    return 1 + dataBits + parityBits + stopBits;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin,
+                           bool invert, unsigned long timeoutMs, uint8_t rxfifoFullThrhd) {
+    (void)rxPin;
+    (void)txPin;
+    (void)invert;
+    (void)timeoutMs;
+    (void)rxfifoFullThrhd;
+    _baud = baud;
+    _config = config;
+    _started = true;
+    if (_model) {
+        _model->portBegin(baud, config);
+    }
+}
+
+void HardwareSerial::updateBaudRate(unsigned long baud) {
+    _baud = baud;
+    if (_model) {
+        _model->portBegin(baud, _config);
+    }
+}
+
+int HardwareSerial::available() {
+    return _model ? _model->portAvailable() : 0;
+}
+
+int HardwareSerial::read() {
+    return _model ? _model->portRead() : -1;
+}
+
+int HardwareSerial::peek() {
+    return _model ? _model->portPeek() : -1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (_model) {
+        return _model->portWrite(buffer, size);
+    }
+    if (_echo) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+void HardwareSerial::flush() {
+    if (_model) {
+        _model->portFlush();
+    } else if (_echo) {
+        fflush(stdout);
+    }
+}
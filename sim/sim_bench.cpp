@@ -0,0 +1,222 @@
+/**
+ * @file sim_bench.cpp
+ * @brief Implementação da varredura de desempenho (ver sim_bench.h)
+ */
+
+#include "sim_bench.h"
+#include "config.h"
+#include "device_profiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/wait.h>
+
+SimBenchAxes simBenchDefaultAxes() {
+    SimBenchAxes axes;
+    axes.devices = { 1, 2, 4, 6, 8, MAX_DEVICES };
+    axes.registers = { 1, 4, 8, 16 };
+    axes.layouts = { "none", "contiguous", "sparse" };
+    axes.bauds = { 9600, 19200, 115200 };
+    axes.codes = { "none", "simple:8", "complex:8", "complex:max" };
+    return axes;
+}
+
+static std::vector<std::string> splitList(const char* text) {
+    std::vector<std::string> items;
+    std::string rest = text;
+    size_t at = 0;
+    while (at <= rest.size()) {
+        size_t next = rest.find(',', at);
+        if (next == std::string::npos) {
+            next = rest.size();
+        }
+        items.push_back(rest.substr(at, next - at));
+        at = next + 1;
+    }
+    return items;
+}
+
+bool simBenchParseList(const char* text, std::vector<int>* values, int minimum, int maximum) {
+    values->clear();
+    std::vector<std::string> items = splitList(text);
+    for (size_t k = 0; k < items.size(); k++) {
+        char* end = nullptr;
+        long value = strtol(items[k].c_str(), &end, 10);
+        if (items[k].empty() || *end != '\0' || value < minimum || value > maximum) {
+            return false;
+        }
+        values->push_back((int)value);
+    }
+    return !values->empty();
+}
+
+bool simBenchParseList(const char* text, std::vector<std::string>* values) {
+    *values = splitList(text);
+    for (size_t k = 0; k < values->size(); k++) {
+        if ((*values)[k].empty()) {
+            return false;
+        }
+    }
+    return !values->empty();
+}
+
+// Linhas de cálculo até encher calculationCode (ou até a quantidade pedida)
+static bool buildCode(const std::string& spec, int devices, int registers, std::string* code, int* lines) {
+    code->clear();
+    *lines = 0;
+    if (spec == "none") {
+        return true;
+    }
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    std::string count = colon == std::string::npos ? "" : spec.substr(colon + 1);
+    if ((kind != "simple" && kind != "complex") || count.empty()) {
+        return false;
+    }
+    int wanted = count == "max" ? 1000 : atoi(count.c_str());
+    if (wanted <= 0) {
+        return false;
+    }
+
+    char line[256];
+    for (int k = 0; k < wanted; k++) {
+        int i = k % devices;
+        int j = (k / devices) % registers;
+        if (kind == "simple") {
+            snprintf(line, sizeof(line), "s%d = {d[%d][%d]} * 0.1 + 2\n", k, i, j);
+        } else {
+            snprintf(line, sizeof(line),
+                     "c%d = if({d[%d][%d]} > 500, sqrt(abs({d[%d][%d]} - 500)), pow({d[%d][%d]} / 100, 2)) * cos(0.5)"
+                     " + log(1 + {d[%d][%d]})\n", k, i, j, i, j, i, j, i, j);
+        }
+        if (code->size() + strlen(line) >= sizeof(config.calculationCode)) {
+            break;
+        }
+        *code += line;
+        (*lines)++;
+    }
+    return *lines > 0;
+}
+
+static bool writeScenario(const char* path, int devices, int registers, const std::string& layout, int baud,
+                          const std::string& code) {
+    // sparse: buraco de maxGap + 1 entre registros, um bloco por registro
+    int stride = layout == "sparse" ? PROFILE_DEFAULT_MAX_GAP + 2 : 1;
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "baud %d\n", baud);
+    if (layout != "none") {
+        fprintf(file, "profile bench 0");
+        for (int j = 0; j < registers; j++) {
+            fprintf(file, " %d", j * stride);
+        }
+        fprintf(file, "\n");
+    }
+    for (int d = 1; d <= devices; d++) {
+        fprintf(file, "device %d dev%d%s\n", d, d, layout != "none" ? " profile=bench" : "");
+        for (int j = 0; j < registers; j++) {
+            fprintf(file, "reg %d %d 0 v%d_%d noise:500:50\n", d, j * stride, d, j);
+        }
+    }
+    size_t at = 0;
+    while (at < code.size()) {
+        size_t end = code.find('\n', at);
+        fprintf(file, "code %s\n", code.substr(at, end - at).c_str());
+        at = end + 1;
+    }
+    return fclose(file) == 0;
+}
+
+// Saída do filho: última linha que começa com '{'
+static bool runChild(const std::string& command, std::string* json, int* status) {
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        return false;
+    }
+    char buffer[4096];
+    json->clear();
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+        if (buffer[0] == '{') {
+            *json = buffer;
+        }
+    }
+    int result = pclose(pipe);
+    *status = WIFEXITED(result) ? WEXITSTATUS(result) : -1;
+    while (!json->empty() && (json->back() == '\n' || json->back() == '\r')) {
+        json->pop_back();
+    }
+    return true;
+}
+
+static int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+int simBenchRun(const char* program, const SimBenchAxes& axes, uint32_t cycles) {
+    char rootTemplate[] = "/tmp/sim_bench_XXXXXX";
+    const char* root = mkdtemp(rootTemplate);
+    if (root == nullptr) {
+        fprintf(stderr, "[Bench] Não foi possível criar o diretório temporário\n");
+        return 1;
+    }
+    std::string scenarioPath = std::string(root) + "/bench.sim";
+
+    size_t total = axes.devices.size() * axes.registers.size() * axes.layouts.size() * axes.bauds.size() *
+                   axes.codes.size();
+    size_t done = 0;
+    int failures = 0;
+    for (size_t a = 0; a < axes.devices.size(); a++) {
+        for (size_t b = 0; b < axes.registers.size(); b++) {
+            for (size_t c = 0; c < axes.layouts.size(); c++) {
+                for (size_t e = 0; e < axes.bauds.size(); e++) {
+                    for (size_t f = 0; f < axes.codes.size(); f++) {
+                        int devices = axes.devices[a];
+                        int registers = axes.registers[b];
+                        const std::string& layout = axes.layouts[c];
+                        int baud = axes.bauds[e];
+                        const std::string& codeSpec = axes.codes[f];
+                        done++;
+
+                        printf("{\"devices\":%d,\"registers\":%d,\"layout\":\"%s\",\"baud\":%d,\"code\":\"%s\",",
+                               devices, registers, layout.c_str(), baud, codeSpec.c_str());
+
+                        std::string code;
+                        int lines = 0;
+                        if (!buildCode(codeSpec, devices, registers, &code, &lines) ||
+                            (layout != "none" && layout != "contiguous" && layout != "sparse")) {
+                            printf("\"error\":\"configuração inválida\"}\n");
+                            failures++;
+                            continue;
+                        }
+                        printf("\"codeLines\":%d,\"codeBytes\":%u,", lines, (unsigned)code.size());
+
+                        std::string fsPath = std::string(root) + "/fs" + std::to_string(done);
+                        std::string json;
+                        int status = -1;
+                        bool ran = writeScenario(scenarioPath.c_str(), devices, registers, layout, baud, code) &&
+                                   runChild("'" + std::string(program) + "' '" + scenarioPath + "' --json --cycles " +
+                                            std::to_string(cycles) + " --fs '" + fsPath + "' 2>/dev/null",
+                                            &json, &status);
+                        nftw(fsPath.c_str(), removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+
+                        // Código 1 = ciclos acima do intervalo (o resultado vale); outros = falha
+                        if (!ran || json.empty() || (status != 0 && status != 1)) {
+                            printf("\"error\":\"simulação terminou com código %d\"}\n", status);
+                            failures++;
+                        } else {
+                            printf("%s\n", json.c_str() + 1);
+                        }
+                        fflush(stdout);
+                        fprintf(stderr, "[Bench] %u/%u\r", (unsigned)done, (unsigned)total);
+                    }
+                }
+            }
+        }
+    }
+    fprintf(stderr, "\n");
+    nftw(root, removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+    return failures;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file sim_bench.h
+ * @brief Varredura de desempenho do ciclo na simulação (sim --bench)
+ *
+ * Gera um cenário para cada combinação de:
+ * - Quantidade de dispositivos (1 a MAX_DEVICES)
+ * - Registros por dispositivo
+ * - Disposição dos registros: none (sem perfil, um a um), contiguous (perfil,
+ *   registros vizinhos em um bloco) ou sparse (perfil com buracos maiores que
+ *   maxGap, um bloco por registro)
+ * - Baud rate
+ * - Código de cálculo: none, simple:N ou complex:N (N linhas, ou max para
+ *   encher calculationCode); simple é uma conta por linha, complex usa if(),
+ *   sqrt(), pow(), cos() e log()
+ *
+ * e executa a simulação em um processo próprio (LittleFS novo, nenhum estado
+ * herdado da configuração anterior). Cada configuração vira uma linha JSON na
+ * saída padrão: os parâmetros seguidos do resultado de sim --json (duração de
+ * cada fase, quadros, pico do heap e alocações por ciclo).
+ */
+
+#ifndef SIM_BENCH_H
+#define SIM_BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct SimBenchAxes {
+    std::vector<int> devices;
+    std::vector<int> registers;
+    std::vector<std::string> layouts;
+    std::vector<int> bauds;
+    std::vector<std::string> codes;
+};
+
+/**
+ * @brief Eixos padrão da varredura
+ */
+SimBenchAxes simBenchDefaultAxes();
+
+/**
+ * @brief Lê "a,b,c" em um eixo (false se algum valor é inválido)
+ */
+bool simBenchParseList(const char* text, std::vector<int>* values, int minimum, int maximum);
+bool simBenchParseList(const char* text, std::vector<std::string>* values);
+
+/**
+ * @brief Executa a varredura
+ * @param program Caminho deste executável (argv[0])
+ * @return Quantidade de configurações que falharam
+ */
+int simBenchRun(const char* program, const SimBenchAxes& axes, uint32_t cycles);
+
+#endif // SIM_BENCH_H
@@ -0,0 +1,339 @@
+/**
+ * @file sim_bus.cpp
+ * @brief Implementação do barramento RS485 e dos escravos simulados
+ */
+
+#include "sim_bus.h"
+#include "sim_clock.h"
+
+SimBus simBus;
+
+uint16_t simCrc16(const uint8_t* data, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void put16(std::vector<uint8_t>& frame, uint16_t value) {
+    frame.push_back(value >> 8);
+    frame.push_back(value & 0xFF);
+}
+
+static double waveValue(const SimWave& wave, int64_t nowUs, uint32_t noise) {
+    double t = nowUs / 1e6;
+    switch (wave.kind) {
+        case SimWave::SINE:
+            return wave.a + wave.b * sin(2.0 * PI * t * 1000.0 / wave.periodMs);
+        case SimWave::RAMP:
+            return wave.a + wave.b * t;
+        case SimWave::NOISE:
+            return wave.a + wave.b * ((noise % 20001) / 10000.0 - 1.0);
+        case SimWave::SQUARE:
+            return fmod(t * 1000.0, wave.periodMs) < wave.periodMs / 2 ? wave.a : wave.b;
+        case SimWave::CONST:
+        default:
+            return wave.a;
+    }
+}
+
+// ==================== ESCRAVO ====================
+
+uint16_t SimSlave::registerValue(uint16_t address, int64_t nowUs, bool* known) const {
+    std::map<uint16_t, uint16_t>::const_iterator value = registers.find(address);
+    if (value != registers.end()) {
+        *known = true;
+        return value->second;
+    }
+    std::map<uint16_t, SimWave>::const_iterator wave = waves.find(address);
+    if (wave != waves.end()) {
+        *known = true;
+        // Ruído determinístico por endereço e instante (reprodutível com a mesma semente do cenário)
+        uint32_t noise = (uint32_t)(nowUs / 1000) * 2654435761u + address * 40503u;
+        double raw = round(waveValue(wave->second, nowUs, noise));
+        raw = constrain(raw, -32768.0, 65535.0);
+        return (uint16_t)(int32_t)raw;
+    }
+    *known = false;
+    return 0;
+}
+
+bool SimSlave::bitValue(uint16_t address, int64_t nowUs, bool* known) const {
+    std::map<uint16_t, bool>::const_iterator value = bits.find(address);
+    if (value != bits.end()) {
+        *known = true;
+        return value->second;
+    }
+    std::map<uint16_t, SimWave>::const_iterator wave = bitWaves.find(address);
+    if (wave != bitWaves.end()) {
+        *known = true;
+        return waveValue(wave->second, nowUs, 0) != 0.0;
+    }
+    *known = false;
+    return false;
+}
+
+void SimSlave::exception(uint8_t function, uint8_t code, std::vector<uint8_t>& response) {
+    response.clear();
+    response.push_back(address);
+    response.push_back(function | 0x80);
+    response.push_back(code);
+    stats.exceptions++;
+}
+
+void SimSlave::handle(const uint8_t* request, uint16_t length, int64_t nowUs, std::vector<uint8_t>& response) {
+    response.clear();
+    stats.requests++;
+    bool broadcast = request[0] == 0;
+    uint8_t function = request[1];
+    uint16_t start = length >= 4 ? (uint16_t)((request[2] << 8) | request[3]) : 0;
+    uint16_t quantity = length >= 6 ? (uint16_t)((request[4] << 8) | request[5]) : 0;
+    bool known = false;
+
+    switch (function) {
+        case 0x01:
+        case 0x02: {
+            if (broadcast) {
+                return;
+            }
+            if (length != 6 || quantity == 0 || quantity > 2000) {
+                exception(function, 0x03, response);
+                return;
+            }
+            response.push_back(address);
+            response.push_back(function);
+            response.push_back((uint8_t)((quantity + 7) / 8));
+            uint8_t current = 0;
+            for (uint16_t k = 0; k < quantity; k++) {
+                bool defined;
+                if (bitValue(start + k, nowUs, &defined)) {
+                    current |= 1 << (k % 8);
+                }
+                if (strict && !defined) {
+                    exception(function, 0x02, response);
+                    return;
+                }
+                if (k % 8 == 7 || k == quantity - 1) {
+                    response.push_back(current);
+                    current = 0;
+                }
+            }
+            return;
+        }
+        case 0x03:
+        case 0x04: {
+            if (broadcast) {
+                return;
+            }
+            if (length != 6 || quantity == 0 || quantity > maxRegisters) {
+                exception(function, 0x03, response);
+                return;
+            }
+            response.push_back(address);
+            response.push_back(function);
+            response.push_back((uint8_t)(quantity * 2));
+            for (uint16_t k = 0; k < quantity; k++) {
+                uint16_t value = registerValue(start + k, nowUs, &known);
+                if (strict && !known) {
+                    exception(function, 0x02, response);
+                    return;
+                }
+                put16(response, value);
+            }
+            return;
+        }
+        case 0x05:
+            if (length != 6 || (quantity != 0xFF00 && quantity != 0x0000)) {
+                exception(function, 0x03, response);
+                break;
+            }
+            bits[start] = quantity == 0xFF00;
+            stats.writes++;
+            response.assign(request, request + 6);
+            break;
+        case 0x06:
+            if (length != 6) {
+                exception(function, 0x03, response);
+                break;
+            }
+            registers[start] = quantity;
+            stats.writes++;
+            response.assign(request, request + 6);
+            break;
+        case 0x0F: {
+            uint8_t byteCount = length >= 7 ? request[6] : 0;
+            if (quantity == 0 || quantity > 1968 || byteCount != (quantity + 7) / 8 || length != 7 + byteCount) {
+                exception(function, 0x03, response);
+                break;
+            }
+            for (uint16_t k = 0; k < quantity; k++) {
+                bits[start + k] = (request[7 + k / 8] >> (k % 8)) & 0x01;
+            }
+            stats.writes += quantity;
+            response.assign(request, request + 6);
+            break;
+        }
+        case 0x10: {
+            uint8_t byteCount = length >= 7 ? request[6] : 0;
+            if (quantity == 0 || quantity > 123 || byteCount != quantity * 2 || length != 7 + byteCount) {
+                exception(function, 0x03, response);
+                break;
+            }
+            for (uint16_t k = 0; k < quantity; k++) {
+                registers[start + k] = (uint16_t)((request[7 + 2 * k] << 8) | request[8 + 2 * k]);
+            }
+            stats.writes += quantity;
+            response.assign(request, request + 6);
+            break;
+        }
+        default:
+            exception(function, 0x01, response);
+            break;
+    }
+
+    if (broadcast) {
+        response.clear();                  // Escravos não respondem ao endereço 0
+    }
+}
+
+// ==================== BARRAMENTO ====================
+
+SimBus::SimBus() : _txStartUs(0), _baud(9600), _config(SERIAL_8N1), _charUs(1042), _random(1), _stats() {
+}
+
+SimSlave& SimBus::slave(uint8_t address) {
+    SimSlave& entry = _slaves[address];
+    entry.address = address;
+    return entry;
+}
+
+SimSlave* SimBus::findSlave(uint8_t address) {
+    std::map<uint8_t, SimSlave>::iterator entry = _slaves.find(address);
+    return entry == _slaves.end() ? nullptr : &entry->second;
+}
+
+double SimBus::uniform() {
+    return (_random() & 0xFFFFFF) / (double)0x1000000;
+}
+
+void SimBus::portBegin(unsigned long baud, uint32_t config) {
+    _baud = baud > 0 ? baud : 9600;
+    _config = config;
+    _charUs = (uint32_t)((serialConfigCharBits(config) * 1000000ULL + _baud - 1) / _baud);
+    _tx.clear();
+    _rx.clear();
+}
+
+size_t SimBus::portWrite(const uint8_t* buffer, size_t size) {
+    if (_tx.empty()) {
+        _txStartUs = simNowUs();
+    }
+    _tx.insert(_tx.end(), buffer, buffer + size);
+    return size;
+}
+
+void SimBus::portFlush() {
+    if (_tx.empty()) {
+        return;
+    }
+    int64_t endUs = _txStartUs + (int64_t)_tx.size() * _charUs;
+    simAdvanceTo(endUs);
+    _stats.txBytes += _tx.size();
+    _stats.busyUs += (int64_t)_tx.size() * _charUs;
+    std::vector<uint8_t> frame;
+    frame.swap(_tx);
+    deliver(frame.data(), (uint16_t)frame.size(), endUs);
+}
+
+void SimBus::deliver(const uint8_t* frame, uint16_t length, int64_t endUs) {
+    _stats.requests++;
+    if (length < 4 || simCrc16(frame, length - 2) != (uint16_t)(frame[length - 2] | (frame[length - 1] << 8))) {
+        _stats.unanswered++;                   // Quadro inválido: nenhum escravo responde
+        return;
+    }
+    uint16_t pdu = length - 2;
+    std::vector<uint8_t> response;
+
+    if (frame[0] == 0) {
+        _stats.broadcasts++;
+        for (std::map<uint8_t, SimSlave>::iterator entry = _slaves.begin(); entry != _slaves.end(); ++entry) {
+            SimSlave& target = entry->second;
+            if (target.baud != 0 && target.baud != _baud) {
+                target.stats.ignored++;
+                continue;
+            }
+            target.handle(frame, pdu, endUs, response);
+        }
+        return;
+    }
+
+    SimSlave* target = findSlave(frame[0]);
+    if (target == nullptr) {
+        _stats.unanswered++;
+        return;
+    }
+    if (target->baud != 0 && target->baud != _baud) {
+        target->stats.ignored++;
+        _stats.unanswered++;
+        return;
+    }
+    if (target->timeoutRate > 0.0 && uniform() < target->timeoutRate) {
+        target->stats.requests++;
+        target->stats.dropped++;
+        _stats.unanswered++;
+        return;
+    }
+
+    target->handle(frame, pdu, endUs, response);
+    if (response.empty()) {
+        return;
+    }
+    uint16_t crc = simCrc16(response.data(), (uint16_t)response.size());
+    response.push_back(crc & 0xFF);
+    response.push_back(crc >> 8);
+    if (target->crcRate > 0.0 && uniform() < target->crcRate) {
+        response[response.size() - 1] ^= 0x5A;
+        target->stats.corrupted++;
+    }
+    target->stats.replies++;
+
+    int64_t atUs = endUs + target->latencyUs + (int64_t)(uniform() * target->jitterUs);
+    for (size_t k = 0; k < response.size(); k++) {
+        atUs += _charUs;
+        _rx.push_back({ response[k], atUs });
+    }
+    _stats.rxBytes += response.size();
+    _stats.busyUs += (int64_t)response.size() * _charUs;
+}
+
+int SimBus::portAvailable() {
+    int64_t nowUs = simNowUs();
+    int count = 0;
+    for (std::deque<RxByte>::const_iterator entry = _rx.begin(); entry != _rx.end() && entry->atUs <= nowUs; ++entry) {
+        count++;
+    }
+    if (count == 0) {
+        simIdlePoll(_rx.empty() ? 0 : _rx.front().atUs);
+    }
+    return count;
+}
+
+int SimBus::portRead() {
+    if (_rx.empty() || _rx.front().atUs > simNowUs()) {
+        return -1;
+    }
+    uint8_t value = _rx.front().value;
+    _rx.pop_front();
+    return value;
+}
+
+int SimBus::portPeek() {
+    if (_rx.empty() || _rx.front().atUs > simNowUs()) {
+        return -1;
+    }
+    return _rx.front().value;
+}
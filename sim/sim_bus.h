@@ -0,0 +1,145 @@
+/**
+ * @file sim_bus.h
+ * @brief Barramento RS485 simulado com escravos Modbus RTU programáveis
+ *
+ * Ligado ao Serial2: o quadro transmitido pelo mestre ocupa a linha pelo
+ * tempo de caractere da configuração (start + dados + paridade + stop) e,
+ * no fim da transmissão (flush), é entregue aos escravos. O escravo endereçado
+ * responde depois da sua latência (mais um atraso aleatório até o jitter) e
+ * os bytes da resposta chegam um a um no tempo de caractere. Cada escravo pode
+ * descartar requisições (timeout) ou corromper o CRC com uma probabilidade,
+ * ou só responder a um baud rate.
+ *
+ * Os registradores do escravo são uma tabela única para 0x03/0x04 e uma para
+ * bobinas/entradas discretas (0x01/0x02); endereços com forma de onda
+ * (SimWave) mudam com o tempo simulado até o mestre escrever neles.
+ */
+
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+#include <deque>
+#include <random>
+
+/**
+ * @brief Valor de um registrador em função do tempo simulado
+ */
+struct SimWave {
+    enum Kind { CONST, SINE, RAMP, NOISE, SQUARE };
+    Kind kind;
+    double a;                              // CONST: valor; SINE/NOISE: centro; RAMP: início; SQUARE: nível baixo
+    double b;                              // SINE/NOISE: amplitude; RAMP: incremento por segundo; SQUARE: nível alto
+    double periodMs;                       // SINE/SQUARE: período
+};
+
+/**
+ * @brief Contadores de um escravo
+ */
+struct SimSlaveStats {
+    uint32_t requests;                     // Quadros endereçados a ele (incluindo broadcast)
+    uint32_t replies;
+    uint32_t exceptions;
+    uint32_t dropped;                      // Timeouts injetados
+    uint32_t corrupted;                    // CRC corrompido injetado
+    uint32_t ignored;                      // Baud rate diferente do escravo
+    uint32_t writes;                       // Registradores/bobinas escritos
+};
+
+class SimSlave {
+public:
+    uint8_t address = 1;
+    std::string name;
+    uint32_t latencyUs = 2000;             // Fim da requisição até o primeiro bit da resposta
+    uint32_t jitterUs = 0;
+    double timeoutRate = 0.0;              // Probabilidade de não responder
+    double crcRate = 0.0;                  // Probabilidade de resposta com CRC errado
+    uint32_t baud = 0;                     // 0 = responde em qualquer baud rate
+    bool strict = false;                   // Endereço sem valor definido responde exceção 0x02
+    uint16_t maxRegisters = 125;           // Maior leitura aceita (registradores)
+
+    std::map<uint16_t, uint16_t> registers;
+    std::map<uint16_t, SimWave> waves;
+    std::map<uint16_t, bool> bits;
+    std::map<uint16_t, SimWave> bitWaves;
+    SimSlaveStats stats = {};
+
+    /**
+     * @brief Processa uma requisição válida (CRC conferido)
+     * @param response Resposta sem CRC (vazia se não responde: broadcast)
+     */
+    void handle(const uint8_t* request, uint16_t length, int64_t nowUs, std::vector<uint8_t>& response);
+
+    uint16_t registerValue(uint16_t address, int64_t nowUs, bool* known) const;
+    bool bitValue(uint16_t address, int64_t nowUs, bool* known) const;
+
+private:
+    void exception(uint8_t function, uint8_t code, std::vector<uint8_t>& response);
+};
+
+/**
+ * @brief Contadores do barramento
+ */
+struct SimBusStats {
+    uint32_t requests;                     // Quadros do mestre
+    uint32_t broadcasts;
+    uint32_t unanswered;                   // Sem escravo, descartados ou em outro baud rate
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    int64_t busyUs;                        // Tempo com a linha ocupada (TX + RX)
+};
+
+class SimBus : public SerialPortModel {
+public:
+    SimBus();
+
+    void seed(uint32_t value) { _random.seed(value); }
+
+    /**
+     * @brief Escravo no endereço (cria se não existe)
+     */
+    SimSlave& slave(uint8_t address);
+    SimSlave* findSlave(uint8_t address);
+    const std::map<uint8_t, SimSlave>& slaves() const { return _slaves; }
+
+    const SimBusStats& stats() const { return _stats; }
+    unsigned long baud() const { return _baud; }
+    uint32_t charUs() const { return _charUs; }
+
+    void portBegin(unsigned long baud, uint32_t config) override;
+    size_t portWrite(const uint8_t* buffer, size_t size) override;
+    void portFlush() override;
+    int portAvailable() override;
+    int portRead() override;
+    int portPeek() override;
+
+private:
+    struct RxByte {
+        uint8_t value;
+        int64_t atUs;
+    };
+
+    std::map<uint8_t, SimSlave> _slaves;
+    std::vector<uint8_t> _tx;
+    int64_t _txStartUs;
+    std::deque<RxByte> _rx;
+    unsigned long _baud;
+    uint32_t _config;
+    uint32_t _charUs;
+    std::mt19937 _random;
+    SimBusStats _stats;
+
+    void deliver(const uint8_t* frame, uint16_t length, int64_t endUs);
+    double uniform();
+};
+
+extern SimBus simBus;
+
+/**
+ * @brief CRC Modbus (mesmo de modbus_rtu.cpp)
+ */
+uint16_t simCrc16(const uint8_t* data, uint16_t length);
+
+#endif // SIM_BUS_H
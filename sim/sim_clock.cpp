@@ -0,0 +1,32 @@
+/**
+ * @file sim_clock.cpp
+ * @brief Implementação do relógio virtual
+ */
+
+#include "sim_clock.h"
+
+static int64_t s_nowUs = SIM_CLOCK_START_US;
+
+int64_t simNowUs() {
+    return s_nowUs;
+}
+
+void simAdvanceUs(int64_t us) {
+    if (us > 0) {
+        s_nowUs += us;
+    }
+}
+
+void simAdvanceTo(int64_t atUs) {
+    if (atUs > s_nowUs) {
+        s_nowUs = atUs;
+    }
+}
+
+void simIdlePoll(int64_t nextEventUs) {
+    int64_t target = s_nowUs + SIM_IDLE_POLL_US;
+    if (nextEventUs > s_nowUs && nextEventUs < target) {
+        target = nextEventUs;
+    }
+    s_nowUs = target;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file sim_clock.h
+ * @brief Relógio virtual da simulação (µs)
+ *
+ * Nada na simulação espera em tempo real: delay(), vTaskDelay(), a transmissão
+ * de um quadro e as esperas ativas por bytes (available() sem dados, yield())
+ * apenas avançam este relógio. Uma espera ativa sem dados avança até o próximo
+ * byte agendado no barramento ou, no máximo, SIM_IDLE_POLL_US, o custo
+ * aproximado de uma volta do laço de espera no ESP32.
+ */
+
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+
+#define SIM_CLOCK_START_US 1000000LL       // O loop começa ~1 s após o boot
+#define SIM_IDLE_POLL_US 20                // Avanço de uma volta de espera ativa
+
+int64_t simNowUs();
+
+/**
+ * @brief Avança o relógio (valores negativos são ignorados)
+ */
+void simAdvanceUs(int64_t us);
+
+/**
+ * @brief Avança até um instante (nada se ele já passou)
+ */
+void simAdvanceTo(int64_t atUs);
+
+/**
+ * @brief Uma volta de espera ativa sem dados
+ * @param nextEventUs Próximo byte agendado (<= 0: nenhum)
+ */
+void simIdlePoll(int64_t nextEventUs);
+
+#endif // SIM_CLOCK_H
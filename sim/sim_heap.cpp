@@ -0,0 +1,142 @@
+/**
+ * @file sim_heap.cpp
+ * @brief Implementação da contagem de alocações (ver sim_heap.h)
+ */
+
+#include "sim_heap.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+
+static SimHeapStats s_heap = {};
+
+static inline void countAllocation(size_t bytes) {
+    s_heap.allocations++;
+    s_heap.liveBytes += bytes;
+    if (s_heap.liveBytes > s_heap.peakBytes) {
+        s_heap.peakBytes = s_heap.liveBytes;
+    }
+}
+
+static inline void countFree(size_t bytes) {
+    s_heap.frees++;
+    s_heap.liveBytes -= bytes;
+}
+
+SimHeapStats simHeapStats() {
+    return s_heap;
+}
+
+void simHeapResetPeak() {
+    s_heap.peakBytes = s_heap.liveBytes;
+}
+
+#if defined(__GLIBC__)
+
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) {
+    void* pointer = __libc_malloc(size);
+    if (pointer != nullptr) {
+        countAllocation(malloc_usable_size(pointer));
+    }
+    return pointer;
+}
+
+void* calloc(size_t count, size_t size) {
+    void* pointer = __libc_calloc(count, size);
+    if (pointer != nullptr) {
+        countAllocation(malloc_usable_size(pointer));
+    }
+    return pointer;
+}
+
+// realloc conta como liberação do bloco antigo e alocação do novo
+void* realloc(void* pointer, size_t size) {
+    size_t previous = pointer != nullptr ? malloc_usable_size(pointer) : 0;
+    void* resized = __libc_realloc(pointer, size);
+    if (resized == nullptr) {
+        if (size == 0 && pointer != nullptr) {
+            countFree(previous);               // realloc(p, 0) libera o bloco
+        }
+        return nullptr;
+    }
+    if (pointer != nullptr) {
+        countFree(previous);
+    }
+    countAllocation(malloc_usable_size(resized));
+    return resized;
+}
+
+void free(void* pointer) {
+    if (pointer != nullptr) {
+        countFree(malloc_usable_size(pointer));
+        __libc_free(pointer);
+    }
+}
+}
+
+#else
+
+// Sem glibc: tamanho guardado antes do bloco, só para new/delete
+static void* countedNew(size_t size) {
+    max_align_t* block = (max_align_t*)::malloc(sizeof(max_align_t) + size);
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *(size_t*)block = size;
+    countAllocation(size);
+    return block + 1;
+}
+
+static void countedDelete(void* pointer) {
+    if (pointer != nullptr) {
+        max_align_t* block = (max_align_t*)pointer - 1;
+        countFree(*(size_t*)block);
+        ::free(block);
+    }
+}
+
+void* operator new(size_t size) {
+    void* pointer = countedNew(size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedNew(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedNew(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    countedDelete(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    countedDelete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    countedDelete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    countedDelete(pointer);
+}
+
+#endif
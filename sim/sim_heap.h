@@ -0,0 +1,31 @@
+/**
+ * @file sim_heap.h
+ * @brief Contagem de alocações do heap na simulação
+ *
+ * Na glibc, malloc/calloc/realloc/free são substituídos por versões que
+ * contam alocações e bytes em uso (o new do C++ passa por eles); nas demais
+ * bibliotecas C só o new/delete do C++ é contado. Os bytes são os do PC
+ * (tamanho útil do bloco), não os do heap do ESP32: servem para comparar
+ * configurações e para ver alocações dentro do ciclo, não como valor absoluto.
+ */
+
+#ifndef SIM_HEAP_H
+#define SIM_HEAP_H
+
+#include <stdint.h>
+
+struct SimHeapStats {
+    uint64_t allocations;
+    uint64_t frees;
+    int64_t liveBytes;
+    int64_t peakBytes;                     // Maior liveBytes desde simHeapResetPeak()
+};
+
+SimHeapStats simHeapStats();
+
+/**
+ * @brief Recomeça o pico a partir dos bytes em uso agora
+ */
+void simHeapResetPeak();
+
+#endif // SIM_HEAP_H
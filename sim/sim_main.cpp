@@ -0,0 +1,458 @@
+/**
+ * @file sim_main.cpp
+ * @brief Simulação no PC: o ciclo do firmware contra o barramento simulado
+ *
+ * Executa o mesmo setup e o mesmo loop de main.cpp (sem WiFi, servidor web e
+ * VPN) em tempo virtual: readAllDevices(), performCalculations() e
+ * writeOutputRegisters() a cada CALCULATION_INTERVAL_MS e os serviços entre
+ * os ciclos. Ao final mostra a duração simulada de cada fase, as transações e
+ * os erros, para comparar a vazão do barramento antes de gravar o ESP32.
+ *
+ * Uso: sim [opções] [cenário]
+ *   --cycles N     Ciclos de leitura/cálculo/escrita (padrão: 60)
+ *   --config ARQ   JSON de configuração (mesmo formato salvo no Preferences)
+ *   --fs DIR       Diretório usado como LittleFS (padrão: temporário novo)
+ *   --seed N       Semente das falhas injetadas (padrão: 1)
+ *   --pcap ARQ     Grava a captura do barramento ao final (bus_capture.h)
+ *   --trace        Uma linha por ciclo
+ *   --verbose      Mostra o console do firmware
+ *   --json         Resultado em uma linha JSON (para comparar execuções)
+ *
+ * Varredura: sim --bench [--cycles N] [--devices L] [--registers L] [--layouts L]
+ *                        [--bauds L] [--codes L]
+ *   Uma linha JSON por configuração (ver sim_bench.h); L = lista separada por vírgulas
+ *
+ * Scripts: sim --script-bench [--runs N] [--config ARQ] [--json] [cenário]
+ *   Custo de uma execução de cada script, interpretado e compilado, com os
+ *   valores do primeiro ciclo de leitura (ver sim_script_bench.h)
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include "sim_bus.h"
+#include "sim_clock.h"
+#include "sim_scenario.h"
+#include "sim_heap.h"
+#include "sim_bench.h"
+#include "sim_script_bench.h"
+#include "config.h"
+#include "config_storage.h"
+#include "modbus_handler.h"
+#include "calculations.h"
+#include "rtc_manager.h"
+#include "data_logger.h"
+#include "alarm_engine.h"
+#include "pid_control.h"
+#include "reactive_rules.h"
+#include "modbus_queue.h"
+#include "psychrometrics.h"
+#include "modbus_scan.h"
+#include "modbus_autodetect.h"
+#include "device_profiles.h"
+#include "modbus_slave.h"
+#include "bus_capture.h"
+#include <chrono>
+#include <sys/stat.h>
+
+/**
+ * @brief Mínimo, máximo e soma de uma fase do ciclo (µs)
+ *
+ * O tempo simulado só avança com o barramento e as esperas; o processamento
+ * (cálculos, montagem dos quadros) tem duração zero nele e é medido à parte
+ * no relógio do PC (host*), útil para comparar o custo do código de cálculo.
+ */
+struct PhaseStats {
+    uint32_t count;
+    int64_t minUs;
+    int64_t maxUs;
+    int64_t totalUs;
+
+    void add(int64_t us) {
+        minUs = (count == 0 || us < minUs) ? us : minUs;
+        maxUs = us > maxUs ? us : maxUs;
+        totalUs += us;
+        count++;
+    }
+};
+
+struct SimOptions {
+    uint32_t cycles;                       // 0 = padrão (60, ou 10 por configuração na varredura)
+    const char* scenario;
+    const char* configPath;
+    const char* fsRoot;
+    const char* pcapPath;
+    uint32_t seed;
+    bool trace;
+    bool verbose;
+    bool json;
+    bool bench;
+    SimBenchAxes axes;
+    bool scriptBench;
+    uint32_t runs;                         // Execuções por script em --script-bench
+};
+
+static void usage() {
+    fprintf(stderr,
+            "Uso: sim [--cycles N] [--config ARQ] [--fs DIR] [--seed N] [--pcap ARQ] [--trace] [--verbose] [--json] [cenário]\n"
+            "     sim --bench [--cycles N] [--devices L] [--registers L] [--layouts L] [--bauds L] [--codes L]\n"
+            "     sim --script-bench [--runs N] [--config ARQ] [--json] [cenário]\n");
+}
+
+static bool parseOptions(int argc, char** argv, SimOptions* options) {
+    *options = { 0, nullptr, nullptr, nullptr, nullptr, 1, false, false, false, false, simBenchDefaultAxes(), false, 2000 };
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        bool hasValue = k + 1 < argc;
+        if (arg == "--cycles" && hasValue) {
+            options->cycles = (uint32_t)strtoul(argv[++k], nullptr, 10);
+        } else if (arg == "--config" && hasValue) {
+            options->configPath = argv[++k];
+        } else if (arg == "--fs" && hasValue) {
+            options->fsRoot = argv[++k];
+        } else if (arg == "--seed" && hasValue) {
+            options->seed = (uint32_t)strtoul(argv[++k], nullptr, 10);
+        } else if (arg == "--pcap" && hasValue) {
+            options->pcapPath = argv[++k];
+        } else if (arg == "--trace") {
+            options->trace = true;
+        } else if (arg == "--verbose") {
+            options->verbose = true;
+        } else if (arg == "--json") {
+            options->json = true;
+        } else if (arg == "--bench") {
+            options->bench = true;
+        } else if (arg == "--script-bench") {
+            options->scriptBench = true;
+        } else if (arg == "--runs" && hasValue) {
+            options->runs = (uint32_t)strtoul(argv[++k], nullptr, 10);
+            if (options->runs == 0) {
+                return false;
+            }
+        } else if (arg == "--devices" && hasValue) {
+            if (!simBenchParseList(argv[++k], &options->axes.devices, 1, MAX_DEVICES)) {
+                return false;
+            }
+        } else if (arg == "--registers" && hasValue) {
+            if (!simBenchParseList(argv[++k], &options->axes.registers, 1, MAX_REGISTERS_PER_DEVICE)) {
+                return false;
+            }
+        } else if (arg == "--layouts" && hasValue) {
+            if (!simBenchParseList(argv[++k], &options->axes.layouts)) {
+                return false;
+            }
+        } else if (arg == "--bauds" && hasValue) {
+            if (!simBenchParseList(argv[++k], &options->axes.bauds, 300, 1000000)) {
+                return false;
+            }
+        } else if (arg == "--codes" && hasValue) {
+            if (!simBenchParseList(argv[++k], &options->axes.codes)) {
+                return false;
+            }
+        } else if (arg[0] != '-' && options->scenario == nullptr) {
+            options->scenario = argv[k];
+        } else {
+            return false;
+        }
+    }
+    if (options->cycles == 0) {
+        options->cycles = options->bench ? 10 : 60;
+    }
+    return true;
+}
+
+// Coloca o JSON do arquivo onde loadConfig() procura (Preferences "modbus"/"config")
+static bool installConfig(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::string json;
+    char buffer[1024];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        json.append(buffer, count);
+    }
+    fclose(file);
+
+    Preferences store;
+    bool ok = store.begin("modbus", false) && store.putString("config", json.c_str()) == json.size();
+    store.end();
+    return ok;
+}
+
+static bool writePcap(const char* path) {
+    size_t length = 0;
+    uint8_t* pcap = busCaptureBuildPcap(&length);
+    if (pcap == nullptr) {
+        return false;
+    }
+    FILE* file = fopen(path, "wb");
+    bool ok = file != nullptr && fwrite(pcap, 1, length, file) == length;
+    if (file != nullptr) {
+        fclose(file);
+    }
+    delete[] pcap;
+    return ok;
+}
+
+static double ms(int64_t us) {
+    return us / 1000.0;
+}
+
+static double meanMs(const PhaseStats& phase) {
+    return phase.count > 0 ? ms(phase.totalUs) / phase.count : 0.0;
+}
+
+static void printPhase(const char* name, const PhaseStats& phase) {
+    printf("  %-10s media %9.2f ms   min %9.2f ms   max %9.2f ms\n", name, meanMs(phase), ms(phase.minUs),
+           ms(phase.maxUs));
+}
+
+static int64_t hostNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void printPhaseJson(const char* name, const PhaseStats& phase) {
+    printf("\"%s\":{\"mean\":%.3f,\"min\":%.3f,\"max\":%.3f},", name, meanMs(phase), ms(phase.minUs),
+           ms(phase.maxUs));
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        usage();
+        return 2;
+    }
+    if (options.bench) {
+        return simBenchRun(argv[0], options.axes, options.cycles) > 0 ? 1 : 0;
+    }
+
+    // LittleFS em um diretório do PC
+    char tempRoot[] = "/tmp/sim_fs_XXXXXX";
+    const char* root = options.fsRoot;
+    if (root == nullptr) {
+        root = mkdtemp(tempRoot);
+    } else {
+        mkdir(root, 0755);
+    }
+    if (root == nullptr) {
+        fprintf(stderr, "[Sim] Não foi possível criar o diretório do LittleFS\n");
+        return 1;
+    }
+    simFsSetRoot(root);
+    Serial.setEcho(options.verbose && !options.json);
+    Serial.begin(115200);
+
+    if (options.configPath != nullptr && !installConfig(options.configPath)) {
+        fprintf(stderr, "[Sim] Não foi possível ler %s\n", options.configPath);
+        return 1;
+    }
+
+    // setup() de main.cpp, sem rede
+    initConfigMutex();
+    modbusQueueInit();
+    loadConfig();
+    simBus.seed(options.seed);
+    randomSeed(options.seed);
+    if (options.scenario != nullptr) {
+        String error;
+        if (!simLoadScenario(options.scenario, &error)) {
+            fprintf(stderr, "[Sim] %s\n", error.c_str());
+            return 1;
+        }
+    }
+    int autoSlaves = simAddMissingSlaves();
+
+    config.rtc.enabled = true;
+    rtcSetEpoch((uint32_t)time(nullptr));
+
+    dataLoggerInit();
+    alarmEngineInit();
+    reactiveRulesInit();
+    pidEngineInit();
+    scriptsInit();
+    psychroInit();
+    profilesInit();
+    modbusSlaveInit();
+    simApplyDefinitions();
+
+    Serial2.attach(&simBus);
+    setupModbus(config.baudRate);
+    for (int i = 0; i < config.deviceCount; i++) {
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            kalmanReset(&kalmanStates[i][j]);
+        }
+    }
+    if (options.scriptBench) {
+        readAllDevices();
+        return simScriptBenchRun(options.runs, options.json) > 0 ? 1 : 0;
+    }
+
+    int registers = 0;
+    for (int i = 0; i < config.deviceCount; i++) {
+        registers += config.devices[i].enabled ? config.devices[i].registerCount : 0;
+    }
+    if (!options.json) {
+            printf("[Sim] %d dispositivos, %d registros, %u escravos (%d padrao), %lu baud, caractere %u us, LittleFS em %s\n",
+                   config.deviceCount, registers, (unsigned)simBus.slaves().size(), autoSlaves,
+               simBus.baud(), simBus.charUs(), root);
+    }
+
+    // loop() de main.cpp
+    PhaseStats readPhase = {}, calcPhase = {}, writePhase = {}, cyclePhase = {};
+    PhaseStats hostRead = {}, hostCalc = {}, hostWrite = {};
+    uint32_t cycles = 0;
+    uint32_t overruns = 0;
+    uint64_t cycleAllocations = 0;
+    int64_t cycleHeapPeak = 0;             // Maior crescimento do heap dentro de um ciclo
+    int64_t heapPeak = 0;
+    unsigned long lastCalculationTime = 0;
+    int64_t simStartUs = simNowUs();
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+
+    while (cycles < options.cycles) {
+        rtcService();
+
+        unsigned long currentTime = millis();
+        if (cycles == 0 || currentTime - lastCalculationTime >= CALCULATION_INTERVAL_MS) {
+            lastCalculationTime = currentTime;
+            uint32_t requestsBefore = simBus.stats().requests;
+            uint32_t unansweredBefore = simBus.stats().unanswered;
+
+            simHeapResetPeak();
+            SimHeapStats heapBefore = simHeapStats();
+            g_cycleInProgress = true;
+            int64_t t0 = simNowUs(), h0 = hostNowUs();
+            readAllDevices();
+            int64_t t1 = simNowUs(), h1 = hostNowUs();
+            performCalculations();
+            int64_t t2 = simNowUs(), h2 = hostNowUs();
+            writeOutputRegisters();
+            int64_t t3 = simNowUs(), h3 = hostNowUs();
+            g_cycleInProgress = false;
+            SimHeapStats heapAfter = simHeapStats();
+
+            cycleAllocations += heapAfter.allocations - heapBefore.allocations;
+            cycleHeapPeak = max(cycleHeapPeak, heapAfter.peakBytes - heapBefore.liveBytes);
+            heapPeak = max(heapPeak, heapAfter.peakBytes);
+            readPhase.add(t1 - t0);
+            calcPhase.add(t2 - t1);
+            writePhase.add(t3 - t2);
+            cyclePhase.add(t3 - t0);
+            hostRead.add(h1 - h0);
+            hostCalc.add(h2 - h1);
+            hostWrite.add(h3 - h2);
+            if (t3 - t0 > CALCULATION_INTERVAL_MS * 1000LL) {
+                overruns++;
+            }
+            cycles++;
+
+            if (options.trace) {
+                printf("[Sim] ciclo %4u  t=%10.3f s  leitura %8.2f ms  calculos %8.2f ms  escrita %8.2f ms  "
+                       "quadros %3u  sem resposta %u\n",
+                       cycles, (t0 - simStartUs) / 1e6, ms(t1 - t0), ms(t2 - t1), ms(t3 - t2),
+                       simBus.stats().requests - requestsBefore, simBus.stats().unanswered - unansweredBefore);
+            }
+        }
+
+        alarmService(monotonicMicros());
+        modbusSlaveUpdate();
+        modbusQueueService();
+        ruleService();
+        pidService(monotonicMicros());
+        calculationsService();
+        busCaptureService();
+        if (millis() - lastCalculationTime + SCAN_SLOT_BUDGET_MS < CALCULATION_INTERVAL_MS) {
+            modbusScanService(SCAN_SLOT_BUDGET_MS * 1000UL);
+        }
+        modbusAutodetectService();
+        dataLoggerService();
+
+        delay(10);
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double simSeconds = (simNowUs() - simStartUs) / 1e6;
+    const SimBusStats& bus = simBus.stats();
+    heapPeak = max(heapPeak, simHeapStats().peakBytes);
+    ScriptStats script;
+    scriptGetStats(0, &script);
+
+    if (options.json) {
+        printf("{\"cycles\":%u,\"simSeconds\":%.3f,\"wallSeconds\":%.4f,", cycles, simSeconds, wallSeconds);
+        printPhaseJson("readMs", readPhase);
+        printPhaseJson("calcMs", calcPhase);
+        printPhaseJson("writeMs", writePhase);
+        printPhaseJson("cycleMs", cyclePhase);
+        printPhaseJson("hostReadMs", hostRead);
+        printPhaseJson("hostCalcMs", hostCalc);
+        printPhaseJson("hostWriteMs", hostWrite);
+        printf("\"overruns\":%u,\"frames\":%u,\"framesPerCycle\":%.2f,\"unanswered\":%u,\"busOccupancy\":%.4f,"
+               "\"heapPeakBytes\":%lld,\"cycleHeapPeakBytes\":%lld,\"allocationsPerCycle\":%.1f,"
+               "\"scriptRuns\":%u,\"scriptLateTicks\":%u,\"scriptMaxSlices\":%u}\n",
+               overruns, bus.requests, (double)bus.requests / cycles, bus.unanswered,
+               simSeconds > 0 ? bus.busyUs / (simSeconds * 1e6) : 0.0, (long long)heapPeak, (long long)cycleHeapPeak,
+               (double)cycleAllocations / cycles, script.runs, script.lateTicks, script.maxSlices);
+        if (options.pcapPath != nullptr && !writePcap(options.pcapPath)) {
+            fprintf(stderr, "[Sim] Não foi possível gravar %s\n", options.pcapPath);
+        }
+        return overruns > 0 ? 1 : 0;
+    }
+
+    printf("\n[Sim] %u ciclos, %.3f s simulados em %.3f s (%.0fx)\n", cycles, simSeconds, wallSeconds,
+           wallSeconds > 0 ? simSeconds / wallSeconds : 0.0);
+    printPhase("leitura", readPhase);
+    printPhase("calculos", calcPhase);
+    printPhase("escrita", writePhase);
+    printPhase("ciclo", cyclePhase);
+    printf("  no PC: leitura %.3f ms, calculos %.3f ms, escrita %.3f ms (media)\n", meanMs(hostRead), meanMs(hostCalc),
+           meanMs(hostWrite));
+    printf("  ciclos acima de %d ms: %u\n", CALCULATION_INTERVAL_MS, overruns);
+    printf("  barramento: %u quadros (%.1f por ciclo), %u broadcasts, %u sem resposta, ocupacao %.1f%%\n",
+           bus.requests, (double)bus.requests / cycles, bus.broadcasts, bus.unanswered,
+           simSeconds > 0 ? 100.0 * bus.busyUs / (simSeconds * 1e6) : 0.0);
+    printf("  heap: pico %lld bytes, maior crescimento no ciclo %lld bytes, %.1f alocacoes por ciclo\n",
+           (long long)heapPeak, (long long)cycleHeapPeak, (double)cycleAllocations / cycles);
+    printf("  script: %u execucoes, ate %u fatias, %u ticks com a anterior em andamento\n", script.runs,
+           script.maxSlices, script.lateTicks);
+    ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    uint8_t scriptCount = scriptGetDefinitions(definitions, SCRIPT_MAX_SCRIPTS);
+    for (uint8_t k = 0; k < scriptCount; k++) {
+        ScriptStats named;
+        scriptGetStats(k + 1, &named);
+        printf("  script %s (prioridade %u): %u execucoes, maior %.2f ms, espera max %.2f ms, %u atrasados, %u interrupcoes\n",
+               definitions[k].name, definitions[k].priority, named.runs, named.maxRunUs / 1000.0, named.maxWaitUs / 1000.0,
+               named.lateTicks, named.preemptions);
+    }
+    delete[] definitions;
+    ReactiveRule* rules = new ReactiveRule[RULE_MAX_RULES];
+    uint8_t ruleCount = ruleGetRules(rules, RULE_MAX_RULES);
+    for (uint8_t k = 0; k < ruleCount; k++) {
+        RuleStatus status;
+        ruleGetStatus(k, &status);
+        printf("  regra %s: %u disparos, %u escritas (%u erros), latencia media %.2f ms, max %.2f ms, ultima fila %.2f ms%s\n",
+               rules[k].name, status.trips, status.writes, status.writeErrors, status.meanLatencyUs / 1000.0,
+               status.maxLatencyUs / 1000.0, status.lastQueueWaitUs / 1000.0, status.tripped ? " (disparada)" : "");
+    }
+    delete[] rules;
+
+    printf("\n  %-4s %-16s %9s %9s %7s %8s %8s %8s\n", "end", "nome", "requis.", "respostas", "excec.", "timeouts",
+           "CRC", "escritas");
+    for (std::map<uint8_t, SimSlave>::const_iterator entry = simBus.slaves().begin(); entry != simBus.slaves().end(); ++entry) {
+        const SimSlave& target = entry->second;
+        printf("  %-4u %-16s %9u %9u %7u %8u %8u %8u\n", target.address, target.name.c_str(), target.stats.requests,
+               target.stats.replies, target.stats.exceptions, target.stats.dropped, target.stats.corrupted,
+               target.stats.writes);
+    }
+
+    if (options.pcapPath != nullptr) {
+        if (writePcap(options.pcapPath)) {
+            printf("\n[Sim] Captura gravada em %s\n", options.pcapPath);
+        } else {
+            fprintf(stderr, "[Sim] Não foi possível gravar %s\n", options.pcapPath);
+        }
+    }
+    return overruns > 0 ? 1 : 0;
+}
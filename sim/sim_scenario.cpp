@@ -0,0 +1,644 @@
+/**
+ * @file sim_scenario.cpp
+ * @brief Leitura do cenário da simulação
+ */
+
+#include "sim_scenario.h"
+#include "sim_bus.h"
+#include "config.h"
+#include "device_profiles.h"
+#include "calculations.h"
+#include "alarm_engine.h"
+#include "reactive_rules.h"
+#include <LittleFS.h>
+#include <vector>
+
+// Divide a linha em palavras separadas por espaço (code usa o resto da linha)
+static std::vector<std::string> splitWords(const std::string& line) {
+    std::vector<std::string> words;
+    size_t at = 0;
+    while (at < line.size()) {
+        while (at < line.size() && isspace((unsigned char)line[at])) {
+            at++;
+        }
+        size_t end = at;
+        while (end < line.size() && !isspace((unsigned char)line[end])) {
+            end++;
+        }
+        if (end > at) {
+            words.push_back(line.substr(at, end - at));
+        }
+        at = end;
+    }
+    return words;
+}
+
+static bool parseNumber(const std::string& text, double* value) {
+    char* end = nullptr;
+    *value = strtod(text.c_str(), &end);
+    return !text.empty() && end != nullptr && *end == '\0';
+}
+
+static bool parseAddress(const std::string& text, int minimum, int maximum, int* value) {
+    double number;
+    if (!parseNumber(text, &number) || number != floor(number) || number < minimum || number > maximum) {
+        return false;
+    }
+    *value = (int)number;
+    return true;
+}
+
+static bool parseWave(const std::string& text, SimWave* wave) {
+    std::vector<double> args;
+    std::string kind = text;
+    size_t colon = text.find(':');
+    if (colon != std::string::npos) {
+        kind = text.substr(0, colon);
+        std::string rest = text.substr(colon + 1);
+        size_t at = 0;
+        while (at <= rest.size()) {
+            size_t next = rest.find(':', at);
+            if (next == std::string::npos) {
+                next = rest.size();
+            }
+            double value;
+            if (!parseNumber(rest.substr(at, next - at), &value)) {
+                return false;
+            }
+            args.push_back(value);
+            at = next + 1;
+        }
+    }
+
+    double value;
+    if (colon == std::string::npos && parseNumber(kind, &value)) {
+        *wave = { SimWave::CONST, value, 0, 0 };
+        return true;
+    }
+    if (kind == "const" && args.size() == 1) {
+        *wave = { SimWave::CONST, args[0], 0, 0 };
+    } else if (kind == "sine" && args.size() == 3 && args[2] > 0) {
+        *wave = { SimWave::SINE, args[0], args[1], args[2] };
+    } else if (kind == "ramp" && args.size() == 2) {
+        *wave = { SimWave::RAMP, args[0], args[1], 0 };
+    } else if (kind == "noise" && args.size() == 2) {
+        *wave = { SimWave::NOISE, args[0], args[1], 0 };
+    } else if (kind == "square" && args.size() == 3 && args[2] > 0) {
+        *wave = { SimWave::SQUARE, args[0], args[1], args[2] };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// "chave=valor" -> valor (nullptr se a palavra não é dessa chave)
+static const char* optionValue(const std::string& word, const char* key) {
+    size_t length = strlen(key);
+    if (word.size() > length && word.compare(0, length, key) == 0 && word[length] == '=') {
+        return word.c_str() + length + 1;
+    }
+    return nullptr;
+}
+
+static int findDevice(uint8_t slaveAddress) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (config.devices[i].slaveAddress == slaveAddress) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool applySlave(const std::vector<std::string>& words, String* reason) {
+    int address;
+    if (words.size() < 2 || !parseAddress(words[1], 1, 247, &address)) {
+        *reason = "endereço do escravo inválido (1-247)";
+        return false;
+    }
+    SimSlave& target = simBus.slave((uint8_t)address);
+    for (size_t k = 2; k < words.size(); k++) {
+        const char* value;
+        double number;
+        if (words[k] == "strict") {
+            target.strict = true;
+        } else if ((value = optionValue(words[k], "name")) != nullptr) {
+            target.name = value;
+        } else if ((value = optionValue(words[k], "latency")) != nullptr && parseNumber(value, &number) && number >= 0) {
+            target.latencyUs = (uint32_t)number;
+        } else if ((value = optionValue(words[k], "jitter")) != nullptr && parseNumber(value, &number) && number >= 0) {
+            target.jitterUs = (uint32_t)number;
+        } else if ((value = optionValue(words[k], "timeout")) != nullptr && parseNumber(value, &number) &&
+                   number >= 0 && number <= 1) {
+            target.timeoutRate = number;
+        } else if ((value = optionValue(words[k], "crc")) != nullptr && parseNumber(value, &number) &&
+                   number >= 0 && number <= 1) {
+            target.crcRate = number;
+        } else if ((value = optionValue(words[k], "baud")) != nullptr && parseNumber(value, &number) && number >= 0) {
+            target.baud = (uint32_t)number;
+        } else {
+            *reason = String("opção inválida: ") + words[k].c_str();
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool applyDevice(const std::vector<std::string>& words, String* reason) {
+    int address;
+    if (words.size() < 3 || !parseAddress(words[1], 1, 247, &address)) {
+        *reason = "uso: device <endereço> <nome> [profile=perfil]";
+        return false;
+    }
+    int index = findDevice((uint8_t)address);
+    if (index < 0) {
+        if (config.deviceCount >= MAX_DEVICES) {
+            *reason = "limite de dispositivos (MAX_DEVICES)";
+            return false;
+        }
+        index = config.deviceCount++;
+        config.devices[index].registerCount = 0;
+        config.devices[index].profile[0] = '\0';
+    }
+    ModbusDevice& device = config.devices[index];
+    device.slaveAddress = (uint8_t)address;
+    device.enabled = true;
+    strncpy(device.deviceName, words[2].c_str(), sizeof(device.deviceName) - 1);
+    device.deviceName[sizeof(device.deviceName) - 1] = '\0';
+    for (size_t k = 3; k < words.size(); k++) {
+        const char* value = optionValue(words[k], "profile");
+        if (value == nullptr) {
+            *reason = String("opção inválida: ") + words[k].c_str();
+            return false;
+        }
+        strncpy(device.profile, value, sizeof(device.profile) - 1);
+        device.profile[sizeof(device.profile) - 1] = '\0';
+    }
+    if (simBus.findSlave((uint8_t)address) == nullptr) {
+        simBus.slave((uint8_t)address).name = words[2];
+    }
+    return true;
+}
+
+// Grava o perfil no LittleFS; profilesInit() carrega e compila como no firmware
+static bool applyProfile(const std::vector<std::string>& words, String* reason) {
+    static DeviceProfile profile;
+    int registerType;
+    if (words.size() < 4 || words[1].size() >= sizeof(profile.name) || !parseAddress(words[2], 0, 2, &registerType) ||
+        registerType == 1) {
+        *reason = "uso: profile <nome> <tipo 0|2> <registro>... [maxGap=n]";
+        return false;
+    }
+    memset(&profile, 0, sizeof(profile));
+    strncpy(profile.name, words[1].c_str(), sizeof(profile.name) - 1);
+    profile.maxGap = PROFILE_DEFAULT_MAX_GAP;
+    for (size_t k = 3; k < words.size(); k++) {
+        const char* value = optionValue(words[k], "maxGap");
+        int number;
+        if (value != nullptr && parseAddress(value, 0, PROFILE_MAX_BLOCK_WORDS, &number)) {
+            profile.maxGap = (uint8_t)number;
+        } else if (parseAddress(words[k], 0, 65535, &number) && profile.registerCount < PROFILE_MAX_REGISTERS) {
+            ProfileRegister& reg = profile.registers[profile.registerCount++];
+            reg.address = (uint16_t)number;
+            snprintf(reg.variableName, sizeof(reg.variableName), "r%d", number);
+            reg.registerType = (uint8_t)registerType;
+            reg.dataType = REGISTER_DATA_UINT16;
+            reg.gain = 1.0f;
+            reg.offset = 0.0f;
+        } else {
+            *reason = String("registro ou opção inválida: ") + words[k].c_str();
+            return false;
+        }
+    }
+
+    DynamicJsonDocument doc(8192);
+    profileToJson(&profile, doc.to<JsonObject>(), false);
+    if (!LittleFS.exists(PROFILE_DIR)) {
+        LittleFS.mkdir(PROFILE_DIR);
+    }
+    File file = LittleFS.open(String(PROFILE_DIR) + "/" + profile.name + ".json", "w");
+    if (!file) {
+        *reason = "não foi possível gravar o perfil";
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    return true;
+}
+
+static bool applyRegister(const std::vector<std::string>& words, String* reason) {
+    int address, registerAddress, registerType;
+    if (words.size() < 5 || !parseAddress(words[1], 1, 247, &address) ||
+        !parseAddress(words[2], 0, 65535, &registerAddress) || !parseAddress(words[3], 0, 4, &registerType)) {
+        *reason = "uso: reg <endereço> <registro> <tipo 0-4> <variável> [forma] [gain=] [offset=] [group=]";
+        return false;
+    }
+    int index = findDevice((uint8_t)address);
+    if (index < 0) {
+        *reason = "dispositivo não declarado (use device antes de reg)";
+        return false;
+    }
+    ModbusDevice& device = config.devices[index];
+    if (device.registerCount >= MAX_REGISTERS_PER_DEVICE) {
+        *reason = "limite de registros por dispositivo (MAX_REGISTERS_PER_DEVICE)";
+        return false;
+    }
+
+    ModbusRegister& reg = device.registers[device.registerCount];
+    memset(&reg, 0, sizeof(reg));
+    reg.address = (uint16_t)registerAddress;
+    reg.registerType = (uint8_t)registerType;
+    reg.isInput = registerType != 1;
+    reg.isOutput = registerType == 1;
+    reg.readOnly = registerType == 0 || registerType == 4;
+    reg.gain = 1.0f;
+    reg.offset = 0.0f;
+    reg.kalmanQ = 0.01f;
+    reg.kalmanR = 0.1f;
+    reg.registerCount = 1;
+    reg.writeRegisterCount = 1;
+    reg.dataType = REGISTER_DATA_UINT16;
+    strncpy(reg.variableName, words[4].c_str(), sizeof(reg.variableName) - 1);
+
+    SimSlave& target = simBus.slave((uint8_t)address);
+    bool bitRegister = registerType == REGISTER_TYPE_COIL || registerType == REGISTER_TYPE_DISCRETE_INPUT;
+    for (size_t k = 5; k < words.size(); k++) {
+        const char* value;
+        double number;
+        SimWave wave;
+        if ((value = optionValue(words[k], "gain")) != nullptr && parseNumber(value, &number)) {
+            reg.gain = (float)number;
+        } else if ((value = optionValue(words[k], "offset")) != nullptr && parseNumber(value, &number)) {
+            reg.offset = (float)number;
+        } else if ((value = optionValue(words[k], "group")) != nullptr && parseNumber(value, &number) &&
+                   number >= 0 && number <= 255) {
+            reg.sampleGroup = (uint8_t)number;
+        } else if (parseWave(words[k], &wave)) {
+            if (bitRegister) {
+                target.bitWaves[reg.address] = wave;
+            } else {
+                target.waves[reg.address] = wave;
+            }
+        } else {
+            *reason = String("opção ou forma inválida: ") + words[k].c_str();
+            return false;
+        }
+    }
+    device.registerCount++;
+    return true;
+}
+
+static bool applyWave(const std::vector<std::string>& words, bool bit, String* reason) {
+    int address, registerAddress;
+    SimWave wave;
+    if (words.size() != 4 || !parseAddress(words[1], 1, 247, &address) ||
+        !parseAddress(words[2], 0, 65535, &registerAddress) || !parseWave(words[3], &wave)) {
+        *reason = bit ? "uso: bit <endereço> <registro> <forma>" : "uso: wave <endereço> <registro> <forma>";
+        return false;
+    }
+    SimSlave& target = simBus.slave((uint8_t)address);
+    if (bit) {
+        target.bitWaves[(uint16_t)registerAddress] = wave;
+    } else {
+        target.waves[(uint16_t)registerAddress] = wave;
+    }
+    return true;
+}
+
+static std::vector<ScriptDefinition> s_scripts;
+static std::vector<AlarmDefinition> s_alarms;
+static std::vector<ReactiveRule> s_rules;
+
+static ScriptDefinition* findScript(const std::string& name) {
+    for (size_t k = 0; k < s_scripts.size(); k++) {
+        if (name == s_scripts[k].name) {
+            return &s_scripts[k];
+        }
+    }
+    return nullptr;
+}
+
+// script <nome> <prioridade> period=<ms> | sample=<end>:<reg>[,...] | alarm=<índice>[:raised|cleared|both]
+static bool applyScript(const std::vector<std::string>& words, String* reason) {
+    *reason = "uso: script <nome> <prioridade> period=<ms>|sample=<end>:<reg>[,...]|alarm=<indice>[:borda]";
+    int priority;
+    if (words.size() != 4 || words[1].size() >= sizeof(ScriptDefinition().name) || findScript(words[1]) != nullptr ||
+        !parseAddress(words[2], 0, SCRIPT_MAIN_PRIORITY - 1, &priority) || s_scripts.size() >= SCRIPT_MAX_SCRIPTS) {
+        return false;
+    }
+    ScriptDefinition definition;
+    memset(&definition, 0, sizeof(definition));
+    definition.enabled = true;
+    strncpy(definition.name, words[1].c_str(), sizeof(definition.name) - 1);
+    definition.priority = (uint8_t)priority;
+
+    const char* value;
+    if ((value = optionValue(words[3], "period")) != nullptr) {
+        int periodMs;
+        if (!parseAddress(value, SCRIPT_MIN_PERIOD_MS, 3600000, &periodMs)) {
+            return false;
+        }
+        definition.trigger = SCRIPT_TRIGGER_PERIOD;
+        definition.periodMs = (uint32_t)periodMs;
+    } else if ((value = optionValue(words[3], "sample")) != nullptr) {
+        definition.trigger = SCRIPT_TRIGGER_SAMPLE;
+        std::string list = value;
+        size_t at = 0;
+        while (at <= list.size()) {
+            size_t next = list.find(',', at);
+            if (next == std::string::npos) {
+                next = list.size();
+            }
+            std::string item = list.substr(at, next - at);
+            size_t colon = item.find(':');
+            int slave, reg;
+            if (colon == std::string::npos || definition.registerCount >= SCRIPT_MAX_TRIGGER_REGISTERS ||
+                !parseAddress(item.substr(0, colon), 1, 247, &slave) || !parseAddress(item.substr(colon + 1), 0, 65535, &reg)) {
+                return false;
+            }
+            definition.slaves[definition.registerCount] = (uint8_t)slave;
+            definition.registers[definition.registerCount++] = (uint16_t)reg;
+            at = next + 1;
+        }
+    } else if ((value = optionValue(words[3], "alarm")) != nullptr) {
+        definition.trigger = SCRIPT_TRIGGER_ALARM;
+        std::string text = value;
+        size_t colon = text.find(':');
+        std::string edge = colon == std::string::npos ? "raised" : text.substr(colon + 1);
+        int alarm;
+        if (!parseAddress(text.substr(0, colon), 0, ALARM_MAX_DEFINITIONS - 1, &alarm)) {
+            return false;
+        }
+        definition.alarmDefinition = (uint8_t)alarm;
+        if (edge == "raised") {
+            definition.alarmEdge = SCRIPT_EDGE_RAISED;
+        } else if (edge == "cleared") {
+            definition.alarmEdge = SCRIPT_EDGE_CLEARED;
+        } else if (edge == "both") {
+            definition.alarmEdge = SCRIPT_EDGE_BOTH;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    s_scripts.push_back(definition);
+    return true;
+}
+
+// alarm <end> <registro> [hi=<v>] [lo=<v>] [deadband=<v>]
+static bool applyAlarm(const std::vector<std::string>& words, String* reason) {
+    *reason = "uso: alarm <end> <registro> [hi=<v>] [lo=<v>] [deadband=<v>]";
+    int slave, reg;
+    if (words.size() < 4 || !parseAddress(words[1], 1, 247, &slave) || !parseAddress(words[2], 0, 65535, &reg) ||
+        s_alarms.size() >= ALARM_MAX_DEFINITIONS) {
+        return false;
+    }
+    AlarmDefinition definition;
+    memset(&definition, 0, sizeof(definition));
+    definition.slaveAddress = (uint8_t)slave;
+    definition.registerAddress = (uint16_t)reg;
+    for (size_t k = 3; k < words.size(); k++) {
+        const char* value;
+        double number;
+        if ((value = optionValue(words[k], "hi")) != nullptr && parseNumber(value, &number)) {
+            definition.enabledMask |= (1 << ALARM_HI);
+            definition.hi = (float)number;
+        } else if ((value = optionValue(words[k], "lo")) != nullptr && parseNumber(value, &number)) {
+            definition.enabledMask |= (1 << ALARM_LO);
+            definition.lo = (float)number;
+        } else if ((value = optionValue(words[k], "deadband")) != nullptr && parseNumber(value, &number)) {
+            definition.deadband = (float)number;
+        } else {
+            return false;
+        }
+    }
+    s_alarms.push_back(definition);
+    return true;
+}
+
+// <end>:<registro>
+static bool parseRegisterRef(const std::string& text, uint8_t* slave, uint16_t* registerAddress) {
+    size_t colon = text.find(':');
+    int address, reg;
+    if (colon == std::string::npos || !parseAddress(text.substr(0, colon), 1, 247, &address) ||
+        !parseAddress(text.substr(colon + 1), 0, 65535, &reg)) {
+        return false;
+    }
+    *slave = (uint8_t)address;
+    *registerAddress = (uint16_t)reg;
+    return true;
+}
+
+// rule <nome> <end>:<reg> above=<v>|below=<v> <end>:<reg> trip=<v> [release=<v>] [deadband=<v>]
+static bool applyRule(const std::vector<std::string>& words, String* reason) {
+    *reason = "uso: rule <nome> <end>:<reg> above=<v>|below=<v> <end>:<reg> trip=<v> [release=<v>] [deadband=<v>]";
+    if (words.size() < 6 || words[1].size() >= sizeof(ReactiveRule().name) || s_rules.size() >= RULE_MAX_RULES) {
+        return false;
+    }
+    ReactiveRule rule;
+    memset(&rule, 0, sizeof(rule));
+    rule.enabled = true;
+    strncpy(rule.name, words[1].c_str(), sizeof(rule.name) - 1);
+    if (!parseRegisterRef(words[2], &rule.inputSlave, &rule.inputRegister) ||
+        !parseRegisterRef(words[4], &rule.outputSlave, &rule.outputRegister)) {
+        return false;
+    }
+    const char* value;
+    double number;
+    if ((value = optionValue(words[3], "above")) != nullptr && parseNumber(value, &number)) {
+        rule.below = false;
+    } else if ((value = optionValue(words[3], "below")) != nullptr && parseNumber(value, &number)) {
+        rule.below = true;
+    } else {
+        return false;
+    }
+    rule.threshold = (float)number;
+    if ((value = optionValue(words[5], "trip")) == nullptr || !parseNumber(value, &number)) {
+        return false;
+    }
+    rule.tripValue = (float)number;
+    for (size_t k = 6; k < words.size(); k++) {
+        if ((value = optionValue(words[k], "release")) != nullptr && parseNumber(value, &number)) {
+            rule.hasRelease = true;
+            rule.releaseValue = (float)number;
+        } else if ((value = optionValue(words[k], "deadband")) != nullptr && parseNumber(value, &number) && number >= 0) {
+            rule.deadband = (float)number;
+        } else {
+            return false;
+        }
+    }
+    s_rules.push_back(rule);
+    return true;
+}
+
+static bool applyBaud(const std::vector<std::string>& words, String* reason) {
+    int baud;
+    if (words.size() < 2 || !parseAddress(words[1], 300, 1000000, &baud)) {
+        *reason = "uso: baud <taxa> [8N1|8E1|8O1|8N2|...]";
+        return false;
+    }
+    config.baudRate = (uint32_t)baud;
+    if (words.size() >= 3) {
+        const std::string& framing = words[2];
+        if (framing.size() != 3 || (framing[0] != '7' && framing[0] != '8') ||
+            strchr("NEO", framing[1]) == nullptr || (framing[2] != '1' && framing[2] != '2')) {
+            *reason = "enquadramento inválido (ex.: 8N1, 8E1, 7O2)";
+            return false;
+        }
+        config.dataBits = framing[0] - '0';
+        config.parity = framing[1] == 'N' ? MODBUS_PARITY_NONE : (framing[1] == 'E' ? MODBUS_PARITY_EVEN : MODBUS_PARITY_ODD);
+        config.stopBits = framing[2] - '0';
+    }
+    return true;
+}
+
+bool simLoadScenario(const char* path, String* error) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        *error = String("não foi possível abrir ") + path;
+        return false;
+    }
+
+    char buffer[512];
+    int lineNumber = 0;
+    String reason;
+    bool ok = true;
+    bool codeStarted = false;
+    while (ok && fgets(buffer, sizeof(buffer), file) != nullptr) {
+        lineNumber++;
+        std::string line = buffer;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+
+        std::vector<std::string> words = splitWords(line);
+        if (words.empty() || words[0][0] == '#') {
+            continue;
+        }
+        const std::string& directive = words[0];
+        if (directive == "scode") {
+            // scode <nome> <linha>: linha acrescentada ao script nomeado
+            ScriptDefinition* script = words.size() >= 2 ? findScript(words[1]) : nullptr;
+            if (script == nullptr) {
+                reason = "scode antes do script correspondente";
+                ok = false;
+                break;
+            }
+            size_t at = line.find(words[1], line.find("scode") + 5) + words[1].size();
+            if (at < line.size() && line[at] == ' ') {
+                at++;
+            }
+            size_t used = strlen(script->code);
+            std::string text = line.substr(at) + "\n";
+            if (used + text.size() >= sizeof(script->code)) {
+                reason = "código do script maior que SCRIPT_MAX_CODE";
+                ok = false;
+                break;
+            }
+            memcpy(script->code + used, text.c_str(), text.size() + 1);
+            continue;
+        }
+        if (directive == "code") {
+            // Resto da linha, sem a palavra "code" (comentários fazem parte do código)
+            size_t at = line.find("code") + 4;
+            if (at < line.size() && line[at] == ' ') {
+                at++;
+            }
+            if (!codeStarted) {
+                config.calculationCode[0] = '\0';
+                codeStarted = true;
+            }
+            size_t used = strlen(config.calculationCode);
+            std::string text = line.substr(at) + "\n";
+            if (used + text.size() >= sizeof(config.calculationCode)) {
+                reason = "código de cálculo maior que calculationCode";
+                ok = false;
+                break;
+            }
+            memcpy(config.calculationCode + used, text.c_str(), text.size() + 1);
+            continue;
+        }
+
+        // Comentário no fim da linha
+        for (size_t k = 1; k < words.size(); k++) {
+            if (words[k][0] == '#') {
+                words.resize(k);
+                break;
+            }
+        }
+
+        double number;
+        if (directive == "baud") {
+            ok = applyBaud(words, &reason);
+        } else if (directive == "timeout") {
+            ok = words.size() == 2 && parseNumber(words[1], &number) && number >= 10 && number <= 1000;
+            if (ok) {
+                config.timeout = (uint16_t)number;
+            } else {
+                reason = "uso: timeout <ms> (10-1000)";
+            }
+        } else if (directive == "slave") {
+            ok = applySlave(words, &reason);
+        } else if (directive == "device") {
+            ok = applyDevice(words, &reason);
+        } else if (directive == "profile") {
+            ok = applyProfile(words, &reason);
+        } else if (directive == "reg") {
+            ok = applyRegister(words, &reason);
+        } else if (directive == "wave" || directive == "bit") {
+            ok = applyWave(words, directive == "bit", &reason);
+        } else if (directive == "script") {
+            ok = applyScript(words, &reason);
+        } else if (directive == "alarm") {
+            ok = applyAlarm(words, &reason);
+        } else if (directive == "rule") {
+            ok = applyRule(words, &reason);
+        } else if (directive == "option" && words.size() == 2 && words[1] == "alignSamples") {
+            config.alignSamples = true;
+        } else if (directive == "option" && words.size() == 2 && words[1] == "syncWrites") {
+            config.syncWrites = true;
+        } else if (directive == "option" && words.size() == 2 && optionValue(words[1], "scriptSliceMs") != nullptr) {
+            int sliceMs;
+            ok = parseAddress(optionValue(words[1], "scriptSliceMs"), 0, CALCULATION_INTERVAL_MS, &sliceMs);
+            config.scriptSliceMs = (uint16_t)sliceMs;
+            if (!ok) {
+                reason = "uso: option scriptSliceMs=<ms>";
+            }
+        } else {
+            reason = String("diretiva desconhecida: ") + directive.c_str();
+            ok = false;
+        }
+    }
+    fclose(file);
+
+    if (!ok) {
+        *error = String(path) + ":" + String(lineNumber) + ": " + reason;
+        return false;
+    }
+    return true;
+}
+
+void simApplyDefinitions() {
+    if (!s_alarms.empty()) {
+        alarmSetDefinitions(s_alarms.data(), (uint8_t)s_alarms.size());
+    }
+    if (!s_scripts.empty()) {
+        scriptSetDefinitions(s_scripts.data(), (uint8_t)s_scripts.size());
+    }
+    if (!s_rules.empty()) {
+        ruleSetRules(s_rules.data(), (uint8_t)s_rules.size());
+    }
+}
+
+int simAddMissingSlaves() {
+    int created = 0;
+    for (int i = 0; i < config.deviceCount; i++) {
+        const ModbusDevice& device = config.devices[i];
+        if (!device.enabled || simBus.findSlave(device.slaveAddress) != nullptr) {
+            continue;
+        }
+        simBus.slave(device.slaveAddress).name = device.deviceName;
+        created++;
+    }
+    return created;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file sim_scenario.h
+ * @brief Cenário da simulação: escravos do barramento e, opcionalmente, dispositivos do config
+ *
+ * Arquivo texto, uma diretiva por linha ('#' inicia comentário):
+ *
+ *   baud <taxa> [8N1|8E1|8O1|8N2|...]     Porta do mestre (config.baudRate e enquadramento)
+ *   timeout <ms>                          config.timeout
+ *   slave <end> [name=X] [latency=µs] [jitter=µs] [timeout=p] [crc=p] [baud=taxa] [strict]
+ *                                         Escravo simulado (p = probabilidade de 0 a 1)
+ *   device <end> <nome> [profile=perfil]  Dispositivo no config (cria o escravo se não existe)
+ *   profile <nome> <tipo 0|2> <registro>... [maxGap=n]
+ *                                         Perfil uint16 gravado em PROFILE_DIR (leitura em blocos)
+ *   reg <end> <registro> <tipo> <variável> [forma] [gain=g] [offset=o] [group=n]
+ *                                         Registro no config (tipo como registerType: 0 a 4) e,
+ *                                         com forma, o valor que o escravo devolve
+ *   wave <end> <registro> <forma>         Só o valor no escravo (perfis, displays, ...)
+ *   bit <end> <registro> <forma>          Bobina/entrada discreta no escravo
+ *   code <linha>                          Linha acrescentada ao código de cálculo
+ *   script <nome> <prioridade> period=<ms>|sample=<end>:<reg>[,...]|alarm=<índice>[:raised|cleared|both]
+ *                                         Script nomeado (SCRIPT_TRIGGER_*)
+ *   scode <nome> <linha>                  Linha acrescentada ao script nomeado
+ *   alarm <end> <registro> [hi=<v>] [lo=<v>] [deadband=<v>]
+ *                                         Definição de alarme (índice na ordem do cenário)
+ *   rule <nome> <end>:<reg> above=<v>|below=<v> <end>:<reg> trip=<v> [release=<v>] [deadband=<v>]
+ *                                         Regra de reação (entrada, limite, saída)
+ *   option alignSamples|syncWrites        Liga a opção do config
+ *   option scriptSliceMs=<ms>             Orçamento de cada fatia do código de cálculo
+ *
+ * Formas (valor raw do registrador, em função do tempo simulado):
+ *   <valor> ou const:<valor>, sine:<centro>:<amplitude>:<período ms>,
+ *   ramp:<início>:<por segundo>, noise:<centro>:<amplitude>,
+ *   square:<baixo>:<alto>:<período ms>
+ *
+ * Dispositivos do config sem diretiva slave ganham um escravo com os valores
+ * padrão (simLoadScenario não cria; ver simAddMissingSlaves()).
+ */
+
+#ifndef SIM_SCENARIO_H
+#define SIM_SCENARIO_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Lê o cenário e aplica em config e simBus
+ * @param error Linha e motivo em caso de erro
+ */
+bool simLoadScenario(const char* path, String* error);
+
+/**
+ * @brief Aplica os alarmes, regras de reação e scripts nomeados do cenário
+ *
+ * Chamar depois de alarmEngineInit(), reactiveRulesInit() e scriptsInit(), que carregam os do
+ * LittleFS; as diretivas do cenário substituem os gravados.
+ */
+void simApplyDefinitions();
+
+/**
+ * @brief Cria escravos (padrão) para os dispositivos habilitados do config que não têm um
+ * @return Quantidade criada
+ */
+int simAddMissingSlaves();
+
+#endif // SIM_SCENARIO_H
@@ -0,0 +1,255 @@
+/**
+ * @file sim_script_bench.cpp
+ * @brief Implementação da comparação interpretado x compilado (ver sim_script_bench.h)
+ */
+
+#include "sim_script_bench.h"
+#include "config.h"
+#include "calculations.h"
+#include "modbus_handler.h"
+#include "modbus_bits.h"
+#include "script_compiler.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static const int MAX_VARIABLES = 50;       // MAX_TEMP_VARS de calculations.cpp
+
+/**
+ * @brief Uma linha executável (mesma divisão de runSlice)
+ */
+struct BenchLine {
+    int sourceLine;
+    std::string text;
+};
+
+/**
+ * @brief Resultado de uma linha na última execução
+ */
+struct BenchResult {
+    bool ok;
+    double value;
+};
+
+/**
+ * @brief Variáveis temporárias de uma execução (como em ScriptRun)
+ */
+struct BenchVariables {
+    Variable variables[MAX_VARIABLES];
+    int count;
+
+    void store(const char* name, double value) {
+        char shortName[6];
+        strncpy(shortName, name, 5);
+        shortName[5] = '\0';
+        for (int k = 0; k < count; k++) {
+            if (strcmp(variables[k].name, shortName) == 0) {
+                variables[k].value = value;
+                return;
+            }
+        }
+        if (count < MAX_VARIABLES) {
+            strcpy(variables[count].name, shortName);
+            variables[count].value = value;
+            count++;
+        }
+    }
+};
+
+static std::vector<BenchLine> splitLines(const char* code) {
+    std::vector<BenchLine> lines;
+    String codeStr = code;
+    int position = 0;
+    int sourceLine = 1;
+    while (position < (int)codeStr.length()) {
+        int endPos = codeStr.indexOf('\n', position);
+        if (endPos == -1) {
+            endPos = codeStr.length();
+        }
+        String line = codeStr.substring(position, endPos);
+        line.trim();
+        position = endPos + 1;
+        if (line.length() > 0 && line.charAt(0) != '#') {
+            lines.push_back({ sourceLine, line.c_str() });
+        }
+        sourceLine++;
+    }
+    return lines;
+}
+
+// Valores processados dos registros (gain/offset; sem Kalman e alinhamento)
+static void buildDeviceValues(DeviceValues* values) {
+    values->deviceCount = config.deviceCount;
+    values->registerCounts = new int[config.deviceCount];
+    values->values = new double*[config.deviceCount];
+    for (int i = 0; i < config.deviceCount; i++) {
+        values->registerCounts[i] = config.devices[i].registerCount;
+        values->values[i] = new double[config.devices[i].registerCount];
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            const ModbusRegister& reg = config.devices[i].registers[j];
+            if (isBitRegister(reg)) {
+                values->values[i][j] = bitGet(i, j) ? 1.0 : 0.0;
+                continue;
+            }
+            float processedValue = (registerRawValue(reg) * reg.gain) + reg.offset;
+            values->values[i][j] = (double)processedValue;
+        }
+    }
+}
+
+static void freeDeviceValues(DeviceValues* values) {
+    for (int i = 0; i < values->deviceCount; i++) {
+        delete[] values->values[i];
+    }
+    delete[] values->values;
+    delete[] values->registerCounts;
+}
+
+// Uma linha pelo interpretador (executeLine sem a escrita)
+static bool interpretLine(const std::string& text, DeviceValues* deviceValues, BenchVariables* variables,
+                          char* processedExpression, double* result) {
+    char errorMsg[256];
+    AssignmentInfo assignmentInfo;
+    if (!parseAssignment(text.c_str(), &assignmentInfo, errorMsg, sizeof(errorMsg))) {
+        return false;
+    }
+    const char* expression = assignmentInfo.hasAssignment ? assignmentInfo.expression : text.c_str();
+    Variable emptyVars[1];
+    bool ok = substituteDeviceValues(expression, deviceValues, processedExpression, 2048, errorMsg, sizeof(errorMsg),
+                                     variables->variables, variables->count) &&
+              evaluateExpression(processedExpression, emptyVars, 0, result, errorMsg, sizeof(errorMsg));
+    if (ok && assignmentInfo.isVariableAssignment) {
+        variables->store(assignmentInfo.targetVariable, *result);
+    }
+    freeAssignmentInfo(&assignmentInfo);
+    return ok;
+}
+
+static void runInterpreted(const std::vector<BenchLine>& lines, DeviceValues* deviceValues, char* processedExpression,
+                           std::vector<BenchResult>* results) {
+    BenchVariables variables;
+    variables.count = 0;
+    for (size_t k = 0; k < lines.size(); k++) {
+        BenchResult& result = (*results)[k];
+        result.ok = interpretLine(lines[k].text, deviceValues, &variables, processedExpression, &result.value);
+    }
+}
+
+static void runCompiled(const ScriptProgram* program, const std::vector<BenchLine>& lines, DeviceValues* deviceValues,
+                        char* processedExpression, std::vector<BenchResult>* results) {
+    BenchVariables variables;
+    variables.count = 0;
+    char errorMsg[256];
+    ScriptProgramState* state = scriptProgramBegin(program);
+    for (size_t k = 0; k < lines.size(); k++) {
+        BenchResult& result = (*results)[k];
+        const CompiledLine* compiled = scriptProgramLine(program, lines[k].sourceLine);
+        if (compiled->mode == SCRIPT_LINE_DEAD) {
+            result.ok = false;
+            continue;
+        }
+        if (compiled->mode != SCRIPT_LINE_COMPILED) {
+            result.ok = interpretLine(lines[k].text, deviceValues, &variables, processedExpression, &result.value);
+            continue;
+        }
+        result.ok = scriptProgramEvaluate(program, state, compiled, deviceValues, variables.variables, variables.count,
+                                          &result.value, errorMsg, sizeof(errorMsg));
+        if (result.ok && compiled->isVariableAssignment) {
+            variables.store(compiled->targetVariable, result.value);
+        }
+    }
+    scriptProgramEnd(state);
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point start, uint32_t runs) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+// @return true se alguma linha falha em só um dos modos
+static bool benchScript(const char* name, const char* code, DeviceValues* deviceValues, uint32_t runs, bool json) {
+    std::vector<BenchLine> lines = splitLines(code);
+    std::vector<BenchResult> interpreted(lines.size()), compiled(lines.size());
+    char* processedExpression = new char[2048];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ScriptProgram* program = scriptCompile(code, deviceValues);
+    double compileUs = elapsedUs(start, 1);
+    ScriptCompileStats stats;
+    scriptProgramStats(program, &stats);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t k = 0; k < runs; k++) {
+        runInterpreted(lines, deviceValues, processedExpression, &interpreted);
+    }
+    double interpretedUs = elapsedUs(start, runs);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t k = 0; k < runs; k++) {
+        runCompiled(program, lines, deviceValues, processedExpression, &compiled);
+    }
+    double compiledUs = elapsedUs(start, runs);
+
+    // Linhas eliminadas não têm resultado; as demais devem falhar nas mesmas linhas
+    double maxDifference = 0.0;
+    int maxLine = 0;
+    int mismatches = 0;
+    for (size_t k = 0; k < lines.size(); k++) {
+        if (scriptProgramLine(program, lines[k].sourceLine)->mode == SCRIPT_LINE_DEAD) {
+            continue;
+        }
+        if (interpreted[k].ok != compiled[k].ok) {
+            mismatches++;
+            if (!json) {
+                printf("  linha %d falha so %s: %s\n", lines[k].sourceLine, interpreted[k].ok ? "compilada" : "interpretada",
+                       lines[k].text.c_str());
+            }
+            continue;
+        }
+        double difference = fabs(interpreted[k].value - compiled[k].value);
+        if (interpreted[k].ok && difference > maxDifference) {
+            maxDifference = difference;
+            maxLine = lines[k].sourceLine;
+        }
+    }
+    scriptProgramFree(program);
+    delete[] processedExpression;
+
+    if (json) {
+        printf("{\"script\":\"%s\",\"lines\":%u,\"compiledLines\":%u,\"interpretedLines\":%u,\"deadAssignments\":%u,"
+               "\"ops\":%u,\"folded\":%u,\"shared\":%u,\"reduced\":%u,\"forwarded\":%u,\"compileUs\":%.1f,"
+               "\"interpretedUs\":%.3f,\"compiledUs\":%.3f,\"speedup\":%.2f,\"maxDifference\":%g,\"mismatches\":%d}\n",
+               name, (unsigned)lines.size(), stats.compiledLines, stats.interpretedLines, stats.deadAssignments, stats.ops,
+               stats.folded, stats.shared, stats.reduced, stats.forwarded, compileUs, interpretedUs, compiledUs,
+               compiledUs > 0 ? interpretedUs / compiledUs : 0.0, maxDifference, mismatches);
+    } else {
+        printf("[Bench] %s: %u linhas (%u compiladas, %u interpretadas, %u eliminadas), compilado em %.1f us\n", name,
+               (unsigned)lines.size(), stats.compiledLines, stats.interpretedLines, stats.deadAssignments, compileUs);
+        printf("  %u operacoes: %u dobradas, %u compartilhadas, %u reduzidas, %u leituras de variavel ligadas\n",
+               stats.ops, stats.folded, stats.shared, stats.reduced, stats.forwarded);
+        printf("  interpretado %10.3f us por execucao\n", interpretedUs);
+        printf("  compilado    %10.3f us por execucao (%.1fx)\n", compiledUs,
+               compiledUs > 0 ? interpretedUs / compiledUs : 0.0);
+        printf("  maior diferenca entre os resultados: %g%s\n", maxDifference,
+               maxLine > 0 ? (" (linha " + std::to_string(maxLine) + ")").c_str() : "");
+    }
+    return mismatches > 0;
+}
+
+int simScriptBenchRun(uint32_t runs, bool json) {
+    DeviceValues deviceValues;
+    buildDeviceValues(&deviceValues);
+    int failures = 0;
+    if (strlen(config.calculationCode) > 0) {
+        failures += benchScript("codigo", config.calculationCode, &deviceValues, runs, json);
+    }
+    ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    uint8_t count = scriptGetDefinitions(definitions, SCRIPT_MAX_SCRIPTS);
+    for (uint8_t k = 0; k < count; k++) {
+        failures += benchScript(definitions[k].name, definitions[k].code, &deviceValues, runs, json);
+    }
+    delete[] definitions;
+    freeDeviceValues(&deviceValues);
+    return failures;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file sim_script_bench.h
+ * @brief Custo de avaliação do código de cálculo, interpretado e compilado (sim --script-bench)
+ *
+ * Para o código de cálculo e cada script nomeado do cenário, com os valores
+ * de um ciclo de leitura simulado, executa todas as linhas N vezes de cada
+ * jeito, sem efeitos colaterais (display(), bcast() e as atribuições a
+ * registros só calculam o valor):
+ * - Interpretado: parseAssignment(), substituteDeviceValues() e
+ *   evaluateExpression() em cada linha, como antes da compilação
+ * - Compilado: scriptCompile() uma vez e scriptProgramEvaluate() em cada
+ *   linha (as que o compilador não trata usam o interpretador, como no firmware)
+ *
+ * Mostra o custo de uma execução de cada script no relógio do PC, o resultado
+ * da compilação e a maior diferença entre os resultados das linhas.
+ */
+
+#ifndef SIM_SCRIPT_BENCH_H
+#define SIM_SCRIPT_BENCH_H
+
+#include <stdint.h>
+
+/**
+ * @brief Compara os dois modos nos scripts carregados (config e scripts nomeados)
+ * @param runs Execuções de cada script em cada modo
+ * @param json Uma linha JSON por script em vez do texto
+ * @return Quantidade de scripts com linhas que falham em só um dos modos
+ */
+int simScriptBenchRun(uint32_t runs, bool json);
+
+#endif // SIM_SCRIPT_BENCH_H
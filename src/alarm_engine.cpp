@@ -0,0 +1,513 @@
+/**
+ * @file alarm_engine.cpp
+ * @brief Implementação do motor de alarmes
+ */
+
+#include "alarm_engine.h"
+#include "console.h"
+#include "data_logger.h"
+#include "rtc_manager.h"
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define ALARM_BIT_COUNT (ALARM_MAX_DEFINITIONS * ALARM_CONDITION_COUNT)
+#define ALARM_BITSET_WORDS ((ALARM_BIT_COUNT + 31) / 32)
+
+/**
+ * @brief Estado de uma condição
+ */
+enum AlarmState {
+    ALARM_STATE_IDLE = 0,
+    ALARM_STATE_PENDING_ON,    // Condição presente, aguardando onDelayMs
+    ALARM_STATE_ACTIVE,
+    ALARM_STATE_PENDING_OFF,   // Condição ausente, aguardando offDelayMs
+    ALARM_STATE_LATCHED        // Condição ausente, retido até o reconhecimento
+};
+
+/**
+ * @struct AlarmChannel
+ * @brief Estado de execução de uma definição
+ */
+struct AlarmChannel {
+    bool hasSample;
+    float lastValue;
+    float lastRate;
+    int64_t lastSampleUs;      // Última leitura (ou início do motor, para o stale)
+    uint8_t state[ALARM_CONDITION_COUNT];
+    int64_t sinceUs[ALARM_CONDITION_COUNT];
+};
+
+static AlarmDefinition s_definitions[ALARM_MAX_DEFINITIONS];
+static AlarmChannel s_channels[ALARM_MAX_DEFINITIONS];
+static uint8_t s_definitionCount = 0;
+
+// Bitsets indexados por definition * ALARM_CONDITION_COUNT + condition
+static uint32_t s_activeBits[ALARM_BITSET_WORDS];
+static uint32_t s_unackedBits[ALARM_BITSET_WORDS];
+static uint32_t s_pendingBits[ALARM_BITSET_WORDS];   // Atraso em andamento (alarmService)
+
+static AlarmEvent s_events[ALARM_EVENT_QUEUE_SIZE];
+static uint32_t s_nextSeq = 1;
+static uint32_t s_consoleCursor = 1;
+
+static SemaphoreHandle_t s_alarmMutex = nullptr;
+
+static inline bool lockAlarms(TickType_t ticks) {
+    if (s_alarmMutex == nullptr) {
+        s_alarmMutex = xSemaphoreCreateMutex();
+    }
+    return s_alarmMutex != nullptr && xSemaphoreTake(s_alarmMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockAlarms() {
+    xSemaphoreGive(s_alarmMutex);
+}
+
+static inline uint16_t bitIndex(uint8_t definition, uint8_t condition) {
+    return (uint16_t)definition * ALARM_CONDITION_COUNT + condition;
+}
+
+static inline void setBit(uint32_t* bits, uint16_t index, bool value) {
+    if (value) {
+        bits[index >> 5] |= (1UL << (index & 31));
+    } else {
+        bits[index >> 5] &= ~(1UL << (index & 31));
+    }
+}
+
+static inline bool getBit(const uint32_t* bits, uint16_t index) {
+    return (bits[index >> 5] >> (index & 31)) & 1UL;
+}
+
+static void pushEvent(uint8_t definition, uint8_t condition, uint8_t kind, float value, int64_t nowUs) {
+    AlarmEvent* event = &s_events[s_nextSeq % ALARM_EVENT_QUEUE_SIZE];
+    bool utc;
+    event->seq = s_nextSeq++;
+    event->timeMs = dataLoggerTimeMs(nowUs, &utc);
+    event->definition = definition;
+    event->condition = condition;
+    event->kind = kind;
+    event->value = value;
+}
+
+static void raise(uint8_t definition, uint8_t condition, float value, int64_t nowUs) {
+    uint16_t index = bitIndex(definition, condition);
+    s_channels[definition].state[condition] = ALARM_STATE_ACTIVE;
+    setBit(s_activeBits, index, true);
+    setBit(s_unackedBits, index, true);
+    pushEvent(definition, condition, ALARM_EVENT_RAISED, value, nowUs);
+}
+
+static void clear(uint8_t definition, uint8_t condition, float value, int64_t nowUs) {
+    uint16_t index = bitIndex(definition, condition);
+    if (s_definitions[definition].latch && getBit(s_unackedBits, index)) {
+        // Retentivo: continua ativo até o reconhecimento
+        s_channels[definition].state[condition] = ALARM_STATE_LATCHED;
+        return;
+    }
+    s_channels[definition].state[condition] = ALARM_STATE_IDLE;
+    setBit(s_activeBits, index, false);
+    setBit(s_unackedBits, index, false);
+    pushEvent(definition, condition, ALARM_EVENT_CLEARED, value, nowUs);
+}
+
+// Avança a máquina de estados de uma condição com o resultado do teste atual
+static void step(uint8_t definition, uint8_t condition, bool present, float value, int64_t nowUs) {
+    const AlarmDefinition* def = &s_definitions[definition];
+    AlarmChannel* channel = &s_channels[definition];
+    uint16_t index = bitIndex(definition, condition);
+    uint8_t state = channel->state[condition];
+
+    switch (state) {
+        case ALARM_STATE_IDLE:
+            if (present) {
+                if (def->onDelayMs == 0) {
+                    raise(definition, condition, value, nowUs);
+                } else {
+                    channel->state[condition] = ALARM_STATE_PENDING_ON;
+                    channel->sinceUs[condition] = nowUs;
+                }
+            }
+            break;
+        case ALARM_STATE_PENDING_ON:
+            if (!present) {
+                channel->state[condition] = ALARM_STATE_IDLE;
+            } else if (nowUs - channel->sinceUs[condition] >= (int64_t)def->onDelayMs * 1000LL) {
+                raise(definition, condition, value, nowUs);
+            }
+            break;
+        case ALARM_STATE_ACTIVE:
+            if (!present) {
+                if (def->offDelayMs == 0) {
+                    clear(definition, condition, value, nowUs);
+                } else {
+                    channel->state[condition] = ALARM_STATE_PENDING_OFF;
+                    channel->sinceUs[condition] = nowUs;
+                }
+            }
+            break;
+        case ALARM_STATE_PENDING_OFF:
+            if (present) {
+                channel->state[condition] = ALARM_STATE_ACTIVE;
+            } else if (nowUs - channel->sinceUs[condition] >= (int64_t)def->offDelayMs * 1000LL) {
+                clear(definition, condition, value, nowUs);
+            }
+            break;
+        case ALARM_STATE_LATCHED:
+            if (present) {
+                // Voltou enquanto retido: segue ativo sem novo evento
+                channel->state[condition] = ALARM_STATE_ACTIVE;
+            }
+            break;
+    }
+
+    state = channel->state[condition];
+    setBit(s_pendingBits, index, state == ALARM_STATE_PENDING_ON || state == ALARM_STATE_PENDING_OFF);
+}
+
+// Condição presente ou em andamento (usa o limite de desativação da histerese)
+static inline bool asserted(const AlarmChannel* channel, uint8_t condition) {
+    uint8_t state = channel->state[condition];
+    return state == ALARM_STATE_ACTIVE || state == ALARM_STATE_PENDING_OFF || state == ALARM_STATE_LATCHED;
+}
+
+static bool testCondition(uint8_t definition, uint8_t condition, float value) {
+    const AlarmDefinition* def = &s_definitions[definition];
+    const AlarmChannel* channel = &s_channels[definition];
+    bool on = asserted(channel, condition);
+    switch (condition) {
+        case ALARM_HIHI: return on ? value > def->hihi - def->deadband : value >= def->hihi;
+        case ALARM_HI:   return on ? value > def->hi - def->deadband : value >= def->hi;
+        case ALARM_LO:   return on ? value < def->lo + def->deadband : value <= def->lo;
+        case ALARM_LOLO: return on ? value < def->lolo + def->deadband : value <= def->lolo;
+        // A taxa não tem banda morta própria; offDelayMs faz o papel de histerese
+        case ALARM_RATE: return channel->lastRate > def->rateLimit;
+    }
+    return false;
+}
+
+static inline bool conditionEnabled(const AlarmDefinition* def, uint8_t condition) {
+    return (def->enabledMask >> condition) & 1;
+}
+
+void alarmOnSample(uint8_t slaveAddress, uint16_t registerAddress, int64_t sampleTimeUs, float value) {
+    if (s_definitionCount == 0 || !lockAlarms(pdMS_TO_TICKS(10))) {
+        return;
+    }
+
+    for (uint8_t d = 0; d < s_definitionCount; d++) {
+        const AlarmDefinition* def = &s_definitions[d];
+        if (def->slaveAddress != slaveAddress || def->registerAddress != registerAddress) {
+            continue;
+        }
+        AlarmChannel* channel = &s_channels[d];
+
+        // Leitura chegou: o dado não está parado
+        if (conditionEnabled(def, ALARM_STALE) && channel->state[ALARM_STALE] != ALARM_STATE_IDLE) {
+            step(d, ALARM_STALE, false, value, sampleTimeUs);
+        }
+
+        bool changed = !channel->hasSample || value != channel->lastValue;
+        float rate = 0.0f;
+        if (channel->hasSample && sampleTimeUs > channel->lastSampleUs) {
+            rate = fabsf(value - channel->lastValue) * 1000000.0f / (float)(sampleTimeUs - channel->lastSampleUs);
+        }
+        bool rateWasZero = channel->lastRate == 0.0f;
+        channel->hasSample = true;
+        channel->lastValue = value;
+        channel->lastRate = rate;
+        channel->lastSampleUs = sampleTimeUs;
+
+        // Valor igual ao anterior: limites não mudam de resultado; os atrasos ficam com alarmService()
+        if (!changed && rateWasZero) {
+            continue;
+        }
+
+        for (uint8_t c = ALARM_HIHI; c <= ALARM_RATE; c++) {
+            if (conditionEnabled(def, c)) {
+                step(d, c, testCondition(d, c, value), c == ALARM_RATE ? rate : value, sampleTimeUs);
+            }
+        }
+    }
+
+    unlockAlarms();
+}
+
+void alarmService(int64_t nowUs) {
+    if (s_definitionCount > 0 && lockAlarms(pdMS_TO_TICKS(10))) {
+        for (uint8_t d = 0; d < s_definitionCount; d++) {
+            const AlarmDefinition* def = &s_definitions[d];
+            AlarmChannel* channel = &s_channels[d];
+
+            if (conditionEnabled(def, ALARM_STALE) && def->staleMs > 0 &&
+                nowUs - channel->lastSampleUs >= (int64_t)def->staleMs * 1000LL &&
+                channel->state[ALARM_STALE] == ALARM_STATE_IDLE) {
+                step(d, ALARM_STALE, true, channel->lastValue, nowUs);
+            }
+
+            // Só condições com atraso em andamento: o teste não mudou desde a última amostra
+            for (uint8_t c = 0; c < ALARM_CONDITION_COUNT; c++) {
+                if (!getBit(s_pendingBits, bitIndex(d, c))) {
+                    continue;
+                }
+                bool present = channel->state[c] == ALARM_STATE_PENDING_ON;
+                if (c == ALARM_STALE) {
+                    present = nowUs - channel->lastSampleUs >= (int64_t)def->staleMs * 1000LL;
+                }
+                step(d, c, present, c == ALARM_RATE ? channel->lastRate : channel->lastValue, nowUs);
+            }
+        }
+        unlockAlarms();
+    }
+
+    // Consumidor do console
+    AlarmEvent event;
+    while (alarmReadEvent(&s_consoleCursor, &event)) {
+        AlarmDefinition def;
+        if (!lockAlarms(pdMS_TO_TICKS(10))) {
+            break;
+        }
+        def = s_definitions[event.definition];
+        unlockAlarms();
+
+        String label = strlen(def.name) > 0
+            ? String(def.name)
+            : "Dev " + String(def.slaveAddress) + " Reg " + String(def.registerAddress);
+        const char* kind = event.kind == ALARM_EVENT_RAISED ? "ATIVO" :
+                           event.kind == ALARM_EVENT_CLEARED ? "normalizado" : "reconhecido";
+        consolePrint("[Alarme] " + label + " " + alarmConditionName(event.condition) + " " + kind +
+                     " (valor: " + String(event.value, 2) + ")\r\n");
+    }
+}
+
+bool alarmAcknowledge(uint8_t definition, uint8_t condition, int64_t nowUs) {
+    if (definition >= ALARM_MAX_DEFINITIONS || condition >= ALARM_CONDITION_COUNT || !lockAlarms(pdMS_TO_TICKS(100))) {
+        return false;
+    }
+    bool acked = false;
+    uint16_t index = bitIndex(definition, condition);
+    if (definition < s_definitionCount && getBit(s_unackedBits, index)) {
+        AlarmChannel* channel = &s_channels[definition];
+        float value = condition == ALARM_RATE ? channel->lastRate : channel->lastValue;
+        setBit(s_unackedBits, index, false);
+        pushEvent(definition, condition, ALARM_EVENT_ACKED, value, nowUs);
+        if (channel->state[condition] == ALARM_STATE_LATCHED) {
+            clear(definition, condition, value, nowUs);
+        }
+        acked = true;
+    }
+    unlockAlarms();
+    return acked;
+}
+
+uint8_t alarmAcknowledgeAll(int64_t nowUs) {
+    uint8_t count = 0;
+    for (uint8_t d = 0; d < ALARM_MAX_DEFINITIONS; d++) {
+        for (uint8_t c = 0; c < ALARM_CONDITION_COUNT; c++) {
+            if (alarmIsUnacknowledged(d, c) && alarmAcknowledge(d, c, nowUs)) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+bool alarmIsActive(uint8_t definition, uint8_t condition) {
+    if (definition >= ALARM_MAX_DEFINITIONS || condition >= ALARM_CONDITION_COUNT) {
+        return false;
+    }
+    return getBit(s_activeBits, bitIndex(definition, condition));
+}
+
+bool alarmIsUnacknowledged(uint8_t definition, uint8_t condition) {
+    if (definition >= ALARM_MAX_DEFINITIONS || condition >= ALARM_CONDITION_COUNT) {
+        return false;
+    }
+    return getBit(s_unackedBits, bitIndex(definition, condition));
+}
+
+uint16_t alarmActiveCount() {
+    uint16_t count = 0;
+    for (uint8_t w = 0; w < ALARM_BITSET_WORDS; w++) {
+        count += __builtin_popcount(s_activeBits[w]);
+    }
+    return count;
+}
+
+bool alarmReadEvent(uint32_t* cursor, AlarmEvent* event) {
+    if (!lockAlarms(pdMS_TO_TICKS(10))) {
+        return false;
+    }
+    bool found = false;
+    // Consumidor atrasado (ou cursor inicial 0): avança para o evento mais antigo ainda na fila
+    uint32_t oldest = s_nextSeq > ALARM_EVENT_QUEUE_SIZE ? s_nextSeq - ALARM_EVENT_QUEUE_SIZE : 1;
+    if (*cursor < oldest) {
+        *cursor = oldest;
+    }
+    if (*cursor < s_nextSeq) {
+        *event = s_events[*cursor % ALARM_EVENT_QUEUE_SIZE];
+        (*cursor)++;
+        found = true;
+    }
+    unlockAlarms();
+    return found;
+}
+
+uint32_t alarmNextEventSeq() {
+    return s_nextSeq;
+}
+
+const char* alarmConditionName(uint8_t condition) {
+    switch (condition) {
+        case ALARM_HIHI:  return "HIHI";
+        case ALARM_HI:    return "HI";
+        case ALARM_LO:    return "LO";
+        case ALARM_LOLO:  return "LOLO";
+        case ALARM_RATE:  return "TAXA";
+        case ALARM_STALE: return "SEM_DADOS";
+    }
+    return "?";
+}
+
+// ==================== DEFINIÇÕES ====================
+
+static const char* const CONDITION_KEYS[ALARM_CONDITION_COUNT] = {
+    "hihi", "hi", "lo", "lolo", "rate", "stale"
+};
+
+void alarmDefinitionToJson(const AlarmDefinition* definition, JsonObject obj) {
+    obj["slaveAddress"] = definition->slaveAddress;
+    obj["registerAddress"] = definition->registerAddress;
+    obj["name"] = definition->name;
+    // Limites desabilitados não são gravados
+    if (definition->enabledMask & (1 << ALARM_HIHI)) obj["hihi"] = definition->hihi;
+    if (definition->enabledMask & (1 << ALARM_HI)) obj["hi"] = definition->hi;
+    if (definition->enabledMask & (1 << ALARM_LO)) obj["lo"] = definition->lo;
+    if (definition->enabledMask & (1 << ALARM_LOLO)) obj["lolo"] = definition->lolo;
+    if (definition->enabledMask & (1 << ALARM_RATE)) obj["rate"] = definition->rateLimit;
+    if (definition->enabledMask & (1 << ALARM_STALE)) obj["stale"] = definition->staleMs;
+    obj["deadband"] = definition->deadband;
+    obj["onDelayMs"] = definition->onDelayMs;
+    obj["offDelayMs"] = definition->offDelayMs;
+    obj["latch"] = definition->latch;
+}
+
+bool alarmDefinitionFromJson(JsonObjectConst obj, AlarmDefinition* definition) {
+    memset(definition, 0, sizeof(AlarmDefinition));
+    definition->slaveAddress = obj["slaveAddress"] | 0;
+    definition->registerAddress = obj["registerAddress"] | 0;
+    const char* name = obj["name"] | "";
+    strncpy(definition->name, name, sizeof(definition->name) - 1);
+
+    // Presença da chave habilita a condição
+    for (uint8_t c = 0; c < ALARM_CONDITION_COUNT; c++) {
+        if (!obj[CONDITION_KEYS[c]].isNull()) {
+            definition->enabledMask |= (1 << c);
+        }
+    }
+    definition->hihi = obj["hihi"] | 0.0f;
+    definition->hi = obj["hi"] | 0.0f;
+    definition->lo = obj["lo"] | 0.0f;
+    definition->lolo = obj["lolo"] | 0.0f;
+    definition->rateLimit = obj["rate"] | 0.0f;
+    definition->staleMs = obj["stale"] | 0;
+    definition->deadband = obj["deadband"] | 0.0f;
+    definition->onDelayMs = obj["onDelayMs"] | 0;
+    definition->offDelayMs = obj["offDelayMs"] | 0;
+    definition->latch = obj["latch"] | false;
+
+    if (isnan(definition->deadband) || definition->deadband < 0.0f) {
+        definition->deadband = 0.0f;
+    }
+    if ((definition->enabledMask & (1 << ALARM_STALE)) && definition->staleMs == 0) {
+        definition->enabledMask &= ~(1 << ALARM_STALE);
+    }
+    return definition->slaveAddress > 0 && definition->enabledMask != 0;
+}
+
+uint8_t alarmSetDefinitions(const AlarmDefinition* definitions, uint8_t count) {
+    if (count > ALARM_MAX_DEFINITIONS) {
+        count = ALARM_MAX_DEFINITIONS;
+    }
+    if (!lockAlarms(portMAX_DELAY)) {
+        return 0;
+    }
+    if (count > 0) {
+        memcpy(s_definitions, definitions, count * sizeof(AlarmDefinition));
+    }
+    s_definitionCount = count;
+
+    // Estados recomeçam; o stale conta a partir de agora
+    int64_t nowUs = monotonicMicros();
+    memset(s_channels, 0, sizeof(s_channels));
+    for (uint8_t d = 0; d < ALARM_MAX_DEFINITIONS; d++) {
+        s_channels[d].lastSampleUs = nowUs;
+    }
+    memset(s_activeBits, 0, sizeof(s_activeBits));
+    memset(s_unackedBits, 0, sizeof(s_unackedBits));
+    memset(s_pendingBits, 0, sizeof(s_pendingBits));
+    unlockAlarms();
+    return count;
+}
+
+uint8_t alarmGetDefinitions(AlarmDefinition* definitions, uint8_t maxCount) {
+    if (!lockAlarms(pdMS_TO_TICKS(100))) {
+        return 0;
+    }
+    uint8_t count = s_definitionCount < maxCount ? s_definitionCount : maxCount;
+    memcpy(definitions, s_definitions, count * sizeof(AlarmDefinition));
+    unlockAlarms();
+    return count;
+}
+
+bool alarmSaveDefinitions() {
+    // CRÍTICO: cópia local para não segurar o mutex durante a gravação em flash
+    AlarmDefinition* definitions = new AlarmDefinition[ALARM_MAX_DEFINITIONS];
+    uint8_t count = alarmGetDefinitions(definitions, ALARM_MAX_DEFINITIONS);
+
+    DynamicJsonDocument doc(8192);
+    JsonArray array = doc.createNestedArray("alarms");
+    for (uint8_t d = 0; d < count; d++) {
+        alarmDefinitionToJson(&definitions[d], array.createNestedObject());
+    }
+    delete[] definitions;
+
+    File file = LittleFS.open(ALARM_CONFIG_FILE, "w");
+    if (!file) {
+        consolePrint("[Alarme] Erro ao gravar " ALARM_CONFIG_FILE "\r\n");
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    return true;
+}
+
+void alarmEngineInit() {
+    s_consoleCursor = alarmNextEventSeq();
+
+    File file = LittleFS.open(ALARM_CONFIG_FILE, "r");
+    if (!file) {
+        alarmSetDefinitions(nullptr, 0);
+        return;
+    }
+    DynamicJsonDocument doc(8192);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        consolePrint("[Alarme] " ALARM_CONFIG_FILE " invalido: " + String(error.c_str()) + "\r\n");
+        alarmSetDefinitions(nullptr, 0);
+        return;
+    }
+
+    AlarmDefinition* definitions = new AlarmDefinition[ALARM_MAX_DEFINITIONS];
+    uint8_t count = 0;
+    for (JsonObjectConst obj : doc["alarms"].as<JsonArrayConst>()) {
+        if (count < ALARM_MAX_DEFINITIONS && alarmDefinitionFromJson(obj, &definitions[count])) {
+            count++;
+        }
+    }
+    alarmSetDefinitions(definitions, count);
+    delete[] definitions;
+    consolePrint("[Alarme] " + String(count) + " definicoes carregadas\r\n");
+}
@@ -0,0 +1,160 @@
+/**
+ * @file alarm_engine.h
+ * @brief Alarmes nativos por registro (limites, taxa de variação e dado parado)
+ *
+ * Cada definição observa um registro (escravo + endereço) e pode ter até seis
+ * condições: HIHI, HI, LO, LOLO, taxa de variação e dado parado (stale). As
+ * condições de limite têm banda morta (histerese); todas têm atrasos de
+ * ativação e desativação e podem ser retentivas (latch: permanecem ativas até
+ * serem reconhecidas, mesmo que a condição desapareça).
+ *
+ * A avaliação é feita por alarmOnSample() somente quando o valor lido muda;
+ * alarmService() no loop só trata atrasos em andamento e dados parados. Os
+ * alarmes ativos ficam em um bitset e as transições geram eventos em uma fila
+ * circular com número de sequência: cada consumidor (console, interface web)
+ * mantém o próprio cursor.
+ *
+ * A máquina de estados não acessa o relógio: todos os instantes são passados
+ * pelo chamador (monotonicMicros()).
+ */
+
+#ifndef ALARM_ENGINE_H
+#define ALARM_ENGINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define ALARM_MAX_DEFINITIONS 32
+#define ALARM_EVENT_QUEUE_SIZE 32
+#define ALARM_CONFIG_FILE "/alarms.json"
+
+/**
+ * @brief Condições de alarme de uma definição (índice do bit)
+ */
+enum AlarmCondition {
+    ALARM_HIHI = 0,
+    ALARM_HI,
+    ALARM_LO,
+    ALARM_LOLO,
+    ALARM_RATE,                // |Δvalor| / Δt acima do limite (unidades por segundo)
+    ALARM_STALE,               // Nenhuma leitura bem-sucedida há staleMs
+    ALARM_CONDITION_COUNT
+};
+
+/**
+ * @brief Tipos de evento
+ */
+enum AlarmEventKind {
+    ALARM_EVENT_RAISED = 0,
+    ALARM_EVENT_CLEARED,
+    ALARM_EVENT_ACKED
+};
+
+/**
+ * @struct AlarmDefinition
+ * @brief Configuração de alarmes de um registro
+ */
+struct AlarmDefinition {
+    uint8_t slaveAddress;
+    uint16_t registerAddress;
+    char name[24];             // Texto exibido nos eventos (vazio = "Dev X Reg Y")
+    uint8_t enabledMask;       // Bit (1 << AlarmCondition) = condição habilitada
+    float hihi;
+    float hi;
+    float lo;
+    float lolo;
+    float deadband;            // Histerese dos limites (mesma unidade do valor processado)
+    float rateLimit;           // Unidades por segundo (ALARM_RATE)
+    uint32_t staleMs;          // ALARM_STALE
+    uint32_t onDelayMs;        // Condição precisa persistir para ativar
+    uint32_t offDelayMs;       // Condição precisa desaparecer por este tempo para desativar
+    bool latch;                // Permanece ativo até ser reconhecido
+};
+
+/**
+ * @struct AlarmEvent
+ * @brief Transição de um alarme
+ */
+struct AlarmEvent {
+    uint32_t seq;              // Sequência crescente (cursor dos consumidores)
+    int64_t timeMs;            // Base de tempo das amostras (dataLoggerTimeMs)
+    uint8_t definition;
+    uint8_t condition;         // AlarmCondition
+    uint8_t kind;              // AlarmEventKind
+    float value;               // Valor (ou taxa, para ALARM_RATE) no instante do evento
+};
+
+/**
+ * @brief Carrega as definições de ALARM_CONFIG_FILE (precisa do LittleFS montado)
+ */
+void alarmEngineInit();
+
+/**
+ * @brief Substitui as definições e reinicia todos os estados
+ * @return Quantidade de definições válidas
+ */
+uint8_t alarmSetDefinitions(const AlarmDefinition* definitions, uint8_t count);
+
+/**
+ * @brief Copia as definições atuais
+ * @return Quantidade de definições
+ */
+uint8_t alarmGetDefinitions(AlarmDefinition* definitions, uint8_t maxCount);
+
+/**
+ * @brief Grava as definições atuais em ALARM_CONFIG_FILE
+ */
+bool alarmSaveDefinitions();
+
+/**
+ * @brief Converte definições entre a estrutura e JSON (arquivo e API)
+ */
+void alarmDefinitionToJson(const AlarmDefinition* definition, JsonObject obj);
+bool alarmDefinitionFromJson(JsonObjectConst obj, AlarmDefinition* definition);
+
+/**
+ * @brief Nova leitura bem-sucedida de um registro (chamar após gain/offset/Kalman)
+ * @param sampleTimeUs Recepção da resposta (monotonicMicros())
+ */
+void alarmOnSample(uint8_t slaveAddress, uint16_t registerAddress, int64_t sampleTimeUs, float value);
+
+/**
+ * @brief Atrasos de ativação/desativação e dados parados; envia eventos novos ao console
+ * @param nowUs monotonicMicros()
+ */
+void alarmService(int64_t nowUs);
+
+/**
+ * @brief Reconhece um alarme (libera alarmes retentivos cuja condição já desapareceu)
+ * @return false se não havia nada a reconhecer
+ */
+bool alarmAcknowledge(uint8_t definition, uint8_t condition, int64_t nowUs);
+
+/**
+ * @brief Reconhece todos os alarmes pendentes
+ * @return Quantidade reconhecida
+ */
+uint8_t alarmAcknowledgeAll(int64_t nowUs);
+
+bool alarmIsActive(uint8_t definition, uint8_t condition);
+bool alarmIsUnacknowledged(uint8_t definition, uint8_t condition);
+uint16_t alarmActiveCount();
+
+/**
+ * @brief Lê o próximo evento a partir de um cursor
+ *
+ * O cursor começa em 0 (ou em alarmNextEventSeq() para ignorar o passado).
+ * Se o consumidor ficou para trás mais que ALARM_EVENT_QUEUE_SIZE eventos,
+ * o cursor avança para o mais antigo disponível.
+ * @return false se não há eventos novos
+ */
+bool alarmReadEvent(uint32_t* cursor, AlarmEvent* event);
+
+/**
+ * @brief Sequência do próximo evento a ser gerado
+ */
+uint32_t alarmNextEventSeq();
+
+const char* alarmConditionName(uint8_t condition);
+
+#endif // ALARM_ENGINE_H
@@ -0,0 +1,456 @@
+/**
+ * @file bus_capture.cpp
+ * @brief Implementação da captura do barramento RS485
+ */
+
+#include "bus_capture.h"
+#include "modbus_handler.h"
+#include "modbus_rtu.h"
+#include "rtc_manager.h"
+#include "freertos/FreeRTOS.h"
+#include <new>
+
+#define CAPTURE_WRAP 0xFFFF                // stored = CAPTURE_WRAP: próximo registro no início do anel
+
+/**
+ * @struct CaptureRecord
+ * @brief Cabeçalho de um quadro no anel (seguido de stored bytes, alinhado em 8)
+ */
+struct CaptureRecord {
+    int64_t timeUs;
+    uint16_t length;                       // Bytes no barramento
+    uint16_t stored;                       // Bytes gravados (ou CAPTURE_WRAP)
+    uint8_t direction;
+    uint8_t flags;
+    uint16_t reserved;
+};
+
+BusCaptureSerial busSerial;
+
+// Anel: escrito somente pelo loop (dono do barramento), lido pela web e pelo console
+static uint8_t s_ring[CAPTURE_RING_BYTES] __attribute__((aligned(8)));
+static uint32_t s_head = 0;                // Próxima posição livre
+static uint32_t s_tail = 0;                // Registro mais antigo
+static uint16_t s_count = 0;
+static int32_t s_lastTxOffset = -1;        // Último TX ainda no anel (marca de falta de resposta)
+static portMUX_TYPE s_ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool s_enabled = true;
+static bool s_trigger = false;
+static volatile bool s_frozen = false;
+static volatile bool s_suspended = false;
+static uint8_t s_triggerFlags = 0;
+static int64_t s_triggerUs = 0;
+static volatile int64_t s_clearedUs = 0;  // Quadros iniciados antes da limpeza são descartados
+static uint32_t s_captured = 0;
+static uint32_t s_overwritten = 0;
+static uint32_t s_crcErrors = 0;
+static uint32_t s_noReply = 0;
+
+// Quadro em montagem (somente o loop)
+static uint8_t s_frame[CAPTURE_MAX_FRAME];
+static uint16_t s_frameLength = 0;
+static uint8_t s_frameDirection = BUS_CAPTURE_DIR_TX;
+static bool s_frameOpen = false;
+static int64_t s_frameStartUs = 0;
+static uint32_t s_lastRxMicros = 0;
+static bool s_awaitingReply = false;
+
+static inline uint32_t recordSize(uint16_t stored) {
+    return (sizeof(CaptureRecord) + stored + 7) & ~7UL;
+}
+
+// Posição do registro em offset (pula a marca de volta ao início)
+static inline uint32_t recordAt(uint32_t offset, CaptureRecord* record) {
+    if (CAPTURE_RING_BYTES - offset < sizeof(CaptureRecord)) {
+        offset = 0;
+    }
+    memcpy(record, &s_ring[offset], sizeof(CaptureRecord));
+    if (record->stored == CAPTURE_WRAP) {
+        offset = 0;
+        memcpy(record, &s_ring[offset], sizeof(CaptureRecord));
+    }
+    return offset;
+}
+
+// Descarta o registro mais antigo (dentro da seção crítica)
+static void evictOldest() {
+    CaptureRecord record;
+    uint32_t offset = recordAt(s_tail, &record);
+    if ((int32_t)offset == s_lastTxOffset) {
+        s_lastTxOffset = -1;
+    }
+    s_tail = offset + recordSize(record.stored);
+    s_count--;
+    s_overwritten++;
+    if (s_count == 0) {
+        s_head = s_tail = 0;
+    }
+}
+
+// Reserva espaço contíguo para um registro (dentro da seção crítica)
+static uint32_t allocate(uint32_t need) {
+    while (true) {
+        if (s_count == 0) {
+            s_head = s_tail = 0;
+            return 0;
+        }
+        if (s_head > s_tail) {
+            if (CAPTURE_RING_BYTES - s_head >= need) {
+                return s_head;
+            }
+            if (CAPTURE_RING_BYTES - s_head >= sizeof(CaptureRecord)) {
+                CaptureRecord wrap = {};
+                wrap.stored = CAPTURE_WRAP;
+                memcpy(&s_ring[s_head], &wrap, sizeof(wrap));
+            }
+            s_head = 0;
+        } else {
+            if (s_tail - s_head >= need) {
+                return s_head;
+            }
+            evictOldest();
+        }
+    }
+}
+
+static void markFrozen(uint8_t flags) {
+    s_frozen = true;
+    s_triggerFlags = flags;
+    s_triggerUs = monotonicMicros();
+}
+
+// Grava o quadro montado no anel
+static void commitFrame() {
+    if (!s_frameOpen) {
+        return;
+    }
+    s_frameOpen = false;
+    if (s_frozen || s_frameStartUs < s_clearedUs) {
+        return;
+    }
+
+    uint8_t flags = 0;
+    uint16_t stored = s_frameLength < CAPTURE_MAX_FRAME ? s_frameLength : CAPTURE_MAX_FRAME;
+    if (s_frameLength > CAPTURE_MAX_FRAME) {
+        flags |= BUS_CAPTURE_FLAG_TRUNCATED;
+    }
+    if (s_frameDirection == BUS_CAPTURE_DIR_RX) {
+        bool valid = s_frameLength >= 4 && s_frameLength <= CAPTURE_MAX_FRAME;
+        if (valid) {
+            uint16_t crc = modbusCrc16(s_frame, s_frameLength - 2);
+            valid = s_frame[s_frameLength - 2] == (crc & 0xFF) && s_frame[s_frameLength - 1] == (crc >> 8);
+        }
+        if (!valid) {
+            flags |= BUS_CAPTURE_FLAG_CRC_ERROR;
+            s_crcErrors++;
+        }
+    }
+    bool freeze = s_trigger && (flags & BUS_CAPTURE_FLAG_CRC_ERROR);
+    if (freeze) {
+        flags |= BUS_CAPTURE_FLAG_TRIGGER;
+    }
+
+    CaptureRecord record;
+    record.timeUs = s_frameStartUs;
+    record.length = s_frameLength;
+    record.stored = stored;
+    record.direction = s_frameDirection;
+    record.flags = flags;
+    record.reserved = 0;
+
+    uint32_t need = recordSize(stored);
+    portENTER_CRITICAL(&s_ringMux);
+    uint32_t offset = allocate(need);
+    memcpy(&s_ring[offset], &record, sizeof(record));
+    memcpy(&s_ring[offset + sizeof(record)], s_frame, stored);
+    s_head = offset + need;
+    s_count++;
+    if (s_frameDirection == BUS_CAPTURE_DIR_TX) {
+        s_lastTxOffset = (int32_t)offset;
+    }
+    portEXIT_CRITICAL(&s_ringMux);
+    s_captured++;
+
+    if (freeze) {
+        markFrozen(flags);
+    }
+}
+
+// Requisição anterior ficou sem resposta: marca o quadro TX ainda no anel
+static void flagMissingReply() {
+    s_awaitingReply = false;
+    s_noReply++;
+    if (s_frozen) {
+        return;
+    }
+    uint8_t flags = BUS_CAPTURE_FLAG_NO_REPLY | (s_trigger ? BUS_CAPTURE_FLAG_TRIGGER : 0);
+    portENTER_CRITICAL(&s_ringMux);
+    if (s_lastTxOffset >= 0) {
+        CaptureRecord record;
+        memcpy(&record, &s_ring[s_lastTxOffset], sizeof(record));
+        record.flags |= flags;
+        memcpy(&s_ring[s_lastTxOffset], &record, sizeof(record));
+    }
+    portEXIT_CRITICAL(&s_ringMux);
+    if (s_trigger) {
+        markFrozen(flags);
+    }
+}
+
+static inline bool capturing() {
+    return s_enabled && !s_suspended;
+}
+
+// Fecha o quadro RX aberto se o barramento ficou em silêncio
+static void closeIdleRx() {
+    if (s_frameOpen && s_frameDirection == BUS_CAPTURE_DIR_RX &&
+        micros() - s_lastRxMicros > interFrameDelayUs() * 2 + 2000) {
+        commitFrame();
+    }
+}
+
+static void appendByte(uint8_t direction, uint8_t value) {
+    if (!s_frameOpen || s_frameDirection != direction) {
+        commitFrame();
+        if (direction == BUS_CAPTURE_DIR_TX && s_awaitingReply) {
+            flagMissingReply();
+        }
+        s_frameOpen = true;
+        s_frameDirection = direction;
+        s_frameLength = 0;
+        s_frameStartUs = monotonicMicros();
+    }
+    if (s_frameLength < CAPTURE_MAX_FRAME) {
+        s_frame[s_frameLength] = value;
+    }
+    if (s_frameLength < 0xFFFF) {
+        s_frameLength++;
+    }
+}
+
+// ==================== SERIAL ====================
+
+int BusCaptureSerial::available() {
+    if (capturing()) {
+        closeIdleRx();
+    }
+    return Serial2.available();
+}
+
+int BusCaptureSerial::read() {
+    int value = Serial2.read();
+    if (value >= 0 && capturing()) {
+        closeIdleRx();
+        appendByte(BUS_CAPTURE_DIR_RX, (uint8_t)value);
+        s_lastRxMicros = micros();
+        s_awaitingReply = false;
+    }
+    return value;
+}
+
+int BusCaptureSerial::peek() {
+    return Serial2.peek();
+}
+
+size_t BusCaptureSerial::write(uint8_t value) {
+    if (capturing()) {
+        appendByte(BUS_CAPTURE_DIR_TX, value);
+    }
+    return Serial2.write(value);
+}
+
+size_t BusCaptureSerial::write(const uint8_t* buffer, size_t size) {
+    if (capturing()) {
+        for (size_t k = 0; k < size; k++) {
+            appendByte(BUS_CAPTURE_DIR_TX, buffer[k]);
+        }
+    }
+    return Serial2.write(buffer, size);
+}
+
+void BusCaptureSerial::flush() {
+    Serial2.flush();
+    if (capturing() && s_frameOpen && s_frameDirection == BUS_CAPTURE_DIR_TX) {
+        // Broadcast (endereço 0) não tem resposta
+        s_awaitingReply = s_frameLength > 0 && s_frame[0] != 0;
+        commitFrame();
+        s_lastRxMicros = micros();
+    }
+}
+
+// ==================== CONTROLE ====================
+
+void busCaptureConfigure(bool enabled, bool trigger) {
+    s_enabled = enabled;
+    s_trigger = trigger;
+}
+
+void busCaptureClear() {
+    portENTER_CRITICAL(&s_ringMux);
+    s_head = s_tail = 0;
+    s_count = 0;
+    s_lastTxOffset = -1;
+    portEXIT_CRITICAL(&s_ringMux);
+    s_clearedUs = monotonicMicros();
+    s_frozen = false;
+    s_triggerFlags = 0;
+    s_triggerUs = 0;
+}
+
+void busCaptureSetSuspended(bool suspended) {
+    if (suspended) {
+        commitFrame();
+    }
+    s_awaitingReply = false;
+    s_suspended = suspended;
+}
+
+void busCaptureService() {
+    if (capturing()) {
+        closeIdleRx();
+    }
+}
+
+void busCaptureGetStatus(BusCaptureStatus* status) {
+    status->enabled = s_enabled;
+    status->trigger = s_trigger;
+    status->frozen = s_frozen;
+    status->suspended = s_suspended;
+    status->triggerFlags = s_triggerFlags;
+    status->triggerUs = s_triggerUs;
+    status->captured = s_captured;
+    status->overwritten = s_overwritten;
+    status->crcErrors = s_crcErrors;
+    status->noReply = s_noReply;
+    status->oldestUs = 0;
+    status->newestUs = 0;
+
+    portENTER_CRITICAL(&s_ringMux);
+    status->frames = s_count;
+    status->bytesUsed = 0;
+    uint32_t offset = s_tail;
+    for (uint16_t k = 0; k < s_count; k++) {
+        CaptureRecord record;
+        offset = recordAt(offset, &record);
+        if (k == 0) {
+            status->oldestUs = record.timeUs;
+        }
+        status->newestUs = record.timeUs;
+        status->bytesUsed += recordSize(record.stored);
+        offset += recordSize(record.stored);
+    }
+    portEXIT_CRITICAL(&s_ringMux);
+}
+
+bool busCaptureGetFrame(uint16_t fromNewest, BusCaptureFrame* frame) {
+    bool found = false;
+    portENTER_CRITICAL(&s_ringMux);
+    if (fromNewest < s_count) {
+        uint32_t offset = s_tail;
+        CaptureRecord record;
+        for (uint16_t k = 0; k < s_count - 1 - fromNewest; k++) {
+            offset = recordAt(offset, &record);
+            offset += recordSize(record.stored);
+        }
+        offset = recordAt(offset, &record);
+        frame->timeUs = record.timeUs;
+        frame->length = record.length;
+        frame->direction = record.direction;
+        frame->flags = record.flags;
+        memcpy(frame->data, &s_ring[offset + sizeof(CaptureRecord)], record.stored);
+        found = true;
+    }
+    portEXIT_CRITICAL(&s_ringMux);
+    return found;
+}
+
+// ==================== PCAP ====================
+
+static uint8_t* putLe32(uint8_t* out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+    return out + 4;
+}
+
+static uint8_t* putLe16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+uint8_t* busCaptureBuildPcap(size_t* length) {
+    // Cópia do anel: a seção crítica dura só o memcpy
+    uint8_t* ring = new (std::nothrow) uint8_t[CAPTURE_RING_BYTES];
+    if (ring == nullptr) {
+        return nullptr;
+    }
+    portENTER_CRITICAL(&s_ringMux);
+    memcpy(ring, s_ring, CAPTURE_RING_BYTES);
+    uint32_t tail = s_tail;
+    uint16_t count = s_count;
+    portEXIT_CRITICAL(&s_ringMux);
+
+    // Cada registro: 16 bytes de cabeçalho pcap + 2 de pseudo-cabeçalho + quadro
+    size_t total = 24;
+    uint32_t offset = tail;
+    for (uint16_t k = 0; k < count; k++) {
+        if (CAPTURE_RING_BYTES - offset < sizeof(CaptureRecord)) {
+            offset = 0;
+        }
+        CaptureRecord record;
+        memcpy(&record, &ring[offset], sizeof(record));
+        if (record.stored == CAPTURE_WRAP) {
+            offset = 0;
+            memcpy(&record, &ring[offset], sizeof(record));
+        }
+        total += 16 + 2 + record.stored;
+        offset += recordSize(record.stored);
+    }
+
+    uint8_t* pcap = new (std::nothrow) uint8_t[total];
+    if (pcap == nullptr) {
+        delete[] ring;
+        return nullptr;
+    }
+
+    // Cabeçalho global: microssegundos, versão 2.4, UTC, snaplen, linktype
+    uint8_t* out = putLe32(pcap, 0xA1B2C3D4);
+    out = putLe16(out, 2);
+    out = putLe16(out, 4);
+    out = putLe32(out, 0);
+    out = putLe32(out, 0);
+    out = putLe32(out, CAPTURE_MAX_FRAME + 2);
+    out = putLe32(out, CAPTURE_PCAP_LINKTYPE);
+
+    offset = tail;
+    for (uint16_t k = 0; k < count; k++) {
+        if (CAPTURE_RING_BYTES - offset < sizeof(CaptureRecord)) {
+            offset = 0;
+        }
+        CaptureRecord record;
+        memcpy(&record, &ring[offset], sizeof(record));
+        if (record.stored == CAPTURE_WRAP) {
+            offset = 0;
+            memcpy(&record, &ring[offset], sizeof(record));
+        }
+        // Horário UTC se o RTC está ajustado; senão, tempo desde o boot
+        int64_t utcUs = monotonicToUtcMicros(record.timeUs);
+        int64_t timeUs = utcUs != 0 ? utcUs : record.timeUs;
+        out = putLe32(out, (uint32_t)(timeUs / 1000000));
+        out = putLe32(out, (uint32_t)(timeUs % 1000000));
+        out = putLe32(out, 2 + record.stored);
+        out = putLe32(out, 2 + record.length);
+        *out++ = record.direction;
+        *out++ = record.flags;
+        memcpy(out, &ring[offset + sizeof(CaptureRecord)], record.stored);
+        out += record.stored;
+        offset += recordSize(record.stored);
+    }
+    delete[] ring;
+
+    *length = total;
+    return pcap;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file bus_capture.h
+ * @brief Captura do tráfego do barramento RS485 em anel, com exportação pcap
+ *
+ * busSerial envolve o Serial2: todas as transações do mestre (ModbusMaster e
+ * modbus_rtu) passam por ele e cada quadro transmitido ou recebido é gravado
+ * com instante (µs) e direção em um anel estático de CAPTURE_RING_BYTES, sem
+ * alocação: os quadros mais antigos são descartados quando falta espaço.
+ *
+ * - Quadro TX: bytes escritos até o flush() (fim da transmissão)
+ * - Quadro RX: bytes lidos até a próxima transmissão ou um silêncio maior que
+ *   o intervalo entre quadros; CRC inválido marca o quadro
+ * - Requisição sem resposta (exceto broadcast) marca o quadro TX
+ * - Modo gatilho: o anel congela no primeiro erro de CRC ou falta de resposta,
+ *   preservando o que levou ao erro até ser rearmado
+ *
+ * A busca de dispositivos e a detecção automática de baud rate suspendem a
+ * captura (as sondas sem resposta são esperadas).
+ *
+ * Exportação pcap: linktype DLT_USER0 (147) com 2 bytes de cabeçalho antes do
+ * quadro RTU (direção: 0 = mestre, 1 = escravo; flags BUS_CAPTURE_FLAG_*).
+ * No Wireshark: Preferências > Protocols > DLT_USER, DLT 147, payload
+ * "mbrtu", header size 2.
+ */
+
+#ifndef BUS_CAPTURE_H
+#define BUS_CAPTURE_H
+
+#include <Arduino.h>
+
+#define CAPTURE_RING_BYTES 16384
+#define CAPTURE_MAX_FRAME 256              // Maior quadro RTU
+#define CAPTURE_PCAP_LINKTYPE 147          // DLT_USER0
+
+#define BUS_CAPTURE_DIR_TX 0               // Mestre -> escravo
+#define BUS_CAPTURE_DIR_RX 1               // Escravo -> mestre
+
+#define BUS_CAPTURE_FLAG_CRC_ERROR 0x01
+#define BUS_CAPTURE_FLAG_NO_REPLY 0x02     // Requisição sem resposta (timeout)
+#define BUS_CAPTURE_FLAG_TRUNCATED 0x04    // Mais de CAPTURE_MAX_FRAME bytes
+#define BUS_CAPTURE_FLAG_TRIGGER 0x08      // Quadro que congelou o anel
+
+/**
+ * @brief Serial2 com captura (usar no lugar do Serial2 nas transações Modbus)
+ */
+class BusCaptureSerial : public Stream {
+public:
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    void flush() override;
+    using Print::write;
+};
+
+extern BusCaptureSerial busSerial;
+
+/**
+ * @struct BusCaptureStatus
+ * @brief Estado e contadores da captura
+ */
+struct BusCaptureStatus {
+    bool enabled;
+    bool trigger;                          // Congela no primeiro erro
+    bool frozen;
+    bool suspended;                        // Busca ou detecção em andamento
+    uint8_t triggerFlags;                  // BUS_CAPTURE_FLAG_* que congelou o anel
+    int64_t triggerUs;                     // monotonicMicros() do congelamento
+    uint16_t frames;                       // Quadros no anel
+    uint32_t bytesUsed;
+    uint32_t captured;                     // Quadros gravados desde o início
+    uint32_t overwritten;                  // Quadros antigos descartados
+    uint32_t crcErrors;
+    uint32_t noReply;
+    int64_t oldestUs;
+    int64_t newestUs;
+};
+
+/**
+ * @struct BusCaptureFrame
+ * @brief Cópia de um quadro do anel
+ */
+struct BusCaptureFrame {
+    int64_t timeUs;                        // monotonicMicros() do primeiro byte
+    uint16_t length;                       // Bytes no barramento (até CAPTURE_MAX_FRAME gravados)
+    uint8_t direction;                     // BUS_CAPTURE_DIR_*
+    uint8_t flags;
+    uint8_t data[CAPTURE_MAX_FRAME];
+};
+
+/**
+ * @brief Liga/desliga a captura e o modo gatilho (padrão: ligada, sem gatilho)
+ */
+void busCaptureConfigure(bool enabled, bool trigger);
+
+/**
+ * @brief Esvazia o anel e rearma o gatilho
+ */
+void busCaptureClear();
+
+/**
+ * @brief Suspende a captura durante sondas (busca, detecção de baud rate)
+ */
+void busCaptureSetSuspended(bool suspended);
+
+/**
+ * @brief Fecha o quadro RX aberto após o silêncio entre quadros (loop)
+ */
+void busCaptureService();
+
+void busCaptureGetStatus(BusCaptureStatus* status);
+
+/**
+ * @brief Copia um quadro (0 = o mais recente)
+ * @return false se não há quadro nessa posição
+ */
+bool busCaptureGetFrame(uint16_t fromNewest, BusCaptureFrame* frame);
+
+/**
+ * @brief Monta o arquivo pcap com o conteúdo atual do anel
+ * @param length Tamanho do arquivo
+ * @return Buffer alocado com new[] (liberar com delete[]) ou nullptr sem memória
+ */
+uint8_t* busCaptureBuildPcap(size_t* length);
+
+#endif // BUS_CAPTURE_H
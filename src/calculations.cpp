@@ -5,38 +5,145 @@
 
 #include "calculations.h"
 #include "modbus_handler.h"
+#include "modbus_queue.h"
+#include "modbus_slave.h"
+#include "modbus_bits.h"
+#include "modbus_broadcast.h"
+#include "alarm_engine.h"
+#include "reactive_rules.h"
+#include "pid_control.h"
 #include "console.h"
 #include "kalman_filter.h"
+#include "bus_capture.h"
+#include <LittleFS.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 
-void performCalculations() {
-    if (g_processingPaused) {
-        return;
+// Arrays para armazenar variáveis temporárias (máximo 50 variáveis)
+// k[i] = nome da variável (máximo 5 caracteres), v[i] = valor
+static const int MAX_TEMP_VARS = 50;
+
+// Índice 0 = código principal, 1..SCRIPT_MAX_SCRIPTS = scripts nomeados
+#define SCRIPT_SLOTS (SCRIPT_MAX_SCRIPTS + 1)
+
+/**
+ * @brief Estado de uma execução do código, preservado entre as fatias
+ *
+ * Buffers alocados no heap no início da execução (evita stack overflow) e
+ * liberados no fim.
+ */
+struct ScriptRun {
+    bool active;
+    uint8_t priority;                      // Da definição no início (vale até o fim da execução)
+    bool ownsStage;                        // Abriu a lista de escritas sincronizadas
+    String label;                          // Prefixo das mensagens no console ("" no código principal)
+    String code;                           // Cópia: salvar a configuração não muda a execução em andamento
+    int position;                          // Início da próxima linha em code
+    int sourceLine;                        // Linha de code em position (1 = primeira)
+    int lineNumber;                        // Linhas executáveis ([Linha N] no console)
+    DeviceValues deviceValues;             // Valores do instante em que a execução começou
+    char (*tempVarNames)[6];
+    double* tempVarValues;
+    Variable* tempVariables;
+    int tempVarCount;
+    char* lineBuffer;
+    char* processedExpression;
+    char* errorMsg;
+    const ScriptProgram* program;          // Código compilado (nullptr = tudo interpretado)
+    ScriptProgramState* programState;
+    int64_t startUs;
+    uint32_t totalUs;
+    uint16_t slices;
+};
+
+/**
+ * @struct ScriptSchedule
+ * @brief Disparo pendente de um script
+ */
+struct ScriptSchedule {
+    bool pending;
+    int64_t triggeredUs;                   // Primeiro disparo ainda não atendido
+    int64_t nextRunUs;                     // SCRIPT_TRIGGER_PERIOD (0 = roda já e começa a grade)
+};
+
+static ScriptRun s_runs[SCRIPT_SLOTS] = {};
+static ScriptStats s_stats[SCRIPT_SLOTS] = {};
+static uint32_t s_statsHash[SCRIPT_SLOTS] = {};  // Código a que s_stats se refere
+static ScriptSchedule s_schedule[SCRIPT_SLOTS] = {};
+// Código compilado de cada script: refeito quando o código ou os dispositivos mudam
+static ScriptProgram* s_programs[SCRIPT_SLOTS] = {};
+static uint32_t s_programKeys[SCRIPT_SLOTS] = {};
+static uint16_t s_startedMask = 0;         // Scripts já iniciados nesta chamada do escalonador
+static bool s_scheduling = false;          // Evita reentrada (scriptFrameService é chamado de dentro do ciclo)
+
+static ScriptDefinition s_definitions[SCRIPT_MAX_SCRIPTS];
+static uint8_t s_definitionCount = 0;
+// Definições novas (servidor web) aplicadas pelo loop, fora de qualquer execução
+static ScriptDefinition* s_pendingDefinitions = nullptr;
+static uint8_t s_pendingCount = 0;
+static uint32_t s_alarmCursor = 0;
+
+static SemaphoreHandle_t s_scriptMutex = nullptr;
+
+static inline bool lockScripts(TickType_t ticks) {
+    if (s_scriptMutex == nullptr) {
+        s_scriptMutex = xSemaphoreCreateMutex();
     }
-    
-    // Verifica se há código de cálculo configurado
-    if (strlen(config.calculationCode) == 0) {
-        return;  // Nenhum cálculo configurado
+    return s_scriptMutex != nullptr && xSemaphoreTake(s_scriptMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockScripts() {
+    xSemaphoreGive(s_scriptMutex);
+}
+
+// FNV-1a: identifica o código das estatísticas sem guardar uma cópia
+static uint32_t codeHash(const char* code) {
+    uint32_t hash = 2166136261UL;
+    while (*code) {
+        hash ^= (uint8_t)*code++;
+        hash *= 16777619UL;
     }
-    
-    // Habilita efeitos colaterais nas expressões (ex: display via Modbus)
-    setExpressionSideEffectsEnabled(true);
-    
-    // Prepara estrutura DeviceValues com todos os valores dos dispositivos
-    // Aplica gain e offset antes de atribuir
-    DeviceValues deviceValues;
-    deviceValues.deviceCount = config.deviceCount;
-    deviceValues.registerCounts = new int[config.deviceCount];
-    deviceValues.values = new double*[config.deviceCount];
+    return hash;
+}
+
+// Código compilado para o código e os dispositivos da execução (compila se mudaram)
+static const ScriptProgram* compiledProgram(uint8_t slot, const char* code, uint32_t hash, const DeviceValues& shape) {
+    // Quantidade de registros de cada dispositivo: os índices {d[i][j]} são conferidos na compilação
+    uint32_t key = hash;
+    for (int i = 0; i < shape.deviceCount; i++) {
+        key = (key ^ (uint32_t)(shape.registerCounts[i] + 1)) * 16777619UL;
+    }
+    key = (key ^ (uint32_t)shape.deviceCount) * 16777619UL;
+    if (s_programs[slot] == nullptr || key != s_programKeys[slot]) {
+        scriptProgramFree(s_programs[slot]);
+        s_programs[slot] = scriptCompile(code, &shape);
+        s_programKeys[slot] = key;
+    }
+    return s_programs[slot];
+}
+
+// Prepara estrutura DeviceValues com todos os valores dos dispositivos
+// Aplica gain e offset antes de atribuir
+static void snapshotDeviceValues(ScriptRun* run) {
+    run->deviceValues.deviceCount = config.deviceCount;
+    run->deviceValues.registerCounts = new int[config.deviceCount];
+    run->deviceValues.values = new double*[config.deviceCount];
     
     for (int i = 0; i < config.deviceCount; i++) {
-        deviceValues.registerCounts[i] = config.devices[i].registerCount;
-        deviceValues.values[i] = new double[config.devices[i].registerCount];
+        run->deviceValues.registerCounts[i] = config.devices[i].registerCount;
+        run->deviceValues.values[i] = new double[config.devices[i].registerCount];
         
         for (int j = 0; j < config.devices[i].registerCount; j++) {
+            // Bobinas e entradas discretas: booleano (0/1), sem gain/offset/Kalman/interpolação
+            if (isBitRegister(config.devices[i].registers[j])) {
+                run->deviceValues.values[i][j] = bitGet(i, j) ? 1.0 : 0.0;
+                continue;
+            }
+            
             // Aplica gain e offset: valor_processado = (valor_raw * gain) + offset
-            float rawValue = (float)config.devices[i].registers[j].value;
+            float rawValue = registerRawValue(config.devices[i].registers[j]);
             float processedValue = (rawValue * config.devices[i].registers[j].gain) + config.devices[i].registers[j].offset;
             
             // Se o filtro de Kalman está habilitado e inicializado, usa o valor do Kalman
@@ -45,73 +152,203 @@ void performCalculations() {
                 processedValue = (kalmanValue * config.devices[i].registers[j].gain) + config.devices[i].registers[j].offset;
             }
             
-            deviceValues.values[i][j] = (double)processedValue;
+            // Alinhamento temporal: todos os valores no mesmo instante (tick do ciclo)
+            if (config.alignSamples) {
+                float alignedValue;
+                if (interpolatedSample(i, j, g_cycleTickUs, &alignedValue)) {
+                    processedValue = alignedValue;
+                }
+            }
+            
+            run->deviceValues.values[i][j] = (double)processedValue;
         }
     }
+}
+
+static bool beginRun(uint8_t slot, int64_t nowUs) {
+    ScriptRun* run = &s_runs[slot];
+    const char* code = slot == 0 ? config.calculationCode : s_definitions[slot - 1].code;
+    s_schedule[slot].pending = false;
+    
+    // Verifica se há código de cálculo configurado
+    if (strlen(code) == 0) {
+        return false;  // Nenhum cálculo configurado
+    }
+    
+    run->code = String(code);
+    uint32_t hash = codeHash(code);
+    if (hash != s_statsHash[slot]) {
+        // Código novo: custos anteriores não valem mais
+        s_statsHash[slot] = hash;
+        s_stats[slot] = ScriptStats();
+    }
+    
+    run->priority = slot == 0 ? SCRIPT_MAIN_PRIORITY : s_definitions[slot - 1].priority;
+    run->label = slot == 0 ? String() : String(s_definitions[slot - 1].name) + " ";
+    
+    // Modo sincronizado (só o código principal): escritas acumuladas e enviadas juntas no final
+    run->ownsStage = slot == 0 && config.syncWrites;
+    if (run->ownsStage) {
+        modbusStageBegin();
+    }
     
-    // Arrays para armazenar variáveis temporárias (máximo 50 variáveis)
-    // IMPORTANTE: Alocados no heap para evitar stack overflow
-    // k[i] = nome da variável (máximo 5 caracteres), v[i] = valor
-    const int MAX_TEMP_VARS = 50;
-    char (*tempVarNames)[6] = new char[MAX_TEMP_VARS][6];  // 5 caracteres + null terminator
-    double* tempVarValues = new double[MAX_TEMP_VARS];
-    int tempVarCount = 0;
+    snapshotDeviceValues(run);
+    run->program = compiledProgram(slot, code, hash, run->deviceValues);
+    run->programState = nullptr;
+    if (run->program != nullptr) {
+        run->programState = scriptProgramBegin(run->program);
+        scriptProgramStats(run->program, &s_stats[slot].compile);
+    }
+    run->tempVarNames = new char[MAX_TEMP_VARS][6];  // 5 caracteres + null terminator
+    run->tempVarValues = new double[MAX_TEMP_VARS];
+    run->tempVarCount = 0;
     
     // Converte para formato Variable para compatibilidade com substituteDeviceValues
-    Variable* tempVariables = new Variable[MAX_TEMP_VARS];
+    run->tempVariables = new Variable[MAX_TEMP_VARS];
     
-    // Buffers alocados no heap para evitar stack overflow
-    char* lineBuffer = new char[1024];
-    char* processedExpression = new char[2048];
-    char* errorMsg = new char[256];
+    run->lineBuffer = new char[1024];
+    run->processedExpression = new char[2048];
+    run->errorMsg = new char[256];
     
-    // Divide o código em linhas e processa cada uma separadamente
-    String codeStr = String(config.calculationCode);
-    int lineNumber = 1;
-    int startPos = 0;
+    run->position = 0;
+    run->sourceLine = 1;
+    run->lineNumber = 1;
+    run->startUs = nowUs;
+    run->totalUs = 0;
+    run->slices = 0;
+    run->active = true;
     
-    while (startPos < codeStr.length()) {
-        if (g_processingPaused) {
-            break;
-        }
-        // Encontra o final da linha (caractere de nova linha ou fim da string)
-        int endPos = codeStr.indexOf('\n', startPos);
-        if (endPos == -1) {
-            endPos = codeStr.length();
-        }
-        
-        // Extrai a linha (remove espaços no início e fim)
-        String line = codeStr.substring(startPos, endPos);
-        line.trim();  // Remove espaços no início e fim
-        
-        // Avança para a próxima linha
-        startPos = endPos + 1;
-        
-        // Ignora linhas vazias ou apenas com espaços
-        if (line.length() == 0) {
-            continue;
+    ScriptStats& stats = s_stats[slot];
+    stats.running = true;
+    stats.lastWaitUs = (uint32_t)(nowUs - s_schedule[slot].triggeredUs);
+    if (stats.lastWaitUs > stats.maxWaitUs) {
+        stats.maxWaitUs = stats.lastWaitUs;
+    }
+    return true;
+}
+
+static void finishRun(uint8_t slot) {
+    ScriptRun* run = &s_runs[slot];
+    
+    // Limpa memória DeviceValues
+    for (int i = 0; i < run->deviceValues.deviceCount; i++) {
+        delete[] run->deviceValues.values[i];
+    }
+    delete[] run->deviceValues.values;
+    delete[] run->deviceValues.registerCounts;
+    
+    // Resultados publicados pelo escravo Modbus (entradas do mapa com variável)
+    modbusSlavePublishVariables(run->tempVarNames, run->tempVarValues, run->tempVarCount);
+    
+    // Limpa memória dos arrays alocados no heap
+    delete[] run->tempVarNames;
+    delete[] run->tempVarValues;
+    delete[] run->tempVariables;
+    delete[] run->lineBuffer;
+    delete[] run->processedExpression;
+    delete[] run->errorMsg;
+    scriptProgramEnd(run->programState);
+    run->programState = nullptr;
+    run->program = nullptr;
+    run->code = String();
+    run->label = String();
+    run->active = false;
+    
+    // Envia as escritas sincronizadas: individuais em sequência, broadcasts (aplicar) por último
+    if (run->ownsStage) {
+        modbusQueueService();
+        modbusStageFlush();
+        run->ownsStage = false;
+    }
+    
+    ScriptStats& stats = s_stats[slot];
+    stats.running = false;
+    stats.runs++;
+    stats.lastRunUs = run->totalUs;
+    if (run->totalUs > stats.maxRunUs) {
+        stats.maxRunUs = run->totalUs;
+    }
+    stats.lastSpanMs = (uint32_t)((esp_timer_get_time() - run->startUs) / 1000);
+    stats.lastSlices = run->slices;
+    if (run->slices > stats.maxSlices) {
+        stats.maxSlices = run->slices;
+    }
+}
+
+static void recordLineCost(uint8_t slot, int sourceLine, uint32_t elapsedUs, uint8_t mode) {
+    ScriptStats& stats = s_stats[slot];
+    for (uint8_t k = 0; k < stats.lineCount; k++) {
+        if (stats.lines[k].line == sourceLine) {
+            stats.lines[k].lastUs = elapsedUs;
+            stats.lines[k].mode = mode;
+            if (elapsedUs > stats.lines[k].maxUs) {
+                stats.lines[k].maxUs = elapsedUs;
+            }
+            return;
         }
-        
-        // Ignora linhas que começam com '#' (comentários)
-        if (line.charAt(0) == '#') {
-            continue;
+    }
+    if (stats.lineCount < SCRIPT_MAX_LINE_COSTS) {
+        ScriptLineCost& cost = stats.lines[stats.lineCount++];
+        cost.line = (uint16_t)sourceLine;
+        cost.lastUs = elapsedUs;
+        cost.maxUs = elapsedUs;
+        cost.mode = mode;
+    }
+}
+
+// Executa uma linha (sem espaços nas pontas, não vazia e sem comentário)
+static void executeLine(ScriptRun* run, const String& line, int lineNumber, const CompiledLine* compiled) {
+    char* lineBuffer = run->lineBuffer;
+    char* processedExpression = run->processedExpression;
+    char* errorMsg = run->errorMsg;
+    char (*tempVarNames)[6] = run->tempVarNames;
+    double* tempVarValues = run->tempVarValues;
+    Variable* tempVariables = run->tempVariables;
+    int& tempVarCount = run->tempVarCount;
+    DeviceValues& deviceValues = run->deviceValues;
+    // Scripts nomeados: "[nome Linha N]"
+    String linePrefix = "[" + run->label + "Linha " + String(lineNumber) + "]";
+    
+    // Atribuição sobrescrita antes de ser lida (compilador): não há o que calcular
+    if (compiled != nullptr && compiled->mode == SCRIPT_LINE_DEAD) {
+        return;
+    }
+    
+    AssignmentInfo assignmentInfo;
+    double result = 0.0;
+    const char* shownExpression = processedExpression;  // Expressão mostrada no console
+    
+    if (compiled != nullptr && compiled->mode == SCRIPT_LINE_COMPILED) {
+        // Código compilado: destino e expressão lidos uma vez, valores com precisão total
+        assignmentInfo.hasAssignment = compiled->hasAssignment;
+        assignmentInfo.isVariableAssignment = compiled->isVariableAssignment;
+        strcpy(assignmentInfo.targetVariable, compiled->targetVariable);
+        assignmentInfo.targetDeviceIndex = compiled->targetDeviceIndex;
+        assignmentInfo.targetRegisterIndex = compiled->targetRegisterIndex;
+        assignmentInfo.expression = nullptr;
+        assignmentInfo.expressionSize = 0;
+        shownExpression = line.c_str() + compiled->expressionOffset;
+        errorMsg[0] = '\0';
+        if (!scriptProgramEvaluate(run->program, run->programState, compiled, &deviceValues, tempVariables, tempVarCount,
+                                   &result, errorMsg, 256)) {
+            String logMsg = linePrefix + " Erro ao avaliar expressao: " + String(errorMsg);
+            consolePrint(logMsg + "\r\n");
+            return;
         }
-        
+    } else {
         // Converte String para char* para processar
         strncpy(lineBuffer, line.c_str(), 1023);
         lineBuffer[1023] = '\0';
         
         // Processa esta linha
-        AssignmentInfo assignmentInfo;
         errorMsg[0] = '\0';  // Limpa buffer de erro
         bool parseSuccess = parseAssignment(lineBuffer, &assignmentInfo, errorMsg, 256);
         
         if (!parseSuccess) {
             // Log de erro no console (mas continua processando outras linhas)
-            String logMsg = "[Linha " + String(lineNumber) + "] Erro ao processar: " + String(errorMsg);
+            String logMsg = linePrefix + " Erro ao processar: " + String(errorMsg);
             consolePrint(logMsg + "\r\n");
-            lineNumber++;
-            continue;
+            return;
         }
         
         // Se há atribuição, processa expressão do segundo membro
@@ -124,15 +361,13 @@ void performCalculations() {
         
         if (!success) {
             // Log de erro no console (mas continua processando outras linhas)
-            String logMsg = "[Linha " + String(lineNumber) + "] Erro ao processar expressao: " + String(errorMsg);
+            String logMsg = linePrefix + " Erro ao processar expressao: " + String(errorMsg);
             consolePrint(logMsg + "\r\n");
             freeAssignmentInfo(&assignmentInfo);
-            lineNumber++;
-            continue;
+            return;
         }
         
         // Avalia a expressão processada (sem variáveis, apenas números e operadores)
-        double result = 0.0;
         Variable emptyVars[1];
         int emptyVarCount = 0;
         // CRÍTICO: errorMsg é um ponteiro (char*). sizeof(errorMsg) seria 4/8 e causaria corrupção de heap.
@@ -140,217 +375,700 @@ void performCalculations() {
         
         if (!evalSuccess) {
             // Log de erro no console (mas continua processando outras linhas)
-            String logMsg = "[Linha " + String(lineNumber) + "] Erro ao avaliar expressao: " + String(errorMsg);
+            String logMsg = linePrefix + " Erro ao avaliar expressao: " + String(errorMsg);
             consolePrint(logMsg + "\r\n");
             freeAssignmentInfo(&assignmentInfo);
-            lineNumber++;
-            continue;
+            return;
         }
+    }
         
-        // Limpa buffer de erro antes de próxima iteração
-        errorMsg[0] = '\0';
-        
-        // Se há atribuição, processa
-        if (assignmentInfo.hasAssignment) {
-            // Se é atribuição a variável temporária
-            if (assignmentInfo.isVariableAssignment) {
-                // Limita nome a 5 caracteres
-                char varName[6];
-                strncpy(varName, assignmentInfo.targetVariable, 5);
-                varName[5] = '\0';
-                
-                // Armazena ou atualiza a variável temporária nos arrays k[] e v[]
-                bool varFound = false;
-                for (int i = 0; i < tempVarCount; i++) {
-                    if (strcmp(tempVarNames[i], varName) == 0) {
-                        tempVarValues[i] = result;
-                        // Atualiza também no array Variable para compatibilidade
-                        tempVariables[i].value = result;
-                        varFound = true;
-                        break;
-                    }
-                }
-                
-                if (!varFound) {
-                    // Adiciona nova variável temporária
-                    if (tempVarCount < MAX_TEMP_VARS) {
-                        strncpy(tempVarNames[tempVarCount], varName, 5);
-                        tempVarNames[tempVarCount][5] = '\0';
-                        tempVarValues[tempVarCount] = result;
-                        
-                        // Atualiza também no array Variable para compatibilidade
-                        strncpy(tempVariables[tempVarCount].name, varName, sizeof(tempVariables[tempVarCount].name) - 1);
-                        tempVariables[tempVarCount].name[sizeof(tempVariables[tempVarCount].name) - 1] = '\0';
-                        tempVariables[tempVarCount].value = result;
-                        
-                        tempVarCount++;
-                    } else {
-                        String logMsg = "[Linha " + String(lineNumber) + "] Aviso: limite de variaveis temporarias atingido (max: " + String(MAX_TEMP_VARS) + ")";
-                        consolePrint(logMsg + "\r\n");
-                    }
-                }
-                
-                // Log no console (sem mencionar {d[-1][-1]})
-                String logMsg = "[Linha " + String(lineNumber) + "] Variavel temporaria: " + String(varName) + " = " + String(processedExpression) + " = " + String(result, 2);
-                consolePrint(logMsg + "\r\n");
-                
-                freeAssignmentInfo(&assignmentInfo);
-                lineNumber++;
-                continue;
-            }
+    // Limpa buffer de erro antes de próxima iteração
+    errorMsg[0] = '\0';
+    
+    // Se há atribuição, processa
+    if (assignmentInfo.hasAssignment) {
+        // Se é atribuição a variável temporária
+        if (assignmentInfo.isVariableAssignment) {
+            // Limita nome a 5 caracteres
+            char varName[6];
+            strncpy(varName, assignmentInfo.targetVariable, 5);
+            varName[5] = '\0';
             
-            // Se é atribuição para {d[i][j]}, escreve no registro de destino
-            // Valida índices do destino
-            if (assignmentInfo.targetDeviceIndex < 0 || assignmentInfo.targetDeviceIndex >= config.deviceCount) {
-                String logMsg = "[Linha " + String(lineNumber) + "] Erro: indice de dispositivo invalido: " + String(assignmentInfo.targetDeviceIndex);
-                consolePrint(logMsg + "\r\n");
-                freeAssignmentInfo(&assignmentInfo);
-                lineNumber++;
-                continue;
+            // Armazena ou atualiza a variável temporária nos arrays k[] e v[]
+            bool varFound = false;
+            for (int i = 0; i < tempVarCount; i++) {
+                if (strcmp(tempVarNames[i], varName) == 0) {
+                    tempVarValues[i] = result;
+                    // Atualiza também no array Variable para compatibilidade
+                    tempVariables[i].value = result;
+                    varFound = true;
+                    break;
+                }
             }
             
-            if (assignmentInfo.targetRegisterIndex < 0 || 
-                assignmentInfo.targetRegisterIndex >= config.devices[assignmentInfo.targetDeviceIndex].registerCount) {
-                String logMsg = "[Linha " + String(lineNumber) + "] Erro: indice de registro invalido: " + String(assignmentInfo.targetRegisterIndex);
-                consolePrint(logMsg + "\r\n");
-                freeAssignmentInfo(&assignmentInfo);
-                lineNumber++;
-                continue;
+            if (!varFound) {
+                // Adiciona nova variável temporária
+                if (tempVarCount < MAX_TEMP_VARS) {
+                    strncpy(tempVarNames[tempVarCount], varName, 5);
+                    tempVarNames[tempVarCount][5] = '\0';
+                    tempVarValues[tempVarCount] = result;
+                    
+                    // Atualiza também no array Variable para compatibilidade
+                    strncpy(tempVariables[tempVarCount].name, varName, sizeof(tempVariables[tempVarCount].name) - 1);
+                    tempVariables[tempVarCount].name[sizeof(tempVariables[tempVarCount].name) - 1] = '\0';
+                    tempVariables[tempVarCount].value = result;
+                    
+                    tempVarCount++;
+                } else {
+                    String logMsg = linePrefix + " Aviso: limite de variaveis temporarias atingido (max: " + String(MAX_TEMP_VARS) + ")";
+                    consolePrint(logMsg + "\r\n");
+                }
             }
             
-            // Obtém referência ao registro de destino
-            ModbusRegister* targetReg = &config.devices[assignmentInfo.targetDeviceIndex].registers[assignmentInfo.targetRegisterIndex];
+            // Log no console (sem mencionar {d[-1][-1]})
+            String logMsg = linePrefix + " Variavel temporaria: " + String(varName) + " = " + String(shownExpression) + " = " + String(result, 2);
+            consolePrint(logMsg + "\r\n");
             
-            // Verifica se o registro não é somente leitura
-            if (targetReg->readOnly) {
-                String logMsg = "[Linha " + String(lineNumber) + "] Erro: registro destino e somente leitura";
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Se é atribuição para {d[i][j]}, escreve no registro de destino
+        // Valida índices do destino
+        if (assignmentInfo.targetDeviceIndex < 0 || assignmentInfo.targetDeviceIndex >= config.deviceCount) {
+            String logMsg = linePrefix + " Erro: indice de dispositivo invalido: " + String(assignmentInfo.targetDeviceIndex);
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        if (assignmentInfo.targetRegisterIndex < 0 || 
+            assignmentInfo.targetRegisterIndex >= config.devices[assignmentInfo.targetDeviceIndex].registerCount) {
+            String logMsg = linePrefix + " Erro: indice de registro invalido: " + String(assignmentInfo.targetRegisterIndex);
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Obtém referência ao registro de destino
+        ModbusRegister* targetReg = &config.devices[assignmentInfo.targetDeviceIndex].registers[assignmentInfo.targetRegisterIndex];
+        
+        // Verifica se o registro não é somente leitura
+        if (targetReg->readOnly || targetReg->registerType == REGISTER_TYPE_DISCRETE_INPUT) {
+            String logMsg = linePrefix + " Erro: registro destino e somente leitura";
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Saída retida por uma regra de reação disparada: a regra tem precedência
+        if (ruleHoldsRegister(config.devices[assignmentInfo.targetDeviceIndex].slaveAddress, targetReg->address)) {
+            String logMsg = linePrefix + " Registro " + String(targetReg->address) + " retido por regra de reacao (ignorado)";
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Saída de um bloco PID habilitado: o bloco é o dono do atuador
+        if (pidOwnsRegister(config.devices[assignmentInfo.targetDeviceIndex].slaveAddress, targetReg->address)) {
+            String logMsg = linePrefix + " Registro " + String(targetReg->address) + " controlado por bloco PID (ignorado)";
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Bobina: fica pendente e writeOutputRegisters() envia as bobinas alteradas agrupadas (0x0F)
+        if (targetReg->registerType == REGISTER_TYPE_COIL) {
+            bool coilValue = result != 0.0;
+            bitRequestWrite(assignmentInfo.targetDeviceIndex, assignmentInfo.targetRegisterIndex, coilValue);
+            String logMsg = linePrefix + " Bobina " + String(targetReg->address) +
+                            " = " + String(coilValue ? 1 : 0) + " (pendente)";
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Aplica transformação inversa de gain/offset antes de escrever
+        // Se valor_processado = (valor_raw * gain) + offset
+        // Então valor_raw = (valor_processado - offset) / gain
+        float valueToWrite = result;
+        
+        // Verifica se gain é zero (evita divisão por zero)
+        if (targetReg->gain == 0.0f) {
+            String logMsg = linePrefix + " Erro: gain zero no registro destino, nao e possivel aplicar transformacao inversa";
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // Aplica transformação inversa
+        valueToWrite = (valueToWrite - targetReg->offset) / targetReg->gain;
+        
+        // Atualiza valor no registro (limitado ao range do tipo de dado; uint16: 0-65535)
+        uint16_t words[2];
+        uint8_t wordCount = encodeRegisterWords(targetReg->dataType, valueToWrite, words);
+        setRegisterRawValue(*targetReg, valueToWrite);
+        valueToWrite = registerRawValue(*targetReg);
+        
+        // Escreve no Modbus
+        uint8_t slaveAddr = config.devices[assignmentInfo.targetDeviceIndex].slaveAddress;
+        
+        // Modo sincronizado: entra na lista enviada ao fim dos cálculos
+        if (modbusStageActive()) {
+            modbusSyncWrite(slaveAddr, targetReg->address, words, wordCount);
+            String logMsg = linePrefix + " Atribuicao sincronizada: {d[" +
+                           String(assignmentInfo.targetDeviceIndex) + "][" +
+                           String(assignmentInfo.targetRegisterIndex) + "]} = " + String(result, 2) +
+                           " (raw: " + String(valueToWrite, 0) + ")";
+            consolePrint(logMsg + "\r\n");
+            freeAssignmentInfo(&assignmentInfo);
+            return;
+        }
+        
+        // CRÍTICO: Yield antes de operação Modbus para manter webserver responsivo
+        yield();
+        
+        // Escritas do operador pendentes têm prioridade sobre as saídas do script
+        modbusQueueService();
+        
+        // CRÍTICO: Reconfigura callbacks RS485 antes de escrever
+        // Isso garante que o controle DE/RE funcione corretamente
+        node.begin(slaveAddr, busSerial);
+        node.preTransmission(preTransmission);
+        node.postTransmission(postTransmission);
+        
+        uint8_t writeResult;
+        if (wordCount == 2) {
+            // Tipos de 32 bits: 0x10 com as 2 palavras do valor
+            node.setTransmitBuffer(0, words[0]);
+            node.setTransmitBuffer(1, words[1]);
+            writeResult = node.writeMultipleRegisters(targetReg->address, 2);
+        } else {
+            writeResult = node.writeSingleRegister(targetReg->address, targetReg->value);
+        }
+        
+        // CRÍTICO: Yield e delay após operação Modbus para estabilizar RS485
+        // Isso evita que a próxima operação Modbus (ex: display()) falhe
+        yield();
+        vTaskDelay(pdMS_TO_TICKS(50)); // Delay para estabilizar RS485 após escrita
+        yield();
+        
+        // CRÍTICO: Limpa buffer serial para evitar interferência na próxima operação
+        while (Serial2.available()) {
+            Serial2.read();
+        }
+        yield();
+        
+        if (writeResult == node.ku8MBSuccess) {
+            // Log no console
+            String logMsg = linePrefix + " Atribuicao executada: {d[" + 
+                           String(assignmentInfo.targetDeviceIndex) + "][" + 
+                           String(assignmentInfo.targetRegisterIndex) + "]} = " + 
+                           String(shownExpression) + " = " + String(result, 2) + 
+                           " (raw: " + String(valueToWrite, 0) + ")";
+            consolePrint(logMsg + "\r\n");
+        } else {
+            String logMsg = linePrefix + " Erro ao escrever Modbus: dispositivo " + 
+                           String(slaveAddr) + ", registro " + String(targetReg->address) + 
+                           ", codigo: " + String(writeResult);
+            consolePrint(logMsg + "\r\n");
+        }
+        
+        freeAssignmentInfo(&assignmentInfo);
+        return;
+    }
+    
+    // Se não há atribuição, comportamento antigo: escreve no primeiro registro de saída
+    // (mas apenas na primeira linha sem atribuição)
+    bool foundOutput = false;
+    for (int i = 0; i < config.deviceCount && !foundOutput; i++) {
+        if (!config.devices[i].enabled) continue;
+        
+        for (int j = 0; j < config.devices[i].registerCount && !foundOutput; j++) {
+            if (config.devices[i].registers[j].isOutput && !config.devices[i].registers[j].readOnly) {
+                // Limita resultado ao range de uint16_t (0-65535)
+                if (result < 0) result = 0;
+                if (result > 65535) result = 65535;
+                
+                config.devices[i].registers[j].value = (uint16_t)result;
+                
+                // Log no console
+                String logMsg = linePrefix + " Calculo executado: " + 
+                               line + " = " + String(shownExpression) + 
+                               " = " + String(result, 2);
                 consolePrint(logMsg + "\r\n");
-                freeAssignmentInfo(&assignmentInfo);
-                lineNumber++;
-                continue;
+                
+                foundOutput = true;
             }
-            
-            // Aplica transformação inversa de gain/offset antes de escrever
-            // Se valor_processado = (valor_raw * gain) + offset
-            // Então valor_raw = (valor_processado - offset) / gain
-            float valueToWrite = result;
-            
-            // Verifica se gain é zero (evita divisão por zero)
-            if (targetReg->gain == 0.0f) {
-                String logMsg = "[Linha " + String(lineNumber) + "] Erro: gain zero no registro destino, nao e possivel aplicar transformacao inversa";
-                consolePrint(logMsg + "\r\n");
-                freeAssignmentInfo(&assignmentInfo);
-                lineNumber++;
+        }
+    }
+    
+    if (!foundOutput) {
+        // Log de aviso se não encontrou registro de saída
+        String logMsg = linePrefix + " Aviso: expressao calculada mas nenhum registro de saida encontrado. Resultado: " + String(result, 2);
+        consolePrint(logMsg + "\r\n");
+    }
+}
+
+// Prioridade com que o script entraria agora
+static inline uint8_t slotPriority(uint8_t slot) {
+    return slot == 0 ? SCRIPT_MAIN_PRIORITY : s_definitions[slot - 1].priority;
+}
+
+// Pronto para começar: disparo pendente ou período vencido, sem execução em andamento
+// (anyCall: inclusive os que já começaram nesta chamada do escalonador)
+static bool isReady(uint8_t slot, int64_t nowUs, bool anyCall = false) {
+    if (s_runs[slot].active || (!anyCall && (s_startedMask & (1 << slot)))) {
+        return false;
+    }
+    if (slot == 0) {
+        return s_schedule[0].pending;
+    }
+    if (slot > s_definitionCount || !s_definitions[slot - 1].enabled) {
+        return false;
+    }
+    if (s_definitions[slot - 1].trigger == SCRIPT_TRIGGER_PERIOD) {
+        return nowUs >= s_schedule[slot].nextRunUs;
+    }
+    return s_schedule[slot].pending;
+}
+
+static bool higherPriorityReady(uint8_t priority, int64_t nowUs, bool anyCall) {
+    for (uint8_t slot = 1; slot <= s_definitionCount; slot++) {
+        if (s_definitions[slot - 1].priority < priority && isReady(slot, nowUs, anyCall)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Próximo a rodar: maior prioridade entre os em andamento e os prontos (empate: menor índice),
+// só entre os de prioridade abaixo de belowPriority
+static int pickNext(int64_t nowUs, uint16_t belowPriority) {
+    int best = -1;
+    uint8_t bestPriority = 0;
+    for (uint8_t slot = 0; slot < SCRIPT_SLOTS; slot++) {
+        uint8_t priority;
+        if (s_runs[slot].active) {
+            priority = s_runs[slot].priority;
+        } else if (isReady(slot, nowUs)) {
+            priority = slotPriority(slot);
+        } else {
+            continue;
+        }
+        if (priority >= belowPriority) {
+            continue;
+        }
+        if (best < 0 || priority < bestPriority) {
+            best = slot;
+            bestPriority = priority;
+        }
+    }
+    return best;
+}
+
+// Período vencido: disparo no instante agendado, próximo na grade fixa
+static void takePeriod(uint8_t slot, int64_t nowUs) {
+    ScriptSchedule& schedule = s_schedule[slot];
+    int64_t periodUs = (int64_t)s_definitions[slot - 1].periodMs * 1000LL;
+    int64_t scheduledUs = schedule.nextRunUs != 0 ? schedule.nextRunUs : nowUs;
+    schedule.pending = true;
+    schedule.triggeredUs = scheduledUs;
+    schedule.nextRunUs = scheduledUs + periodUs;
+    if (nowUs >= schedule.nextRunUs) {
+        // Perdeu um ou mais períodos (execução anterior longa): realinha em vez de executar em rajada
+        s_stats[slot].lateTicks += (uint32_t)((nowUs - schedule.nextRunUs) / periodUs) + 1;
+        schedule.nextRunUs = nowUs + periodUs - ((nowUs - scheduledUs) % periodUs);
+    }
+}
+
+static void markTriggered(uint8_t slot, int64_t nowUs) {
+    if (s_runs[slot].active) {
+        // Roda mais uma vez quando a execução atual terminar, com os valores novos
+        s_stats[slot].lateTicks++;
+    }
+    if (!s_schedule[slot].pending) {
+        s_schedule[slot].pending = true;
+        s_schedule[slot].triggeredUs = nowUs;
+    }
+}
+
+// Executa linhas até o fim do código, até passar do orçamento (0 = sem limite)
+// ou até um script de prioridade mais alta ficar pronto
+// @return true se foi interrompido por prioridade
+static bool runSlice(uint8_t slot, uint32_t budgetUs) {
+    ScriptRun* run = &s_runs[slot];
+    ScriptStats& stats = s_stats[slot];
+    
+    // Habilita efeitos colaterais nas expressões (ex: display via Modbus)
+    setExpressionSideEffectsEnabled(true);
+    // Lista de escritas sincronizadas aberta por outro script: este escreve na hora
+    modbusStageSuspend(!run->ownsStage);
+    int64_t sliceStartUs = esp_timer_get_time();
+    run->slices++;
+    bool preempted = false;
+    
+    // Divide o código em linhas e processa cada uma separadamente
+    const String& codeStr = run->code;
+    while (run->position < (int)codeStr.length()) {
+        if (g_processingPaused) {
+            break;
+        }
+        // Encontra o final da linha (caractere de nova linha ou fim da string)
+        int endPos = codeStr.indexOf('\n', run->position);
+        if (endPos == -1) {
+            endPos = codeStr.length();
+        }
+        
+        // Extrai a linha (remove espaços no início e fim)
+        String line = codeStr.substring(run->position, endPos);
+        line.trim();  // Remove espaços no início e fim
+        
+        // Avança para a próxima linha
+        run->position = endPos + 1;
+        int sourceLine = run->sourceLine++;
+        
+        // Ignora linhas vazias ou apenas com espaços e linhas que começam com '#' (comentários)
+        if (line.length() == 0 || line.charAt(0) == '#') {
+            continue;
+        }
+        
+        const CompiledLine* compiled = run->program != nullptr ? scriptProgramLine(run->program, sourceLine) : nullptr;
+        int64_t lineStartUs = esp_timer_get_time();
+        executeLine(run, line, run->lineNumber, compiled);
+        run->lineNumber++;
+        int64_t lineEndUs = esp_timer_get_time();
+        uint32_t elapsedUs = (uint32_t)(lineEndUs - lineStartUs);
+        run->totalUs += elapsedUs;
+        recordLineCost(slot, sourceLine, elapsedUs, compiled != nullptr ? compiled->mode : (uint8_t)SCRIPT_LINE_INTERPRETED);
+        
+        // Orçamento e prioridade conferidos entre linhas: a próxima fica para depois
+        if (budgetUs > 0 && (uint32_t)(lineEndUs - sliceStartUs) >= budgetUs) {
+            break;
+        }
+        if (run->position < (int)codeStr.length() && higherPriorityReady(run->priority, lineEndUs, true)) {
+            stats.preemptions++;
+            preempted = true;
+            break;
+        }
+    }
+    
+    uint32_t sliceUs = (uint32_t)(esp_timer_get_time() - sliceStartUs);
+    if (sliceUs > stats.maxSliceUs) {
+        stats.maxSliceUs = sliceUs;
+    }
+    
+    // Pausado (ex: salvando config): a execução termina aqui, como antes
+    if (run->position >= (int)codeStr.length() || g_processingPaused) {
+        finishRun(slot);
+    }
+    
+    // CRÍTICO: Desabilita efeitos colaterais ao fim de cada fatia
+    // Testes da interface entre as fatias não escrevem no Modbus
+    modbusStageSuspend(false);
+    setExpressionSideEffectsEnabled(false);
+    return preempted;
+}
+
+// Definições novas do servidor web: aplicadas entre as fatias (execuções em andamento mantêm o código)
+static void applyPendingDefinitions() {
+    if (s_pendingDefinitions == nullptr || !lockScripts(0)) {
+        return;
+    }
+    for (uint8_t k = 0; k < s_pendingCount; k++) {
+        uint8_t slot = k + 1;
+        if (k >= s_definitionCount || strcmp(s_definitions[k].name, s_pendingDefinitions[k].name) != 0) {
+            // Outro script neste índice: estatísticas recomeçam
+            s_statsHash[slot] = 0;
+            s_stats[slot] = ScriptStats();
+            s_stats[slot].running = s_runs[slot].active;
+        }
+        s_definitions[k] = s_pendingDefinitions[k];
+    }
+    s_definitionCount = s_pendingCount;
+    for (uint8_t slot = 1; slot < SCRIPT_SLOTS; slot++) {
+        s_schedule[slot] = ScriptSchedule();
+    }
+    delete[] s_pendingDefinitions;
+    s_pendingDefinitions = nullptr;
+    unlockScripts();
+}
+
+// Transições de alarme desde a última chamada (cursor próprio na fila de eventos)
+static void collectAlarmTriggers(int64_t nowUs) {
+    AlarmEvent event;
+    while (alarmReadEvent(&s_alarmCursor, &event)) {
+        if (event.kind == ALARM_EVENT_ACKED) {
+            continue;
+        }
+        for (uint8_t k = 0; k < s_definitionCount; k++) {
+            const ScriptDefinition& definition = s_definitions[k];
+            if (!definition.enabled || definition.trigger != SCRIPT_TRIGGER_ALARM ||
+                definition.alarmDefinition != event.definition) {
                 continue;
             }
-            
-            // Aplica transformação inversa
-            valueToWrite = (valueToWrite - targetReg->offset) / targetReg->gain;
-            
-            // Limita ao range de uint16_t (0-65535)
-            if (valueToWrite < 0) valueToWrite = 0;
-            if (valueToWrite > 65535) valueToWrite = 65535;
-            
-            // Atualiza valor no registro
-            targetReg->value = (uint16_t)valueToWrite;
-            
-            // Escreve no Modbus
-            uint8_t slaveAddr = config.devices[assignmentInfo.targetDeviceIndex].slaveAddress;
-            
-            // CRÍTICO: Yield antes de operação Modbus para manter webserver responsivo
-            yield();
-            
-            // CRÍTICO: Reconfigura callbacks RS485 antes de escrever
-            // Isso garante que o controle DE/RE funcione corretamente
-            node.begin(slaveAddr, Serial2);
-            node.preTransmission(preTransmission);
-            node.postTransmission(postTransmission);
-            
-            uint8_t writeResult = node.writeSingleRegister(targetReg->address, targetReg->value);
-            
-            // CRÍTICO: Yield e delay após operação Modbus para estabilizar RS485
-            // Isso evita que a próxima operação Modbus (ex: display()) falhe
-            yield();
-            vTaskDelay(pdMS_TO_TICKS(50)); // Delay para estabilizar RS485 após escrita
-            yield();
-            
-            // CRÍTICO: Limpa buffer serial para evitar interferência na próxima operação
-            while (Serial2.available()) {
-                Serial2.read();
+            bool raised = event.kind == ALARM_EVENT_RAISED;
+            if (definition.alarmEdge == SCRIPT_EDGE_BOTH || raised == (definition.alarmEdge == SCRIPT_EDGE_RAISED)) {
+                markTriggered(k + 1, nowUs);
             }
-            yield();
-            
-            if (writeResult == node.ku8MBSuccess) {
-                // Log no console
-                String logMsg = "[Linha " + String(lineNumber) + "] Atribuicao executada: {d[" + 
-                               String(assignmentInfo.targetDeviceIndex) + "][" + 
-                               String(assignmentInfo.targetRegisterIndex) + "]} = " + 
-                               String(processedExpression) + " = " + String(result, 2) + 
-                               " (raw: " + String(valueToWrite, 0) + ")";
-                consolePrint(logMsg + "\r\n");
-            } else {
-                String logMsg = "[Linha " + String(lineNumber) + "] Erro ao escrever Modbus: dispositivo " + 
-                               String(slaveAddr) + ", registro " + String(targetReg->address) + 
-                               ", codigo: " + String(writeResult);
-                consolePrint(logMsg + "\r\n");
+        }
+    }
+}
+
+// Roda os scripts prontos em ordem de prioridade até passar do orçamento (0 = sem limite)
+static void schedule(uint16_t belowPriority) {
+    if (s_scheduling) {
+        return;
+    }
+    s_scheduling = true;
+    applyPendingDefinitions();
+    collectAlarmTriggers(esp_timer_get_time());
+    
+    uint32_t budgetUs = (uint32_t)config.scriptSliceMs * 1000UL;
+    int64_t startUs = esp_timer_get_time();
+    s_startedMask = 0;
+    while (!g_processingPaused) {
+        int64_t nowUs = esp_timer_get_time();
+        uint32_t elapsedUs = (uint32_t)(nowUs - startUs);
+        if (budgetUs > 0 && elapsedUs >= budgetUs) {
+            break;
+        }
+        int slot = pickNext(nowUs, belowPriority);
+        if (slot < 0) {
+            break;
+        }
+        if (!s_runs[slot].active) {
+            // Cada script começa no máximo uma vez por chamada (período menor que a execução)
+            s_startedMask |= (1 << slot);
+            if (slot > 0 && s_definitions[slot - 1].trigger == SCRIPT_TRIGGER_PERIOD) {
+                takePeriod(slot, nowUs);
             }
-            
-            freeAssignmentInfo(&assignmentInfo);
-            lineNumber++;
+            if (!beginRun(slot, nowUs)) {
+                continue;
+            }
+        }
+        if (runSlice(slot, budgetUs > 0 ? budgetUs - elapsedUs : 0) &&
+            !higherPriorityReady(s_runs[slot].priority, esp_timer_get_time(), false)) {
+            // Quem interrompeu já rodou nesta chamada: roda na próxima passagem do loop
+            break;
+        }
+    }
+    s_scheduling = false;
+}
+
+void performCalculations() {
+    if (g_processingPaused) {
+        return;
+    }
+    
+    if (s_runs[0].active) {
+        // A execução anterior ainda não terminou: continua com os valores do tick em que começou
+        s_stats[0].lateTicks++;
+    } else {
+        s_schedule[0].pending = true;
+        s_schedule[0].triggeredUs = esp_timer_get_time();
+    }
+    schedule(SCRIPT_MAIN_PRIORITY + 1);
+}
+
+void calculationsService() {
+    if (g_processingPaused) {
+        return;
+    }
+    schedule(SCRIPT_MAIN_PRIORITY + 1);
+}
+
+void scriptFrameService() {
+    if (g_processingPaused || s_definitionCount == 0) {
+        return;
+    }
+    schedule(SCRIPT_MAIN_PRIORITY);
+}
+
+void scriptOnSample(uint8_t slaveAddress, uint16_t registerAddress) {
+    int64_t nowUs = 0;
+    for (uint8_t k = 0; k < s_definitionCount; k++) {
+        const ScriptDefinition& definition = s_definitions[k];
+        if (!definition.enabled || definition.trigger != SCRIPT_TRIGGER_SAMPLE) {
             continue;
         }
-        
-        // Se não há atribuição, comportamento antigo: escreve no primeiro registro de saída
-        // (mas apenas na primeira linha sem atribuição)
-        bool foundOutput = false;
-        for (int i = 0; i < config.deviceCount && !foundOutput; i++) {
-            if (!config.devices[i].enabled) continue;
-            
-            for (int j = 0; j < config.devices[i].registerCount && !foundOutput; j++) {
-                if (config.devices[i].registers[j].isOutput && !config.devices[i].registers[j].readOnly) {
-                    // Limita resultado ao range de uint16_t (0-65535)
-                    if (result < 0) result = 0;
-                    if (result > 65535) result = 65535;
-                    
-                    config.devices[i].registers[j].value = (uint16_t)result;
-                    
-                    // Log no console
-                    String logMsg = "[Linha " + String(lineNumber) + "] Calculo executado: " + 
-                                   String(lineBuffer) + " = " + String(processedExpression) + 
-                                   " = " + String(result, 2);
-                    consolePrint(logMsg + "\r\n");
-                    
-                    foundOutput = true;
+        for (uint8_t r = 0; r < definition.registerCount; r++) {
+            if (definition.slaves[r] == slaveAddress && definition.registers[r] == registerAddress) {
+                if (nowUs == 0) {
+                    nowUs = esp_timer_get_time();
                 }
+                markTriggered(k + 1, nowUs);
+                break;
             }
         }
-        
-        if (!foundOutput) {
-            // Log de aviso se não encontrou registro de saída
-            String logMsg = "[Linha " + String(lineNumber) + "] Aviso: expressao calculada mas nenhum registro de saida encontrado. Resultado: " + String(result, 2);
-            consolePrint(logMsg + "\r\n");
+    }
+}
+
+bool scriptGetStats(uint8_t index, ScriptStats* stats) {
+    if (index >= SCRIPT_SLOTS) {
+        return false;
+    }
+    // Cópia sem mutex: no pior caso mistura valores de duas execuções consecutivas
+    *stats = s_stats[index];
+    return true;
+}
+
+// ==================== SCRIPTS NOMEADOS ====================
+
+uint8_t scriptSetDefinitions(const ScriptDefinition* definitions, uint8_t count) {
+    if (count > SCRIPT_MAX_SCRIPTS) {
+        count = SCRIPT_MAX_SCRIPTS;
+    }
+    ScriptDefinition* copy = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    memcpy(copy, definitions, count * sizeof(ScriptDefinition));
+    if (!lockScripts(portMAX_DELAY)) {
+        delete[] copy;
+        return 0;
+    }
+    delete[] s_pendingDefinitions;
+    s_pendingDefinitions = copy;
+    s_pendingCount = count;
+    unlockScripts();
+    return count;
+}
+
+uint8_t scriptGetDefinitions(ScriptDefinition* definitions, uint8_t maxCount) {
+    if (!lockScripts(pdMS_TO_TICKS(500))) {
+        return 0;
+    }
+    const ScriptDefinition* source = s_pendingDefinitions != nullptr ? s_pendingDefinitions : s_definitions;
+    uint8_t available = s_pendingDefinitions != nullptr ? s_pendingCount : s_definitionCount;
+    uint8_t count = available < maxCount ? available : maxCount;
+    memcpy(definitions, source, count * sizeof(ScriptDefinition));
+    unlockScripts();
+    return count;
+}
+
+static const char* const EDGE_NAMES[] = { "raised", "cleared", "both" };
+
+// O disparo é dado pela chave presente: "samples", "alarm" ou (padrão) "periodMs"
+void scriptDefinitionToJson(const ScriptDefinition* definition, JsonObject obj) {
+    obj["enabled"] = definition->enabled;
+    obj["name"] = definition->name;
+    obj["priority"] = definition->priority;
+    if (definition->trigger == SCRIPT_TRIGGER_SAMPLE) {
+        JsonArray samples = obj.createNestedArray("samples");
+        for (uint8_t r = 0; r < definition->registerCount; r++) {
+            JsonObject sample = samples.createNestedObject();
+            sample["slave"] = definition->slaves[r];
+            sample["register"] = definition->registers[r];
         }
-        
-        lineNumber++;
+    } else if (definition->trigger == SCRIPT_TRIGGER_ALARM) {
+        obj["alarm"] = definition->alarmDefinition;
+        obj["edge"] = EDGE_NAMES[definition->alarmEdge < 3 ? definition->alarmEdge : 0];
+    } else {
+        obj["periodMs"] = definition->periodMs;
+    }
+    obj["code"] = definition->code;
+}
+
+bool scriptDefinitionFromJson(JsonObjectConst obj, ScriptDefinition* definition) {
+    memset(definition, 0, sizeof(ScriptDefinition));
+    definition->enabled = obj["enabled"] | true;
+    const char* name = obj["name"] | "";
+    strncpy(definition->name, name, sizeof(definition->name) - 1);
+    int priority = obj["priority"] | 0;
+    definition->priority = (uint8_t)constrain(priority, 0, SCRIPT_MAIN_PRIORITY - 1);
+    const char* code = obj["code"] | "";
+    if (strlen(code) >= sizeof(definition->code)) {
+        return false;
     }
+    strncpy(definition->code, code, sizeof(definition->code) - 1);
     
-    // Limpa memória DeviceValues
-    for (int i = 0; i < config.deviceCount; i++) {
-        delete[] deviceValues.values[i];
+    if (obj["samples"].is<JsonArrayConst>()) {
+        definition->trigger = SCRIPT_TRIGGER_SAMPLE;
+        for (JsonObjectConst sample : obj["samples"].as<JsonArrayConst>()) {
+            if (definition->registerCount >= SCRIPT_MAX_TRIGGER_REGISTERS) {
+                return false;
+            }
+            uint8_t r = definition->registerCount++;
+            definition->slaves[r] = sample["slave"] | 0;
+            definition->registers[r] = sample["register"] | 0;
+            if (definition->slaves[r] == 0) {
+                return false;
+            }
+        }
+        if (definition->registerCount == 0) {
+            return false;
+        }
+    } else if (!obj["alarm"].isNull()) {
+        definition->trigger = SCRIPT_TRIGGER_ALARM;
+        int alarm = obj["alarm"] | -1;
+        if (alarm < 0 || alarm >= ALARM_MAX_DEFINITIONS) {
+            return false;
+        }
+        definition->alarmDefinition = (uint8_t)alarm;
+        const char* edge = obj["edge"] | "raised";
+        definition->alarmEdge = 0xFF;
+        for (uint8_t e = 0; e < 3; e++) {
+            if (strcmp(edge, EDGE_NAMES[e]) == 0) {
+                definition->alarmEdge = e;
+            }
+        }
+        if (definition->alarmEdge == 0xFF) {
+            return false;
+        }
+    } else {
+        definition->trigger = SCRIPT_TRIGGER_PERIOD;
+        definition->periodMs = obj["periodMs"] | 1000;
+        if (definition->periodMs < SCRIPT_MIN_PERIOD_MS) {
+            definition->periodMs = SCRIPT_MIN_PERIOD_MS;
+        }
     }
-    delete[] deviceValues.values;
-    delete[] deviceValues.registerCounts;
+    return strlen(definition->name) > 0;
+}
+
+bool scriptSaveDefinitions() {
+    ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    uint8_t count = scriptGetDefinitions(definitions, SCRIPT_MAX_SCRIPTS);
     
-    // Limpa memória dos arrays alocados no heap
-    delete[] tempVarNames;
-    delete[] tempVarValues;
-    delete[] tempVariables;
-    delete[] lineBuffer;
-    delete[] processedExpression;
-    delete[] errorMsg;
-    
-    // CRÍTICO: Desabilita efeitos colaterais APÓS processar todas as linhas
-    // Isso garante que funções como display() funcionem durante todo o processamento
-    setExpressionSideEffectsEnabled(false);
+    DynamicJsonDocument doc(4096 + SCRIPT_MAX_SCRIPTS * SCRIPT_MAX_CODE);
+    JsonArray array = doc.createNestedArray("scripts");
+    for (uint8_t k = 0; k < count; k++) {
+        scriptDefinitionToJson(&definitions[k], array.createNestedObject());
+    }
+    
+    File file = LittleFS.open(SCRIPT_CONFIG_FILE, "w");
+    if (!file) {
+        delete[] definitions;
+        consolePrint("[Script] Erro ao gravar " SCRIPT_CONFIG_FILE "\r\n");
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    delete[] definitions;
+    return true;
 }
 
+void scriptsInit() {
+    // Transições de alarme anteriores à inicialização não disparam scripts
+    s_alarmCursor = alarmNextEventSeq();
+    
+    File file = LittleFS.open(SCRIPT_CONFIG_FILE, "r");
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(4096 + SCRIPT_MAX_SCRIPTS * SCRIPT_MAX_CODE);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        consolePrint("[Script] " SCRIPT_CONFIG_FILE " invalido: " + String(error.c_str()) + "\r\n");
+        return;
+    }
+    
+    ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    uint8_t count = 0;
+    for (JsonObjectConst obj : doc["scripts"].as<JsonArrayConst>()) {
+        if (count < SCRIPT_MAX_SCRIPTS && scriptDefinitionFromJson(obj, &definitions[count])) {
+            count++;
+        }
+    }
+    scriptSetDefinitions(definitions, count);
+    delete[] definitions;
+    consolePrint("[Script] " + String(count) + " scripts carregados\r\n");
+}
@@ -1,6 +1,38 @@
 /**
  * @file calculations.h
  * @brief Funções para cálculos e expressões
+ *
+ * Além do código principal (config.calculationCode, executado no tick do
+ * ciclo), até SCRIPT_MAX_SCRIPTS scripts nomeados, gravados em
+ * SCRIPT_CONFIG_FILE, cada um com o seu disparo:
+ * - Período próprio (grade fixa, como os blocos PID)
+ * - Nova leitura de um ou mais registros (qualquer um deles)
+ * - Ativação e/ou desativação de um alarme
+ *
+ * Os scripts prontos rodam em ordem de prioridade (0 = mais alta; o código
+ * principal vem depois de todos). A execução é feita em fatias: com
+ * config.scriptSliceMs > 0, cada chamada executa linhas até passar do
+ * orçamento e devolve o controle ao loop (servidor web, watchdog, fila de
+ * escritas); a execução continua da mesma linha na chamada seguinte. Entre
+ * duas linhas, um script de prioridade mais alta que ficou pronto interrompe
+ * o que está rodando, que continua depois dele: lógica rápida não espera a
+ * lenta terminar. Uma linha não é interrompida no meio: uma linha mais cara
+ * que o orçamento faz a fatia passar dele.
+ *
+ * Os scripts nomeados também rodam entre os quadros do ciclo de leitura
+ * (como os blocos PID), então um script disparado por uma leitura não espera
+ * as leituras dos demais dispositivos.
+ *
+ * Cada execução trabalha sobre uma cópia do código e dos valores do instante
+ * em que começou, com variáveis temporárias próprias. Um disparo com a
+ * execução anterior ainda em andamento conta em lateTicks: o tick do código
+ * principal e os períodos perdidos são descartados; disparos por leitura ou
+ * alarme rodam uma vez mais quando a execução termina. Escritas sincronizadas
+ * (config.syncWrites) valem só para o código principal; os scripts nomeados
+ * escrevem na hora.
+ *
+ * O código é compilado (script_compiler.h) na primeira execução depois de
+ * mudar; as linhas que o compilador não trata usam o interpretador.
  */
 
 #ifndef CALCULATIONS_H
@@ -9,11 +41,142 @@
 #include <Arduino.h>
 #include "config.h"
 #include "expression_parser.h"
+#include "script_compiler.h"
+#include <ArduinoJson.h>
+
+#define SCRIPT_MAX_LINE_COSTS 64           // Linhas com custo medido (as seguintes só entram no total)
+#define SCRIPT_MAX_SCRIPTS 8               // Scripts nomeados (além do código principal)
+#define SCRIPT_MAX_CODE 1024
+#define SCRIPT_MAX_TRIGGER_REGISTERS 4
+#define SCRIPT_MIN_PERIOD_MS 100
+#define SCRIPT_MAIN_PRIORITY 255           // Código principal: depois de todos os scripts nomeados
+#define SCRIPT_CONFIG_FILE "/scripts.json"
+
+/**
+ * @brief Disparo de um script nomeado
+ */
+enum ScriptTrigger {
+    SCRIPT_TRIGGER_PERIOD = 0,             // A cada periodMs
+    SCRIPT_TRIGGER_SAMPLE,                 // Nova leitura de um dos registros
+    SCRIPT_TRIGGER_ALARM                   // Transição de um alarme
+};
+
+/**
+ * @brief Transições de alarme que disparam o script
+ */
+enum ScriptAlarmEdge {
+    SCRIPT_EDGE_RAISED = 0,
+    SCRIPT_EDGE_CLEARED,
+    SCRIPT_EDGE_BOTH
+};
+
+/**
+ * @struct ScriptDefinition
+ * @brief Configuração de um script nomeado
+ */
+struct ScriptDefinition {
+    bool enabled;
+    char name[24];
+    uint8_t priority;                      // 0 = mais alta (até SCRIPT_MAIN_PRIORITY - 1)
+    uint8_t trigger;                       // ScriptTrigger
+    uint32_t periodMs;                     // SCRIPT_TRIGGER_PERIOD (mínimo SCRIPT_MIN_PERIOD_MS)
+    uint8_t registerCount;                 // SCRIPT_TRIGGER_SAMPLE
+    uint8_t slaves[SCRIPT_MAX_TRIGGER_REGISTERS];
+    uint16_t registers[SCRIPT_MAX_TRIGGER_REGISTERS];
+    uint8_t alarmDefinition;               // SCRIPT_TRIGGER_ALARM: índice da definição de alarme
+    uint8_t alarmEdge;                     // ScriptAlarmEdge
+    char code[SCRIPT_MAX_CODE];
+};
+
+/**
+ * @struct ScriptLineCost
+ * @brief Custo de uma linha executável do código (µs, incluindo o barramento)
+ */
+struct ScriptLineCost {
+    uint16_t line;                         // Linha no código (1 = primeira, contando vazias e comentários)
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint8_t mode;                          // ScriptLineMode (compilada ou interpretada)
+};
+
+/**
+ * @struct ScriptStats
+ * @brief Execuções do código de cálculo (zeradas quando o código muda)
+ */
+struct ScriptStats {
+    bool running;                          // Execução em andamento (continua na próxima fatia)
+    uint32_t runs;                         // Execuções completas
+    uint32_t lateTicks;                    // Disparos com a execução anterior ainda em andamento
+    uint32_t lastWaitUs;                   // Do disparo ao início da execução
+    uint32_t maxWaitUs;
+    uint32_t preemptions;                  // Interrupções por um script de prioridade mais alta
+    uint32_t lastRunUs;                    // Soma das linhas da última execução
+    uint32_t maxRunUs;
+    uint32_t lastSpanMs;                   // Do início ao fim da última execução, com as pausas entre fatias
+    uint16_t lastSlices;
+    uint16_t maxSlices;
+    uint32_t maxSliceUs;                   // Maior fatia (passa do orçamento quando uma linha sozinha passa)
+    ScriptCompileStats compile;            // Compilação do código (script_compiler.h)
+    uint8_t lineCount;
+    ScriptLineCost lines[SCRIPT_MAX_LINE_COSTS];
+};
+
+/**
+ * @brief Carrega os scripts nomeados de SCRIPT_CONFIG_FILE (precisa do LittleFS montado)
+ */
+void scriptsInit();
 
 /**
  * @brief Realiza cálculos customizados nos valores lidos
+ *
+ * No tick do ciclo: dispara o código principal (ou conta o tick como
+ * atrasado se a execução anterior não terminou) e roda os scripts prontos.
  */
 void performCalculations();
 
-#endif // CALCULATIONS_H
+/**
+ * @brief Roda os scripts prontos e continua os que estão em andamento (loop, entre os ciclos)
+ */
+void calculationsService();
+
+/**
+ * @brief Entre os quadros do ciclo de leitura: só os scripts nomeados (o código principal espera o tick)
+ *
+ * Um script disparado pela leitura de um registro roda logo depois dela, sem
+ * esperar as leituras dos demais dispositivos.
+ */
+void scriptFrameService();
 
+/**
+ * @brief Nova leitura bem-sucedida de um registro (dispara os scripts que o observam)
+ */
+void scriptOnSample(uint8_t slaveAddress, uint16_t registerAddress);
+
+/**
+ * @brief Substitui os scripts nomeados (aplicado pelo loop antes da próxima execução)
+ *
+ * Execuções em andamento terminam com o código com que começaram.
+ * @return Quantidade de scripts válidos
+ */
+uint8_t scriptSetDefinitions(const ScriptDefinition* definitions, uint8_t count);
+
+/**
+ * @brief Copia os scripts nomeados (inclusive os ainda não aplicados)
+ */
+uint8_t scriptGetDefinitions(ScriptDefinition* definitions, uint8_t maxCount);
+
+/**
+ * @brief Grava os scripts nomeados em SCRIPT_CONFIG_FILE
+ */
+bool scriptSaveDefinitions();
+
+void scriptDefinitionToJson(const ScriptDefinition* definition, JsonObject obj);
+bool scriptDefinitionFromJson(JsonObjectConst obj, ScriptDefinition* definition);
+
+/**
+ * @brief Estatísticas de um script
+ * @param index 0 = código principal, 1..SCRIPT_MAX_SCRIPTS = scripts nomeados
+ */
+bool scriptGetStats(uint8_t index, ScriptStats* stats);
+
+#endif // CALCULATIONS_H
@@ -30,6 +30,19 @@
 #define MAX_REGISTERS_PER_DEVICE 20
 #define CALCULATION_INTERVAL_MS 1000
 
+// Tipo de dado de um registro (ModbusRegister.dataType); tipos de 32 bits ocupam 2 registradores
+#define REGISTER_DATA_UINT16 0
+#define REGISTER_DATA_INT16 1
+#define REGISTER_DATA_UINT32 2
+#define REGISTER_DATA_INT32 3
+#define REGISTER_DATA_FLOAT32 4
+#define REGISTER_DATA_TYPE_MASK 0x0F
+#define REGISTER_DATA_WORD_SWAP 0x80    // Palavra menos significativa primeiro (32 bits)
+
+// Tipos de registro de bit (ModbusRegister.registerType; 0 a 2 são registradores de 16 bits)
+#define REGISTER_TYPE_COIL 3            // Bobina: leitura 0x01, escrita 0x05/0x0F
+#define REGISTER_TYPE_DISCRETE_INPUT 4  // Entrada discreta: leitura 0x02
+
 // Pinos RS485 (ajustar conforme hardware)
 // Pinout ESP32-S3-RS485-CAN (Waveshare):
 // GPIO17: RS485 TX
@@ -39,6 +52,12 @@
 #define RS485_RX_PIN 18
 #define RS485_DE_RE_PIN 21  // Driver Enable / Receiver Enable
 
+// Segundo barramento RS485 (modo escravo, Serial1): requer um segundo transceptor
+// Pinos padrão; podem ser alterados em /slave.json (ajustar conforme hardware)
+#define SLAVE_RS485_TX_PIN 15
+#define SLAVE_RS485_RX_PIN 16
+#define SLAVE_RS485_DE_RE_PIN 14
+
 // ==================== ESTRUTURAS DE DADOS ====================
 
 /**
@@ -60,8 +79,12 @@ struct ModbusRegister {
     bool generateGraph;      // true = incluir esta variável no gráfico em tempo real
     uint8_t writeFunction;   // Função Modbus para escrita: 0x06 (Write Single Register) ou 0x10 (Write Multiple Registers) - DEPRECATED: calculado automaticamente
     uint8_t writeRegisterCount; // Quantidade de registros para escrita - DEPRECATED: usar registerCount
-    uint8_t registerType;    // 0 = Leitura, 1 = Escrita, 2 = Leitura e Escrita
+    uint8_t registerType;    // 0 = Leitura, 1 = Escrita, 2 = Leitura e Escrita, 3 = Bobina, 4 = Entrada discreta
     uint8_t registerCount;   // Quantidade de registradores para leitura/escrita (padrão: 1)
+    int64_t sampleTimeUs;    // Recepção da última leitura (monotonicMicros(), µs); 0 = nunca lido
+    uint8_t sampleGroup;     // Grupo de amostragem (0 = nenhum): registros do mesmo grupo são lidos em sequência logo após o tick do ciclo
+    uint8_t dataType;        // REGISTER_DATA_* (padrão: uint16), opcionalmente com REGISTER_DATA_WORD_SWAP
+    float typedRaw;          // Valor decodificado da última leitura (antes de gain/offset); usado pelos tipos de 32 bits
 };
 
 /**
@@ -73,6 +96,7 @@ struct ModbusDevice {
     bool enabled;            // Dispositivo habilitado
     uint8_t registerCount;   // Quantidade de registros configurados
     char deviceName[32];     // Nome do dispositivo
+    char profile[24];        // Perfil de dispositivo (device_profiles.h); vazio = registros lidos um a um
     ModbusRegister registers[MAX_REGISTERS_PER_DEVICE];
 };
 
@@ -112,7 +136,7 @@ struct RTCConfig {
     char ntpServer[64];     // Servidor NTP
     bool ntpEnabled;       // Atualizar via NTP
     uint32_t epochTime;    // Timestamp Unix (epoch) da última sincronização
-    uint32_t bootTime;     // millis() no momento da última sincronização
+    uint32_t bootTime;     // millis() no momento da última sincronização - DEPRECATED: usar monotonicToUtcMicros()
 };
 
 /**
@@ -148,6 +172,9 @@ struct SystemConfig {
     RTCConfig rtc;           // Configuração RTC
     WireGuardConfig wireguard; // Configuração WireGuard VPN
     char calculationCode[1024];  // Código Python/expressão para cálculos
+    bool alignSamples;       // true = cálculos usam valores interpolados no tick do ciclo
+    bool syncWrites;         // true = escritas do script enviadas juntas ao fim dos cálculos (modbus_broadcast.h)
+    uint16_t scriptSliceMs;  // Orçamento de cada fatia do script (calculations.h); 0 = executa tudo no tick
 };
 
 // ==================== VARIÁVEIS GLOBAIS EXTERNAS ====================
@@ -70,10 +70,14 @@ void loadConfig() {
         
         // Código de cálculo vazio por padrão
         config.calculationCode[0] = '\0';
+        config.alignSamples = false;
+        config.syncWrites = false;
+        config.scriptSliceMs = 0;
         
         // Inicializa todos os campos padrão
         for (int i = 0; i < MAX_DEVICES; i++) {
             config.devices[i].deviceName[0] = '\0';
+            config.devices[i].profile[0] = '\0';
             for (int j = 0; j < MAX_REGISTERS_PER_DEVICE; j++) {
                 config.devices[i].registers[j].variableName[0] = '\0';
                 config.devices[i].registers[j].gain = 1.0f;      // Ganho padrão: 1.0
@@ -83,6 +87,8 @@ void loadConfig() {
                 config.devices[i].registers[j].kalmanQ = 0.01f; // Process noise padrão
                 config.devices[i].registers[j].kalmanR = 0.1f;  // Measurement noise padrão
                 config.devices[i].registers[j].generateGraph = false; // Padrão: não gerar gráfico
+                config.devices[i].registers[j].sampleGroup = 0; // Padrão: sem grupo de amostragem
+                config.devices[i].registers[j].dataType = REGISTER_DATA_UINT16; // Padrão: uint16
             }
         }
         
@@ -230,6 +236,9 @@ void loadConfig() {
     } else {
         config.calculationCode[0] = '\0';
     }
+    config.alignSamples = doc["alignSamples"] | false;
+    config.syncWrites = doc["syncWrites"] | false;
+    config.scriptSliceMs = doc["scriptSliceMs"] | 0;
     
     // Verifica se há array de dispositivos
     if (!doc.containsKey("devices") || !doc["devices"].is<JsonArray>()) {
@@ -262,6 +271,11 @@ void loadConfig() {
         strncpy(config.devices[i].deviceName, devName, sizeof(config.devices[i].deviceName) - 1);
         config.devices[i].deviceName[sizeof(config.devices[i].deviceName) - 1] = '\0';
         
+        // Perfil de dispositivo (vazio = sem perfil)
+        const char* profileName = deviceObj["profile"] | "";
+        strncpy(config.devices[i].profile, profileName, sizeof(config.devices[i].profile) - 1);
+        config.devices[i].profile[sizeof(config.devices[i].profile) - 1] = '\0';
+        
         Serial.print("Carregando dispositivo ");
         Serial.print(i);
         Serial.print(": ");
@@ -311,6 +325,8 @@ void loadConfig() {
             // IMPORTANTE: Inicializa valor com 0 mesmo sem leitura do dispositivo
             // Isso garante que a variável existe e pode ser usada nas expressões
             config.devices[i].registers[j].value = 0;
+            config.devices[i].registers[j].typedRaw = 0.0f;
+            config.devices[i].registers[j].sampleTimeUs = 0;
             
             // Carrega nome da variável
             const char* varName = regObj["variableName"] | "";
@@ -350,6 +366,12 @@ void loadConfig() {
             // Carrega registerCount (padrão: 1)
             config.devices[i].registers[j].registerCount = regObj["registerCount"] | 1;
             
+            // Carrega sampleGroup (padrão: 0 - sem grupo)
+            config.devices[i].registers[j].sampleGroup = regObj["sampleGroup"] | 0;
+            
+            // Carrega dataType (padrão: uint16)
+            config.devices[i].registers[j].dataType = regObj["dataType"] | REGISTER_DATA_UINT16;
+            
             Serial.print("  Registro ");
             Serial.print(j);
             Serial.print(": endereco=");
@@ -427,6 +449,9 @@ bool saveConfig() {
     
     // Adiciona código de cálculo
     doc["calculationCode"] = String(config.calculationCode);
+    doc["alignSamples"] = config.alignSamples;
+    doc["syncWrites"] = config.syncWrites;
+    doc["scriptSliceMs"] = config.scriptSliceMs;
     
     JsonArray devicesArray = doc.createNestedArray("devices");
     
@@ -435,6 +460,7 @@ bool saveConfig() {
         deviceObj["slaveAddress"] = config.devices[i].slaveAddress;
         deviceObj["enabled"] = config.devices[i].enabled;
         deviceObj["deviceName"] = String(config.devices[i].deviceName);
+        deviceObj["profile"] = String(config.devices[i].profile);
         
         JsonArray registersArray = deviceObj.createNestedArray("registers");
         
@@ -454,6 +480,8 @@ bool saveConfig() {
             regObj["generateGraph"] = config.devices[i].registers[j].generateGraph;
             regObj["registerType"] = config.devices[i].registers[j].registerType;
             regObj["registerCount"] = config.devices[i].registers[j].registerCount;
+            regObj["sampleGroup"] = config.devices[i].registers[j].sampleGroup;
+            regObj["dataType"] = config.devices[i].registers[j].dataType;
             // Não salva value aqui, pois será lido do Modbus ou inicializado com 0
         }
         
@@ -646,6 +674,9 @@ bool resetConfig() {
     
     // Código de cálculo vazio por padrão
     config.calculationCode[0] = '\0';
+    config.alignSamples = false;
+    config.syncWrites = false;
+    config.scriptSliceMs = 0;
     
     // Inicializa todos os campos padrão
     for (int i = 0; i < MAX_DEVICES; i++) {
@@ -653,9 +684,12 @@ bool resetConfig() {
         config.devices[i].enabled = false;
         config.devices[i].registerCount = 0;
         config.devices[i].deviceName[0] = '\0';
+        config.devices[i].profile[0] = '\0';
         for (int j = 0; j < MAX_REGISTERS_PER_DEVICE; j++) {
             config.devices[i].registers[j].address = 0;
             config.devices[i].registers[j].value = 0;
+            config.devices[i].registers[j].typedRaw = 0.0f;
+            config.devices[i].registers[j].sampleTimeUs = 0;
             config.devices[i].registers[j].isInput = true;
             config.devices[i].registers[j].isOutput = false;
             config.devices[i].registers[j].readOnly = false;
@@ -670,6 +704,8 @@ bool resetConfig() {
             config.devices[i].registers[j].writeRegisterCount = 1;
             config.devices[i].registers[j].registerType = 2; // padrão: Leitura e Escrita
             config.devices[i].registers[j].registerCount = 1; // padrão: 1 registrador
+            config.devices[i].registers[j].sampleGroup = 0;   // padrão: sem grupo de amostragem
+            config.devices[i].registers[j].dataType = REGISTER_DATA_UINT16; // padrão: uint16
         }
     }
     
@@ -6,6 +6,23 @@
 #include "console.h"
 #include "config.h"
 #include "modbus_handler.h"
+#include "data_logger.h"
+#include "data_rollup.h"
+#include "alarm_engine.h"
+#include "pid_control.h"
+#include "reactive_rules.h"
+#include "modbus_queue.h"
+#include "psychrometrics.h"
+#include "modbus_scan.h"
+#include "modbus_autodetect.h"
+#include "device_profiles.h"
+#include "modbus_slave.h"
+#include "modbus_bits.h"
+#include "modbus_broadcast.h"
+#include "bus_capture.h"
+#include "calculations.h"
+#include "expression_parser.h"
+#include "rtc_manager.h"
 #include <WiFi.h>
 #include <ESP.h>
 #include "freertos/FreeRTOS.h"
@@ -90,6 +107,21 @@ void processConsoleCommand(AsyncWebSocketClient* client, String command) {
         client->text("uptime   - Tempo de funcionamento\r\n");
         client->text("config   - Mostra configuracoes\r\n");
         client->text("modbus   - Status Modbus\r\n");
+        client->text("timing   - Desvio de aquisicao por registro e grupos de amostragem\r\n");
+        client->text("alarms   - Alarmes ativos (alarms ack: reconhece todos)\r\n");
+        client->text("pid      - Blocos PID: saida, jitter e latencia\r\n");
+        client->text("rules    - Regras de reacao: estado, disparos e latencia entrada-saida\r\n");
+        client->text("queue    - Fila de escritas Modbus (pendentes e espera)\r\n");
+        client->text("psychro  - Constantes psicrometricas e pontos (psychro fit: recalibra)\r\n");
+        client->text("scan     - Busca de dispositivos (scan start, scan cancel)\r\n");
+        client->text("autodetect - Velocidade/enquadramento detectados (autodetect start, autodetect apply)\r\n");
+        client->text("profiles - Perfis de dispositivo e blocos de leitura compilados\r\n");
+        client->text("slave    - Escravo Modbus na Serial1: mapa, tabela e contadores\r\n");
+        client->text("bits     - Bobinas e entradas discretas: valores, blocos e contadores\r\n");
+        client->text("bcast    - Broadcast, escritas sincronizadas e display(): contadores\r\n");
+        client->text("capture  - Captura do barramento: estado e ultimos quadros (capture clear | capture trigger)\r\n");
+        client->text("script   - Scripts de calculo: fatias, duracao e custo por linha (script N: detalha o script nomeado N)\r\n");
+        client->text("log      - Status do historico (log flush: grava pendentes, log bench: compressao)\r\n");
     }
     else if (command == "status") {
         client->text("=== Status do Sistema ===\r\n");
@@ -107,6 +139,7 @@ void processConsoleCommand(AsyncWebSocketClient* client, String command) {
     }
     else if (command == "reboot") {
         client->text("Reiniciando em 2 segundos...\r\n");
+        dataLoggerFlush();
         if (webSocket) {
             webSocket->textAll("Sistema reiniciando...\r\n");
         }
@@ -147,6 +180,436 @@ void processConsoleCommand(AsyncWebSocketClient* client, String command) {
             client->text(msg);
         }
     }
+    else if (command == "timing") {
+        client->text("=== Amostragem (relativo ao tick do ciclo) ===\r\n");
+        client->text(String("Alinhamento nos calculos: ") + (config.alignSamples ? "Habilitado" : "Desabilitado") + "\r\n");
+        for (int i = 0; i < config.deviceCount; i++) {
+            for (int j = 0; j < config.devices[i].registerCount; j++) {
+                const ModbusRegister& reg = config.devices[i].registers[j];
+                if (reg.sampleTimeUs <= 0) {
+                    continue;
+                }
+                String msg = "  Dev " + String(config.devices[i].slaveAddress) + " Reg " + String(reg.address);
+                if (strlen(reg.variableName) > 0) {
+                    msg += " (" + String(reg.variableName) + ")";
+                }
+                msg += ": +" + String(sampleTimings[i][j].offsetUs / 1000.0f, 1) + " ms";
+                if (reg.sampleGroup != 0) {
+                    msg += " [grupo " + String(reg.sampleGroup) + "]";
+                }
+                if (reg.sampleTimeUs < g_cycleTickUs) {
+                    msg += " (falhou no ultimo ciclo)";
+                }
+                client->text(msg + "\r\n");
+            }
+        }
+        // Espalhamento de cada grupo configurado (grupos em ordem crescente)
+        uint8_t group = 0;
+        while (true) {
+            uint8_t nextGroup = 0;
+            for (int i = 0; i < config.deviceCount; i++) {
+                for (int j = 0; j < config.devices[i].registerCount; j++) {
+                    uint8_t g = config.devices[i].registers[j].sampleGroup;
+                    if (g > group && (nextGroup == 0 || g < nextGroup)) {
+                        nextGroup = g;
+                    }
+                }
+            }
+            if (nextGroup == 0) {
+                break;
+            }
+            group = nextGroup;
+            int32_t spreadUs = sampleGroupSpreadUs(group);
+            client->text("Grupo " + String(group) + ": " +
+                         (spreadUs < 0 ? String("sem leituras") : "espalhamento " + String(spreadUs / 1000.0f, 1) + " ms") + "\r\n");
+        }
+    }
+    else if (command == "alarms" || command == "alarms ack") {
+        if (command == "alarms ack") {
+            client->text("Reconhecidos: " + String(alarmAcknowledgeAll(monotonicMicros())) + "\r\n");
+        }
+        AlarmDefinition* definitions = new AlarmDefinition[ALARM_MAX_DEFINITIONS];
+        uint8_t count = alarmGetDefinitions(definitions, ALARM_MAX_DEFINITIONS);
+        client->text("=== Alarmes (" + String(count) + " definicoes, " + String(alarmActiveCount()) + " ativos) ===\r\n");
+        for (uint8_t d = 0; d < count; d++) {
+            for (uint8_t c = 0; c < ALARM_CONDITION_COUNT; c++) {
+                if (!alarmIsActive(d, c)) {
+                    continue;
+                }
+                String label = strlen(definitions[d].name) > 0
+                    ? String(definitions[d].name)
+                    : "Dev " + String(definitions[d].slaveAddress) + " Reg " + String(definitions[d].registerAddress);
+                client->text("  " + label + " " + alarmConditionName(c) +
+                             (alarmIsUnacknowledged(d, c) ? " (nao reconhecido)" : "") + "\r\n");
+            }
+        }
+        delete[] definitions;
+    }
+    else if (command == "scan" || command == "scan start" || command == "scan cancel") {
+        if (command == "scan start") {
+            ModbusScanRequest scan;
+            memset(&scan, 0, sizeof(scan));
+            scan.firstAddress = 1;
+            scan.lastAddress = 247;
+            client->text(modbusScanStart(&scan) ? "Busca iniciada (1-247, velocidade configurada)\r\n" : "Busca ja em andamento\r\n");
+        } else if (command == "scan cancel") {
+            modbusScanCancel();
+        }
+        ModbusScanStatus status;
+        modbusScanGetStatus(&status);
+        client->text("=== Busca Modbus ===\r\n");
+        client->text(String(status.running ? "Em andamento" : (status.cancelled ? "Cancelada" : "Parada")) + ": " +
+                     String(status.probed) + "/" + String(status.total) + " enderecos, " + String(status.retries) +
+                     " repeticoes, espera " + String(status.timeoutUs / 1000.0f, 1) + " ms, " +
+                     String(status.elapsedMs / 1000.0f, 1) + " s\r\n");
+        ModbusScanFound* found = new ModbusScanFound[SCAN_MAX_RESULTS];
+        uint8_t count = modbusScanGetResults(found, SCAN_MAX_RESULTS);
+        for (uint8_t k = 0; k < count; k++) {
+            client->text("  Endereco " + String(found[k].address) + " @ " + String(found[k].baud) + " baud, latencia " +
+                         String(found[k].latencyUs / 1000.0f, 1) + " ms" +
+                         (found[k].exception ? ", excecao " + String(found[k].exception) : String("")) +
+                         (found[k].configured ? " (configurado)" : "") + "\r\n");
+        }
+        delete[] found;
+    }
+    else if (command == "autodetect" || command == "autodetect start" || command == "autodetect apply") {
+        if (command != "autodetect") {
+            AutodetectRequest detect;
+            memset(&detect, 0, sizeof(detect));
+            detect.apply = (command == "autodetect apply");
+            client->text(modbusAutodetectRequest(&detect) ? "Deteccao agendada (dispositivos habilitados)\r\n"
+                                                          : "Deteccao ja agendada ou nenhum dispositivo habilitado\r\n");
+            return;
+        }
+        AutodetectResult* result = new AutodetectResult;
+        modbusAutodetectGetResult(result);
+        client->text("=== Deteccao de velocidade ===\r\n");
+        if (result->pending) {
+            client->text("Agendada, aguardando o loop\r\n");
+        } else if (!result->done) {
+            client->text("Nenhuma deteccao executada\r\n");
+        } else {
+            const char* parity = result->parity == MODBUS_PARITY_EVEN ? "E" : (result->parity == MODBUS_PARITY_ODD ? "O" : "N");
+            client->text(result->found
+                ? "Encontrado: " + String(result->baudRate) + " 8" + String(parity) + String(result->stopBits) +
+                  (result->applied ? " (aplicado)" : " (nao aplicado)") + "\r\n"
+                : String("Nada encontrado") + (result->timedOut ? " (tempo esgotado)" : "") + "\r\n");
+            client->text(String(result->candidateCount) + " combinacoes testadas em " + String(result->elapsedMs) + " ms\r\n");
+        }
+        delete result;
+    }
+    else if (command == "profiles") {
+        DeviceProfile* profile = new DeviceProfile;
+        client->text("=== Perfis de dispositivo (" + String(profileCount()) + ") ===\r\n");
+        for (uint8_t p = 0; profileGetAt(p, profile); p++) {
+            client->text(String(profile->name) + ": " + String(profile->registerCount) + " registros, " +
+                         String(profile->plan.blockCount) + " blocos (maxGap " + String(profile->maxGap) + ")\r\n");
+            for (uint8_t b = 0; b < profile->plan.blockCount; b++) {
+                const ProfileBlock& block = profile->plan.blocks[b];
+                client->text("  0x0" + String(block.function) + " " + String(block.start) + "-" +
+                             String(block.start + block.count - 1) + " (" + String(block.count) + " regs)\r\n");
+            }
+        }
+        delete profile;
+        // Dispositivos que referenciam um perfil inexistente são lidos registro a registro
+        ProfilePlan* plan = new ProfilePlan;
+        for (int i = 0; i < config.deviceCount; i++) {
+            if (config.devices[i].profile[0] == '\0') {
+                continue;
+            }
+            bool found = profileGetPlan(config.devices[i].profile, plan);
+            client->text("Dev " + String(config.devices[i].slaveAddress) + " -> " + String(config.devices[i].profile) +
+                         (found ? "" : " (nao encontrado)") + "\r\n");
+        }
+        delete plan;
+    }
+    else if (command == "slave") {
+        SlaveConfig* slaveConfig = new SlaveConfig;
+        modbusSlaveGetConfig(slaveConfig);
+        SlaveStats stats;
+        modbusSlaveGetStats(&stats);
+        client->text("=== Escravo Modbus (Serial1) ===\r\n");
+        if (!slaveConfig->enabled) {
+            client->text("Desabilitado\r\n");
+        } else {
+            const char* parity = slaveConfig->parity == MODBUS_PARITY_EVEN ? "E" : (slaveConfig->parity == MODBUS_PARITY_ODD ? "O" : "N");
+            client->text("Endereco " + String(slaveConfig->address) + " @ " + String(slaveConfig->baudRate) + " 8" + String(parity) +
+                         String(slaveConfig->stopBits) + ", tabela " + String(stats.tableBase) + "-" +
+                         String(stats.tableBase + stats.tableWords - 1) + " (" + String(stats.tableWords) + " palavras)\r\n");
+        }
+        static const char* kSources[] = { "registro", "variavel", "alarme", "alarmes ativos" };
+        for (uint8_t m = 0; m < slaveConfig->mapCount; m++) {
+            const SlaveMapEntry& entry = slaveConfig->map[m];
+            String origin = kSources[entry.source];
+            if (entry.source == SLAVE_SOURCE_REGISTER) {
+                origin += " Dev " + String(entry.slaveAddress) + " Reg " + String(entry.registerAddress);
+            } else if (entry.source == SLAVE_SOURCE_VARIABLE) {
+                origin += " " + String(entry.variable);
+            } else if (entry.source == SLAVE_SOURCE_ALARM) {
+                origin += " " + String(entry.alarm);
+            }
+            client->text("  " + String(entry.address) + " <- " + origin + " (" + String(registerDataTypeName(entry.dataType)) +
+                         ", x" + String(entry.scale, 2) + ")\r\n");
+        }
+        delete slaveConfig;
+        client->text("Requisicoes: " + String(stats.requests) + ", respostas: " + String(stats.replies) +
+                     ", excecoes: " + String(stats.exceptions) + ", CRC: " + String(stats.crcErrors) +
+                     ", outros enderecos: " + String(stats.otherAddress) + "\r\n");
+        client->text("Tempo de resposta: ultimo " + String(stats.lastReplyUs) + " us, max " + String(stats.maxReplyUs) + " us\r\n");
+    }
+    else if (command == "capture" || command == "capture clear" || command == "capture trigger") {
+        BusCaptureStatus status;
+        busCaptureGetStatus(&status);
+        if (command == "capture clear") {
+            busCaptureClear();
+            client->text("Captura limpa (gatilho rearmado)\r\n");
+            return;
+        }
+        if (command == "capture trigger") {
+            busCaptureConfigure(status.enabled, !status.trigger);
+            busCaptureClear();
+            client->text(String("Modo gatilho: ") + (!status.trigger ? "Habilitado" : "Desabilitado") + "\r\n");
+            return;
+        }
+        client->text("=== Captura do barramento ===\r\n");
+        client->text(String("Captura: ") + (status.enabled ? "Habilitada" : "Desabilitada") +
+                     (status.suspended ? " (suspensa)" : "") + ", gatilho: " + (status.trigger ? "Habilitado" : "Desabilitado") +
+                     (status.frozen ? String(", CONGELADA (") + ((status.triggerFlags & BUS_CAPTURE_FLAG_CRC_ERROR) ? "CRC" : "sem resposta") + ")" : String("")) + "\r\n");
+        client->text("Quadros: " + String(status.frames) + " (" + String(status.bytesUsed) + "/" + String(CAPTURE_RING_BYTES) +
+                     " bytes, " + String((status.newestUs - status.oldestUs) / 1000.0f, 0) + " ms), capturados " + String(status.captured) +
+                     ", descartados " + String(status.overwritten) + "\r\n");
+        client->text("Erros de CRC: " + String(status.crcErrors) + ", sem resposta: " + String(status.noReply) + "\r\n");
+        BusCaptureFrame* frame = new BusCaptureFrame;
+        for (int k = 7; k >= 0; k--) {
+            if (!busCaptureGetFrame(k, frame)) {
+                continue;
+            }
+            String line = String(frame->direction == BUS_CAPTURE_DIR_TX ? "  TX" : "  RX") + " -" +
+                          String((monotonicMicros() - frame->timeUs) / 1000.0f, 1) + " ms:";
+            uint16_t shown = frame->length < 24 ? frame->length : 24;
+            for (uint16_t b = 0; b < shown; b++) {
+                char hex[4];
+                snprintf(hex, sizeof(hex), " %02X", frame->data[b]);
+                line += hex;
+            }
+            if (shown < frame->length) {
+                line += " ..";
+            }
+            if (frame->flags & BUS_CAPTURE_FLAG_CRC_ERROR) {
+                line += " [CRC]";
+            }
+            if (frame->flags & BUS_CAPTURE_FLAG_NO_REPLY) {
+                line += " [sem resposta]";
+            }
+            client->text(line + "\r\n");
+        }
+        delete frame;
+    }
+    else if (command == "bcast") {
+        BroadcastStats stats;
+        modbusBroadcastGetStats(&stats);
+        client->text("=== Broadcast e escritas sincronizadas ===\r\n");
+        client->text(String("Modo sincronizado: ") + (config.syncWrites ? "Habilitado" : "Desabilitado") +
+                     ", turnaround " + String(MODBUS_BROADCAST_TURNAROUND_MS) + " ms\r\n");
+        client->text("Broadcasts: " + String(stats.broadcasts) + "\r\n");
+        client->text("Na lista: " + String(stats.staged) + " (substituidas " + String(stats.merged) + ", lista cheia " +
+                     String(stats.overflow) + ")\r\n");
+        client->text("Envios: " + String(stats.flushes) + " (erros " + String(stats.flushErrors) + "), ultimo: " +
+                     String(stats.lastFlushWrites) + " escritas em " + String(stats.lastFlushUs / 1000.0f, 1) + " ms\r\n");
+        uint32_t displayWrites, displaySkipped;
+        getDisplayWriteStats(&displayWrites, &displaySkipped);
+        client->text("display(): " + String(displayWrites) + " escritas, " + String(displaySkipped) + " sem mudanca\r\n");
+    }
+    else if (command == "script" || command.startsWith("script ")) {
+        // 0 = código principal; "script N" detalha o script nomeado N
+        int index = command == "script" ? 0 : command.substring(7).toInt();
+        ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+        uint8_t count = scriptGetDefinitions(definitions, SCRIPT_MAX_SCRIPTS);
+        ScriptStats* stats = new ScriptStats;
+        if (index < 0 || index > count || !scriptGetStats(index, stats)) {
+            client->text("Script inexistente (1 a " + String(count) + ")\r\n");
+        } else {
+            client->text(index == 0 ? String("=== Codigo de calculo ===\r\n") :
+                         "=== Script " + String(definitions[index - 1].name) + " (prioridade " +
+                         String(definitions[index - 1].priority) + ") ===\r\n");
+            client->text("Fatia: " + (config.scriptSliceMs > 0 ? String(config.scriptSliceMs) + " ms" : String("sem limite")) +
+                         ", ciclo " + String(CALCULATION_INTERVAL_MS) + " ms" + (stats->running ? " (em execucao)" : "") + "\r\n");
+            client->text("Execucoes: " + String(stats->runs) + ", disparos com a anterior em andamento: " + String(stats->lateTicks) +
+                         ", interrompido " + String(stats->preemptions) + " vezes\r\n");
+            client->text("Espera do disparo ao inicio: " + String(stats->lastWaitUs / 1000.0f, 2) + " ms (max " +
+                         String(stats->maxWaitUs / 1000.0f, 2) + " ms)\r\n");
+            client->text("Ultima: " + String(stats->lastRunUs / 1000.0f, 2) + " ms em " + String(stats->lastSlices) + " fatias (" +
+                         String(stats->lastSpanMs) + " ms do inicio ao fim); maior: " + String(stats->maxRunUs / 1000.0f, 2) +
+                         " ms, " + String(stats->maxSlices) + " fatias, fatia mais longa " + String(stats->maxSliceUs / 1000.0f, 2) + " ms\r\n");
+            client->text("Compilacao: " + String(stats->compile.compiledLines) + " linhas compiladas, " +
+                         String(stats->compile.interpretedLines) + " interpretadas, " + String(stats->compile.deadAssignments) +
+                         " eliminadas; " + String(stats->compile.ops) + " operacoes (" + String(stats->compile.folded) +
+                         " dobradas, " + String(stats->compile.shared) + " compartilhadas, " + String(stats->compile.reduced) +
+                         " reduzidas)\r\n");
+            for (uint8_t k = 0; k < stats->lineCount; k++) {
+                const char* mode = stats->lines[k].mode == SCRIPT_LINE_COMPILED ? "compilada" :
+                                   stats->lines[k].mode == SCRIPT_LINE_DEAD ? "eliminada" : "interpretada";
+                client->text("  linha " + String(stats->lines[k].line) + " (" + mode + "): " +
+                             String(stats->lines[k].lastUs / 1000.0f, 2) + " ms (max " +
+                             String(stats->lines[k].maxUs / 1000.0f, 2) + " ms)\r\n");
+            }
+            if (index == 0) {
+                for (uint8_t k = 0; k < count; k++) {
+                    scriptGetStats(k + 1, stats);
+                    client->text("  [" + String(k + 1) + "] " + String(definitions[k].name) +
+                                 (definitions[k].enabled ? "" : " (desabilitado)") + ": prioridade " + String(definitions[k].priority) +
+                                 ", " + String(stats->runs) + " execucoes, maior " + String(stats->maxRunUs / 1000.0f, 2) +
+                                 " ms, espera max " + String(stats->maxWaitUs / 1000.0f, 2) + " ms\r\n");
+                }
+            }
+        }
+        delete stats;
+        delete[] definitions;
+    }
+    else if (command == "bits") {
+        BitStats stats;
+        bitGetStats(&stats);
+        client->text("=== Bobinas e entradas discretas ===\r\n");
+        BitBlock* blocks = new BitBlock[MODBUS_BITS_MAX_BLOCKS];
+        for (int i = 0; i < config.deviceCount; i++) {
+            uint8_t blockCount = bitPlanBlocks(i, blocks, MODBUS_BITS_MAX_BLOCKS);
+            if (blockCount == 0) {
+                continue;
+            }
+            String msg = "Dev " + String(config.devices[i].slaveAddress) + ":";
+            for (uint8_t b = 0; b < blockCount; b++) {
+                msg += " 0x0" + String(blocks[b].function) + " " + String(blocks[b].start) + "+" + String(blocks[b].count);
+            }
+            client->text(msg + "\r\n");
+            for (int j = 0; j < config.devices[i].registerCount; j++) {
+                const ModbusRegister& reg = config.devices[i].registers[j];
+                if (!isBitRegister(reg)) {
+                    continue;
+                }
+                client->text(String("  ") + (reg.registerType == REGISTER_TYPE_COIL ? "Bobina " : "Entrada ") +
+                             String(reg.address) + " = " + String(bitGet(i, j) ? 1 : 0) + "\r\n");
+            }
+        }
+        delete[] blocks;
+        client->text("Leituras: " + String(stats.readTransactions) + " (erros " + String(stats.readErrors) + "), bits lidos: " +
+                     String(stats.bitsRead) + ", mudancas: " + String(stats.changes) + "\r\n");
+        client->text("Escritas: " + String(stats.writeTransactions) + " (erros " + String(stats.writeErrors) + "), bits escritos: " +
+                     String(stats.bitsWritten) + "\r\n");
+    }
+    else if (command == "psychro" || command == "psychro fit") {
+        if (command == "psychro fit") {
+            PsychroFitResult fit;
+            if (!psychroCalibrate(&fit)) {
+                client->text("Ajuste falhou (" + String(fit.pointCount) + " pontos; minimo " + String(PSYCHRO_MIN_POINTS) + ")\r\n");
+            } else {
+                psychroSave();
+            }
+        }
+        PsychroConstants constants;
+        psychroGetConstants(&constants);
+        client->text("=== Psicrometria ===\r\n");
+        client->text("A=" + String(constants.a, 6) + " B=" + String(constants.b, 6) +
+                     " C=" + String(constants.c, 6) + " D=" + String(constants.d, 6) + "\r\n");
+        PsychroPoint points[PSYCHRO_MAX_POINTS];
+        uint8_t count = psychroGetPoints(points, PSYCHRO_MAX_POINTS);
+        for (uint8_t k = 0; k < count; k++) {
+            client->text("  TS=" + String(points[k].ts, 2) + " TU=" + String(points[k].tu, 2) + " UR=" + String(points[k].ur, 2) +
+                         " calc=" + String(psychroRelativeHumidity(points[k].ts, points[k].tu, &constants), 2) + "\r\n");
+        }
+        PsychroFitResult fit;
+        psychroGetLastFit(&fit);
+        if (fit.pointCount > 0) {
+            client->text("Ultimo ajuste: " + String(fit.success ? "ok" : "falhou") + ", RMS " + String(fit.rmsError, 3) +
+                         "%, max " + String(fit.maxError, 3) + "%, " + String(fit.iterations) + " iteracoes, " + String(fit.elapsedUs) + " us\r\n");
+        }
+    }
+    else if (command == "queue") {
+        ModbusQueueStats stats;
+        modbusQueueGetStats(&stats);
+        client->text("=== Fila de escrita Modbus ===\r\n");
+        client->text("Pendentes: " + String(stats.pending) + ", executadas: " + String(stats.executed) +
+                     ", falhas: " + String(stats.failed) + ", recusadas (fila cheia): " + String(stats.rejected) + "\r\n");
+        client->text("Espera na fila: ultima " + String(stats.lastWaitUs / 1000.0f, 1) + " ms, max " +
+                     String(stats.maxWaitUs / 1000.0f, 1) + " ms\r\n");
+    }
+    else if (command == "pid") {
+        PidBlock* blocks = new PidBlock[PID_MAX_BLOCKS];
+        uint8_t count = pidGetBlocks(blocks, PID_MAX_BLOCKS);
+        client->text("=== PID (" + String(count) + " blocos) ===\r\n");
+        for (uint8_t b = 0; b < count; b++) {
+            PidStatus status;
+            pidGetStatus(b, &status);
+            String label = strlen(blocks[b].name) > 0 ? String(blocks[b].name) : "PID " + String(b);
+            client->text(label + (blocks[b].enabled ? (blocks[b].manual ? " [manual]" : " [auto]") : " [desabilitado]") +
+                         " PV=" + String(status.processValue, 3) + " SP=" + String(blocks[b].setpoint, 3) +
+                         " OUT=" + String(status.output, 3) + "\r\n");
+            client->text("  Execucoes: " + String(status.runs) + ", atrasos: " + String(status.overruns) +
+                         ", erros leitura/escrita: " + String(status.readErrors) + "/" + String(status.writeErrors) + "\r\n");
+            client->text("  Jitter: " + String(status.meanJitterUs / 1000.0f, 1) + " ms (max " + String(status.maxJitterUs / 1000.0f, 1) +
+                         "), latencia: " + String(status.meanLatencyUs / 1000.0f, 1) + " ms (max " + String(status.maxLatencyUs / 1000.0f, 1) + ")\r\n");
+        }
+        delete[] blocks;
+    }
+    else if (command == "rules") {
+        ReactiveRule* rules = new ReactiveRule[RULE_MAX_RULES];
+        uint8_t count = ruleGetRules(rules, RULE_MAX_RULES);
+        client->text("=== Regras de reacao (" + String(count) + ") ===\r\n");
+        for (uint8_t r = 0; r < count; r++) {
+            RuleStatus status;
+            ruleGetStatus(r, &status);
+            String label = strlen(rules[r].name) > 0 ? String(rules[r].name) : "Regra " + String(r);
+            client->text(label + (rules[r].enabled ? (status.tripped ? " [disparada]" : " [normal]") : " [desabilitada]") +
+                         " Dev " + String(rules[r].inputSlave) + " Reg " + String(rules[r].inputRegister) + " = " +
+                         String(status.lastValue, 2) + (rules[r].below ? " <= " : " >= ") + String(rules[r].threshold, 2) +
+                         " -> Dev " + String(rules[r].outputSlave) + " Reg " + String(rules[r].outputRegister) + "\r\n");
+            client->text("  Disparos: " + String(status.trips) + ", escritas: " + String(status.writes) +
+                         ", erros: " + String(status.writeErrors) + "\r\n");
+            client->text("  Latencia: " + String(status.meanLatencyUs / 1000.0f, 1) + " ms (max " + String(status.maxLatencyUs / 1000.0f, 1) +
+                         ", ultima " + String(status.lastLatencyUs / 1000.0f, 1) + ", fila " + String(status.lastQueueWaitUs / 1000.0f, 1) + ")\r\n");
+        }
+        delete[] rules;
+    }
+    else if (command == "log" || command == "log flush") {
+        if (command == "log flush") {
+            dataLoggerFlush();
+            client->text("Blocos pendentes gravados.\r\n");
+        }
+        DataLogStats stats;
+        dataLoggerGetStats(&stats);
+        client->text("=== Historico ===\r\n");
+        if (!stats.ready) {
+            client->text("Logger inativo (LittleFS nao montado)\r\n");
+            return;
+        }
+        client->text("Segmentos: " + String(stats.firstSegment) + ".." + String(stats.currentSegment) +
+                     " (atual: " + String(stats.currentSegmentBytes) + " bytes)\r\n");
+        client->text("Canais ativos: " + String(stats.activeChannels) + "\r\n");
+        client->text("Amostras: " + String(stats.samplesLogged) + " (descartadas: " + String(stats.samplesDropped) + ")\r\n");
+        client->text("Blocos gravados: " + String(stats.blocksWritten) + ", na fila: " + String(stats.queuedBlocks) +
+                     ", descartados: " + String(stats.blocksDropped) + ", erros: " + String(stats.writeErrors) + "\r\n");
+        client->text("Rollups (10s/1min/15min): " + String(rollupRecordCount()) + " registros\r\n");
+        client->text("Gravacao: ultima " + String(stats.lastFlushMicros) + " us, maxima " + String(stats.maxFlushMicros) + " us\r\n");
+        if (stats.recoveredTornSegment) {
+            client->text("Segmento incompleto recuperado na inicializacao\r\n");
+        }
+    }
+    else if (command == "log bench") {
+        client->text("Recodificando historico registrado...\r\n");
+        DataLogBenchResult bench;
+        dataLoggerBenchmark(20000, &bench);
+        if (bench.samples == 0) {
+            client->text("Nenhuma amostra registrada ainda.\r\n");
+            return;
+        }
+        float ratio = bench.encodedBytes > 0 ? (float)bench.rawBytes / (float)bench.encodedBytes : 0.0f;
+        client->text("Amostras: " + String(bench.samples) + " em " + String(bench.blocks) + " blocos\r\n");
+        client->text("Bytes: " + String(bench.encodedBytes) + " codificados vs " + String(bench.rawBytes) +
+                     " (timestamp 8 + float 4), razao " + String(ratio, 2) + "x, " +
+                     String((float)bench.encodedBytes / bench.samples, 2) + " bytes/amostra\r\n");
+        client->text("Codificacao: " + String(bench.encodeMicros * 1000.0f / bench.samples, 0) + " ns/amostra, " +
+                     "decodificacao: " + String(bench.decodeMicros * 1000.0f / bench.samples, 0) + " ns/amostra\r\n");
+        client->text(String("Ida e volta: ") + (bench.roundTripOk ? "OK" : "FALHA") + "\r\n");
+    }
     else {
         client->text("Comando desconhecido. Digite 'help' para ver comandos disponiveis.\r\n");
     }
@@ -0,0 +1,940 @@
+/**
+ * @file data_logger.cpp
+ * @brief Implementação do registro histórico em segmentos rotativos no LittleFS
+ */
+
+#include "data_logger.h"
+#include "data_rollup.h"
+#include "rtc_manager.h"
+#include "console.h"
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static_assert(sizeof(DataLogBlockHeader) == 32, "DataLogBlockHeader deve ter 32 bytes");
+static_assert(sizeof(DataLogRawSample) == 8, "DataLogRawSample deve ter 8 bytes");
+static_assert(DATALOG_SEGMENT_SIZE % DATALOG_BLOCK_SIZE == 0, "Segmento deve conter blocos inteiros");
+
+/**
+ * @struct DataLogChannel
+ * @brief Bloco aberto (em preenchimento) de um canal
+ */
+struct DataLogChannel {
+    bool used;
+    uint8_t slaveAddress;
+    uint16_t registerAddress;
+    unsigned long openedAtMillis;  // Quando a primeira amostra do bloco chegou
+    unsigned long lastAppendMillis;  // Última amostra recebida (libera canais parados)
+    TsEncoder encoder;             // Estado do codificador do bloco aberto
+    uint8_t block[DATALOG_BLOCK_SIZE];
+};
+
+// Estado do módulo
+static DataLogChannel s_channels[DATALOG_MAX_CHANNELS];
+static uint8_t s_queue[DATALOG_WRITE_QUEUE_BLOCKS][DATALOG_BLOCK_SIZE];
+static uint8_t s_queueHead = 0;
+static uint8_t s_queueCount = 0;
+static uint32_t s_poppedSeq = 0;       // Blocos já retirados da fila (sequência absoluta)
+
+/**
+ * @struct DataLogStore
+ * @brief Conjunto rotativo de arquivos de segmento
+ */
+struct DataLogStore {
+    const char* prefix;        // Ex: "/dl_"
+    uint32_t segmentSize;
+    uint8_t maxSegments;
+    uint32_t firstSeq;         // Segmento mais antigo existente
+    uint32_t currentSeq;       // Segmento em gravação
+    uint32_t currentBytes;     // Bytes gravados no segmento atual
+};
+static DataLogStore s_stores[DATALOG_STORE_COUNT];
+static DataLogStats s_stats;
+static SemaphoreHandle_t s_logMutex = nullptr;
+
+// Garante que o mutex do logger exista antes de usar
+static inline bool ensureLogMutex() {
+    if (s_logMutex == nullptr) {
+        s_logMutex = xSemaphoreCreateMutex();
+    }
+    return (s_logMutex != nullptr);
+}
+
+static inline bool lockLog(TickType_t ticks) {
+    return ensureLogMutex() && xSemaphoreTake(s_logMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockLog() {
+    xSemaphoreGive(s_logMutex);
+}
+
+static inline DataLogBlockHeader* headerOf(uint8_t* block) {
+    return (DataLogBlockHeader*)block;
+}
+
+static void segmentPath(const DataLogStore* store, uint32_t seq, char* path, size_t size) {
+    snprintf(path, size, "%s%06lu" DATALOG_FILE_SUFFIX, store->prefix, (unsigned long)seq);
+}
+
+// Store de destino de um bloco (blocos antigos têm store = 0: brutos)
+static inline DataLogStore* storeOf(const uint8_t* block) {
+    uint8_t store = ((const DataLogBlockHeader*)block)->store;
+    return &s_stores[store < DATALOG_STORE_COUNT ? store : DATALOG_STORE_RAW];
+}
+
+/**
+ * @brief CRC16 Modbus (polinômio 0xA001), o mesmo usado no barramento
+ */
+static uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+// CRC do bloco inteiro com o campo crc zerado (padding também é coberto)
+static uint16_t blockCrc(const uint8_t* block) {
+    DataLogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    header.crc = 0;
+    uint16_t crc = crc16((const uint8_t*)&header, sizeof(header));
+    return crc16(block + sizeof(header), DATALOG_PAYLOAD_SIZE, crc);
+}
+
+static bool blockIsValid(const uint8_t* block) {
+    const DataLogBlockHeader* header = (const DataLogBlockHeader*)block;
+    if (header->magic != DATALOG_BLOCK_MAGIC || header->version != DATALOG_BLOCK_VERSION) {
+        return false;
+    }
+    if (header->payloadBytes > DATALOG_PAYLOAD_SIZE || header->sampleCount == 0) {
+        return false;
+    }
+    return blockCrc(block) == header->crc;
+}
+
+int64_t dataLoggerTimeMs(int64_t monotonicUs, bool* utc) {
+    int64_t utcUs = monotonicToUtcMicros(monotonicUs);
+    if (utcUs > 0) {
+        *utc = true;
+        return utcUs / 1000;
+    }
+    *utc = false;
+    return monotonicUs / 1000;
+}
+
+int64_t dataLoggerNowMs(bool* utc) {
+    return dataLoggerTimeMs(monotonicMicros(), utc);
+}
+
+void dataLoggerEnqueueBlock(uint8_t* block) {
+    DataLogBlockHeader* header = headerOf(block);
+    if (header->sampleCount == 0) {
+        return;
+    }
+
+    header->crc = 0;
+    header->crc = blockCrc(block);
+
+    if (s_queueCount >= DATALOG_WRITE_QUEUE_BLOCKS) {
+        // Flash não está acompanhando (ou falhando): descarta o bloco novo
+        s_stats.blocksDropped++;
+        return;
+    }
+    uint8_t slot = (s_queueHead + s_queueCount) % DATALOG_WRITE_QUEUE_BLOCKS;
+    memcpy(s_queue[slot], block, DATALOG_BLOCK_SIZE);
+    s_queueCount++;
+}
+
+// Fecha o bloco do canal e o coloca na fila de gravação (chamar com mutex)
+static void sealChannel(DataLogChannel* channel) {
+    dataLoggerEnqueueBlock(channel->block);
+    memset(channel->block, 0, DATALOG_BLOCK_SIZE);
+}
+
+// Apaga segmentos antigos até respeitar o limite do store
+static void enforceSegmentLimit(DataLogStore* store) {
+    char path[24];
+    while (store->currentSeq - store->firstSeq + 1 > store->maxSegments) {
+        segmentPath(store, store->firstSeq, path, sizeof(path));
+        if (LittleFS.exists(path)) {
+            LittleFS.remove(path);
+        }
+        store->firstSeq++;
+    }
+}
+
+// Grava um bloco no segmento atual do seu store (chamar com mutex)
+static bool writeBlock(const uint8_t* block) {
+    DataLogStore* store = storeOf(block);
+    if (store->currentBytes + DATALOG_BLOCK_SIZE > store->segmentSize) {
+        store->currentSeq++;
+        store->currentBytes = 0;
+        enforceSegmentLimit(store);
+    }
+
+    char path[24];
+    segmentPath(store, store->currentSeq, path, sizeof(path));
+    File file = LittleFS.open(path, "a");
+    if (!file) {
+        return false;
+    }
+    size_t written = file.write(block, DATALOG_BLOCK_SIZE);
+    file.close();
+
+    if (written != DATALOG_BLOCK_SIZE) {
+        // CRÍTICO: append parcial quebra o alinhamento; continua em segmento novo
+        store->currentSeq++;
+        store->currentBytes = 0;
+        enforceSegmentLimit(store);
+        return false;
+    }
+
+    store->currentBytes += DATALOG_BLOCK_SIZE;
+    return true;
+}
+
+/**
+ * @brief Localiza segmentos existentes e decide onde continuar gravando
+ */
+static void scanSegments(DataLogStore* store) {
+    uint32_t minSeq = 0;
+    uint32_t maxSeq = 0;
+    size_t prefixLen = strlen(store->prefix) - 1;  // Sem a barra inicial
+
+    File root = LittleFS.open("/");
+    if (root && root.isDirectory()) {
+        File entry = root.openNextFile();
+        while (entry) {
+            const char* name = entry.name();
+            if (name[0] == '/') name++;  // Algumas versões do core retornam o caminho completo
+            if (!entry.isDirectory() && strncmp(name, store->prefix + 1, prefixLen) == 0) {
+                uint32_t seq = strtoul(name + prefixLen, nullptr, 10);
+                if (seq > 0) {
+                    if (minSeq == 0 || seq < minSeq) minSeq = seq;
+                    if (seq > maxSeq) maxSeq = seq;
+                }
+            }
+            entry.close();
+            entry = root.openNextFile();
+        }
+        root.close();
+    }
+
+    if (maxSeq == 0) {
+        store->firstSeq = 1;
+        store->currentSeq = 1;
+        store->currentBytes = 0;
+        return;
+    }
+
+    store->firstSeq = minSeq;
+    store->currentSeq = maxSeq;
+    store->currentBytes = 0;
+
+    char path[24];
+    segmentPath(store, maxSeq, path, sizeof(path));
+    File last = LittleFS.open(path, "r");
+    if (last) {
+        size_t size = last.size();
+        bool torn = (size % DATALOG_BLOCK_SIZE) != 0;
+        if (!torn && size >= DATALOG_BLOCK_SIZE) {
+            // Verifica o último bloco: queda de energia no meio do append
+            static uint8_t tail[DATALOG_BLOCK_SIZE];
+            last.seek(size - DATALOG_BLOCK_SIZE);
+            torn = last.read(tail, DATALOG_BLOCK_SIZE) != DATALOG_BLOCK_SIZE || !blockIsValid(tail);
+        }
+        last.close();
+
+        if (torn) {
+            // Não reescreve o segmento: leitores ignoram o trecho inválido
+            store->currentSeq = maxSeq + 1;
+            s_stats.recoveredTornSegment = true;
+        } else {
+            store->currentBytes = size;
+        }
+    }
+
+    enforceSegmentLimit(store);
+}
+
+bool dataLoggerInit() {
+    if (!ensureLogMutex()) {
+        return false;
+    }
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_channels, 0, sizeof(s_channels));
+    s_queueHead = 0;
+    s_queueCount = 0;
+    s_poppedSeq = 0;
+    rollupReset();
+
+    s_stores[DATALOG_STORE_RAW].prefix = DATALOG_FILE_PREFIX;
+    s_stores[DATALOG_STORE_RAW].segmentSize = DATALOG_SEGMENT_SIZE;
+    s_stores[DATALOG_STORE_RAW].maxSegments = DATALOG_MAX_SEGMENTS;
+    for (uint8_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+        DataLogStore* store = &s_stores[DATALOG_STORE_ROLLUP_FIRST + level];
+        store->prefix = ROLLUP_LEVELS[level].filePrefix;
+        store->segmentSize = ROLLUP_SEGMENT_SIZE;
+        store->maxSegments = ROLLUP_LEVELS[level].maxSegments;
+    }
+    for (uint8_t i = 0; i < DATALOG_STORE_COUNT; i++) {
+        scanSegments(&s_stores[i]);
+    }
+    s_stats.ready = true;
+
+    const DataLogStore* raw = &s_stores[DATALOG_STORE_RAW];
+    String logMsg = "[Logger] Segmentos " + String(raw->firstSeq) + ".." + String(raw->currentSeq) +
+                    ", atual com " + String(raw->currentBytes) + " bytes";
+    if (s_stats.recoveredTornSegment) {
+        logMsg += " (ultimo segmento incompleto ignorado)";
+    }
+    logMsg += "\r\n";
+    consolePrint(logMsg);
+    return true;
+}
+
+// Prepara o cabeçalho e o codificador de um bloco vazio
+static void openBlock(DataLogChannel* channel, uint8_t encoding, uint8_t flags, int64_t timeMs) {
+    DataLogBlockHeader* header = headerOf(channel->block);
+    header->magic = DATALOG_BLOCK_MAGIC;
+    header->version = DATALOG_BLOCK_VERSION;
+    header->encoding = encoding;
+    header->slaveAddress = channel->slaveAddress;
+    header->flags = flags;
+    header->registerAddress = channel->registerAddress;
+    header->firstTimeMs = timeMs;
+    header->lastTimeMs = timeMs;
+    tsEncoderInit(&channel->encoder, encoding, timeMs);
+    channel->openedAtMillis = millis();
+}
+
+void dataLoggerAppend(uint8_t slaveAddress, uint16_t registerAddress, int64_t sampleTimeUs, float value, bool integer) {
+    if (!s_stats.ready || !lockLog(pdMS_TO_TICKS(10))) {
+        s_stats.samplesDropped++;
+        return;
+    }
+
+    bool utc = false;
+    int64_t timeMs = dataLoggerTimeMs(sampleTimeUs, &utc);
+    uint8_t flags = utc ? DATALOG_FLAG_UTC : 0;
+    uint8_t encoding = (integer && tsIsIntegral(value)) ? DATALOG_ENCODING_DELTA_VARINT : DATALOG_ENCODING_GORILLA;
+
+    // Procura o canal (ou um livre)
+    DataLogChannel* channel = nullptr;
+    DataLogChannel* freeChannel = nullptr;
+    for (int i = 0; i < DATALOG_MAX_CHANNELS; i++) {
+        if (s_channels[i].used) {
+            if (s_channels[i].slaveAddress == slaveAddress && s_channels[i].registerAddress == registerAddress) {
+                channel = &s_channels[i];
+                break;
+            }
+        } else if (freeChannel == nullptr) {
+            freeChannel = &s_channels[i];
+        }
+    }
+    if (channel == nullptr) {
+        if (freeChannel == nullptr) {
+            s_stats.samplesDropped++;
+            unlockLog();
+            return;
+        }
+        channel = freeChannel;
+        memset(channel, 0, sizeof(DataLogChannel));
+        channel->used = true;
+        channel->slaveAddress = slaveAddress;
+        channel->registerAddress = registerAddress;
+    }
+
+    DataLogBlockHeader* header = headerOf(channel->block);
+
+    // Fecha o bloco se a base de tempo mudou (NTP/ajuste manual) ou se o
+    // registro deixou de ser inteiro (gain/offset alterados)
+    if (header->sampleCount > 0) {
+        bool timeBaseChanged = header->flags != flags || timeMs < header->lastTimeMs;
+        if (timeBaseChanged || header->encoding != encoding) {
+            sealChannel(channel);
+        }
+    }
+
+    if (header->sampleCount == 0) {
+        openBlock(channel, encoding, flags, timeMs);
+    }
+
+    uint8_t* payload = channel->block + sizeof(DataLogBlockHeader);
+    if (!tsEncoderAppend(&channel->encoder, payload, DATALOG_PAYLOAD_SIZE, timeMs, value)) {
+        // Bloco cheio: fecha e recomeça (a primeira amostra sempre cabe)
+        sealChannel(channel);
+        openBlock(channel, encoding, flags, timeMs);
+        tsEncoderAppend(&channel->encoder, payload, DATALOG_PAYLOAD_SIZE, timeMs, value);
+    }
+    header->payloadBytes = tsEncoderBytes(&channel->encoder);
+    header->sampleCount = channel->encoder.count;
+    header->lastTimeMs = timeMs;
+    channel->lastAppendMillis = millis();
+    s_stats.samplesLogged++;
+
+    rollupAddSample((uint8_t)(channel - s_channels), slaveAddress, registerAddress, timeMs, flags, value);
+
+    unlockLog();
+}
+
+/**
+ * @brief Grava até maxBlocks blocos da fila
+ *
+ * O loop principal é o único que adiciona amostras e grava blocos, então
+ * manter o mutex durante a escrita não atrasa a aquisição; apenas leitores
+ * (tasks do servidor web) esperam, e assim enxergam fila e arquivo consistentes.
+ */
+static void writePending(uint8_t maxBlocks) {
+    uint8_t written = 0;
+    while (written < maxBlocks) {
+        if (!lockLog(pdMS_TO_TICKS(50))) {
+            return;
+        }
+        if (s_queueCount == 0) {
+            unlockLog();
+            return;
+        }
+
+        unsigned long startMicros = micros();
+        bool ok = writeBlock(s_queue[s_queueHead]);
+        uint32_t elapsed = (uint32_t)(micros() - startMicros);
+
+        if (ok) {
+            s_queueHead = (s_queueHead + 1) % DATALOG_WRITE_QUEUE_BLOCKS;
+            s_queueCount--;
+            s_poppedSeq++;
+            s_stats.blocksWritten++;
+        } else {
+            // Mantém o bloco na fila para tentar de novo na próxima chamada
+            s_stats.writeErrors++;
+        }
+        s_stats.lastFlushMicros = elapsed;
+        if (elapsed > s_stats.maxFlushMicros) {
+            s_stats.maxFlushMicros = elapsed;
+        }
+        unlockLog();
+
+        if (!ok) {
+            return;
+        }
+        written++;
+        yield();
+    }
+}
+
+void dataLoggerService() {
+    if (!s_stats.ready) {
+        return;
+    }
+
+    // Fecha blocos parciais antigos para limitar a perda em queda de energia
+    if (lockLog(pdMS_TO_TICKS(10))) {
+        unsigned long now = millis();
+        for (int i = 0; i < DATALOG_MAX_CHANNELS; i++) {
+            DataLogChannel* channel = &s_channels[i];
+            if (!channel->used) {
+                continue;
+            }
+            if (headerOf(channel->block)->sampleCount > 0 &&
+                now - channel->openedAtMillis >= DATALOG_SEAL_INTERVAL_MS) {
+                sealChannel(channel);
+            }
+            // Libera canais parados: registros removidos da configuração não ocupam vaga
+            if (now - channel->lastAppendMillis >= 2UL * DATALOG_SEAL_INTERVAL_MS) {
+                sealChannel(channel);
+                rollupCloseChannel(i);
+                channel->used = false;
+            }
+        }
+
+        bool utc = false;
+        int64_t timeMs = dataLoggerNowMs(&utc);
+        rollupService(timeMs, utc ? DATALOG_FLAG_UTC : 0, false);
+        unlockLog();
+    }
+
+    writePending(DATALOG_MAX_BLOCKS_PER_SERVICE);
+}
+
+void dataLoggerFlush() {
+    if (!s_stats.ready) {
+        return;
+    }
+
+    if (lockLog(pdMS_TO_TICKS(100))) {
+        for (int i = 0; i < DATALOG_MAX_CHANNELS; i++) {
+            if (s_channels[i].used) {
+                sealChannel(&s_channels[i]);
+            }
+        }
+        bool utc = false;
+        int64_t timeMs = dataLoggerNowMs(&utc);
+        rollupService(timeMs, utc ? DATALOG_FLAG_UTC : 0, true);
+        unlockLog();
+    }
+
+    writePending(DATALOG_WRITE_QUEUE_BLOCKS);
+}
+
+void dataLoggerGetStats(DataLogStats* stats) {
+    if (!lockLog(pdMS_TO_TICKS(50))) {
+        memset(stats, 0, sizeof(DataLogStats));
+        return;
+    }
+    *stats = s_stats;
+    stats->firstSegment = s_stores[DATALOG_STORE_RAW].firstSeq;
+    stats->currentSegment = s_stores[DATALOG_STORE_RAW].currentSeq;
+    stats->currentSegmentBytes = s_stores[DATALOG_STORE_RAW].currentBytes;
+    stats->queuedBlocks = s_queueCount;
+    uint8_t active = 0;
+    for (int i = 0; i < DATALOG_MAX_CHANNELS; i++) {
+        if (s_channels[i].used) active++;
+    }
+    stats->activeChannels = active;
+    unlockLog();
+}
+
+// ==================== LEITURA ====================
+
+static void beginBlockDecode(const uint8_t* block, TsDecoder* decoder) {
+    const DataLogBlockHeader* header = (const DataLogBlockHeader*)block;
+    tsDecoderInit(decoder, header->encoding, header->firstTimeMs);
+}
+
+// Decodifica a amostra index do bloco (amostras codificadas: em sequência)
+static bool decodeBlockSample(const uint8_t* block, uint16_t index, TsDecoder* decoder, DataLogSample* sample) {
+    const DataLogBlockHeader* header = (const DataLogBlockHeader*)block;
+    const uint8_t* payload = block + sizeof(DataLogBlockHeader);
+
+    sample->slaveAddress = header->slaveAddress;
+    sample->registerAddress = header->registerAddress;
+    sample->utc = (header->flags & DATALOG_FLAG_UTC) != 0;
+    sample->count = 1;
+
+    if (header->encoding == DATALOG_ENCODING_ROLLUP) {
+        RollupRecord record;
+        memcpy(&record, payload + index * sizeof(RollupRecord), sizeof(record));
+        sample->timeMs = header->firstTimeMs + record.offsetMs;
+        sample->value = record.meanValue;
+        sample->minValue = record.minValue;
+        sample->maxValue = record.maxValue;
+        sample->count = record.count;
+        sample->slaveAddress = record.slaveAddress;
+        sample->registerAddress = record.registerAddress;
+        return true;
+    }
+
+    if (header->encoding == DATALOG_ENCODING_RAW) {
+        DataLogRawSample raw;
+        memcpy(&raw, payload + index * sizeof(DataLogRawSample), sizeof(raw));
+        sample->timeMs = header->firstTimeMs + raw.offsetMs;
+        sample->value = raw.value;
+    } else if (!tsDecoderNext(decoder, payload, header->payloadBytes, &sample->timeMs, &sample->value)) {
+        return false;
+    }
+    sample->minValue = sample->value;
+    sample->maxValue = sample->value;
+    return true;
+}
+
+void dataLogReaderBegin(DataLogReader* reader, int64_t fromMs, int64_t toMs, int16_t slaveAddress, int32_t registerAddress,
+                        uint8_t store) {
+    reader->fromMs = fromMs;
+    reader->toMs = toMs;
+    reader->slaveAddress = slaveAddress;
+    reader->registerAddress = registerAddress;
+    reader->store = store < DATALOG_STORE_COUNT ? store : DATALOG_STORE_RAW;
+    reader->phase = 0;
+    reader->position = 0;
+    reader->queueSeq = 0;
+    reader->blockLoaded = false;
+    reader->sampleIndex = 0;
+    reader->file = File();
+
+    if (lockLog(pdMS_TO_TICKS(100))) {
+        reader->segmentSeq = s_stores[reader->store].firstSeq;
+        unlockLog();
+    } else {
+        reader->phase = 3;
+    }
+}
+
+// Verifica se o bloco carregado interessa ao leitor
+static bool readerAccepts(DataLogReader* reader) {
+    if (!blockIsValid(reader->block)) {
+        return false;
+    }
+    const DataLogBlockHeader* header = (const DataLogBlockHeader*)reader->block;
+    if (header->store != reader->store) {
+        return false;
+    }
+    if (header->encoding == DATALOG_ENCODING_ROLLUP) {
+        // Blocos de rollup misturam canais: filtro aplicado por registro
+        if (header->payloadBytes < header->sampleCount * sizeof(RollupRecord)) {
+            return false;
+        }
+    } else if (header->encoding == DATALOG_ENCODING_RAW || header->encoding == DATALOG_ENCODING_GORILLA ||
+               header->encoding == DATALOG_ENCODING_DELTA_VARINT) {
+        if (reader->slaveAddress >= 0 && header->slaveAddress != reader->slaveAddress) {
+            return false;
+        }
+        if (reader->registerAddress >= 0 && header->registerAddress != reader->registerAddress) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return header->lastTimeMs >= reader->fromMs && header->firstTimeMs <= reader->toMs;
+}
+
+// Lê o próximo bloco de arquivo; retorna false quando os segmentos acabam
+static bool readerLoadFileBlock(DataLogReader* reader) {
+    char path[24];
+    const DataLogStore* store = &s_stores[reader->store];
+    while (true) {
+        if (!lockLog(pdMS_TO_TICKS(100))) {
+            return false;
+        }
+        if (reader->segmentSeq < store->firstSeq) {
+            // Segmento apagado pela rotação durante a leitura
+            if (reader->file) reader->file.close();
+            reader->segmentSeq = store->firstSeq;
+            reader->position = 0;
+        }
+        uint32_t currentSeq = store->currentSeq;
+        bool isCurrent = reader->segmentSeq >= currentSeq;
+
+        if (reader->segmentSeq > currentSeq) {
+            unlockLog();
+            return false;
+        }
+
+        // Segmento atual: reabre com mutex para enxergar o tamanho real junto com a fila
+        if (isCurrent && reader->file) {
+            reader->file.close();
+        }
+        if (!reader->file) {
+            segmentPath(store, reader->segmentSeq, path, sizeof(path));
+            reader->file = LittleFS.open(path, "r");
+        }
+
+        bool loaded = false;
+        if (reader->file) {
+            uint32_t offset = reader->position * DATALOG_BLOCK_SIZE;
+            if (offset + DATALOG_BLOCK_SIZE <= reader->file.size() && reader->file.seek(offset)) {
+                loaded = reader->file.read(reader->block, DATALOG_BLOCK_SIZE) == DATALOG_BLOCK_SIZE;
+            }
+        }
+
+        if (loaded) {
+            reader->position++;
+            if (isCurrent) {
+                reader->file.close();
+            }
+            unlockLog();
+            return true;
+        }
+
+        if (isCurrent) {
+            // Fim dos dados em flash: os próximos estão na fila a partir de s_poppedSeq
+            reader->queueSeq = s_poppedSeq;
+            if (reader->file) reader->file.close();
+            unlockLog();
+            return false;
+        }
+
+        if (reader->file) reader->file.close();
+        reader->segmentSeq++;
+        reader->position = 0;
+        unlockLog();
+    }
+}
+
+// Retrato do próximo bloco aberto (canais brutos ou bloco do nível de rollup)
+static bool readerCopyOpenBlock(DataLogReader* reader) {
+    if (reader->store != DATALOG_STORE_RAW) {
+        if (reader->position > 0) {
+            return false;
+        }
+        reader->position++;
+        return rollupCopyOpenBlock(reader->store - DATALOG_STORE_ROLLUP_FIRST, reader->block);
+    }
+
+    while (reader->position < DATALOG_MAX_CHANNELS) {
+        DataLogChannel* channel = &s_channels[reader->position++];
+        if (channel->used && headerOf(channel->block)->sampleCount > 0) {
+            memcpy(reader->block, channel->block, DATALOG_BLOCK_SIZE);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Carrega o próximo bloco (segmentos, fila, blocos abertos) que passa nos filtros
+static bool readerLoadNextBlock(DataLogReader* reader) {
+    while (reader->phase < 3) {
+        if (reader->phase == 0) {
+            if (readerLoadFileBlock(reader)) {
+                if (readerAccepts(reader)) return true;
+                continue;
+            }
+            reader->phase = 1;
+            continue;
+        }
+
+        if (!lockLog(pdMS_TO_TICKS(100))) {
+            reader->phase = 3;
+            return false;
+        }
+
+        if (reader->phase == 1) {
+            if (reader->queueSeq < s_poppedSeq) {
+                // Blocos foram gravados desde a última verificação: continua pelo arquivo
+                unlockLog();
+                reader->phase = 0;
+                continue;
+            }
+            uint32_t index = reader->queueSeq - s_poppedSeq;
+            if (index < s_queueCount) {
+                memcpy(reader->block, s_queue[(s_queueHead + index) % DATALOG_WRITE_QUEUE_BLOCKS], DATALOG_BLOCK_SIZE);
+                reader->queueSeq++;
+                unlockLog();
+                if (readerAccepts(reader)) return true;
+                continue;
+            }
+            reader->phase = 2;
+            reader->position = 0;
+            unlockLog();
+            continue;
+        }
+
+        // Fase 2: retrato dos blocos ainda abertos
+        bool loaded = readerCopyOpenBlock(reader);
+        if (loaded) {
+            DataLogBlockHeader* header = headerOf(reader->block);
+            header->crc = 0;
+            header->crc = blockCrc(reader->block);
+        }
+        unlockLog();
+        if (!loaded) {
+            reader->phase = 3;
+            return false;
+        }
+        if (readerAccepts(reader)) return true;
+    }
+    return false;
+}
+
+bool dataLogReaderNext(DataLogReader* reader, DataLogSample* sample) {
+    while (true) {
+        if (!reader->blockLoaded) {
+            if (!readerLoadNextBlock(reader)) {
+                return false;
+            }
+            reader->blockLoaded = true;
+            reader->sampleIndex = 0;
+            beginBlockDecode(reader->block, &reader->decoder);
+        }
+
+        const DataLogBlockHeader* header = (const DataLogBlockHeader*)reader->block;
+        bool ordered = header->encoding != DATALOG_ENCODING_ROLLUP;
+        while (reader->sampleIndex < header->sampleCount) {
+            if (!decodeBlockSample(reader->block, reader->sampleIndex, &reader->decoder, sample)) {
+                break;  // Fluxo inválido: descarta o resto do bloco
+            }
+            reader->sampleIndex++;
+
+            if (sample->timeMs > reader->toMs) {
+                if (ordered) break;  // Timestamps crescem dentro de blocos brutos
+                continue;
+            }
+            if (sample->timeMs < reader->fromMs) {
+                continue;
+            }
+            if (!ordered) {
+                if (reader->slaveAddress >= 0 && sample->slaveAddress != reader->slaveAddress) continue;
+                if (reader->registerAddress >= 0 && sample->registerAddress != reader->registerAddress) continue;
+            }
+            return true;
+        }
+        reader->blockLoaded = false;
+    }
+}
+
+void dataLogReaderEnd(DataLogReader* reader) {
+    if (reader->file) {
+        reader->file.close();
+    }
+    reader->phase = 3;
+    reader->blockLoaded = false;
+}
+
+int64_t dataLogStoreOldestMs(uint8_t store) {
+    if (store >= DATALOG_STORE_COUNT || !lockLog(pdMS_TO_TICKS(100))) {
+        return INT64_MAX;
+    }
+
+    // Apenas o primeiro bloco válido do segmento mais antigo é lido
+    static uint8_t block[DATALOG_BLOCK_SIZE];
+    const DataLogStore* target = &s_stores[store];
+    int64_t oldest = INT64_MAX;
+    char path[24];
+    for (uint32_t seq = target->firstSeq; seq <= target->currentSeq && oldest == INT64_MAX; seq++) {
+        segmentPath(target, seq, path, sizeof(path));
+        File file = LittleFS.open(path, "r");
+        if (!file) {
+            continue;
+        }
+        while (file.read(block, DATALOG_BLOCK_SIZE) == DATALOG_BLOCK_SIZE) {
+            if (blockIsValid(block)) {
+                oldest = headerOf(block)->firstTimeMs;
+                break;
+            }
+        }
+        file.close();
+    }
+
+    if (oldest == INT64_MAX) {
+        for (uint8_t i = 0; i < s_queueCount; i++) {
+            const uint8_t* queued = s_queue[(s_queueHead + i) % DATALOG_WRITE_QUEUE_BLOCKS];
+            if (storeOf(queued) == target) {
+                oldest = ((const DataLogBlockHeader*)queued)->firstTimeMs;
+                break;
+            }
+        }
+    }
+    unlockLog();
+    return oldest;
+}
+
+int64_t dataLoggerPersistedUntilMs(uint8_t store) {
+    bool utc = false;
+    int64_t until = dataLoggerNowMs(&utc);
+    if (store >= DATALOG_STORE_COUNT || !lockLog(pdMS_TO_TICKS(100))) {
+        return INT64_MIN;
+    }
+
+    // Dados ainda em RAM (fila, blocos abertos, intervalos de rollup) começam em firstTimeMs
+    for (uint8_t i = 0; i < s_queueCount; i++) {
+        const uint8_t* queued = s_queue[(s_queueHead + i) % DATALOG_WRITE_QUEUE_BLOCKS];
+        const DataLogBlockHeader* header = (const DataLogBlockHeader*)queued;
+        if (header->store == store && header->firstTimeMs <= until) {
+            until = header->firstTimeMs - 1;
+        }
+    }
+    if (store == DATALOG_STORE_RAW) {
+        for (uint8_t i = 0; i < DATALOG_MAX_CHANNELS; i++) {
+            const DataLogBlockHeader* header = headerOf(s_channels[i].block);
+            if (s_channels[i].used && header->sampleCount > 0 && header->firstTimeMs <= until) {
+                until = header->firstTimeMs - 1;
+            }
+        }
+    } else {
+        int64_t pending = rollupPendingFromMs(store - DATALOG_STORE_ROLLUP_FIRST);
+        if (pending <= until) {
+            until = pending - 1;
+        }
+    }
+    unlockLog();
+    return until;
+}
+
+// ==================== BENCHMARK DO CODIFICADOR ====================
+
+#define DATALOG_BENCH_BATCH 1024  // Amostras de um canal processadas por vez
+
+// Codifica um lote do mesmo canal em blocos e confere a decodificação
+static void benchEncodeBatch(const int64_t* times, const float* values, uint16_t count, uint8_t encoding,
+                             uint8_t* payload, DataLogBenchResult* result) {
+    uint16_t start = 0;
+    while (start < count) {
+        TsEncoder encoder;
+        tsEncoderInit(&encoder, encoding, times[start]);
+
+        unsigned long t0 = micros();
+        uint16_t end = start;
+        while (end < count && tsEncoderAppend(&encoder, payload, DATALOG_PAYLOAD_SIZE, times[end], values[end])) {
+            end++;
+        }
+        result->encodeMicros += micros() - t0;
+
+        uint16_t payloadBytes = tsEncoderBytes(&encoder);
+        result->blocks++;
+        result->encodedBytes += sizeof(DataLogBlockHeader) + payloadBytes;
+
+        TsDecoder decoder;
+        tsDecoderInit(&decoder, encoding, times[start]);
+        t0 = micros();
+        for (uint16_t i = start; i < end; i++) {
+            int64_t timeMs;
+            float value;
+            if (!tsDecoderNext(&decoder, payload, payloadBytes, &timeMs, &value) ||
+                timeMs != times[i] || memcmp(&value, &values[i], sizeof(float)) != 0) {
+                result->roundTripOk = false;
+                break;
+            }
+        }
+        result->decodeMicros += micros() - t0;
+
+        if (end == start) {
+            result->roundTripOk = false;  // Não deveria ocorrer: a primeira amostra sempre cabe
+            return;
+        }
+        start = end;
+    }
+}
+
+void dataLoggerBenchmark(uint32_t maxSamples, DataLogBenchResult* result) {
+    memset(result, 0, sizeof(DataLogBenchResult));
+    result->roundTripOk = true;
+
+    // Heap: a task do servidor web tem pilha pequena
+    DataLogReader* reader = new DataLogReader();
+    int64_t* times = new int64_t[DATALOG_BENCH_BATCH];
+    float* values = new float[DATALOG_BENCH_BATCH];
+    uint8_t* payload = new uint8_t[DATALOG_PAYLOAD_SIZE];
+
+    uint16_t count = 0;
+    uint8_t batchEncoding = DATALOG_ENCODING_GORILLA;
+    uint8_t batchSlave = 0;
+    uint16_t batchRegister = 0;
+
+    dataLogReaderBegin(reader, INT64_MIN, INT64_MAX);
+    DataLogSample sample;
+    while (result->samples < maxSamples && dataLogReaderNext(reader, &sample)) {
+        // Integer só se o bloco de origem já foi gravado como inteiro
+        uint8_t encoding = headerOf(reader->block)->encoding == DATALOG_ENCODING_DELTA_VARINT
+            ? DATALOG_ENCODING_DELTA_VARINT : DATALOG_ENCODING_GORILLA;
+
+        bool sameBatch = count > 0 && sample.slaveAddress == batchSlave && sample.registerAddress == batchRegister &&
+                         encoding == batchEncoding && sample.timeMs >= times[count - 1];
+        if (count > 0 && (!sameBatch || count >= DATALOG_BENCH_BATCH)) {
+            benchEncodeBatch(times, values, count, batchEncoding, payload, result);
+            count = 0;
+        }
+        if (count == 0) {
+            batchEncoding = encoding;
+            batchSlave = sample.slaveAddress;
+            batchRegister = sample.registerAddress;
+        }
+        times[count] = sample.timeMs;
+        values[count] = sample.value;
+        count++;
+        result->samples++;
+        result->rawBytes += sizeof(int64_t) + sizeof(float);
+    }
+    if (count > 0) {
+        benchEncodeBatch(times, values, count, batchEncoding, payload, result);
+    }
+    dataLogReaderEnd(reader);
+
+    delete reader;
+    delete[] times;
+    delete[] values;
+    delete[] payload;
+}
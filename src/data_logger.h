@@ -0,0 +1,259 @@
+/**
+ * @file data_logger.h
+ * @brief Registro histórico das medições em segmentos rotativos no LittleFS
+ *
+ * Os valores processados de cada registro (canal) são agrupados em blocos de
+ * tamanho fixo (DATALOG_BLOCK_SIZE, alinhados à página de flash). Blocos cheios
+ * são copiados para uma fila em RAM e gravados depois por dataLoggerService(),
+ * sempre como append de blocos inteiros em arquivos de segmento "/dl_NNNNNN.bin".
+ * Quando um segmento atinge DATALOG_SEGMENT_SIZE um novo é aberto e, acima de
+ * DATALOG_MAX_SEGMENTS, o mais antigo é apagado (espaço total limitado).
+ *
+ * Os agregados de data_rollup usam o mesmo formato de bloco e a mesma fila, em
+ * conjuntos de segmentos próprios (stores) com retenção independente.
+ *
+ * Recuperação após queda de energia: cada bloco tem magic + CRC16. Na
+ * inicialização, se o último segmento terminar em um bloco incompleto ou
+ * inválido, a gravação continua em um segmento novo e os leitores ignoram o
+ * trecho corrompido. Perda máxima: blocos ainda não gravados (no máximo
+ * DATALOG_SEAL_INTERVAL_MS de dados por canal).
+ */
+
+#ifndef DATA_LOGGER_H
+#define DATA_LOGGER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+#include "ts_codec.h"
+
+// ==================== PARÂMETROS DO LOGGER ====================
+#define DATALOG_BLOCK_SIZE 256                 // Bytes por bloco (= página de flash)
+#define DATALOG_SEGMENT_SIZE (64 * 1024)       // Bytes por arquivo de segmento
+#define DATALOG_MAX_SEGMENTS 10                // Limite de segmentos brutos (640KB no total)
+#define DATALOG_MAX_CHANNELS 16                // Canais (registros) registrados simultaneamente
+#define DATALOG_WRITE_QUEUE_BLOCKS 20          // Blocos aguardando gravação (todos os canais fecham juntos)
+#define DATALOG_SEAL_INTERVAL_MS 300000        // Fecha blocos parciais a cada 5 minutos
+#define DATALOG_MAX_BLOCKS_PER_SERVICE 4       // Limita o tempo gasto por chamada de service
+#define DATALOG_FILE_PREFIX "/dl_"
+#define DATALOG_FILE_SUFFIX ".bin"
+
+#define DATALOG_BLOCK_MAGIC 0xDA7A
+#define DATALOG_BLOCK_VERSION 1
+#define DATALOG_ENCODING_RAW 0                 // Payload: DataLogRawSample[] (somente leitura)
+#define DATALOG_ENCODING_GORILLA TS_ENCODING_GORILLA            // Delta-of-delta + XOR float
+#define DATALOG_ENCODING_DELTA_VARINT TS_ENCODING_DELTA_VARINT  // Delta-of-delta + delta inteiro
+#define DATALOG_ENCODING_ROLLUP 3              // Payload: RollupRecord[] (data_rollup.h)
+#define DATALOG_FLAG_UTC 0x01                  // Timestamps em UTC (senão: uptime em ms)
+
+#define DATALOG_STORE_RAW 0                    // Amostras brutas ("/dl_")
+#define DATALOG_STORE_ROLLUP_FIRST 1           // Primeiro nível de rollup; demais em sequência
+#define DATALOG_STORE_COUNT 4                  // Brutos + 3 níveis de rollup
+
+/**
+ * @struct DataLogBlockHeader
+ * @brief Cabeçalho de 32 bytes no início de cada bloco gravado
+ */
+struct DataLogBlockHeader {
+    uint16_t magic;            // DATALOG_BLOCK_MAGIC
+    uint8_t version;           // DATALOG_BLOCK_VERSION
+    uint8_t encoding;          // Formato do payload (DATALOG_ENCODING_*)
+    uint8_t slaveAddress;      // Endereço Modbus do dispositivo de origem
+    uint8_t flags;             // DATALOG_FLAG_*
+    uint16_t registerAddress;  // Endereço do registro de origem
+    uint16_t sampleCount;      // Amostras no bloco
+    uint16_t payloadBytes;     // Bytes válidos do payload
+    uint16_t crc;              // CRC16 do cabeçalho (com crc = 0) + payload
+    uint8_t store;             // DATALOG_STORE_* de destino
+    uint8_t reserved;
+    int64_t firstTimeMs;       // Timestamp da primeira amostra
+    int64_t lastTimeMs;        // Timestamp da última amostra
+};
+
+/**
+ * @struct DataLogRawSample
+ * @brief Amostra no formato DATALOG_ENCODING_RAW (8 bytes, blocos antigos)
+ */
+struct DataLogRawSample {
+    uint32_t offsetMs;         // Diferença para firstTimeMs
+    float value;               // Valor processado (gain/offset/Kalman aplicados)
+};
+
+#define DATALOG_PAYLOAD_SIZE (DATALOG_BLOCK_SIZE - sizeof(DataLogBlockHeader))
+
+/**
+ * @struct DataLogSample
+ * @brief Amostra decodificada entregue pelo leitor
+ */
+struct DataLogSample {
+    int64_t timeMs;            // Amostra ou início do intervalo (rollup)
+    float value;               // Valor (média no rollup)
+    float minValue;            // Igual a value em amostras brutas
+    float maxValue;
+    uint16_t count;            // 1 em amostras brutas
+    uint8_t slaveAddress;
+    uint16_t registerAddress;
+    bool utc;
+};
+
+/**
+ * @struct DataLogReader
+ * @brief Cursor de leitura com memória constante (um bloco em RAM)
+ *
+ * Percorre os segmentos gravados em ordem, depois os blocos na fila de
+ * gravação e por fim os blocos ainda abertos de cada canal.
+ */
+struct DataLogReader {
+    int64_t fromMs;            // Filtro de tempo (inclusivo)
+    int64_t toMs;              // Filtro de tempo (inclusivo)
+    int16_t slaveAddress;      // -1 = todos
+    int32_t registerAddress;   // -1 = todos
+    uint8_t store;             // DATALOG_STORE_* lido
+    uint8_t phase;             // 0 = segmentos, 1 = fila, 2 = canais abertos, 3 = fim
+    uint32_t segmentSeq;       // Segmento atual
+    uint32_t position;         // Índice do bloco no segmento / canal
+    uint32_t queueSeq;         // Sequência absoluta do próximo bloco da fila
+    File file;
+    uint8_t block[DATALOG_BLOCK_SIZE];
+    bool blockLoaded;
+    uint16_t sampleIndex;
+    TsDecoder decoder;         // Decodificação preguiçosa do bloco carregado
+};
+
+/**
+ * @struct DataLogStats
+ * @brief Estatísticas do logger (console/API)
+ */
+struct DataLogStats {
+    bool ready;
+    uint32_t firstSegment;
+    uint32_t currentSegment;
+    uint32_t currentSegmentBytes;
+    uint32_t blocksWritten;
+    uint32_t blocksDropped;
+    uint32_t writeErrors;
+    uint32_t samplesLogged;
+    uint32_t samplesDropped;
+    uint32_t lastFlushMicros;
+    uint32_t maxFlushMicros;
+    uint8_t activeChannels;
+    uint8_t queuedBlocks;
+    bool recoveredTornSegment;
+};
+
+/**
+ * @struct DataLogBenchResult
+ * @brief Resultado de dataLoggerBenchmark()
+ */
+struct DataLogBenchResult {
+    uint32_t samples;          // Amostras recodificadas
+    uint32_t blocks;           // Blocos gerados pelo codificador
+    uint32_t encodedBytes;     // Bytes de payload gerados
+    uint32_t rawBytes;         // Equivalente em timestamp (8) + float (4) por amostra
+    uint32_t encodeMicros;     // Tempo total de codificação
+    uint32_t decodeMicros;     // Tempo total de decodificação
+    bool roundTripOk;          // Decodificação reproduz exatamente as amostras
+};
+
+/**
+ * @brief Inicializa o logger (chamar após montar o LittleFS)
+ * @return true se o logger está pronto para gravar
+ */
+bool dataLoggerInit();
+
+/**
+ * @brief Adiciona uma amostra ao bloco do canal (somente RAM, não bloqueia)
+ * @param slaveAddress Endereço Modbus do dispositivo
+ * @param registerAddress Endereço do registro
+ * @param sampleTimeUs Recepção da resposta (monotonicMicros()); gravado em ms, UTC se o RTC estiver válido
+ * @param value Valor processado
+ * @param integer true se o valor é sempre inteiro (sem gain/offset/Kalman)
+ */
+void dataLoggerAppend(uint8_t slaveAddress, uint16_t registerAddress, int64_t sampleTimeUs, float value, bool integer = false);
+
+/**
+ * @brief Grava na flash os blocos pendentes e fecha blocos antigos
+ *
+ * Chamar no loop principal, fora da leitura Modbus. Grava no máximo
+ * DATALOG_MAX_BLOCKS_PER_SERVICE blocos por chamada.
+ */
+void dataLoggerService();
+
+/**
+ * @brief Fecha todos os blocos abertos e grava tudo imediatamente
+ */
+void dataLoggerFlush();
+
+/**
+ * @brief Converte um instante monotônico (µs) para a base das amostras em ms
+ *
+ * UTC se o RTC estiver válido, senão tempo desde o boot (sem volta em 49 dias).
+ * @param utc Recebe true se o timestamp está em UTC
+ */
+int64_t dataLoggerTimeMs(int64_t monotonicUs, bool* utc);
+
+/**
+ * @brief Timestamp atual em ms na base das amostras (ver dataLoggerTimeMs)
+ * @param utc Recebe true se o timestamp está em UTC
+ */
+int64_t dataLoggerNowMs(bool* utc);
+
+/**
+ * @brief Copia as estatísticas atuais
+ */
+void dataLoggerGetStats(DataLogStats* stats);
+
+/**
+ * @brief Fecha um bloco montado fora do logger e o coloca na fila de gravação
+ *
+ * Usado por data_rollup; chamar com o mutex do logger adquirido (dentro de
+ * dataLoggerAppend/dataLoggerService). O campo store do cabeçalho define o destino.
+ */
+void dataLoggerEnqueueBlock(uint8_t* block);
+
+/**
+ * @brief Timestamp do bloco mais antigo de um store
+ * @return INT64_MAX se o store estiver vazio
+ */
+int64_t dataLogStoreOldestMs(uint8_t store);
+
+/**
+ * @brief Instante até o qual todos os dados de um store já estão gravados em flash
+ *
+ * Leituras com toMs <= este valor não mudam mais (exceto pela rotação dos
+ * segmentos mais antigos), o que permite retomar exportações por Range.
+ * @return INT64_MIN se o mutex não pôde ser obtido
+ */
+int64_t dataLoggerPersistedUntilMs(uint8_t store = DATALOG_STORE_RAW);
+
+/**
+ * @brief Recodifica amostras já registradas e mede taxa de compressão e tempo
+ * @param maxSamples Limite de amostras processadas (mantém a chamada curta)
+ * @param result Resultado
+ */
+void dataLoggerBenchmark(uint32_t maxSamples, DataLogBenchResult* result);
+
+/**
+ * @brief Inicia um cursor de leitura
+ * @param reader Cursor a inicializar
+ * @param fromMs Início do intervalo (inclusivo)
+ * @param toMs Fim do intervalo (inclusivo)
+ * @param slaveAddress Filtro de dispositivo (-1 = todos)
+ * @param registerAddress Filtro de registro (-1 = todos)
+ * @param store Origem: brutos ou um nível de rollup (ver rollupChooseStore)
+ */
+void dataLogReaderBegin(DataLogReader* reader, int64_t fromMs, int64_t toMs, int16_t slaveAddress = -1, int32_t registerAddress = -1,
+                        uint8_t store = DATALOG_STORE_RAW);
+
+/**
+ * @brief Obtém a próxima amostra que satisfaz os filtros
+ * @return true se uma amostra foi obtida, false no fim dos dados
+ */
+bool dataLogReaderNext(DataLogReader* reader, DataLogSample* sample);
+
+/**
+ * @brief Libera os recursos do cursor (fecha arquivo aberto)
+ */
+void dataLogReaderEnd(DataLogReader* reader);
+
+#endif // DATA_LOGGER_H
@@ -0,0 +1,245 @@
+/**
+ * @file data_rollup.cpp
+ * @brief Implementação dos agregados min/max/média do histórico
+ */
+
+#include "data_rollup.h"
+
+static_assert(sizeof(RollupRecord) == 24, "RollupRecord deve ter 24 bytes");
+
+// Retenção aproximada com 10 canais: 10 s ~1 h, 1 min ~13 h, 15 min ~4 dias
+const RollupLevel ROLLUP_LEVELS[ROLLUP_LEVEL_COUNT] = {
+    { 10000, "/r1_", 2 },
+    { 60000, "/r2_", 8 },
+    { 900000, "/r3_", 4 },
+};
+
+/**
+ * @struct RollupAccumulator
+ * @brief Intervalo em andamento de um canal em um nível
+ */
+struct RollupAccumulator {
+    bool active;
+    uint8_t slaveAddress;
+    uint16_t registerAddress;
+    uint8_t flags;
+    int64_t bucketStartMs;
+    float minValue;
+    float maxValue;
+    double sum;
+    uint32_t count;
+};
+
+/**
+ * @struct RollupOpenBlock
+ * @brief Bloco em preenchimento de um nível (compartilhado entre canais)
+ */
+struct RollupOpenBlock {
+    unsigned long openedAtMillis;
+    uint8_t block[DATALOG_BLOCK_SIZE];
+};
+
+// Estado do módulo (protegido pelo mutex do logger)
+static RollupAccumulator s_accumulators[DATALOG_MAX_CHANNELS][ROLLUP_LEVEL_COUNT];
+static RollupOpenBlock s_openBlocks[ROLLUP_LEVEL_COUNT];
+static uint32_t s_recordCount = 0;
+
+static inline DataLogBlockHeader* rollupHeader(uint8_t level) {
+    return (DataLogBlockHeader*)s_openBlocks[level].block;
+}
+
+static inline int64_t bucketStartFor(int64_t timeMs, uint32_t resolutionMs) {
+    int64_t remainder = timeMs % (int64_t)resolutionMs;
+    if (remainder < 0) remainder += resolutionMs;
+    return timeMs - remainder;
+}
+
+static void sealLevel(uint8_t level) {
+    if (rollupHeader(level)->sampleCount == 0) {
+        return;
+    }
+    dataLoggerEnqueueBlock(s_openBlocks[level].block);
+    memset(s_openBlocks[level].block, 0, DATALOG_BLOCK_SIZE);
+}
+
+// Converte o acumulador em registro no bloco aberto do nível
+static void emitRecord(uint8_t level, RollupAccumulator* acc) {
+    if (!acc->active || acc->count == 0) {
+        acc->active = false;
+        return;
+    }
+
+    DataLogBlockHeader* header = rollupHeader(level);
+    if (header->sampleCount > 0) {
+        bool full = header->sampleCount >= ROLLUP_RECORDS_PER_BLOCK;
+        bool timeBaseChanged = header->flags != acc->flags;
+        bool outOfRange = acc->bucketStartMs < header->firstTimeMs ||
+                          (acc->bucketStartMs - header->firstTimeMs) > (int64_t)UINT32_MAX;
+        if (full || timeBaseChanged || outOfRange) {
+            sealLevel(level);
+        }
+    }
+
+    if (header->sampleCount == 0) {
+        header->magic = DATALOG_BLOCK_MAGIC;
+        header->version = DATALOG_BLOCK_VERSION;
+        header->encoding = DATALOG_ENCODING_ROLLUP;
+        header->store = DATALOG_STORE_ROLLUP_FIRST + level;
+        header->flags = acc->flags;
+        header->firstTimeMs = acc->bucketStartMs;
+        header->lastTimeMs = acc->bucketStartMs;
+        s_openBlocks[level].openedAtMillis = millis();
+    }
+
+    RollupRecord record;
+    memset(&record, 0, sizeof(record));
+    record.offsetMs = (uint32_t)(acc->bucketStartMs - header->firstTimeMs);
+    record.slaveAddress = acc->slaveAddress;
+    record.registerAddress = acc->registerAddress;
+    record.minValue = acc->minValue;
+    record.maxValue = acc->maxValue;
+    record.meanValue = (float)(acc->sum / acc->count);
+    record.count = acc->count > 0xFFFF ? 0xFFFF : (uint16_t)acc->count;
+
+    uint8_t* payload = s_openBlocks[level].block + sizeof(DataLogBlockHeader);
+    memcpy(payload + header->sampleCount * sizeof(RollupRecord), &record, sizeof(record));
+    header->sampleCount++;
+    header->payloadBytes = header->sampleCount * sizeof(RollupRecord);
+    if (acc->bucketStartMs > header->lastTimeMs) {
+        header->lastTimeMs = acc->bucketStartMs;
+    }
+
+    s_recordCount++;
+    acc->active = false;
+}
+
+void rollupReset() {
+    memset(s_accumulators, 0, sizeof(s_accumulators));
+    memset(s_openBlocks, 0, sizeof(s_openBlocks));
+    s_recordCount = 0;
+}
+
+void rollupAddSample(uint8_t channel, uint8_t slaveAddress, uint16_t registerAddress, int64_t timeMs, uint8_t flags, float value) {
+    if (channel >= DATALOG_MAX_CHANNELS) {
+        return;
+    }
+
+    for (uint8_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+        RollupAccumulator* acc = &s_accumulators[channel][level];
+        int64_t bucketStart = bucketStartFor(timeMs, ROLLUP_LEVELS[level].resolutionMs);
+
+        if (acc->active && (acc->slaveAddress != slaveAddress || acc->registerAddress != registerAddress ||
+                            acc->bucketStartMs != bucketStart || acc->flags != flags)) {
+            emitRecord(level, acc);
+        }
+
+        if (!acc->active) {
+            acc->active = true;
+            acc->slaveAddress = slaveAddress;
+            acc->registerAddress = registerAddress;
+            acc->flags = flags;
+            acc->bucketStartMs = bucketStart;
+            acc->minValue = value;
+            acc->maxValue = value;
+            acc->sum = 0.0;
+            acc->count = 0;
+        }
+
+        if (value < acc->minValue) acc->minValue = value;
+        if (value > acc->maxValue) acc->maxValue = value;
+        acc->sum += value;
+        acc->count++;
+    }
+}
+
+void rollupCloseChannel(uint8_t channel) {
+    if (channel >= DATALOG_MAX_CHANNELS) {
+        return;
+    }
+    for (uint8_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+        emitRecord(level, &s_accumulators[channel][level]);
+    }
+}
+
+void rollupService(int64_t nowMs, uint8_t flags, bool force) {
+    for (uint8_t level = 0; level < ROLLUP_LEVEL_COUNT; level++) {
+        uint32_t resolutionMs = ROLLUP_LEVELS[level].resolutionMs;
+
+        // Intervalos vencidos de canais que pararam de receber amostras
+        for (uint8_t channel = 0; channel < DATALOG_MAX_CHANNELS; channel++) {
+            RollupAccumulator* acc = &s_accumulators[channel][level];
+            if (!acc->active) {
+                continue;
+            }
+            bool expired = acc->flags != flags || nowMs >= acc->bucketStartMs + (int64_t)resolutionMs;
+            if (force || expired) {
+                emitRecord(level, acc);
+            }
+        }
+
+        // Limita a perda em queda de energia, como nos blocos brutos
+        if (rollupHeader(level)->sampleCount > 0 &&
+            (force || millis() - s_openBlocks[level].openedAtMillis >= DATALOG_SEAL_INTERVAL_MS)) {
+            sealLevel(level);
+        }
+    }
+}
+
+bool rollupCopyOpenBlock(uint8_t level, uint8_t* block) {
+    if (level >= ROLLUP_LEVEL_COUNT || rollupHeader(level)->sampleCount == 0) {
+        return false;
+    }
+    memcpy(block, s_openBlocks[level].block, DATALOG_BLOCK_SIZE);
+    return true;
+}
+
+int64_t rollupPendingFromMs(uint8_t level) {
+    int64_t pending = INT64_MAX;
+    if (level >= ROLLUP_LEVEL_COUNT) {
+        return pending;
+    }
+    // O bloco aberto é fechado antes de receber intervalo anterior a firstTimeMs
+    if (rollupHeader(level)->sampleCount > 0) {
+        pending = rollupHeader(level)->firstTimeMs;
+    }
+    for (uint8_t channel = 0; channel < DATALOG_MAX_CHANNELS; channel++) {
+        const RollupAccumulator* acc = &s_accumulators[channel][level];
+        if (acc->active && acc->bucketStartMs < pending) {
+            pending = acc->bucketStartMs;
+        }
+    }
+    return pending;
+}
+
+uint32_t rollupRecordCount() {
+    return s_recordCount;
+}
+
+uint8_t rollupChooseStore(int64_t fromMs, int64_t toMs, uint32_t maxPoints) {
+    if (toMs <= fromMs || maxPoints == 0) {
+        return DATALOG_STORE_RAW;
+    }
+
+    int64_t span = toMs - fromMs;
+    int chosen = -1;
+    for (int level = ROLLUP_LEVEL_COUNT - 1; level >= 0; level--) {
+        if (span / (int64_t)ROLLUP_LEVELS[level].resolutionMs >= (int64_t)maxPoints) {
+            chosen = level;
+            break;
+        }
+    }
+    if (chosen < 0) {
+        return DATALOG_STORE_RAW;
+    }
+
+    // Níveis finos guardam menos tempo: prefere um nível mais grosso que cubra o início
+    if (dataLogStoreOldestMs(DATALOG_STORE_ROLLUP_FIRST + chosen) > fromMs) {
+        for (int level = chosen + 1; level < ROLLUP_LEVEL_COUNT; level++) {
+            if (dataLogStoreOldestMs(DATALOG_STORE_ROLLUP_FIRST + level) <= fromMs) {
+                chosen = level;
+                break;
+            }
+        }
+    }
+    return DATALOG_STORE_ROLLUP_FIRST + chosen;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file data_rollup.h
+ * @brief Agregados min/max/média do histórico em várias resoluções
+ *
+ * Cada amostra registrada atualiza, por canal, um acumulador por nível
+ * (10 s, 1 min e 15 min, alinhados ao relógio). Quando o intervalo do
+ * acumulador termina, um RollupRecord é adicionado ao bloco aberto do nível;
+ * blocos cheios seguem pela mesma fila de gravação do logger para arquivos
+ * de segmento próprios de cada nível, com retenção maior que a dos dados brutos.
+ *
+ * Consultas longas usam o nível mais grosso que ainda entrega a quantidade de
+ * pontos pedida (rollupChooseStore), lendo centenas de registros em vez de
+ * dezenas de milhares de amostras.
+ */
+
+#ifndef DATA_ROLLUP_H
+#define DATA_ROLLUP_H
+
+#include <Arduino.h>
+#include "data_logger.h"
+
+#define ROLLUP_LEVEL_COUNT 3
+#define ROLLUP_SEGMENT_SIZE (32 * 1024)
+
+/**
+ * @struct RollupLevel
+ * @brief Parâmetros de um nível de agregação
+ */
+struct RollupLevel {
+    uint32_t resolutionMs;     // Duração de cada intervalo
+    const char* filePrefix;    // Prefixo dos arquivos de segmento do nível
+    uint8_t maxSegments;       // Retenção (segmentos de ROLLUP_SEGMENT_SIZE)
+};
+
+extern const RollupLevel ROLLUP_LEVELS[ROLLUP_LEVEL_COUNT];
+
+/**
+ * @struct RollupRecord
+ * @brief Registro gravado no payload de blocos DATALOG_ENCODING_ROLLUP (24 bytes)
+ *
+ * Um bloco de rollup mistura canais; o filtro por dispositivo/registro é
+ * aplicado por registro.
+ */
+struct RollupRecord {
+    uint32_t offsetMs;         // Início do intervalo em relação a firstTimeMs do bloco
+    uint8_t slaveAddress;
+    uint8_t reserved;
+    uint16_t registerAddress;
+    float minValue;
+    float maxValue;
+    float meanValue;
+    uint16_t count;            // Amostras agregadas
+    uint16_t reserved2;
+};
+
+#define ROLLUP_RECORDS_PER_BLOCK (DATALOG_PAYLOAD_SIZE / sizeof(RollupRecord))
+
+/**
+ * @brief Descarta acumuladores e blocos abertos (inicialização do logger)
+ */
+void rollupReset();
+
+/**
+ * @brief Agrega uma amostra em todos os níveis
+ *
+ * Chamado pelo logger com o mutex do logger adquirido.
+ * @param channel Índice do canal no logger (0..DATALOG_MAX_CHANNELS-1)
+ */
+void rollupAddSample(uint8_t channel, uint8_t slaveAddress, uint16_t registerAddress, int64_t timeMs, uint8_t flags, float value);
+
+/**
+ * @brief Fecha os intervalos pendentes de um canal que será liberado
+ */
+void rollupCloseChannel(uint8_t channel);
+
+/**
+ * @brief Fecha intervalos vencidos e blocos abertos há muito tempo
+ * @param nowMs Timestamp atual na mesma base das amostras
+ * @param flags Base de tempo atual (DATALOG_FLAG_*)
+ * @param force true para fechar tudo (flush/reboot)
+ */
+void rollupService(int64_t nowMs, uint8_t flags, bool force);
+
+/**
+ * @brief Copia o bloco aberto de um nível (retrato para leitores)
+ * @return false se o bloco está vazio
+ */
+bool rollupCopyOpenBlock(uint8_t level, uint8_t* block);
+
+/**
+ * @brief Início do intervalo mais antigo de um nível ainda em RAM
+ *
+ * Chamar com o mutex do logger adquirido.
+ * @return INT64_MAX se não há nada pendente
+ */
+int64_t rollupPendingFromMs(uint8_t level);
+
+/**
+ * @brief Total de registros de rollup gerados desde o boot
+ */
+uint32_t rollupRecordCount();
+
+/**
+ * @brief Escolhe a origem de dados de uma consulta
+ *
+ * Retorna o nível mais grosso cujo número de intervalos no período é pelo
+ * menos maxPoints; se esse nível não alcançar fromMs (retenção) e um nível
+ * mais grosso alcançar, usa o mais grosso. Sem nível adequado: dados brutos.
+ * @return DATALOG_STORE_RAW ou DATALOG_STORE_ROLLUP_FIRST + nível
+ */
+uint8_t rollupChooseStore(int64_t fromMs, int64_t toMs, uint32_t maxPoints);
+
+#endif // DATA_ROLLUP_H
@@ -0,0 +1,384 @@
+/**
+ * @file device_profiles.cpp
+ * @brief Implementação dos perfis de dispositivo
+ */
+
+#include "device_profiles.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static DeviceProfile s_profiles[PROFILE_MAX_PROFILES];
+static uint8_t s_profileCount = 0;
+
+static SemaphoreHandle_t s_profileMutex = nullptr;
+
+static inline bool lockProfiles(TickType_t ticks) {
+    if (s_profileMutex == nullptr) {
+        s_profileMutex = xSemaphoreCreateMutex();
+    }
+    return s_profileMutex != nullptr && xSemaphoreTake(s_profileMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockProfiles() {
+    xSemaphoreGive(s_profileMutex);
+}
+
+static const char* const kDataTypeNames[] = { "uint16", "int16", "uint32", "int32", "float32" };
+#define PROFILE_DATA_TYPE_COUNT (sizeof(kDataTypeNames) / sizeof(kDataTypeNames[0]))
+
+const char* registerDataTypeName(uint8_t dataType) {
+    static const char* const kSwappedNames[] = { "uint16", "int16", "uint32_lsw", "int32_lsw", "float32_lsw" };
+    uint8_t type = dataType & REGISTER_DATA_TYPE_MASK;
+    if (type >= PROFILE_DATA_TYPE_COUNT) {
+        return "uint16";
+    }
+    return (dataType & REGISTER_DATA_WORD_SWAP) ? kSwappedNames[type] : kDataTypeNames[type];
+}
+
+// "float32_lsw" -> REGISTER_DATA_FLOAT32 | REGISTER_DATA_WORD_SWAP; false se desconhecido
+static bool parseDataType(const char* text, uint8_t* dataType) {
+    for (uint8_t t = 0; t < PROFILE_DATA_TYPE_COUNT; t++) {
+        size_t len = strlen(kDataTypeNames[t]);
+        if (strncmp(text, kDataTypeNames[t], len) != 0) {
+            continue;
+        }
+        if (text[len] == '\0') {
+            *dataType = t;
+            return true;
+        }
+        // Ordem de palavras só faz sentido nos tipos de 32 bits
+        if (strcmp(text + len, "_lsw") == 0 && registerWordCount(t) == 2) {
+            *dataType = t | REGISTER_DATA_WORD_SWAP;
+            return true;
+        }
+    }
+    return false;
+}
+
+// O nome vira nome de arquivo: só letras, números, '_' e '-'
+static bool validProfileName(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= sizeof(((DeviceProfile*)0)->name)) {
+        return false;
+    }
+    for (size_t k = 0; k < len; k++) {
+        char c = name[k];
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static String profilePath(const char* name) {
+    return String(PROFILE_DIR) + "/" + name + ".json";
+}
+
+// Mesma regra de transactRead(): leitura sem escrita usa 0x04, leitura e escrita 0x03
+static inline uint8_t readFunction(uint8_t registerType) {
+    return registerType == 0 ? 0x04 : 0x03;
+}
+
+bool profileCompile(DeviceProfile* profile, String* error) {
+    ProfilePlan& plan = profile->plan;
+    memset(&plan, 0, sizeof(plan));
+
+    // Registros legíveis ordenados por (função, endereço); inserção basta para 32 itens
+    uint8_t order[PROFILE_MAX_REGISTERS];
+    uint8_t readable = 0;
+    for (uint8_t r = 0; r < profile->registerCount; r++) {
+        const ProfileRegister& reg = profile->registers[r];
+        if (reg.registerType == 1) {
+            continue;
+        }
+        uint32_t key = ((uint32_t)readFunction(reg.registerType) << 16) | reg.address;
+        uint8_t k = readable++;
+        while (k > 0) {
+            const ProfileRegister& prev = profile->registers[order[k - 1]];
+            if ((((uint32_t)readFunction(prev.registerType) << 16) | prev.address) <= key) {
+                break;
+            }
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = r;
+    }
+
+    uint32_t blockEnd = 0;                 // Primeiro registrador depois do bloco atual
+    for (uint8_t k = 0; k < readable; k++) {
+        const ProfileRegister& reg = profile->registers[order[k]];
+        uint8_t function = readFunction(reg.registerType);
+        uint32_t end = (uint32_t)reg.address + registerWordCount(reg.dataType);
+        if (end > 0x10000) {
+            *error = "registro " + String(reg.address) + " passa do fim do mapa";
+            return false;
+        }
+
+        ProfileBlock* block = plan.blockCount > 0 ? &plan.blocks[plan.blockCount - 1] : nullptr;
+        if (block && block->function == function && reg.address < blockEnd) {
+            *error = "registros sobrepostos em " + String(reg.address);
+            return false;
+        }
+        bool join = block && block->function == function &&
+                    reg.address - blockEnd <= profile->maxGap &&
+                    end - block->start <= PROFILE_MAX_BLOCK_WORDS;
+        if (!join) {
+            if (plan.blockCount >= PROFILE_MAX_BLOCKS) {
+                *error = "mais de " + String(PROFILE_MAX_BLOCKS) + " blocos de leitura";
+                return false;
+            }
+            block = &plan.blocks[plan.blockCount++];
+            block->function = function;
+            block->start = reg.address;
+        }
+        block->count = (uint8_t)(end - block->start);
+        blockEnd = end;
+
+        ProfileDecoder& decoder = plan.decoders[plan.decoderCount++];
+        decoder.address = reg.address;
+        decoder.function = function;
+        decoder.dataType = reg.dataType;
+        decoder.block = plan.blockCount - 1;
+        decoder.offset = (uint8_t)(reg.address - block->start);
+    }
+    return true;
+}
+
+bool profileFromJson(JsonObjectConst obj, DeviceProfile* profile, String* error) {
+    memset(profile, 0, sizeof(DeviceProfile));
+    const char* name = obj["name"] | "";
+    if (!validProfileName(name)) {
+        *error = "nome invalido (letras, numeros, '_' e '-', ate 23 caracteres)";
+        return false;
+    }
+    strncpy(profile->name, name, sizeof(profile->name) - 1);
+    const char* description = obj["description"] | "";
+    strncpy(profile->description, description, sizeof(profile->description) - 1);
+    profile->maxGap = obj["maxGap"] | PROFILE_DEFAULT_MAX_GAP;
+
+    JsonArrayConst registers = obj["registers"].as<JsonArrayConst>();
+    if (registers.isNull() || registers.size() == 0) {
+        *error = "perfil sem registros";
+        return false;
+    }
+    if (registers.size() > PROFILE_MAX_REGISTERS) {
+        *error = "mais de " + String(PROFILE_MAX_REGISTERS) + " registros";
+        return false;
+    }
+    for (JsonObjectConst regObj : registers) {
+        ProfileRegister& reg = profile->registers[profile->registerCount++];
+        reg.address = regObj["address"] | 0;
+        const char* varName = regObj["variableName"] | "";
+        strncpy(reg.variableName, varName, sizeof(reg.variableName) - 1);
+        reg.registerType = regObj["registerType"] | 2;
+        reg.gain = regObj["gain"] | 1.0f;
+        reg.offset = regObj["offset"] | 0.0f;
+        if (reg.registerType > 2) {
+            *error = "registerType invalido no registro " + String(reg.address);
+            return false;
+        }
+        if (!parseDataType(regObj["dataType"] | "uint16", &reg.dataType)) {
+            *error = "dataType invalido no registro " + String(reg.address);
+            return false;
+        }
+    }
+    return profileCompile(profile, error);
+}
+
+void profileToJson(const DeviceProfile* profile, JsonObject obj, bool includePlan) {
+    obj["name"] = profile->name;
+    obj["description"] = profile->description;
+    obj["maxGap"] = profile->maxGap;
+    JsonArray registers = obj.createNestedArray("registers");
+    for (uint8_t r = 0; r < profile->registerCount; r++) {
+        const ProfileRegister& reg = profile->registers[r];
+        JsonObject regObj = registers.createNestedObject();
+        regObj["address"] = reg.address;
+        regObj["variableName"] = reg.variableName;
+        regObj["registerType"] = reg.registerType;
+        regObj["dataType"] = registerDataTypeName(reg.dataType);
+        regObj["gain"] = reg.gain;
+        regObj["offset"] = reg.offset;
+    }
+    if (!includePlan) {
+        return;
+    }
+    JsonArray blocks = obj.createNestedArray("blocks");
+    for (uint8_t b = 0; b < profile->plan.blockCount; b++) {
+        JsonObject blockObj = blocks.createNestedObject();
+        blockObj["function"] = profile->plan.blocks[b].function;
+        blockObj["start"] = profile->plan.blocks[b].start;
+        blockObj["count"] = profile->plan.blocks[b].count;
+    }
+    JsonArray decoders = obj.createNestedArray("decoders");
+    for (uint8_t d = 0; d < profile->plan.decoderCount; d++) {
+        JsonObject decoderObj = decoders.createNestedObject();
+        decoderObj["address"] = profile->plan.decoders[d].address;
+        decoderObj["block"] = profile->plan.decoders[d].block;
+        decoderObj["offset"] = profile->plan.decoders[d].offset;
+        decoderObj["dataType"] = registerDataTypeName(profile->plan.decoders[d].dataType);
+    }
+}
+
+// Índice do perfil com o nome dado (-1 = nenhum); chamar com o mutex
+static int findProfile(const char* name) {
+    for (uint8_t p = 0; p < s_profileCount; p++) {
+        if (strcmp(s_profiles[p].name, name) == 0) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+// Substitui o perfil de mesmo nome ou acrescenta; chamar com o mutex
+static bool installProfile(const DeviceProfile* profile) {
+    int index = findProfile(profile->name);
+    if (index < 0) {
+        if (s_profileCount >= PROFILE_MAX_PROFILES) {
+            return false;
+        }
+        index = s_profileCount++;
+    }
+    s_profiles[index] = *profile;
+    return true;
+}
+
+void profilesInit() {
+    File dir = LittleFS.open(PROFILE_DIR);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+
+    DeviceProfile* profile = new DeviceProfile;
+    uint8_t loaded = 0;
+    File entry = dir.openNextFile();
+    while (entry) {
+        String fileName = entry.name();
+        if (fileName.startsWith("/")) {
+            fileName = fileName.substring(fileName.lastIndexOf('/') + 1);  // Algumas versões do core retornam o caminho completo
+        }
+        if (!entry.isDirectory() && fileName.endsWith(".json")) {
+            DynamicJsonDocument doc(8192);
+            DeserializationError jsonError = deserializeJson(doc, entry);
+            String error;
+            if (jsonError) {
+                error = jsonError.c_str();
+            } else if (profileFromJson(doc.as<JsonObjectConst>(), profile, &error)) {
+                // O arquivo é a identidade do perfil (profileDelete() remove <nome>.json)
+                String baseName = fileName.substring(0, fileName.length() - 5);
+                if (baseName != profile->name) {
+                    consolePrint("[Perfis] " + fileName + ": nome '" + String(profile->name) + "' substituido por '" + baseName + "'\r\n");
+                    strncpy(profile->name, baseName.c_str(), sizeof(profile->name) - 1);
+                    profile->name[sizeof(profile->name) - 1] = '\0';
+                }
+                if (lockProfiles(portMAX_DELAY)) {
+                    if (installProfile(profile)) {
+                        loaded++;
+                    } else {
+                        error = "limite de " + String(PROFILE_MAX_PROFILES) + " perfis";
+                    }
+                    unlockProfiles();
+                }
+            }
+            if (error.length() > 0) {
+                consolePrint("[Perfis] " + fileName + " ignorado: " + error + "\r\n");
+            }
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    dir.close();
+    delete profile;
+    consolePrint("[Perfis] " + String(loaded) + " perfis carregados\r\n");
+}
+
+uint8_t profileCount() {
+    return s_profileCount;
+}
+
+bool profileGetAt(uint8_t index, DeviceProfile* profile) {
+    if (!lockProfiles(pdMS_TO_TICKS(500))) {
+        return false;
+    }
+    bool found = index < s_profileCount;
+    if (found) {
+        *profile = s_profiles[index];
+    }
+    unlockProfiles();
+    return found;
+}
+
+bool profileGet(const char* name, DeviceProfile* profile) {
+    if (!lockProfiles(pdMS_TO_TICKS(500))) {
+        return false;
+    }
+    int index = findProfile(name);
+    if (index >= 0) {
+        *profile = s_profiles[index];
+    }
+    unlockProfiles();
+    return index >= 0;
+}
+
+bool profileGetPlan(const char* name, ProfilePlan* plan) {
+    if (name[0] == '\0' || !lockProfiles(pdMS_TO_TICKS(100))) {
+        return false;
+    }
+    int index = findProfile(name);
+    if (index >= 0) {
+        *plan = s_profiles[index].plan;
+    }
+    unlockProfiles();
+    return index >= 0;
+}
+
+bool profileSave(const DeviceProfile* profile) {
+    if (!validProfileName(profile->name) || !lockProfiles(pdMS_TO_TICKS(1000))) {
+        return false;
+    }
+    bool installed = installProfile(profile);
+    unlockProfiles();
+    if (!installed) {
+        return false;
+    }
+
+    DynamicJsonDocument doc(8192);
+    profileToJson(profile, doc.to<JsonObject>(), false);
+    if (!LittleFS.exists(PROFILE_DIR)) {
+        LittleFS.mkdir(PROFILE_DIR);
+    }
+    File file = LittleFS.open(profilePath(profile->name), "w");
+    if (!file) {
+        consolePrint("[Perfis] Erro ao gravar " + profilePath(profile->name) + "\r\n");
+        return false;
+    }
+    serializeJsonPretty(doc, file);
+    file.close();
+    return true;
+}
+
+bool profileDelete(const char* name) {
+    if (!lockProfiles(pdMS_TO_TICKS(1000))) {
+        return false;
+    }
+    int index = findProfile(name);
+    if (index >= 0) {
+        for (uint8_t p = index; p + 1 < s_profileCount; p++) {
+            s_profiles[p] = s_profiles[p + 1];
+        }
+        s_profileCount--;
+    }
+    unlockProfiles();
+    if (index < 0) {
+        return false;
+    }
+    String path = profilePath(name);
+    if (LittleFS.exists(path)) {
+        LittleFS.remove(path);
+    }
+    return true;
+}
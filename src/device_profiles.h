@@ -0,0 +1,153 @@
+/**
+ * @file device_profiles.h
+ * @brief Perfis de dispositivo: mapa de registros declarado uma vez, plano de leitura compilado
+ *
+ * Um perfil é um arquivo JSON em PROFILE_DIR (ex.: /profiles/display_led.json)
+ * com o mapa de registros de um modelo de dispositivo: endereço, nome da
+ * variável, tipo (leitura/escrita), tipo de dado e escala (gain/offset).
+ * Dispositivos referenciam o perfil pelo nome (ModbusDevice.profile) e a
+ * interface preenche os registros do dispositivo a partir dele.
+ *
+ * Ao carregar, o perfil é compilado em um plano de leitura:
+ * - Registros legíveis ordenados por função (0x04 / 0x03) e endereço
+ * - Registros vizinhos unidos em blocos quando o buraco entre eles é de até
+ *   maxGap registradores e o bloco não passa de PROFILE_MAX_BLOCK_WORDS (64)
+ * - Um decodificador por registro: bloco, posição no bloco e tipo de dado
+ *   (uint16, int16, uint32, int32, float32; 32 bits com ordem de palavras)
+ *
+ * No ciclo, readAllDevices() lê cada bloco com registros configurados em uma
+ * única transação (somente o trecho entre o primeiro e o último registro
+ * configurado) e decodifica os valores; registros fora do perfil, ou com tipo
+ * diferente do declarado, continuam sendo lidos um a um.
+ */
+
+#ifndef DEVICE_PROFILES_H
+#define DEVICE_PROFILES_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define PROFILE_DIR "/profiles"
+#define PROFILE_MAX_PROFILES 8
+#define PROFILE_MAX_REGISTERS 32
+#define PROFILE_MAX_BLOCKS 16
+#define PROFILE_MAX_BLOCK_WORDS 64         // Buffer de resposta do ModbusMaster (o Modbus permite 125)
+#define PROFILE_DEFAULT_MAX_GAP 4          // Registradores não usados lidos para evitar uma transação
+
+/**
+ * @struct ProfileRegister
+ * @brief Registro declarado no perfil (mesmos campos de ModbusRegister)
+ */
+struct ProfileRegister {
+    uint16_t address;
+    char variableName[32];
+    uint8_t registerType;                  // 0 = Leitura (0x04), 1 = Escrita, 2 = Leitura e Escrita (0x03)
+    uint8_t dataType;                      // REGISTER_DATA_*
+    float gain;
+    float offset;
+};
+
+/**
+ * @struct ProfileBlock
+ * @brief Uma transação de leitura do plano
+ */
+struct ProfileBlock {
+    uint8_t function;                      // 0x03 ou 0x04
+    uint16_t start;
+    uint8_t count;                         // Registradores (até PROFILE_MAX_BLOCK_WORDS)
+};
+
+/**
+ * @struct ProfileDecoder
+ * @brief Onde está e como decodificar um registro legível do perfil
+ */
+struct ProfileDecoder {
+    uint16_t address;
+    uint8_t function;
+    uint8_t dataType;
+    uint8_t block;                         // Índice em ProfilePlan.blocks
+    uint8_t offset;                        // Posição da primeira palavra no bloco
+};
+
+/**
+ * @struct ProfilePlan
+ * @brief Plano de leitura compilado
+ */
+struct ProfilePlan {
+    uint8_t blockCount;
+    ProfileBlock blocks[PROFILE_MAX_BLOCKS];
+    uint8_t decoderCount;
+    ProfileDecoder decoders[PROFILE_MAX_REGISTERS];
+};
+
+/**
+ * @struct DeviceProfile
+ * @brief Perfil carregado
+ */
+struct DeviceProfile {
+    char name[24];                         // Também é o nome do arquivo (letras, números, '_' e '-')
+    char description[64];
+    uint8_t maxGap;
+    uint8_t registerCount;
+    ProfileRegister registers[PROFILE_MAX_REGISTERS];
+    ProfilePlan plan;
+};
+
+/**
+ * @brief Carrega e compila os perfis de PROFILE_DIR (precisa do LittleFS montado)
+ */
+void profilesInit();
+
+/**
+ * @brief Monta o plano de leitura do perfil (profile->plan)
+ * @param error Motivo da recusa (registros sobrepostos, blocos demais...)
+ * @return false se o mapa de registros é inválido
+ */
+bool profileCompile(DeviceProfile* profile, String* error);
+
+/**
+ * @brief Lê um perfil de JSON e o compila
+ * @return false se o JSON ou o mapa de registros é inválido (motivo em error)
+ */
+bool profileFromJson(JsonObjectConst obj, DeviceProfile* profile, String* error);
+
+/**
+ * @brief Converte um perfil em JSON
+ * @param includePlan Inclui os blocos e decodificadores compilados
+ */
+void profileToJson(const DeviceProfile* profile, JsonObject obj, bool includePlan);
+
+uint8_t profileCount();
+
+/**
+ * @brief Copia o perfil na posição index (listagem)
+ */
+bool profileGetAt(uint8_t index, DeviceProfile* profile);
+
+/**
+ * @brief Copia o perfil com o nome dado
+ */
+bool profileGet(const char* name, DeviceProfile* profile);
+
+/**
+ * @brief Copia só o plano compilado do perfil (ciclo de leitura)
+ * @return false se não há perfil com esse nome
+ */
+bool profileGetPlan(const char* name, ProfilePlan* plan);
+
+/**
+ * @brief Instala o perfil (substitui o de mesmo nome) e grava em PROFILE_DIR
+ */
+bool profileSave(const DeviceProfile* profile);
+
+/**
+ * @brief Remove o perfil da memória e de PROFILE_DIR
+ */
+bool profileDelete(const char* name);
+
+/**
+ * @brief Nome de um tipo de dado ("uint16", "float32_lsw"...)
+ */
+const char* registerDataTypeName(uint8_t dataType);
+
+#endif // DEVICE_PROFILES_H
@@ -7,6 +7,9 @@
 #include "modbus_handler.h"
 #include "config.h"
 #include "console.h"
+#include "psychrometrics.h"
+#include "modbus_broadcast.h"
+#include "modbus_queue.h"
 #include <math.h>
 #include <ctype.h>
 #include <string.h>
@@ -20,23 +23,93 @@ void setExpressionSideEffectsEnabled(bool enabled) {
     g_expressionSideEffectsEnabled = enabled;
 }
 
-// Registros do display conforme manual (seções 4.1.2 a 4.1.4)
+// Registros do display conforme manual (seções 4.1.2 a 4.1.4): bloco contínuo 0x0010-0x0013
 static const uint16_t kDisplayDecimalPointRegister = 0x0010;
 static const uint16_t kDisplaySignRegister = 0x0011;
 static const uint16_t kDisplayUpperRegister = 0x0012;
 static const uint16_t kDisplayLowerRegister = 0x0013;
+static const uint8_t kDisplayBlockWords = 4;
+
+// Cache das últimas palavras escritas por display: valor, sinal e ponto iguais não
+// geram quadro. A entrada expira para reescrever displays que reiniciaram.
+#define DISPLAY_CACHE_SIZE 16
+#define DISPLAY_CACHE_REFRESH_MS 30000
+
+struct DisplayCacheEntry {
+    bool valid;
+    uint8_t slaveAddr;
+    uint16_t words[kDisplayBlockWords];
+    uint32_t writtenMs;
+};
+
+static DisplayCacheEntry s_displayCache[DISPLAY_CACHE_SIZE];
+static uint32_t s_displayWrites = 0;
+static uint32_t s_displaySkipped = 0;
+
+// Entrada do display (ou a mais antiga, para reutilizar)
+static DisplayCacheEntry* displayCacheEntry(uint8_t slaveAddr) {
+    DisplayCacheEntry* oldest = &s_displayCache[0];
+    for (int k = 0; k < DISPLAY_CACHE_SIZE; k++) {
+        DisplayCacheEntry& entry = s_displayCache[k];
+        if (entry.valid && entry.slaveAddr == slaveAddr) {
+            return &entry;
+        }
+        if (!entry.valid) {
+            if (oldest->valid) {
+                oldest = &entry;
+            }
+        } else if (oldest->valid && (int32_t)(entry.writtenMs - oldest->writtenMs) < 0) {
+            oldest = &entry;
+        }
+    }
+    oldest->valid = false;
+    oldest->slaveAddr = slaveAddr;
+    return oldest;
+}
+
+// Atualiza o cache com o resultado de uma escrita do bloco: só o que chegou ao display fica
+static void displayCacheUpdate(uint8_t slaveAddr, const uint16_t* words, bool ok) {
+    for (int k = 0; k < DISPLAY_CACHE_SIZE; k++) {
+        DisplayCacheEntry& entry = s_displayCache[k];
+        if (!entry.valid) {
+            continue;
+        }
+        // Broadcast altera todos os displays; uma escrita individual faz aquele display
+        // deixar de mostrar o último broadcast
+        if (entry.slaveAddr == slaveAddr || slaveAddr == 0 || entry.slaveAddr == 0) {
+            entry.valid = false;
+        }
+    }
+    if (!ok) {
+        return;
+    }
+    DisplayCacheEntry* cached = displayCacheEntry(slaveAddr);
+    memcpy(cached->words, words, sizeof(cached->words));
+    cached->writtenMs = millis();
+    cached->valid = true;
+}
+
+// Resultado das escritas sincronizadas, chamado por modbusStageFlush() após cada envio
+static void displayStageResult(uint8_t slaveAddress, uint16_t registerAddress, const uint16_t* words, uint8_t count,
+                               bool ok) {
+    if (registerAddress == kDisplayDecimalPointRegister && count == kDisplayBlockWords) {
+        displayCacheUpdate(slaveAddress, words, ok);
+    }
+}
+
+void getDisplayWriteStats(uint32_t* writes, uint32_t* skipped) {
+    *writes = s_displayWrites;
+    *skipped = s_displaySkipped;
+}
 
 // Escreve o valor no display 7 segmentos via Modbus
 // Esta função pode ser chamada múltiplas vezes para diferentes endereços Modbus
+// Endereço 0 = broadcast (todos os displays); no modo sincronizado a escrita fica
+// na lista enviada ao fim dos cálculos
 static bool writeDisplayRegisters(double value, uint8_t slaveAddr, uint8_t digits, uint16_t decimalPoint, char* errorMsg, size_t errorMsgSize) {
-    // Log de debug para verificar se a função está sendo chamada
-    char logMsg[128];
-    snprintf(logMsg, sizeof(logMsg), "[Display] Escrevendo valor %.2f no endereco %u, digitos: %u, ponto: %u\r\n", value, slaveAddr, digits, decimalPoint);
-    consolePrint(logMsg);
-    
-    if (slaveAddr < 1 || slaveAddr > 247) {
+    if (slaveAddr > 247) {
         if (errorMsg && errorMsgSize > 0) {
-            snprintf(errorMsg, errorMsgSize, "Endereco Modbus invalido (1-247): %u", slaveAddr);
+            snprintf(errorMsg, errorMsgSize, "Endereco Modbus invalido (0-247): %u", slaveAddr);
         }
         return false;
     }
@@ -57,11 +130,6 @@ static bool writeDisplayRegisters(double value, uint8_t slaveAddr, uint8_t digit
         value = (value < 0.0) ? -maxValue : maxValue;
     }
     
-    uint32_t absValue = (uint32_t)llround(fabs(value));
-    uint16_t lower = (uint16_t)(absValue & 0xFFFF);
-    uint16_t upper = (uint16_t)((absValue >> 16) & 0xFFFF);
-    uint16_t signValue = (value < 0.0) ? 1 : 0;
-    
     // Valida posição do ponto decimal (já validado antes, mas valida novamente por segurança)
     if (decimalPoint > 7) {
         if (errorMsg && errorMsgSize > 0) {
@@ -70,6 +138,24 @@ static bool writeDisplayRegisters(double value, uint8_t slaveAddr, uint8_t digit
         return false;
     }
     
+    // Bloco 0x0010-0x0013: ponto decimal, sinal, parte superior e inferior do valor
+    // (com até 4 dígitos a parte superior é sempre 0)
+    uint32_t absValue = (uint32_t)llround(fabs(value));
+    uint16_t words[kDisplayBlockWords];
+    words[kDisplayDecimalPointRegister - kDisplayDecimalPointRegister] = decimalPoint;
+    words[kDisplaySignRegister - kDisplayDecimalPointRegister] = (absValue != 0 && value < 0.0) ? 1 : 0;
+    words[kDisplayUpperRegister - kDisplayDecimalPointRegister] = (uint16_t)((absValue >> 16) & 0xFFFF);
+    words[kDisplayLowerRegister - kDisplayDecimalPointRegister] = (uint16_t)(absValue & 0xFFFF);
+    
+    // Display já mostra exatamente isso: nenhum quadro
+    uint32_t nowMs = millis();
+    DisplayCacheEntry* cached = displayCacheEntry(slaveAddr);
+    if (cached->valid && memcmp(cached->words, words, sizeof(words)) == 0 &&
+        nowMs - cached->writtenMs < DISPLAY_CACHE_REFRESH_MS) {
+        s_displaySkipped++;
+        return true;
+    }
+    
     // CRÍTICO: Garante que o Modbus está configurado antes de usar
     // Se não estiver configurado, inicializa com os parâmetros da configuração
     if (currentBaudRate == 0) {
@@ -83,122 +169,95 @@ static bool writeDisplayRegisters(double value, uint8_t slaveAddr, uint8_t digit
     if (timeout > 1000) timeout = 1000;  // Máximo 1000ms
     Serial2.setTimeout(timeout);
     
-    // CRÍTICO: Configura endereço do dispositivo Modbus e garante que callbacks estão configurados
-    // Os callbacks preTransmission/postTransmission são essenciais para controle RS485
-    // IMPORTANTE: Sempre reconfigura os callbacks, pois podem ter sido perdidos
-    node.begin(slaveAddr, Serial2);
-    node.preTransmission(preTransmission);
-    node.postTransmission(postTransmission);
-    
-    // Escreve registradores do display (0x0012/0x0013) conforme quantidade de digitos
-    uint8_t result;
-    
-    // Se tem mais de 4 dígitos, escreve o registro superior primeiro
-    if (digits > 4) {
-        result = node.writeSingleRegister(kDisplayUpperRegister, upper);
-        if (result != node.ku8MBSuccess) {
-            const char* errorDesc = "Erro desconhecido";
-            switch (result) {
-                case 0xE1: errorDesc = "Timeout na resposta"; break;
-                case 0xE2: errorDesc = "Resposta invalida ou dispositivo nao respondeu"; break;
-                case 0xE3: errorDesc = "CRC invalido"; break;
-                case 0xE4: errorDesc = "Funcao Modbus ilegal"; break;
-                case 0xE5: errorDesc = "Endereco de registro invalido"; break;
-                case 0xE6: errorDesc = "Valor invalido"; break;
-                default: errorDesc = "Erro Modbus"; break;
-            }
-            char debugMsg[256];
-            snprintf(debugMsg, sizeof(debugMsg), "[Display] Erro ao escrever registro superior (0x%04X) no endereco %u: 0x%02X (%s)\r\n", kDisplayUpperRegister, slaveAddr, result, errorDesc);
-            consolePrint(debugMsg);
-            if (errorMsg && errorMsgSize > 0) {
-                snprintf(errorMsg, errorMsgSize, "Erro Modbus ao escrever registro superior (0x%04X) no endereco %u: 0x%02X (%s)", kDisplayUpperRegister, slaveAddr, result, errorDesc);
-            }
-            return false;
-        }
-        yield();
-        vTaskDelay(pdMS_TO_TICKS(20)); // Pequeno delay para estabilidade RS485
-        yield();
+    // Um único 0x10 com o bloco inteiro (endereço e callbacks RS485 configurados por modbusSyncWrite)
+    bool staged = modbusStageActive();
+    if (staged) {
+        modbusStageSetResultFn(displayStageResult);
     }
-    
-    // Sempre escreve o registro inferior (contém os 4 dígitos menos significativos)
-    result = node.writeSingleRegister(kDisplayLowerRegister, lower);
+    uint8_t result = modbusSyncWrite(slaveAddr, kDisplayDecimalPointRegister, words, kDisplayBlockWords);
     if (result != node.ku8MBSuccess) {
-        const char* errorDesc = "Erro desconhecido";
-        switch (result) {
-            case 0xE1: errorDesc = "Timeout na resposta"; break;
-            case 0xE2: errorDesc = "Resposta invalida ou dispositivo nao respondeu"; break;
-            case 0xE3: errorDesc = "CRC invalido"; break;
-            case 0xE4: errorDesc = "Funcao Modbus ilegal"; break;
-            case 0xE5: errorDesc = "Endereco de registro invalido"; break;
-            case 0xE6: errorDesc = "Valor invalido"; break;
-            default: errorDesc = "Erro Modbus"; break;
+        displayCacheUpdate(slaveAddr, words, false);
+        String errorDesc = modbusResultDescription(result);
+        if (errorMsg && errorMsgSize > 0) {
+            snprintf(errorMsg, errorMsgSize, "Erro Modbus ao escrever display (0x%04X-0x%04X) no endereco %u: 0x%02X (%s)",
+                     kDisplayDecimalPointRegister, kDisplayLowerRegister, slaveAddr, result, errorDesc.c_str());
         }
-        char debugMsg[256];
-        snprintf(debugMsg, sizeof(debugMsg), "[Display] Erro ao escrever registro inferior (0x%04X) no endereco %u: 0x%02X (%s)\r\n", kDisplayLowerRegister, slaveAddr, result, errorDesc);
-        consolePrint(debugMsg);
+        return false;
+    }
+    s_displayWrites++;
+    
+    // Modo sincronizado: o quadro só foi para a lista. As entradas afetadas deixam de
+    // valer até o envio (displayStageResult), para uma nova chamada no mesmo ciclo
+    // (inclusive um broadcast depois desta) não ser pulada
+    displayCacheUpdate(slaveAddr, words, !staged);
+    return true;
+}
+
+// display(valor, endereco, digitos[, ponto]): valida os argumentos e, com efeitos
+// colaterais habilitados, escreve no display (compartilhado com o código compilado)
+bool expressionDisplay(double valueArg, double slaveArg, double digitsArg, double decimalArg, char* errorMsg, size_t errorMsgSize) {
+    // Converte argumentos para inteiros com validação
+    uint8_t slaveAddr = (uint8_t)llround(slaveArg);
+    uint8_t digits = (uint8_t)llround(digitsArg);
+    uint16_t decimalPoint = (uint16_t)llround(decimalArg);
+    
+    // Valida endereço Modbus (0 = broadcast)
+    if (slaveArg < 0.0 || slaveArg > 247.0) {
         if (errorMsg && errorMsgSize > 0) {
-            snprintf(errorMsg, errorMsgSize, "Erro Modbus ao escrever registro inferior (0x%04X) no endereco %u: 0x%02X (%s)", kDisplayLowerRegister, slaveAddr, result, errorDesc);
+            snprintf(errorMsg, errorMsgSize, "Endereco Modbus invalido (0-247): %.0f", slaveArg);
         }
         return false;
     }
-    yield();
-    vTaskDelay(pdMS_TO_TICKS(20)); // Pequeno delay para estabilidade RS485
-    yield();
     
-    // Configura sinal e ponto decimal conforme manual
-    result = node.writeSingleRegister(kDisplaySignRegister, signValue);
-    if (result != node.ku8MBSuccess) {
-        const char* errorDesc = "Erro desconhecido";
-        switch (result) {
-            case 0xE1: errorDesc = "Timeout na resposta"; break;
-            case 0xE2: errorDesc = "Resposta invalida ou dispositivo nao respondeu"; break;
-            case 0xE3: errorDesc = "CRC invalido"; break;
-            case 0xE4: errorDesc = "Funcao Modbus ilegal"; break;
-            case 0xE5: errorDesc = "Endereco de registro invalido"; break;
-            case 0xE6: errorDesc = "Valor invalido"; break;
-            default: errorDesc = "Erro Modbus"; break;
+    // Valida quantidade de dígitos
+    if (digits < 1 || digits > 8) {
+        if (errorMsg && errorMsgSize > 0) {
+            snprintf(errorMsg, errorMsgSize, "Quantidade de digitos invalida (1-8): %u", digits);
         }
-        char debugMsg[256];
-        snprintf(debugMsg, sizeof(debugMsg), "[Display] Erro ao escrever registro de sinal (0x%04X) no endereco %u: 0x%02X (%s)\r\n", kDisplaySignRegister, slaveAddr, result, errorDesc);
-        consolePrint(debugMsg);
+        return false;
+    }
+    
+    // Valida posição do ponto decimal
+    if (decimalPoint > 7) {
         if (errorMsg && errorMsgSize > 0) {
-            snprintf(errorMsg, errorMsgSize, "Erro Modbus ao escrever registro de sinal (0x%04X) no endereco %u: 0x%02X (%s)", kDisplaySignRegister, slaveAddr, result, errorDesc);
+            snprintf(errorMsg, errorMsgSize, "Posicao do ponto decimal invalida (0-7): %u", decimalPoint);
         }
         return false;
     }
-    yield();
-    vTaskDelay(pdMS_TO_TICKS(20)); // Pequeno delay para estabilidade RS485
-    yield();
     
-    result = node.writeSingleRegister(kDisplayDecimalPointRegister, decimalPoint);
-    if (result != node.ku8MBSuccess) {
-        const char* errorDesc = "Erro desconhecido";
-        switch (result) {
-            case 0xE1: errorDesc = "Timeout na resposta"; break;
-            case 0xE2: errorDesc = "Resposta invalida ou dispositivo nao respondeu"; break;
-            case 0xE3: errorDesc = "CRC invalido"; break;
-            case 0xE4: errorDesc = "Funcao Modbus ilegal"; break;
-            case 0xE5: errorDesc = "Endereco de registro invalido"; break;
-            case 0xE6: errorDesc = "Valor invalido"; break;
-            default: errorDesc = "Erro Modbus"; break;
+    // CRÍTICO: Verifica se efeitos colaterais estão habilitados
+    // Se não estiverem, a função display não escreve no Modbus (apenas retorna o valor)
+    if (g_expressionSideEffectsEnabled) {
+        bool ok = writeDisplayRegisters(valueArg, slaveAddr, digits, decimalPoint, errorMsg, errorMsgSize);
+        if (!ok) {
+            // Log do erro para debug
+            if (errorMsg && errorMsgSize > 0 && strlen(errorMsg) > 0) {
+                char logMsg[256];
+                snprintf(logMsg, sizeof(logMsg), "[Display] Erro: %s\r\n", errorMsg);
+                consolePrint(logMsg);
+            }
+            return false;
         }
-        char debugMsg[256];
-        snprintf(debugMsg, sizeof(debugMsg), "[Display] Erro ao escrever registro de ponto decimal (0x%04X) no endereco %u: 0x%02X (%s)\r\n", kDisplayDecimalPointRegister, slaveAddr, result, errorDesc);
-        consolePrint(debugMsg);
+    }
+    // Se efeitos colaterais não estão habilitados, apenas retorna o valor sem escrever
+    // Isso permite usar display() em testes sem escrever no Modbus
+    return true;
+}
+
+// bcast(registro, valor): valida e, com efeitos colaterais habilitados, envia
+bool expressionBroadcast(double registerArg, double valueArg, char* errorMsg, size_t errorMsgSize) {
+    if (registerArg < 0.0 || registerArg > 65535.0 || valueArg < 0.0 || valueArg > 65535.0) {
         if (errorMsg && errorMsgSize > 0) {
-            snprintf(errorMsg, errorMsgSize, "Erro Modbus ao escrever registro de ponto decimal (0x%04X) no endereco %u: 0x%02X (%s)", kDisplayDecimalPointRegister, slaveAddr, result, errorDesc);
+            snprintf(errorMsg, errorMsgSize, "Funcao bcast: registro e valor devem estar entre 0 e 65535");
         }
         return false;
     }
-    yield();
-    vTaskDelay(pdMS_TO_TICKS(20)); // Pequeno delay para estabilidade RS485
-    yield();
-    
-    // Log de sucesso
-    char successMsg[128];
-    snprintf(successMsg, sizeof(successMsg), "[Display] Sucesso: Valor %.2f escrito no endereco %u\r\n", value, slaveAddr);
-    consolePrint(successMsg);
     
+    // Sem efeitos colaterais (teste de cálculo) apenas retorna o valor
+    if (g_expressionSideEffectsEnabled) {
+        uint16_t word = (uint16_t)llround(valueArg);
+        modbusSyncWrite(0, (uint16_t)llround(registerArg), &word, 1);
+    }
     return true;
 }
 
@@ -401,7 +460,7 @@ static double evalTerm(const char** expr, Variable* variables, int varCount, boo
                         termSuccess = true;
                     } else if (strcmp(identifier, "display") == 0 || strcmp(identifier, "disp") == 0) {
                         // display(valor, endereco_modbus, digitos[, ponto_decimal])
-                        // endereco_modbus = endereco do dispositivo (slave)
+                        // endereco_modbus = endereco do dispositivo (slave); 0 = broadcast para todos os displays
                         // ponto_decimal = posicao do ponto (0-7). Default: 0
                         // Escreve no display 7 segmentos conforme manual do dispositivo
                         skipSpaces(expr);
@@ -458,70 +517,55 @@ static double evalTerm(const char** expr, Variable* variables, int varCount, boo
                         }
                         (*expr)++;
                         
-                        // Converte argumentos para inteiros com validação
-                        uint8_t slaveAddr = (uint8_t)llround(slaveArg);
-                        uint8_t digits = (uint8_t)llround(digitsArg);
-                        uint16_t decimalPoint = (uint16_t)llround(decimalArg);
-                        
-                        // Valida endereço Modbus
-                        if (slaveAddr < 1 || slaveAddr > 247) {
-                            if (errorMsg && errorMsgSize > 0) {
-                                snprintf(errorMsg, errorMsgSize, "Endereco Modbus invalido (1-247): %u", slaveAddr);
-                            }
+                        if (!expressionDisplay(valueArg, slaveArg, digitsArg, decimalArg, errorMsg, errorMsgSize)) {
                             *success = false;
                             return 0.0;
                         }
                         
-                        // Valida quantidade de dígitos
-                        if (digits < 1 || digits > 8) {
+                        // Retorna o valor original para permitir uso em expressões
+                        result = valueArg;
+                        termSuccess = true;
+                    } else if (strcmp(identifier, "bcast") == 0) {
+                        // bcast(registro, valor): escreve valor (0-65535) no registro de todos os
+                        // dispositivos em um único quadro para o endereço 0 (sem resposta).
+                        // No modo sincronizado vai depois das demais escritas (comando de aplicar)
+                        skipSpaces(expr);
+                        double registerArg = evalExpression(expr, variables, varCount, success, errorMsg, errorMsgSize);
+                        if (!*success) return 0.0;
+                        skipSpaces(expr);
+                        
+                        if (**expr != ',') {
                             if (errorMsg && errorMsgSize > 0) {
-                                snprintf(errorMsg, errorMsgSize, "Quantidade de digitos invalida (1-8): %u", digits);
+                                snprintf(errorMsg, errorMsgSize, "Funcao bcast requer 2 argumentos separados por virgula");
                             }
                             *success = false;
                             return 0.0;
                         }
+                        (*expr)++;
+                        skipSpaces(expr);
+                        
+                        double valueArg = evalExpression(expr, variables, varCount, success, errorMsg, errorMsgSize);
+                        if (!*success) return 0.0;
+                        skipSpaces(expr);
                         
-                        // Valida posição do ponto decimal
-                        if (decimalPoint > 7) {
+                        if (**expr != ')') {
                             if (errorMsg && errorMsgSize > 0) {
-                                snprintf(errorMsg, errorMsgSize, "Posicao do ponto decimal invalida (0-7): %u", decimalPoint);
+                                snprintf(errorMsg, errorMsgSize, "Parentese nao fechado na funcao bcast");
                             }
                             *success = false;
                             return 0.0;
                         }
+                        (*expr)++;
                         
-                                            // CRÍTICO: Verifica se efeitos colaterais estão habilitados
-                        // Se não estiverem, a função display não escreve no Modbus (apenas retorna o valor)
-                        if (g_expressionSideEffectsEnabled) {
-                            bool ok = writeDisplayRegisters(valueArg, slaveAddr, digits, decimalPoint, errorMsg, errorMsgSize);
-                            if (!ok) {
-                                // Log do erro para debug
-                                if (errorMsg && errorMsgSize > 0 && strlen(errorMsg) > 0) {
-                                    char logMsg[256];
-                                    snprintf(logMsg, sizeof(logMsg), "[Display] Erro: %s\r\n", errorMsg);
-                                    consolePrint(logMsg);
-                                }
-                                *success = false;
-                                return 0.0;
-                            }
+                        if (!expressionBroadcast(registerArg, valueArg, errorMsg, errorMsgSize)) {
+                            *success = false;
+                            return 0.0;
                         }
-                        // Se efeitos colaterais não estão habilitados, apenas retorna o valor sem escrever
-                        // Isso permite usar display() em testes sem escrever no Modbus
                         
-                        // Retorna o valor original para permitir uso em expressões
                         result = valueArg;
                         termSuccess = true;
                     } else if (strcmp(identifier, "pow") == 0) {
-                        // pow(base, expoente) - requer dois argumentos
-                        skipSpaces(expr);
-                        if (**expr != '(') {
-                            if (errorMsg && errorMsgSize > 0) {
-                                snprintf(errorMsg, errorMsgSize, "Funcao pow requer parentese");
-                            }
-                            *success = false;
-                            return 0.0;
-                        }
-                        (*expr)++; // Pula o parêntese de abertura
+                        // pow(base, expoente) - requer dois argumentos (o parêntese já foi consumido)
                         skipSpaces(expr);
                         
                         // Avalia o primeiro argumento (base)
@@ -558,6 +602,35 @@ static double evalTerm(const char** expr, Variable* variables, int varCount, boo
                         // Calcula potência
                         result = pow(base, exponent);
                         termSuccess = true;
+                    } else if (strcmp(identifier, "ur") == 0) {
+                        // ur(ts, tu) - umidade relativa psicrométrica com as constantes calibradas
+                        skipSpaces(expr);
+                        double ts = evalExpression(expr, variables, varCount, success, errorMsg, errorMsgSize);
+                        if (!*success) return 0.0;
+                        skipSpaces(expr);
+                        if (**expr != ',') {
+                            if (errorMsg && errorMsgSize > 0) {
+                                snprintf(errorMsg, errorMsgSize, "Funcao ur requer 2 argumentos (ts, tu)");
+                            }
+                            *success = false;
+                            return 0.0;
+                        }
+                        (*expr)++; // Pula a vírgula
+                        skipSpaces(expr);
+                        double tu = evalExpression(expr, variables, varCount, success, errorMsg, errorMsgSize);
+                        if (!*success) return 0.0;
+                        skipSpaces(expr);
+                        if (**expr != ')') {
+                            if (errorMsg && errorMsgSize > 0) {
+                                snprintf(errorMsg, errorMsgSize, "Parentese nao fechado na funcao ur");
+                            }
+                            *success = false;
+                            return 0.0;
+                        }
+                        (*expr)++; // Pula o parêntese de fechamento
+                        
+                        result = psychroRelativeHumidityCurrent(ts, tu);
+                        termSuccess = true;
                     } else {
                         // Funções normais (sin, cos, etc.) - apenas 1 argumento
                         double arg = evalExpression(expr, variables, varCount, success, errorMsg, errorMsgSize);
@@ -1046,6 +1119,25 @@ bool substituteDeviceValues(const char* expression, DeviceValues* deviceValues,
                             break;
                         }
                         pos++;
+                    } else if (*pos == '{') {
+                        // {d[i][j]} dentro dos argumentos (ex: display({d[0][0]}, 3, 4))
+                        const char* closeBrace = strchr(pos, '}');
+                        if (closeBrace == nullptr || (size_t)(closeBrace - pos) >= 32) {
+                            if (errorMsg && errorMsgSize > 0) {
+                                snprintf(errorMsg, errorMsgSize, "Erro: esperado } apos d[i][j]");
+                            }
+                            return false;
+                        }
+                        char placeholder[32];
+                        size_t placeholderLen = closeBrace - pos + 1;
+                        memcpy(placeholder, pos, placeholderLen);
+                        placeholder[placeholderLen] = '\0';
+                        if (!substituteDeviceValues(placeholder, deviceValues, output + outputPos, outputSize - outputPos,
+                                                    errorMsg, errorMsgSize, tempVariables, tempVarCount)) {
+                            return false;
+                        }
+                        outputPos += strlen(output + outputPos);
+                        pos = closeBrace + 1;
                     } else if (isalpha(*pos) || *pos == '_') {
                         // Pode ser variável temporária dentro dos argumentos - processa recursivamente
                         const char* argVarStart = pos;
@@ -54,6 +54,27 @@ bool evaluateExpression(const char* expression, Variable* variables, int varCoun
  */
 void setExpressionSideEffectsEnabled(bool enabled);
 
+/**
+ * @brief display(valor, endereco, digitos, ponto) com os argumentos já avaliados
+ *
+ * Valida os argumentos e, com efeitos colaterais habilitados, escreve no
+ * display. Usada pelo interpretador e pelo código compilado (script_compiler.h).
+ * @return false com a mensagem em errorMsg se um argumento é inválido ou a escrita falhou
+ */
+bool expressionDisplay(double valueArg, double slaveArg, double digitsArg, double decimalArg, char* errorMsg, size_t errorMsgSize);
+
+/**
+ * @brief bcast(registro, valor) com os argumentos já avaliados
+ */
+bool expressionBroadcast(double registerArg, double valueArg, char* errorMsg, size_t errorMsgSize);
+
+/**
+ * @brief Contadores da função display()
+ * @param writes Quadros enviados (um 0x10 por atualização)
+ * @param skipped Chamadas sem quadro (display já mostrava o mesmo valor, sinal e ponto)
+ */
+void getDisplayWriteStats(uint32_t* writes, uint32_t* skipped);
+
 /**
  * @brief Encontra o valor de uma variável pelo nome
  * @param varName Nome da variável
@@ -0,0 +1,168 @@
+/**
+ * @file lttb.cpp
+ * @brief Implementação da redução LTTB incremental
+ */
+
+#include "lttb.h"
+
+// Intervalo de tempo de uma amostra (amostras fora do período vão para as pontas)
+static uint32_t bucketOf(const LttbState* state, int64_t timeMs) {
+    if (timeMs <= state->fromMs) {
+        return 0;
+    }
+    int64_t bucket = (timeMs - state->fromMs) * (int64_t)state->bucketCount / state->spanMs;
+    if (bucket >= (int64_t)state->bucketCount) {
+        return state->bucketCount - 1;
+    }
+    return (uint32_t)bucket;
+}
+
+static bool leadPeek(LttbState* state, LttbPoint* point) {
+    if (!state->leadPending) {
+        if (state->leadDone || !state->read(state->leadCursor, &state->leadNext)) {
+            state->leadDone = true;
+            return false;
+        }
+        state->leadPending = true;
+    }
+    *point = state->leadNext;
+    return true;
+}
+
+static inline void leadConsume(LttbState* state) {
+    state->leadLast = state->leadNext;
+    state->leadPending = false;
+}
+
+// Garante em state->average a média do primeiro intervalo não vazio depois de bucket
+static void updateAverage(LttbState* state, uint32_t bucket) {
+    if (state->averageBucket > (int32_t)bucket) {
+        return;
+    }
+
+    LttbPoint point;
+    if (!state->leadStarted) {
+        // O primeiro ponto é emitido sozinho e não entra nas médias
+        state->leadStarted = true;
+        if (leadPeek(state, &point)) {
+            leadConsume(state);
+        }
+    }
+
+    while (leadPeek(state, &point) && bucketOf(state, point.timeMs) <= bucket) {
+        leadConsume(state);
+    }
+
+    if (state->leadDone) {
+        // Não há intervalo seguinte: o último ponto da série fecha o triângulo
+        state->average = state->leadLast;
+        state->averageBucket = (int32_t)state->bucketCount;
+        return;
+    }
+
+    uint32_t next = bucketOf(state, point.timeMs);
+    int64_t baseMs = point.timeMs;
+    double sumOffset = 0.0;
+    double sumValue = 0.0;
+    uint32_t count = 0;
+    while (leadPeek(state, &point) && bucketOf(state, point.timeMs) == next) {
+        sumOffset += (double)(point.timeMs - baseMs);
+        sumValue += point.value;
+        count++;
+        leadConsume(state);
+    }
+
+    state->average.timeMs = baseMs + (int64_t)(sumOffset / count);
+    state->average.value = (float)(sumValue / count);
+    state->averageBucket = (int32_t)next;
+}
+
+// Dobro da área do triângulo anchor-candidate-average (tempos relativos ao anchor)
+static inline double triangleArea(const LttbPoint* anchor, const LttbPoint* candidate, const LttbPoint* average) {
+    double bx = (double)(candidate->timeMs - anchor->timeMs);
+    double cx = (double)(average->timeMs - anchor->timeMs);
+    double by = (double)candidate->value - anchor->value;
+    double cy = (double)average->value - anchor->value;
+    double area = bx * cy - cx * by;
+    return area < 0 ? -area : area;
+}
+
+static bool mainRead(LttbState* state) {
+    if (!state->read(state->mainCursor, &state->mainNext)) {
+        state->mainPending = false;
+        return false;
+    }
+    state->mainPending = true;
+    state->mainCount++;
+    return true;
+}
+
+void lttbBegin(LttbState* state, LttbReadFn read, void* mainCursor, void* leadCursor,
+               int64_t fromMs, int64_t toMs, uint32_t maxPoints) {
+    memset(state, 0, sizeof(LttbState));
+    if (maxPoints < LTTB_MIN_POINTS) maxPoints = LTTB_MIN_POINTS;
+    if (maxPoints > LTTB_MAX_POINTS) maxPoints = LTTB_MAX_POINTS;
+
+    state->read = read;
+    state->mainCursor = mainCursor;
+    state->leadCursor = leadCursor;
+    state->fromMs = fromMs;
+    state->spanMs = toMs > fromMs ? toMs - fromMs + 1 : 1;
+    state->bucketCount = maxPoints - 2;
+    state->averageBucket = -1;
+    state->phase = 0;
+}
+
+bool lttbNext(LttbState* state, LttbPoint* point) {
+    if (state->phase == 0) {
+        if (!mainRead(state)) {
+            state->phase = 3;
+            return false;
+        }
+        state->anchor = state->mainNext;
+        state->mainLast = state->mainNext;
+        state->mainPending = false;
+        state->phase = 1;
+        *point = state->anchor;
+        return true;
+    }
+
+    if (state->phase == 1) {
+        if (!state->mainPending && !mainRead(state)) {
+            state->phase = 2;
+        } else {
+            uint32_t bucket = bucketOf(state, state->mainNext.timeMs);
+            updateAverage(state, bucket);
+
+            LttbPoint best = state->mainNext;
+            double bestArea = -1.0;
+            do {
+                double area = triangleArea(&state->anchor, &state->mainNext, &state->average);
+                if (area > bestArea) {
+                    bestArea = area;
+                    best = state->mainNext;
+                }
+                state->mainLast = state->mainNext;
+                if (!mainRead(state)) {
+                    state->phase = 2;
+                    break;
+                }
+            } while (bucketOf(state, state->mainNext.timeMs) == bucket);
+
+            state->anchor = best;
+            *point = best;
+            return true;
+        }
+    }
+
+    if (state->phase == 2) {
+        state->phase = 3;
+        // Último ponto da série, se ainda não foi o escolhido do seu intervalo
+        if (state->mainLast.timeMs != state->anchor.timeMs || state->mainLast.value != state->anchor.value) {
+            state->anchor = state->mainLast;
+            *point = state->mainLast;
+            return true;
+        }
+    }
+    return false;
+}
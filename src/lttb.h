@@ -0,0 +1,81 @@
+/**
+ * @file lttb.h
+ * @brief Redução de séries temporais por Largest-Triangle-Three-Buckets
+ *
+ * O período [fromMs, toMs] é dividido em (maxPoints - 2) intervalos de tempo
+ * iguais. A primeira e a última amostra são sempre mantidas; de cada intervalo
+ * fica a amostra que forma o maior triângulo com o ponto escolhido no
+ * intervalo anterior e a média do próximo intervalo não vazio.
+ *
+ * A redução é incremental e usa memória constante: duas leituras da mesma
+ * série andam em paralelo, uma escolhendo os pontos e outra um intervalo à
+ * frente calculando a média. Cada chamada de lttbNext() devolve um ponto,
+ * permitindo gerar a resposta HTTP em partes.
+ */
+
+#ifndef LTTB_H
+#define LTTB_H
+
+#include <Arduino.h>
+
+#define LTTB_MIN_POINTS 3
+#define LTTB_MAX_POINTS 2000
+
+/**
+ * @struct LttbPoint
+ * @brief Amostra de entrada/saída
+ */
+struct LttbPoint {
+    int64_t timeMs;
+    float value;
+};
+
+/**
+ * @brief Lê a próxima amostra de um cursor (em ordem crescente de tempo)
+ * @return false no fim da série
+ */
+typedef bool (*LttbReadFn)(void* cursor, LttbPoint* point);
+
+/**
+ * @struct LttbState
+ * @brief Estado da redução (tamanho constante)
+ */
+struct LttbState {
+    LttbReadFn read;
+    void* mainCursor;          // Escolhe os pontos de cada intervalo
+    void* leadCursor;          // Mesma série, um intervalo à frente (médias)
+    int64_t fromMs;
+    int64_t spanMs;
+    uint32_t bucketCount;
+    uint8_t phase;             // 0 = primeiro ponto, 1 = intervalos, 2 = último ponto, 3 = fim
+
+    LttbPoint anchor;          // Último ponto emitido (vértice A)
+    LttbPoint mainLast;        // Última amostra lida pelo cursor principal
+    bool mainPending;          // mainNext já lido e ainda não processado
+    LttbPoint mainNext;
+    uint32_t mainCount;
+
+    bool leadStarted;
+    bool leadPending;
+    bool leadDone;
+    LttbPoint leadNext;
+    LttbPoint leadLast;
+    int32_t averageBucket;     // Intervalo da média calculada (-1 = nenhuma)
+    LttbPoint average;         // Média do intervalo seguinte (vértice C)
+};
+
+/**
+ * @brief Inicia a redução de uma série
+ * @param mainCursor e leadCursor devem ler a mesma série, cada um do início
+ * @param maxPoints Pontos máximos na saída (limitado a LTTB_MIN_POINTS..LTTB_MAX_POINTS)
+ */
+void lttbBegin(LttbState* state, LttbReadFn read, void* mainCursor, void* leadCursor,
+               int64_t fromMs, int64_t toMs, uint32_t maxPoints);
+
+/**
+ * @brief Obtém o próximo ponto da série reduzida
+ * @return false quando a série terminou
+ */
+bool lttbNext(LttbState* state, LttbPoint* point);
+
+#endif // LTTB_H
@@ -22,6 +22,17 @@
 #include "console.h"
 #include "kalman_filter.h"
 #include "wireguard_manager.h"
+#include "data_logger.h"
+#include "alarm_engine.h"
+#include "pid_control.h"
+#include "reactive_rules.h"
+#include "modbus_queue.h"
+#include "psychrometrics.h"
+#include "modbus_scan.h"
+#include "modbus_autodetect.h"
+#include "device_profiles.h"
+#include "modbus_slave.h"
+#include "bus_capture.h"
 
 // Variáveis globais
 unsigned long lastCalculationTime = 0;
@@ -72,11 +83,26 @@ void setup() {
 
     // CRÍTICO: inicializa mutex do config antes de carregar/usar config em múltiplas tasks
     initConfigMutex();
+    // Fila de escritas Modbus: usada pelo servidor web e pelo loop
+    modbusQueueInit();
 
     loadConfig();
     Serial.println("Configuração carregada!");
     Serial.flush();
     
+    // Inicializa o registro histórico (precisa do LittleFS montado)
+    if (littleFSStatus) {
+        dataLoggerInit();
+        alarmEngineInit();
+        reactiveRulesInit();
+        pidEngineInit();
+        scriptsInit();
+        psychroInit();
+        profilesInit();
+    }
+    // Escravo Modbus: cria o mutex mesmo sem LittleFS (fica a configuração padrão)
+    modbusSlaveInit();
+    
     // Configura WiFi baseado na configuração salva
     Serial.print("Modo WiFi configurado: '");
     Serial.print(config.wifi.mode);
@@ -167,9 +193,8 @@ void setup() {
             consolePrint("[RTC] Tentando sincronizar NTP...\r\n");
             syncNTP();
         } else if (config.rtc.epochTime > 0) {
-            // Usa data/hora salva anteriormente
-            rtcInitialized = true;
-            config.rtc.bootTime = millis();  // Atualiza bootTime para continuar contando
+            // Usa data/hora salva anteriormente (continua contando a partir dela)
+            rtcSetEpoch(config.rtc.epochTime);
             Serial.println("RTC inicializado com data/hora salva");
             
             char dateStr[11];
@@ -261,6 +286,9 @@ void loop() {
         }
     }
     
+    // Mantém o mapeamento tempo monotônico -> UTC alinhado ao NTP
+    rtcService();
+    
     // Executa cálculos a cada 1 segundo
     unsigned long currentTime = millis();
     if (currentTime - lastCalculationTime >= CALCULATION_INTERVAL_MS) {
@@ -288,5 +316,38 @@ void loop() {
         }
     }
     
+    // Atrasos de alarmes, dados parados e eventos para o console
+    alarmService(monotonicMicros());
+    
+    // Tabela do escravo Modbus (Serial1) com os valores do ciclo e o estado dos alarmes;
+    // as requisições são respondidas pela task de eventos da UART, não pelo loop
+    modbusSlaveUpdate();
+    
+    // Fora do ciclo de leitura o barramento fica livre: escritas na fila
+    // (regras de reação e operador) e blocos PID com período vencido
+    modbusQueueService();
+    ruleService();
+    pidService(monotonicMicros());
+    
+    // Scripts nomeados prontos e o código de cálculo que não coube na fatia do tick
+    calculationsService();
+    
+    // Fecha o último quadro recebido na captura do barramento (silêncio após a resposta)
+    busCaptureService();
+    
+    // Busca de dispositivos só no tempo ocioso que sobra até o próximo ciclo
+    if (millis() - lastCalculationTime + SCAN_SLOT_BUDGET_MS < CALCULATION_INTERVAL_MS) {
+        modbusScanService(SCAN_SLOT_BUDGET_MS * 1000UL);
+    }
+    
+    // Detecção de velocidade/enquadramento pedida pela interface (reconfigura o barramento)
+    modbusAutodetectService();
+    
+    // Grava blocos pendentes do histórico fora da janela de leitura Modbus
+    dataLoggerService();
+    
+    // Tamanho de uma exportação do histórico para retomada por Range
+    historyExportService();
+    
     delay(10);
 }
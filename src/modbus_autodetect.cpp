@@ -0,0 +1,230 @@
+/**
+ * @file modbus_autodetect.cpp
+ * @brief Implementação da detecção automática de velocidade e enquadramento
+ */
+
+#include "modbus_autodetect.h"
+#include "config.h"
+#include "config_storage.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "modbus_rtu.h"
+#include "bus_capture.h"
+#include <HardwareSerial.h>
+
+// Velocidades da mais rápida para a mais lenta (mesmas opções da interface)
+static const uint32_t kBauds[] = { 115200, 57600, 38400, 19200, 9600, 4800, 2400, 1200 };
+#define AUTODETECT_BAUD_COUNT (sizeof(kBauds) / sizeof(kBauds[0]))
+
+// Enquadramentos de 8 bits; os com paridade primeiro, pois um escravo sem
+// paridade às vezes aceita o bit de paridade como stop bit, mas não o contrário
+static const uint8_t kFramings[][2] = {
+    { MODBUS_PARITY_EVEN, 1 },
+    { MODBUS_PARITY_ODD, 1 },
+    { MODBUS_PARITY_NONE, 2 },
+    { MODBUS_PARITY_NONE, 1 },
+};
+#define AUTODETECT_FRAMING_COUNT (sizeof(kFramings) / sizeof(kFramings[0]))
+
+static AutodetectRequest s_request;
+static AutodetectResult s_result = {};
+static volatile bool s_pending = false;
+
+bool modbusAutodetectRequest(const AutodetectRequest* request) {
+    if (s_pending) {
+        return false;
+    }
+    s_request = *request;
+    if (s_request.slaveCount > AUTODETECT_MAX_SLAVES) {
+        s_request.slaveCount = AUTODETECT_MAX_SLAVES;
+    }
+    // Sem lista explícita, testa os dispositivos habilitados da configuração
+    if (s_request.slaveCount == 0) {
+        for (int i = 0; i < config.deviceCount && s_request.slaveCount < AUTODETECT_MAX_SLAVES; i++) {
+            if (config.devices[i].enabled && config.devices[i].slaveAddress >= 1 && config.devices[i].slaveAddress <= 247) {
+                s_request.slaves[s_request.slaveCount++] = config.devices[i].slaveAddress;
+            }
+        }
+    }
+    if (s_request.slaveCount == 0) {
+        return false;
+    }
+    if (s_request.budgetMs == 0) {
+        s_request.budgetMs = AUTODETECT_BUDGET_MS;
+    }
+    if (s_request.turnaroundMs == 0) {
+        s_request.turnaroundMs = AUTODETECT_TURNAROUND_MS;
+    }
+    s_result.pending = true;
+    s_pending = true;
+    return true;
+}
+
+// Registro lido no teste: o primeiro configurado do escravo (ou 0); exceção também serve
+static uint16_t probeRegisterFor(uint8_t slave) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (config.devices[i].slaveAddress == slave && config.devices[i].registerCount > 0) {
+            return config.devices[i].registers[0].address;
+        }
+    }
+    return 0;
+}
+
+// CRÍTICO: troca enquadramento por setupModbus() (reabre a UART) e a velocidade
+// por updateBaudRate(), bem mais barato; currentBaudRate acompanha para que o
+// silêncio entre quadros e a comparação de setupModbus() continuem corretos
+static void applySerial(uint32_t baudRate, uint8_t parity, uint8_t stopBits) {
+    uint32_t serialConfig = buildSerialConfig(8, parity, stopBits);
+    if (currentSerialConfig != serialConfig) {
+        setupModbus(baudRate, serialConfig);
+    } else if (currentBaudRate != baudRate) {
+        Serial2.updateBaudRate(baudRate);
+        currentBaudRate = baudRate;
+    }
+}
+
+// Uma leitura de 1 registro; 1 = CRC válido, 0 = silêncio, -1 = ruído
+static int probe(uint8_t slave, uint32_t baudRate) {
+    uint16_t reg = probeRegisterFor(slave);
+    uint8_t request[6] = { slave, 0x03, (uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF), 0x00, 0x01 };
+    // Espera: tempo do escravo mais dois caracteres até o primeiro byte chegar
+    uint32_t timeoutUs = s_request.turnaroundMs * 1000UL + (uint32_t)(2 * 11 * 1000000.0f / baudRate);
+    static ModbusRtuResult result;
+    delayMicroseconds(interFrameDelayUs());
+    // Sondas sem resposta são esperadas: fora da captura do barramento
+    busCaptureSetSuspended(true);
+    modbusRtuTransaction(request, sizeof(request), timeoutUs, &result);
+    busCaptureSetSuspended(false);
+    if (result.status == MODBUS_RTU_OK) {
+        return 1;
+    }
+    return result.status == MODBUS_RTU_PARTIAL ? -1 : 0;
+}
+
+static String framingName(uint8_t parity, uint8_t stopBits) {
+    const char* p = parity == MODBUS_PARITY_EVEN ? "E" : (parity == MODBUS_PARITY_ODD ? "O" : "N");
+    return "8" + String(p) + String(stopBits);
+}
+
+void modbusAutodetectService() {
+    if (!s_pending || g_processingPaused) {
+        return;
+    }
+
+    uint32_t startMs = millis();
+    uint32_t budgetMs = s_request.budgetMs;
+    uint32_t originalBaud = config.baudRate;
+    uint32_t originalSerial = buildSerialConfig(config.dataBits, config.parity, config.stopBits);
+
+    AutodetectResult result;
+    memset(&result, 0, sizeof(result));
+    result.slaveCount = s_request.slaveCount;
+
+    consolePrint("[Autodetect] Testando " + String(AUTODETECT_BAUD_COUNT * AUTODETECT_FRAMING_COUNT) +
+                 " combinacoes com " + String(s_request.slaveCount) + " escravo(s), limite " + String(budgetMs) + " ms\r\n");
+
+    // Fase 1: uma leitura por combinação até o primeiro escravo que responder
+    for (uint8_t f = 0; f < AUTODETECT_FRAMING_COUNT && !result.timedOut; f++) {
+        for (uint8_t b = 0; b < AUTODETECT_BAUD_COUNT; b++) {
+            if (millis() - startMs >= budgetMs) {
+                result.timedOut = true;
+                break;
+            }
+            AutodetectCandidate& candidate = result.candidates[result.candidateCount++];
+            candidate.baudRate = kBauds[b];
+            candidate.parity = kFramings[f][0];
+            candidate.stopBits = kFramings[f][1];
+            applySerial(candidate.baudRate, candidate.parity, candidate.stopBits);
+            for (uint8_t s = 0; s < s_request.slaveCount; s++) {
+                int outcome = probe(s_request.slaves[s], candidate.baudRate);
+                candidate.probes++;
+                if (outcome < 0) {
+                    candidate.noise++;
+                }
+                if (outcome > 0) {
+                    candidate.valid = 1;
+                    break;
+                }
+                if (millis() - startMs >= budgetMs) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Fase 2: confirma com todos os escravos, da velocidade mais alta para a mais baixa
+    int best = -1;
+    for (uint8_t b = 0; b < AUTODETECT_BAUD_COUNT && best < 0; b++) {
+        for (uint8_t k = 0; k < result.candidateCount; k++) {
+            AutodetectCandidate& candidate = result.candidates[k];
+            if (candidate.baudRate != kBauds[b] || candidate.valid == 0) {
+                continue;
+            }
+            if (millis() - startMs >= budgetMs) {
+                result.timedOut = true;
+                break;
+            }
+            applySerial(candidate.baudRate, candidate.parity, candidate.stopBits);
+            candidate.valid = 0;
+            candidate.probes = 0;
+            candidate.noise = 0;
+            bool everySlave = true;
+            for (uint8_t s = 0; s < s_request.slaveCount; s++) {
+                uint8_t slaveValid = 0;
+                for (uint8_t n = 0; n < AUTODETECT_CONFIRM_PROBES; n++) {
+                    int outcome = probe(s_request.slaves[s], candidate.baudRate);
+                    candidate.probes++;
+                    if (outcome > 0) slaveValid++;
+                    if (outcome < 0) candidate.noise++;
+                }
+                candidate.valid += slaveValid;
+                if (slaveValid == 0) {
+                    everySlave = false;
+                }
+            }
+            // Mesma velocidade: fica a combinação com mais respostas íntegras (empate: ordem de kFramings)
+            if (everySlave && (best < 0 || candidate.valid > result.candidates[best].valid)) {
+                best = k;
+            }
+        }
+    }
+
+    if (best >= 0) {
+        const AutodetectCandidate& chosen = result.candidates[best];
+        result.found = true;
+        result.baudRate = chosen.baudRate;
+        result.dataBits = 8;
+        result.parity = chosen.parity;
+        result.stopBits = chosen.stopBits;
+    }
+
+    if (result.found && s_request.apply && lockConfig(pdMS_TO_TICKS(1000))) {
+        config.baudRate = result.baudRate;
+        config.dataBits = result.dataBits;
+        config.parity = result.parity;
+        config.stopBits = result.stopBits;
+        setupModbus(config.baudRate, buildSerialConfig(config.dataBits, config.parity, config.stopBits));
+        result.applied = saveConfig();
+        unlockConfig();
+    } else {
+        setupModbus(originalBaud, originalSerial);
+    }
+
+    result.elapsedMs = millis() - startMs;
+    result.done = true;
+    if (result.found) {
+        consolePrint("[Autodetect] Encontrado: " + String(result.baudRate) + " " + framingName(result.parity, result.stopBits) +
+                     " (" + String(result.elapsedMs) + " ms" + (result.applied ? ", aplicado e gravado" : "") + ")\r\n");
+    } else {
+        consolePrint("[Autodetect] Nenhuma combinacao aceita por todos os escravos (" + String(result.elapsedMs) + " ms" +
+                     (result.timedOut ? ", tempo esgotado" : "") + ")\r\n");
+    }
+
+    s_result = result;
+    s_pending = false;
+}
+
+void modbusAutodetectGetResult(AutodetectResult* result) {
+    *result = s_result;
+    result->pending = s_pending;
+}
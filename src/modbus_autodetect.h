@@ -0,0 +1,96 @@
+/**
+ * @file modbus_autodetect.h
+ * @brief Detecção automática de velocidade e enquadramento serial do barramento
+ *
+ * Ao comissionar um segmento novo não é preciso adivinhar baud rate, paridade
+ * e stop bits: a detecção percorre as combinações de setupModbus() /
+ * buildSerialConfig() e envia uma leitura curta a escravos conhecidos.
+ *
+ * - Fase 1: para cada enquadramento (8E1, 8O1, 8N2, 8N1) e cada velocidade, da
+ *   mais rápida para a mais lenta, uma leitura ao primeiro escravo
+ * - Fase 2: as combinações que responderam com CRC válido são confirmadas com
+ *   todos os escravos (AUTODETECT_CONFIRM_PROBES leituras cada)
+ * - Vence a combinação mais rápida aceita por todos os escravos; em empate de
+ *   velocidade, a que teve mais respostas válidas
+ * - O tempo total é limitado (AUTODETECT_BUDGET_MS); ao fim, a configuração
+ *   anterior é restaurada, a menos que o resultado seja aplicado
+ *
+ * Resposta de exceção Modbus também conta: o quadro chegou íntegro. Só
+ * enquadramentos de 8 bits são testados (o modo RTU exige 8 bits de dados).
+ *
+ * Executado pelo loop (dono do barramento): a interface só agenda o pedido.
+ */
+
+#ifndef MODBUS_AUTODETECT_H
+#define MODBUS_AUTODETECT_H
+
+#include <Arduino.h>
+
+#define AUTODETECT_MAX_SLAVES 8
+#define AUTODETECT_MAX_CANDIDATES 32       // 8 velocidades x 4 enquadramentos
+#define AUTODETECT_BUDGET_MS 5000          // Tempo máximo padrão da busca
+#define AUTODETECT_TURNAROUND_MS 20        // Espera padrão do escravo além do tempo do quadro
+#define AUTODETECT_CONFIRM_PROBES 2        // Leituras por escravo na confirmação
+
+/**
+ * @struct AutodetectRequest
+ * @brief Pedido de detecção
+ */
+struct AutodetectRequest {
+    uint8_t slaves[AUTODETECT_MAX_SLAVES]; // Endereços a testar (vazio = dispositivos habilitados da configuração)
+    uint8_t slaveCount;
+    uint16_t budgetMs;                     // 0 = AUTODETECT_BUDGET_MS
+    uint16_t turnaroundMs;                 // 0 = AUTODETECT_TURNAROUND_MS
+    bool apply;                            // Aplica e grava a combinação encontrada
+};
+
+/**
+ * @struct AutodetectCandidate
+ * @brief Resultado de uma combinação testada
+ */
+struct AutodetectCandidate {
+    uint32_t baudRate;
+    uint8_t parity;                        // MODBUS_PARITY_*
+    uint8_t stopBits;
+    uint8_t valid;                         // Respostas com CRC válido
+    uint8_t probes;                        // Leituras enviadas
+    uint8_t noise;                         // Respostas truncadas/corrompidas (indício de velocidade próxima)
+};
+
+/**
+ * @struct AutodetectResult
+ * @brief Estado e resultado da última detecção
+ */
+struct AutodetectResult {
+    bool pending;                          // Agendada, aguardando o loop
+    bool done;                             // Já executou ao menos uma vez
+    bool found;
+    bool applied;
+    bool timedOut;                         // Tempo esgotado antes de testar tudo
+    uint32_t baudRate;                     // Combinação escolhida (se found)
+    uint8_t dataBits;
+    uint8_t parity;
+    uint8_t stopBits;
+    uint8_t slaveCount;
+    uint32_t elapsedMs;
+    uint8_t candidateCount;
+    AutodetectCandidate candidates[AUTODETECT_MAX_CANDIDATES];
+};
+
+/**
+ * @brief Agenda uma detecção (executada no próximo modbusAutodetectService())
+ * @return false se já houver uma agendada ou nenhum escravo para testar
+ */
+bool modbusAutodetectRequest(const AutodetectRequest* request);
+
+/**
+ * @brief Executa a detecção agendada (somente o loop, fora do ciclo de leitura)
+ *
+ * Bloqueia o loop por no máximo o tempo do pedido; a aquisição fica parada
+ * nesse intervalo, pois o barramento é reconfigurado a cada combinação.
+ */
+void modbusAutodetectService();
+
+void modbusAutodetectGetResult(AutodetectResult* result);
+
+#endif // MODBUS_AUTODETECT_H
@@ -0,0 +1,158 @@
+/**
+ * @file modbus_bits.cpp
+ * @brief Implementação das bobinas e entradas discretas
+ */
+
+#include "modbus_bits.h"
+#include "modbus_handler.h"
+#include "modbus_rtu.h"
+#include "rtc_manager.h"
+
+static uint32_t s_values[MAX_DEVICES];     // Bit j = valor do registro j
+static uint32_t s_known[MAX_DEVICES];      // Bit j = registro j já lido
+static uint32_t s_pending[MAX_DEVICES];    // Bit j = escrita pendente do registro j
+static BitStats s_stats = {};
+
+bool isBitRegister(const ModbusRegister& reg) {
+    return reg.registerType == REGISTER_TYPE_COIL || reg.registerType == REGISTER_TYPE_DISCRETE_INPUT;
+}
+
+uint8_t bitPlanBlocks(int deviceIndex, BitBlock* blocks, uint8_t maxBlocks) {
+    const ModbusDevice& device = config.devices[deviceIndex];
+
+    // Índices dos registros de bit ordenados por função e endereço (inserção: no máximo 20)
+    uint8_t order[MAX_REGISTERS_PER_DEVICE];
+    uint8_t count = 0;
+    for (int j = 0; j < device.registerCount; j++) {
+        const ModbusRegister& reg = device.registers[j];
+        if (!isBitRegister(reg)) {
+            continue;
+        }
+        uint32_t key = ((uint32_t)reg.registerType << 16) | reg.address;
+        int k = count;
+        while (k > 0) {
+            const ModbusRegister& prev = device.registers[order[k - 1]];
+            if ((((uint32_t)prev.registerType << 16) | prev.address) <= key) {
+                break;
+            }
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = j;
+        count++;
+    }
+
+    uint8_t blockCount = 0;
+    for (uint8_t k = 0; k < count; k++) {
+        const ModbusRegister& reg = device.registers[order[k]];
+        uint8_t function = reg.registerType == REGISTER_TYPE_COIL ? 0x01 : 0x02;
+        if (blockCount > 0) {
+            BitBlock& last = blocks[blockCount - 1];
+            uint32_t end = (uint32_t)last.start + last.count;
+            // Mesmo endereço repetido cabe no bloco atual
+            if (last.function == function && reg.address < end) {
+                last.members |= (1UL << order[k]);
+                continue;
+            }
+            if (last.function == function && reg.address - end <= MODBUS_BITS_MAX_GAP &&
+                reg.address + 1 - last.start <= MODBUS_BITS_MAX_PER_READ) {
+                last.count = reg.address + 1 - last.start;
+                last.members |= (1UL << order[k]);
+                continue;
+            }
+        }
+        if (blockCount >= maxBlocks) {
+            break;
+        }
+        BitBlock& block = blocks[blockCount++];
+        block.function = function;
+        block.start = reg.address;
+        block.count = 1;
+        block.members = (1UL << order[k]);
+    }
+    return blockCount;
+}
+
+uint8_t bitReadBlock(uint8_t slaveAddress, const BitBlock& block, uint8_t* packed, int64_t* sampleTimeUs) {
+    static ModbusRtuResult result;
+    uint8_t request[6] = {
+        slaveAddress, block.function,
+        (uint8_t)(block.start >> 8), (uint8_t)(block.start & 0xFF),
+        (uint8_t)(block.count >> 8), (uint8_t)(block.count & 0xFF)
+    };
+    modbusRtuTransaction(request, sizeof(request), MODBUS_BITS_TIMEOUT_MS * 1000UL, &result);
+    *sampleTimeUs = monotonicMicros();
+
+    if (result.status == MODBUS_RTU_NO_RESPONSE) {
+        return ModbusMaster::ku8MBResponseTimedOut;
+    }
+    uint8_t exception = modbusRtuException(&result);
+    if (exception != 0) {
+        return exception;
+    }
+    uint8_t byteCount = (block.count + 7) / 8;
+    if (result.status != MODBUS_RTU_OK || result.frame[1] != block.function || result.frame[2] != byteCount ||
+        result.length != 5 + byteCount) {
+        return ModbusMaster::ku8MBInvalidCRC;
+    }
+    memcpy(packed, &result.frame[3], byteCount);
+    return ModbusMaster::ku8MBSuccess;
+}
+
+bool bitStore(int deviceIndex, int registerIndex, bool value) {
+    uint32_t mask = 1UL << registerIndex;
+    bool first = !(s_known[deviceIndex] & mask) || config.devices[deviceIndex].registers[registerIndex].sampleTimeUs <= 0;
+    bool changed = first || ((s_values[deviceIndex] & mask) != 0) != value;
+    if (value) {
+        s_values[deviceIndex] |= mask;
+    } else {
+        s_values[deviceIndex] &= ~mask;
+    }
+    s_known[deviceIndex] |= mask;
+    s_stats.bitsRead++;
+    if (changed && !first) {
+        s_stats.changes++;
+    }
+    return changed;
+}
+
+bool bitGet(int deviceIndex, int registerIndex) {
+    return (s_values[deviceIndex] & (1UL << registerIndex)) != 0;
+}
+
+void bitRequestWrite(int deviceIndex, int registerIndex, bool value) {
+    uint32_t mask = 1UL << registerIndex;
+    if (value) {
+        s_values[deviceIndex] |= mask;
+    } else {
+        s_values[deviceIndex] &= ~mask;
+    }
+    config.devices[deviceIndex].registers[registerIndex].value = value ? 1 : 0;
+    s_pending[deviceIndex] |= mask;
+}
+
+uint32_t bitTakePendingWrites(int deviceIndex) {
+    uint32_t pending = s_pending[deviceIndex];
+    s_pending[deviceIndex] = 0;
+    return pending;
+}
+
+void bitGetStats(BitStats* stats) {
+    *stats = s_stats;
+}
+
+void bitCountRead(uint8_t result) {
+    s_stats.readTransactions++;
+    if (result != ModbusMaster::ku8MBSuccess) {
+        s_stats.readErrors++;
+    }
+}
+
+void bitCountWrite(uint8_t result, uint16_t bits) {
+    s_stats.writeTransactions++;
+    if (result == ModbusMaster::ku8MBSuccess) {
+        s_stats.bitsWritten += bits;
+    } else {
+        s_stats.writeErrors++;
+    }
+}
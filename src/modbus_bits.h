@@ -0,0 +1,100 @@
+/**
+ * @file modbus_bits.h
+ * @brief Bobinas e entradas discretas (0x01/0x02/0x05/0x0F) com armazenamento em bits
+ *
+ * Registros com registerType REGISTER_TYPE_COIL ou REGISTER_TYPE_DISCRETE_INPUT
+ * valem 0 ou 1 e não passam pela leitura de registradores de 16 bits:
+ * - Os registros de bit de um dispositivo são ordenados por função e endereço
+ *   e unidos em blocos quando o buraco entre eles é de até MODBUS_BITS_MAX_GAP
+ *   bits, com até MODBUS_BITS_MAX_PER_READ (2000) bits por transação
+ * - O valor fica em um bitset por dispositivo (bit j = registro j); histórico
+ *   e console só recebem as mudanças, alarmes recebem toda leitura
+ * - Para os cálculos o valor é booleano (0/1), sem gain/offset/Kalman
+ * - Escritas dos cálculos ficam pendentes e writeOutputRegisters() as envia
+ *   agrupadas: bobinas com endereços consecutivos em um único 0x0F
+ */
+
+#ifndef MODBUS_BITS_H
+#define MODBUS_BITS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define MODBUS_BITS_MAX_PER_READ 2000      // Limite do Modbus para 0x01/0x02 (250 bytes de dados)
+#define MODBUS_BITS_MAX_GAP 64             // Bits não usados lidos para evitar uma transação (8 bytes)
+#define MODBUS_BITS_MAX_BLOCKS MAX_REGISTERS_PER_DEVICE
+#define MODBUS_BITS_TIMEOUT_MS 500         // Espera pela resposta de uma leitura de bits
+
+/**
+ * @struct BitBlock
+ * @brief Uma leitura de bits de um dispositivo
+ */
+struct BitBlock {
+    uint8_t function;                      // 0x01 ou 0x02
+    uint16_t start;
+    uint16_t count;                        // Bits (até MODBUS_BITS_MAX_PER_READ)
+    uint32_t members;                      // Bit j = registro j do dispositivo está no bloco
+};
+
+/**
+ * @struct BitStats
+ * @brief Contadores das leituras e escritas de bits
+ */
+struct BitStats {
+    uint32_t readTransactions;
+    uint32_t readErrors;
+    uint32_t bitsRead;                     // Registros de bit atualizados
+    uint32_t changes;                      // Leituras com valor diferente do anterior
+    uint32_t writeTransactions;            // 0x05 e 0x0F
+    uint32_t bitsWritten;
+    uint32_t writeErrors;
+};
+
+/**
+ * @brief Indica se o registro é uma bobina ou entrada discreta
+ */
+bool isBitRegister(const ModbusRegister& reg);
+
+/**
+ * @brief Monta os blocos de leitura dos registros de bit de um dispositivo
+ * @return Quantidade de blocos
+ */
+uint8_t bitPlanBlocks(int deviceIndex, BitBlock* blocks, uint8_t maxBlocks);
+
+/**
+ * @brief Lê um bloco (transação direta: o ModbusMaster guarda só 1024 bits)
+ * @param packed Bits recebidos, o primeiro no bit 0 do primeiro byte (até 250 bytes)
+ * @return Código no padrão ModbusMaster (ku8MBSuccess, exceção, timeout ou CRC)
+ */
+uint8_t bitReadBlock(uint8_t slaveAddress, const BitBlock& block, uint8_t* packed, int64_t* sampleTimeUs);
+
+/**
+ * @brief Guarda uma leitura no bitset (chamar antes de atualizar sampleTimeUs do registro)
+ * @return true se é a primeira leitura (ou a configuração foi recarregada) ou o valor mudou
+ */
+bool bitStore(int deviceIndex, int registerIndex, bool value);
+
+/**
+ * @brief Valor atual de um registro de bit
+ */
+bool bitGet(int deviceIndex, int registerIndex);
+
+/**
+ * @brief Altera uma bobina e marca a escrita como pendente (enviada por writeOutputRegisters)
+ */
+void bitRequestWrite(int deviceIndex, int registerIndex, bool value);
+
+/**
+ * @brief Retira as escritas pendentes de um dispositivo (bit j = registro j)
+ */
+uint32_t bitTakePendingWrites(int deviceIndex);
+
+void bitGetStats(BitStats* stats);
+
+/**
+ * @brief Contadores atualizados por modbus_handler (os bits lidos são contados em bitStore())
+ */
+void bitCountRead(uint8_t result);
+void bitCountWrite(uint8_t result, uint16_t bits);
+
+#endif // MODBUS_BITS_H
@@ -0,0 +1,184 @@
+/**
+ * @file modbus_broadcast.cpp
+ * @brief Implementação das escritas em broadcast e sincronizadas
+ */
+
+#include "modbus_broadcast.h"
+#include "modbus_handler.h"
+#include "modbus_rtu.h"
+#include "modbus_queue.h"
+#include "console.h"
+#include "rtc_manager.h"
+#include "bus_capture.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * @struct StagedWrite
+ * @brief Escrita aguardando o fim dos cálculos
+ */
+struct StagedWrite {
+    uint8_t slaveAddress;                  // 0 = broadcast
+    uint16_t registerAddress;
+    uint8_t count;
+    uint16_t words[MODBUS_STAGE_MAX_WORDS];
+};
+
+static StagedWrite s_staged[MODBUS_STAGE_MAX];
+static uint8_t s_stagedCount = 0;
+static bool s_stageActive = false;
+static bool s_stageSuspended = false;      // Outro script rodando: escreve na hora
+static BroadcastStats s_stats = {};
+static ModbusStageResultFn s_resultFn = nullptr;
+
+uint8_t modbusBroadcastWrite(uint16_t registerAddress, const uint16_t* words, uint8_t count) {
+    static ModbusRtuResult result;
+    uint8_t request[7 + 2 * MODBUS_STAGE_MAX_WORDS];
+    uint8_t length;
+    request[0] = 0;
+    request[2] = registerAddress >> 8;
+    request[3] = registerAddress & 0xFF;
+    if (count == 1) {
+        request[1] = 0x06;
+        request[4] = words[0] >> 8;
+        request[5] = words[0] & 0xFF;
+        length = 6;
+    } else {
+        if (count > MODBUS_STAGE_MAX_WORDS) {
+            count = MODBUS_STAGE_MAX_WORDS;
+        }
+        request[1] = 0x10;
+        request[4] = 0;
+        request[5] = count;
+        request[6] = count * 2;
+        for (uint8_t k = 0; k < count; k++) {
+            request[7 + 2 * k] = words[k] >> 8;
+            request[8 + 2 * k] = words[k] & 0xFF;
+        }
+        length = 7 + 2 * count;
+    }
+
+    delayMicroseconds(interFrameDelayUs());
+    modbusRtuTransaction(request, length, 0, &result);
+    s_stats.broadcasts++;
+
+    // Nenhum escravo responde: espera todos aplicarem antes do próximo quadro
+    vTaskDelay(pdMS_TO_TICKS(MODBUS_BROADCAST_TURNAROUND_MS));
+    return ModbusMaster::ku8MBSuccess;
+}
+
+// Escrita individual imediata (0x06 ou 0x10)
+static uint8_t unicastWrite(uint8_t slaveAddress, uint16_t registerAddress, const uint16_t* words, uint8_t count) {
+    delayMicroseconds(interFrameDelayUs());
+    node.begin(slaveAddress, busSerial);
+    node.preTransmission(preTransmission);
+    node.postTransmission(postTransmission);
+    if (count == 1) {
+        return node.writeSingleRegister(registerAddress, words[0]);
+    }
+    for (uint8_t k = 0; k < count; k++) {
+        node.setTransmitBuffer(k, words[k]);
+    }
+    return node.writeMultipleRegisters(registerAddress, count);
+}
+
+static uint8_t writeNow(uint8_t slaveAddress, uint16_t registerAddress, const uint16_t* words, uint8_t count) {
+    if (slaveAddress == 0) {
+        return modbusBroadcastWrite(registerAddress, words, count);
+    }
+    return unicastWrite(slaveAddress, registerAddress, words, count);
+}
+
+uint8_t modbusSyncWrite(uint8_t slaveAddress, uint16_t registerAddress, const uint16_t* words, uint8_t count) {
+    if (count == 0 || count > MODBUS_STAGE_MAX_WORDS) {
+        return ModbusMaster::ku8MBIllegalDataValue;
+    }
+    if (!modbusStageActive()) {
+        return writeNow(slaveAddress, registerAddress, words, count);
+    }
+
+    // Mesmo escravo e registrador no ciclo: a última escrita vence
+    StagedWrite* entry = nullptr;
+    for (uint8_t k = 0; k < s_stagedCount; k++) {
+        if (s_staged[k].slaveAddress == slaveAddress && s_staged[k].registerAddress == registerAddress) {
+            entry = &s_staged[k];
+            s_stats.merged++;
+            break;
+        }
+    }
+    if (entry == nullptr) {
+        if (s_stagedCount >= MODBUS_STAGE_MAX) {
+            s_stats.overflow++;
+            return writeNow(slaveAddress, registerAddress, words, count);
+        }
+        entry = &s_staged[s_stagedCount++];
+    }
+    entry->slaveAddress = slaveAddress;
+    entry->registerAddress = registerAddress;
+    entry->count = count;
+    memcpy(entry->words, words, count * sizeof(uint16_t));
+    s_stats.staged++;
+    return ModbusMaster::ku8MBSuccess;
+}
+
+void modbusStageBegin() {
+    s_stagedCount = 0;
+    s_stageActive = true;
+}
+
+bool modbusStageActive() {
+    return s_stageActive && !s_stageSuspended;
+}
+
+void modbusStageSuspend(bool suspended) {
+    s_stageSuspended = suspended;
+}
+
+void modbusStageSetResultFn(ModbusStageResultFn fn) {
+    s_resultFn = fn;
+}
+
+uint8_t modbusStageFlush() {
+    s_stageActive = false;
+    if (s_stagedCount == 0) {
+        return 0;
+    }
+
+    int64_t startUs = monotonicMicros();
+    uint8_t errors = 0;
+    // Duas passadas: valores individuais primeiro, broadcasts (trava/aplicar) por último
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        for (uint8_t k = 0; k < s_stagedCount; k++) {
+            const StagedWrite& entry = s_staged[k];
+            if ((entry.slaveAddress == 0) != (pass == 1)) {
+                continue;
+            }
+            uint8_t result = writeNow(entry.slaveAddress, entry.registerAddress, entry.words, entry.count);
+            if (result != ModbusMaster::ku8MBSuccess) {
+                errors++;
+                consolePrint("[Sync] Erro ao escrever Dev " + String(entry.slaveAddress) + " Reg " +
+                             String(entry.registerAddress) + ": " + modbusResultDescription(result) + "\r\n");
+            }
+            if (s_resultFn != nullptr) {
+                s_resultFn(entry.slaveAddress, entry.registerAddress, entry.words, entry.count,
+                           result == ModbusMaster::ku8MBSuccess);
+            }
+        }
+    }
+
+    // Limpa bytes atrasados antes da próxima operação do ciclo
+    while (Serial2.available()) {
+        Serial2.read();
+    }
+
+    s_stats.flushes++;
+    s_stats.flushErrors += errors;
+    s_stats.lastFlushUs = (uint32_t)(monotonicMicros() - startUs);
+    s_stats.lastFlushWrites = s_stagedCount;
+    s_stagedCount = 0;
+    return errors;
+}
+
+void modbusBroadcastGetStats(BroadcastStats* stats) {
+    *stats = s_stats;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file modbus_broadcast.h
+ * @brief Escritas em broadcast (endereço 0) e escritas sincronizadas dos cálculos
+ *
+ * Broadcast: um único quadro 0x06/0x10 para o endereço 0 é aceito por todos os
+ * escravos do barramento e nenhum responde; o mestre só espera o tempo de
+ * processamento (MODBUS_BROADCAST_TURNAROUND_MS) antes do próximo quadro. No
+ * script, display(valor, 0, ...) e bcast(registro, valor) usam esse caminho
+ * quando todos os dispositivos devem receber o mesmo valor.
+ *
+ * Modo sincronizado (config.syncWrites): durante o script, display() e as
+ * atribuições a registros ({d[i][j]} = ...) não vão ao barramento na hora;
+ * ficam em uma lista (uma entrada por escravo e registrador, a última vence)
+ * enviada ao fim da execução do script, em sequência e sem pausas: primeiro
+ * as escritas individuais, depois os broadcasts. Um bcast() no script vira
+ * assim o comando de "aplicar" enviado a todos de uma vez, depois que todos os
+ * valores já foram carregados (para displays e atuadores com registrador de
+ * trava).
+ */
+
+#ifndef MODBUS_BROADCAST_H
+#define MODBUS_BROADCAST_H
+
+#include <Arduino.h>
+
+#define MODBUS_BROADCAST_TURNAROUND_MS 100 // Tempo para os escravos processarem um broadcast
+#define MODBUS_STAGE_MAX 32                // Escritas sincronizadas por ciclo
+#define MODBUS_STAGE_MAX_WORDS 4
+
+/**
+ * @struct BroadcastStats
+ * @brief Contadores de broadcast e escritas sincronizadas
+ */
+struct BroadcastStats {
+    uint32_t broadcasts;                   // Quadros enviados ao endereço 0
+    uint32_t staged;                       // Escritas colocadas na lista
+    uint32_t merged;                       // Escritas que substituíram outra do mesmo ciclo
+    uint32_t overflow;                     // Lista cheia: escrita feita na hora
+    uint32_t flushes;
+    uint32_t flushErrors;
+    uint32_t lastFlushUs;                  // Duração do último envio da lista
+    uint8_t lastFlushWrites;
+};
+
+/**
+ * @brief Envia uma escrita em broadcast (0x06 para 1 palavra, 0x10 para mais) e espera o turnaround
+ * @return ku8MBSuccess (não há resposta para conferir)
+ */
+uint8_t modbusBroadcastWrite(uint16_t registerAddress, const uint16_t* words, uint8_t count);
+
+/**
+ * @brief Escreve agora (escravo 1-247 ou broadcast 0) ou coloca na lista se o modo sincronizado está aberto
+ * @return Código no padrão ModbusMaster
+ */
+uint8_t modbusSyncWrite(uint8_t slaveAddress, uint16_t registerAddress, const uint16_t* words, uint8_t count);
+
+/**
+ * @brief Abre a lista de escritas sincronizadas (início dos cálculos)
+ */
+void modbusStageBegin();
+
+/**
+ * @brief Indica se as escritas estão sendo acumuladas
+ */
+bool modbusStageActive();
+
+/**
+ * @brief Suspende a lista aberta enquanto roda outro script (as escritas dele vão na hora)
+ */
+void modbusStageSuspend(bool suspended);
+
+/**
+ * @brief Resultado de uma escrita da lista, chamado por modbusStageFlush() após o envio
+ * @param ok false em erro de comunicação (broadcast não tem resposta: sempre true)
+ */
+typedef void (*ModbusStageResultFn)(uint8_t slaveAddress, uint16_t registerAddress, const uint16_t* words, uint8_t count,
+                                    bool ok);
+
+/**
+ * @brief Registra quem acompanha o resultado das escritas da lista (nullptr desliga)
+ */
+void modbusStageSetResultFn(ModbusStageResultFn fn);
+
+/**
+ * @brief Envia a lista (individuais e depois broadcasts) e fecha o modo sincronizado
+ * @return Quantidade de escritas com erro
+ */
+uint8_t modbusStageFlush();
+
+void modbusBroadcastGetStats(BroadcastStats* stats);
+
+#endif // MODBUS_BROADCAST_H
@@ -5,6 +5,16 @@
 
 #include "modbus_handler.h"
 #include "console.h"
+#include "data_logger.h"
+#include "rtc_manager.h"
+#include "alarm_engine.h"
+#include "reactive_rules.h"
+#include "calculations.h"
+#include "pid_control.h"
+#include "modbus_queue.h"
+#include "device_profiles.h"
+#include "modbus_bits.h"
+#include "bus_capture.h"
 #include <HardwareSerial.h>
 
 // Variáveis globais
@@ -12,6 +22,8 @@ ModbusMaster node;
 uint32_t currentBaudRate = 0;
 uint32_t currentSerialConfig = 0;
 KalmanState kalmanStates[MAX_DEVICES][MAX_REGISTERS_PER_DEVICE];
+SampleTiming sampleTimings[MAX_DEVICES][MAX_REGISTERS_PER_DEVICE];
+int64_t g_cycleTickUs = 0;
 
 
 uint32_t buildSerialConfig(uint8_t dataBits, uint8_t parity, uint8_t stopBits) {
@@ -88,7 +100,7 @@ void setupModbus(uint32_t baudRate, uint32_t serialConfig) {
     
     // Inicializa ModbusMaster
     // O endereço do escravo será configurado dinamicamente nas leituras
-    node.begin(1, Serial2); // Endereço temporário, será alterado por dispositivo
+    node.begin(1, busSerial); // Endereço temporário, será alterado por dispositivo
     node.preTransmission(preTransmission);
     node.postTransmission(postTransmission);
     
@@ -117,6 +129,496 @@ void setupModbus(uint32_t baudRate, uint32_t serialConfig) {
     consolePrint(logMsg);
 }
 
+// Determina se o registro deve ser lido baseado no registerType
+static bool shouldReadRegister(const ModbusRegister& reg) {
+    uint8_t registerType = reg.registerType;
+    bool shouldRead = (registerType == 0 || registerType == 2); // Leitura ou Leitura e Escrita
+    
+    // Compatibilidade: se registerType não estiver definido, usa campos antigos
+    if (registerType == 0 && reg.isOutput) {
+        shouldRead = false; // Se é somente escrita, não lê
+    } else if (registerType == 0 && reg.isOutput == false && 
+               reg.readOnly == false && 
+               reg.isInput == true) {
+        shouldRead = true; // Leitura e Escrita
+    }
+    return shouldRead;
+}
+
+uint8_t registerWordCount(uint8_t dataType) {
+    uint8_t type = dataType & REGISTER_DATA_TYPE_MASK;
+    return (type == REGISTER_DATA_UINT32 || type == REGISTER_DATA_INT32 || type == REGISTER_DATA_FLOAT32) ? 2 : 1;
+}
+
+float decodeRegisterWords(uint8_t dataType, const uint16_t* words) {
+    switch (dataType & REGISTER_DATA_TYPE_MASK) {
+        case REGISTER_DATA_INT16:
+            return (float)(int16_t)words[0];
+        case REGISTER_DATA_UINT32:
+        case REGISTER_DATA_INT32:
+        case REGISTER_DATA_FLOAT32: {
+            // Padrão Modbus: palavra mais significativa primeiro
+            bool swap = (dataType & REGISTER_DATA_WORD_SWAP) != 0;
+            uint32_t bits = swap ? ((uint32_t)words[1] << 16) | words[0] : ((uint32_t)words[0] << 16) | words[1];
+            if ((dataType & REGISTER_DATA_TYPE_MASK) == REGISTER_DATA_UINT32) {
+                return (float)bits;
+            }
+            if ((dataType & REGISTER_DATA_TYPE_MASK) == REGISTER_DATA_INT32) {
+                return (float)(int32_t)bits;
+            }
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        default:
+            return (float)words[0];
+    }
+}
+
+uint8_t encodeRegisterWords(uint8_t dataType, float value, uint16_t* words) {
+    uint32_t bits;
+    switch (dataType & REGISTER_DATA_TYPE_MASK) {
+        case REGISTER_DATA_INT16:
+            if (value < -32768.0f) value = -32768.0f;
+            if (value > 32767.0f) value = 32767.0f;
+            words[0] = (uint16_t)(int16_t)value;
+            return 1;
+        case REGISTER_DATA_UINT32:
+            // Limites em float: 4294967295 não é representável e arredondaria para cima
+            bits = value <= 0.0f ? 0 : (value >= 4294967040.0f ? 0xFFFFFFFFUL : (uint32_t)value);
+            break;
+        case REGISTER_DATA_INT32:
+            bits = (uint32_t)(value <= -2147483648.0f ? INT32_MIN : (value >= 2147483520.0f ? INT32_MAX : (int32_t)value));
+            break;
+        case REGISTER_DATA_FLOAT32:
+            memcpy(&bits, &value, sizeof(bits));
+            break;
+        default:
+            if (value < 0.0f) value = 0.0f;
+            if (value > 65535.0f) value = 65535.0f;
+            words[0] = (uint16_t)value;
+            return 1;
+    }
+    bool swap = (dataType & REGISTER_DATA_WORD_SWAP) != 0;
+    words[0] = swap ? (uint16_t)(bits & 0xFFFF) : (uint16_t)(bits >> 16);
+    words[1] = swap ? (uint16_t)(bits >> 16) : (uint16_t)(bits & 0xFFFF);
+    return 2;
+}
+
+void setRegisterRawValue(ModbusRegister& reg, float value) {
+    uint16_t words[2];
+    encodeRegisterWords(reg.dataType, value, words);
+    reg.value = words[0];
+    reg.typedRaw = decodeRegisterWords(reg.dataType, words);
+}
+
+float registerRawValue(const ModbusRegister& reg) {
+    switch (reg.dataType & REGISTER_DATA_TYPE_MASK) {
+        case REGISTER_DATA_UINT16:
+            return (float)reg.value;
+        case REGISTER_DATA_INT16:
+            return (float)(int16_t)reg.value;
+        default:
+            return reg.typedRaw;
+    }
+}
+
+// Executa a transação de leitura de um registro e carimba o instante da resposta
+// words: primeiras palavras da resposta (2 posições, suficiente para os tipos de 32 bits)
+static uint8_t transactRead(int i, int j, uint16_t* words, int64_t* sampleTimeUs) {
+    const ModbusRegister& reg = config.devices[i].registers[j];
+    uint8_t registerType = reg.registerType;
+    uint8_t registerCount = reg.registerCount;
+    if (registerCount == 0) registerCount = 1; // Garante mínimo de 1
+    uint8_t wordCount = registerWordCount(reg.dataType);
+    if (registerCount < wordCount) registerCount = wordCount; // Tipos de 32 bits leem 2 registradores
+    
+    // Configura o endereço do escravo para este dispositivo
+    node.begin(config.devices[i].slaveAddress, busSerial);
+    
+    uint8_t result;
+    
+    // Lê registro Modbus usando função apropriada baseada no tipo
+    // Padrão Modbus:
+    // - Input Registers (0x04): somente leitura (registerType == 0)
+    // - Holding Registers (0x03): leitura/escrita (registerType == 2)
+    // Compatibilidade: se registerType não definido, usa isInput
+    if (registerType == 0 || (!reg.isInput && registerType == 0)) {
+        // Input Register (0x04) - somente leitura, pode ler múltiplos registros
+        result = node.readInputRegisters(reg.address, registerCount);
+    } else {
+        // Holding Register (0x03) - leitura/escrita, pode ler múltiplos registros
+        result = node.readHoldingRegisters(reg.address, registerCount);
+    }
+    // ModbusMaster retorna logo após receber o quadro de resposta
+    *sampleTimeUs = monotonicMicros();
+    
+    // Armazena as palavras do valor raw do Modbus (o tipo de dado diz quantas valem)
+    // Para múltiplos registros de 16 bits, vale apenas o primeiro (compatibilidade)
+    bool success = (result == node.ku8MBSuccess);
+    words[0] = success ? node.getResponseBuffer(0) : 0;
+    words[1] = success && wordCount == 2 ? node.getResponseBuffer(1) : 0;
+    return result;
+}
+
+// Processa o resultado de uma leitura (Kalman, histórico, instantes e console)
+// words: palavras do valor na ordem recebida, decodificadas conforme o dataType do registro
+static void handleReadResult(int i, int j, uint8_t result, const uint16_t* words, int64_t sampleTimeUs, bool verbose = true) {
+    uint8_t slaveAddr = config.devices[i].slaveAddress;
+    uint16_t regAddr = config.devices[i].registers[j].address;
+    
+    // Verifica se a leitura foi bem-sucedida
+    if (result == node.ku8MBSuccess) {
+        // Aplica filtro de Kalman se habilitado
+        uint8_t dataType = config.devices[i].registers[j].dataType;
+        uint16_t rawValueModbus = words[0];
+        float rawValue = decodeRegisterWords(dataType, words);
+        if (config.devices[i].registers[j].kalmanEnabled) {
+            // Aplica filtro de Kalman ao valor raw com parâmetros configuráveis
+            float kalmanQ = config.devices[i].registers[j].kalmanQ;
+            float kalmanR = config.devices[i].registers[j].kalmanR;
+            rawValue = kalmanFilter(&kalmanStates[i][j], rawValue, kalmanQ, kalmanR);
+            // Arredonda para o tipo de 16 bits após filtro (32 bits ficam em typedRaw)
+            if ((dataType & REGISTER_DATA_TYPE_MASK) == REGISTER_DATA_INT16) {
+                rawValueModbus = (uint16_t)(int16_t)round(rawValue);
+            } else if (registerWordCount(dataType) == 1) {
+                rawValueModbus = (uint16_t)round(rawValue);
+            }
+        } else {
+            // Se filtro foi desabilitado, reseta o estado
+            if (kalmanStates[i][j].initialized) {
+                kalmanReset(&kalmanStates[i][j]);
+            }
+        }
+        
+        // Calcula valor processado (com gain e offset)
+        float processedValue = (rawValue * config.devices[i].registers[j].gain) + config.devices[i].registers[j].offset;
+        
+        // Guarda a leitura anterior para interpolação no tick do ciclo
+        SampleTiming& timing = sampleTimings[i][j];
+        if (config.devices[i].registers[j].sampleTimeUs > 0) {
+            timing.previousValue = timing.lastValue;
+            timing.previousTimeUs = config.devices[i].registers[j].sampleTimeUs;
+        } else {
+            // Primeira leitura (ou configuração recarregada): descarta histórico antigo
+            timing.previousTimeUs = 0;
+        }
+        timing.lastValue = processedValue;
+        timing.offsetUs = (int32_t)(sampleTimeUs - g_cycleTickUs);
+        
+        // Armazena valor (raw ou filtrado) no registro
+        config.devices[i].registers[j].value = rawValueModbus;
+        config.devices[i].registers[j].typedRaw = rawValue;
+        config.devices[i].registers[j].sampleTimeUs = sampleTimeUs;
+        
+        // Registra no histórico (somente RAM aqui; gravação em flash no loop)
+        // Sem gain/offset/Kalman o valor é inteiro e usa codificação delta+varint
+        bool integerValue = !config.devices[i].registers[j].kalmanEnabled &&
+                            config.devices[i].registers[j].gain == 1.0f &&
+                            config.devices[i].registers[j].offset == 0.0f;
+        dataLoggerAppend(slaveAddr, regAddr, sampleTimeUs, processedValue, integerValue);
+        
+        // Regras de reação primeiro: a escrita da saída entra na fila já na decodificação
+        ruleOnSample(slaveAddr, regAddr, sampleTimeUs, processedValue);
+        
+        // Alarmes do registro (avaliados só quando o valor muda)
+        alarmOnSample(slaveAddr, regAddr, sampleTimeUs, processedValue);
+        scriptOnSample(slaveAddr, regAddr);
+        
+        // Leituras rápidas (blocos PID) não poluem o console
+        if (!verbose) {
+            return;
+        }
+        
+        // Mostra no console
+        String varName = strlen(config.devices[i].registers[j].variableName) > 0 
+            ? String(config.devices[i].registers[j].variableName) 
+            : "sem_nome";
+        
+        String msg = "[Modbus] Dev " + String(slaveAddr) + 
+                    " Reg " + String(regAddr) + 
+                    " (" + varName + "): " + 
+                    String(processedValue, 2) + 
+                    " (raw: " + String(registerRawValue(config.devices[i].registers[j]), registerWordCount(dataType) == 2 ? 2 : 0) + ")\r\n";
+        // consolePrint já imprime no Serial e no WebSocket, não precisa duplicar
+        consolePrint(msg);
+    } else {
+        // Erros de leituras rápidas são contados por quem as pediu
+        if (!verbose) {
+            return;
+        }
+        
+        // Em caso de erro, mantém o valor anterior ou zera
+        String varName = strlen(config.devices[i].registers[j].variableName) > 0 
+            ? String(config.devices[i].registers[j].variableName) 
+            : "sem_nome";
+        
+        // Obtém descrição do erro
+        String errorDesc = "Erro desconhecido";
+        switch(result) {
+            case 0x01: errorDesc = "Funcao ilegal"; break;
+            case 0x02: errorDesc = "Endereco de dados ilegal"; break;
+            case 0x03: errorDesc = "Valor de dados ilegal"; break;
+            case 0x04: errorDesc = "Falha no dispositivo escravo"; break;
+            case 0xE1: errorDesc = "Timeout"; break;
+            case 0xE2: errorDesc = "Resposta invalida"; break;
+            case 0xE3: errorDesc = "Checksum invalido"; break;
+            case 0xE4: errorDesc = "Excecao Modbus"; break;
+            default: errorDesc = "Codigo: 0x" + String(result, HEX); break;
+        }
+        
+        String msg = "[Modbus ERRO] Dev " + String(slaveAddr) + 
+                    " Reg " + String(regAddr) + 
+                    " (" + varName + "): " + errorDesc + "\r\n";
+        // consolePrint já imprime no Serial e no WebSocket, não precisa duplicar
+        consolePrint(msg);
+    }
+}
+
+uint32_t interFrameDelayUs() {
+    uint32_t baud = currentBaudRate > 0 ? currentBaudRate : 9600;
+    if (baud > 19200) {
+        return 1750;
+    }
+    return (uint32_t)(3.5f * 11.0f * 1000000.0f / baud);
+}
+
+// Fronteira entre quadros do ciclo: escritas na fila (regras de reação, depois
+// operador), depois blocos PID vencidos (saídas de controle) e scripts nomeados
+// prontos; as leituras do ciclo vêm por último
+static void busFrameBoundary() {
+    modbusQueueService();
+    ruleService();
+    pidService(monotonicMicros());
+    scriptFrameService();
+}
+
+// Depois de decodificar uma leitura: escrita de regra de reação na fila sai já,
+// antes da pausa fixa entre leituras (o silêncio entre quadros é respeitado pela fila)
+static void ruleFastPath() {
+    if (ruleWritePending()) {
+        modbusQueueService();
+        ruleService();
+    }
+}
+
+// Leitura de um grupo de amostragem: transações em sequência, processamento depois
+struct GroupRead {
+    uint8_t device;
+    uint8_t reg;
+    uint8_t result;
+    uint16_t words[2];
+    int64_t sampleTimeUs;
+};
+
+// Registros sem grupo de um dispositivo com perfil: uma transação por bloco do
+// plano compilado, só do primeiro ao último registro configurado do bloco.
+// Marca em handled os registros lidos aqui; os demais seguem a leitura individual.
+static void readProfileBlocks(int i, bool* handled) {
+    static ProfilePlan plan;
+    static uint16_t blockWords[PROFILE_MAX_BLOCK_WORDS];
+    if (!profileGetPlan(config.devices[i].profile, &plan)) {
+        return;
+    }
+    
+    // Decodificador de cada registro (-1 = fora do perfil ou com tipo diferente do declarado)
+    // Refeito a cada ciclo: no máximo 20 x 32 comparações, e a configuração pode ter mudado
+    int8_t decoderOf[MAX_REGISTERS_PER_DEVICE];
+    for (int j = 0; j < config.devices[i].registerCount; j++) {
+        decoderOf[j] = -1;
+        const ModbusRegister& reg = config.devices[i].registers[j];
+        if (reg.sampleGroup != 0 || !shouldReadRegister(reg)) {
+            continue;
+        }
+        uint8_t function = reg.registerType == 0 ? 0x04 : 0x03;
+        for (uint8_t d = 0; d < plan.decoderCount; d++) {
+            const ProfileDecoder& decoder = plan.decoders[d];
+            if (decoder.address == reg.address && decoder.function == function && decoder.dataType == reg.dataType) {
+                decoderOf[j] = d;
+                break;
+            }
+        }
+    }
+    
+    for (uint8_t b = 0; b < plan.blockCount; b++) {
+        if (g_processingPaused) {
+            return;
+        }
+        // Trecho do bloco que contém registros configurados
+        uint8_t first = 0xFF;
+        uint8_t end = 0;
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            if (decoderOf[j] < 0 || plan.decoders[decoderOf[j]].block != b) {
+                continue;
+            }
+            const ProfileDecoder& decoder = plan.decoders[decoderOf[j]];
+            uint8_t decoderEnd = decoder.offset + registerWordCount(decoder.dataType);
+            if (decoder.offset < first) first = decoder.offset;
+            if (decoderEnd > end) end = decoderEnd;
+        }
+        if (first >= end) {
+            continue;
+        }
+        // CRÍTICO: Yield antes de cada leitura para manter webserver responsivo
+        yield();
+        
+        const ProfileBlock& block = plan.blocks[b];
+        node.begin(config.devices[i].slaveAddress, busSerial);
+        uint8_t result = block.function == 0x04
+            ? node.readInputRegisters(block.start + first, end - first)
+            : node.readHoldingRegisters(block.start + first, end - first);
+        int64_t sampleTimeUs = monotonicMicros();
+        for (uint8_t k = 0; k < end - first; k++) {
+            blockWords[k] = (result == node.ku8MBSuccess) ? node.getResponseBuffer(k) : 0;
+        }
+        
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            if (decoderOf[j] < 0 || plan.decoders[decoderOf[j]].block != b) {
+                continue;
+            }
+            handleReadResult(i, j, result, &blockWords[plan.decoders[decoderOf[j]].offset - first], sampleTimeUs);
+            handled[j] = true;
+        }
+        
+        ruleFastPath();
+        delay(50); // Delay para garantir resposta antes da próxima leitura
+        busFrameBoundary();
+    }
+}
+
+// Bobinas e entradas discretas de um dispositivo: uma transação por bloco de bits.
+// Histórico e console só recebem mudanças; alarmes recebem toda leitura (dado parado).
+static void readBitBlocks(int i) {
+    static BitBlock blocks[MODBUS_BITS_MAX_BLOCKS];
+    static uint8_t packed[(MODBUS_BITS_MAX_PER_READ + 7) / 8];
+    uint8_t blockCount = bitPlanBlocks(i, blocks, MODBUS_BITS_MAX_BLOCKS);
+    uint8_t slaveAddr = config.devices[i].slaveAddress;
+    
+    for (uint8_t b = 0; b < blockCount; b++) {
+        if (g_processingPaused) {
+            return;
+        }
+        // CRÍTICO: Yield antes de cada leitura para manter webserver responsivo
+        yield();
+        
+        const BitBlock& block = blocks[b];
+        delayMicroseconds(interFrameDelayUs());
+        int64_t sampleTimeUs;
+        uint8_t result = bitReadBlock(slaveAddr, block, packed, &sampleTimeUs);
+        bitCountRead(result);
+        
+        if (result != node.ku8MBSuccess) {
+            consolePrint("[Modbus ERRO] Dev " + String(slaveAddr) + " bits 0x0" + String(block.function) + " " +
+                         String(block.start) + "-" + String(block.start + block.count - 1) + ": " +
+                         modbusResultDescription(result) + "\r\n");
+        } else {
+            for (int j = 0; j < config.devices[i].registerCount; j++) {
+                if (!(block.members & (1UL << j))) {
+                    continue;
+                }
+                ModbusRegister& reg = config.devices[i].registers[j];
+                uint16_t offset = reg.address - block.start;
+                bool value = (packed[offset >> 3] >> (offset & 7)) & 1;
+                bool changed = bitStore(i, j, value);
+                float processedValue = value ? 1.0f : 0.0f;
+                
+                SampleTiming& timing = sampleTimings[i][j];
+                if (reg.sampleTimeUs > 0) {
+                    timing.previousValue = timing.lastValue;
+                    timing.previousTimeUs = reg.sampleTimeUs;
+                } else {
+                    timing.previousTimeUs = 0;
+                }
+                timing.lastValue = processedValue;
+                timing.offsetUs = (int32_t)(sampleTimeUs - g_cycleTickUs);
+                reg.value = value ? 1 : 0;
+                reg.typedRaw = processedValue;
+                reg.sampleTimeUs = sampleTimeUs;
+                
+                ruleOnSample(slaveAddr, reg.address, sampleTimeUs, processedValue);
+                alarmOnSample(slaveAddr, reg.address, sampleTimeUs, processedValue);
+                scriptOnSample(slaveAddr, reg.address);
+                if (!changed) {
+                    continue;
+                }
+                dataLoggerAppend(slaveAddr, reg.address, sampleTimeUs, processedValue, true);
+                String varName = strlen(reg.variableName) > 0 ? String(reg.variableName) : "sem_nome";
+                consolePrint("[Modbus] Dev " + String(slaveAddr) + (reg.registerType == REGISTER_TYPE_COIL ? " Bobina " : " Entrada ") +
+                             String(reg.address) + " (" + varName + "): " + String(value ? 1 : 0) + "\r\n");
+            }
+        }
+        
+        ruleFastPath();
+        delay(50); // Delay para garantir resposta antes da próxima leitura
+        busFrameBoundary();
+    }
+}
+
+// Bobinas alteradas pelos cálculos: endereços consecutivos em um único 0x0F, isoladas com 0x05
+static void writeBitOutputs(int i) {
+    uint32_t pending = bitTakePendingWrites(i);
+    if (pending == 0) {
+        return;
+    }
+    
+    // Índices pendentes ordenados por endereço
+    uint8_t order[MAX_REGISTERS_PER_DEVICE];
+    uint8_t count = 0;
+    for (int j = 0; j < config.devices[i].registerCount; j++) {
+        if (!(pending & (1UL << j)) || config.devices[i].registers[j].registerType != REGISTER_TYPE_COIL) {
+            continue;
+        }
+        int k = count;
+        while (k > 0 && config.devices[i].registers[order[k - 1]].address > config.devices[i].registers[j].address) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = j;
+        count++;
+    }
+    
+    uint8_t slaveAddr = config.devices[i].slaveAddress;
+    uint8_t k = 0;
+    while (k < count) {
+        if (g_processingPaused) {
+            return;
+        }
+        // Sequência de endereços consecutivos a partir de order[k]
+        uint16_t start = config.devices[i].registers[order[k]].address;
+        uint8_t length = 1;
+        while (k + length < count && config.devices[i].registers[order[k + length]].address == start + length) {
+            length++;
+        }
+        
+        node.begin(slaveAddr, busSerial);
+        uint8_t result;
+        if (length == 1) {
+            result = node.writeSingleCoil(start, config.devices[i].registers[order[k]].value ? 1 : 0);
+        } else {
+            // ModbusMaster envia os bits de cada palavra do menos para o mais significativo
+            uint16_t words[(MAX_REGISTERS_PER_DEVICE + 15) / 16] = {};
+            for (uint8_t n = 0; n < length; n++) {
+                if (config.devices[i].registers[order[k + n]].value) {
+                    words[n >> 4] |= (1 << (n & 15));
+                }
+            }
+            for (uint8_t w = 0; w < (length + 15) / 16; w++) {
+                node.setTransmitBuffer(w, words[w]);
+            }
+            result = node.writeMultipleCoils(start, length);
+        }
+        bitCountWrite(result, length);
+        if (result != node.ku8MBSuccess) {
+            consolePrint("[Modbus ERRO] Escrita Dev " + String(slaveAddr) + " bobinas " + String(start) +
+                         (length > 1 ? "-" + String(start + length - 1) : String("")) + ": " + modbusResultDescription(result) + "\r\n");
+        }
+        k += length;
+        
+        delay(50); // Delay para garantir escrita antes da próxima operação
+        busFrameBoundary();
+    }
+}
+
 void readAllDevices() {
     if (g_processingPaused) {
         return;
@@ -131,6 +633,68 @@ void readAllDevices() {
         lastReadTime = currentTime;
     }
     
+    // Tick do ciclo: referência dos desvios de aquisição e instante comum da interpolação
+    g_cycleTickUs = monotonicMicros();
+    
+    // 1) Grupos de amostragem, em ordem crescente de grupo, logo após o tick.
+    // Entre leituras do mesmo grupo só há o silêncio mínimo entre quadros;
+    // console, histórico e Kalman ficam para depois das transações do grupo.
+    static GroupRead groupReads[MAX_DEVICES * MAX_REGISTERS_PER_DEVICE];
+    uint8_t group = 0;
+    while (true) {
+        // Próximo grupo configurado acima do atual
+        uint8_t nextGroup = 0;
+        for (int i = 0; i < config.deviceCount; i++) {
+            if (!config.devices[i].enabled) {
+                continue;
+            }
+            for (int j = 0; j < config.devices[i].registerCount; j++) {
+                uint8_t g = config.devices[i].registers[j].sampleGroup;
+                if (g > group && (nextGroup == 0 || g < nextGroup) && shouldReadRegister(config.devices[i].registers[j])) {
+                    nextGroup = g;
+                }
+            }
+        }
+        if (nextGroup == 0) {
+            break;
+        }
+        group = nextGroup;
+        
+        int readCount = 0;
+        for (int i = 0; i < config.deviceCount; i++) {
+            if (!config.devices[i].enabled) {
+                continue;
+            }
+            for (int j = 0; j < config.devices[i].registerCount; j++) {
+                if (g_processingPaused) {
+                    return;
+                }
+                if (config.devices[i].registers[j].sampleGroup != group || !shouldReadRegister(config.devices[i].registers[j])) {
+                    continue;
+                }
+                if (readCount > 0) {
+                    delayMicroseconds(interFrameDelayUs());
+                }
+                GroupRead& read = groupReads[readCount++];
+                read.device = i;
+                read.reg = j;
+                read.result = transactRead(i, j, read.words, &read.sampleTimeUs);
+            }
+        }
+        
+        for (int k = 0; k < readCount; k++) {
+            // CRÍTICO: Yield permite que o webserver e outras tarefas executem
+            yield();
+            handleReadResult(groupReads[k].device, groupReads[k].reg, groupReads[k].result,
+                             groupReads[k].words, groupReads[k].sampleTimeUs);
+        }
+        
+        ruleFastPath();
+        delay(50); // Delay para garantir resposta antes da próxima leitura
+        busFrameBoundary();
+    }
+    
+    // 2) Registros sem grupo, na ordem de configuração
     for (int i = 0; i < config.deviceCount; i++) {
         if (g_processingPaused) {
             return;
@@ -143,10 +707,12 @@ void readAllDevices() {
             continue;
         }
         
-        uint8_t slaveAddr = config.devices[i].slaveAddress;
+        // Bobinas e entradas discretas em blocos de bits
+        readBitBlocks(i);
         
-        // Configura o endereço do escravo para este dispositivo
-        node.begin(slaveAddr, Serial2);
+        // Dispositivo com perfil: primeiro os blocos do plano de leitura
+        bool handled[MAX_REGISTERS_PER_DEVICE] = {};
+        readProfileBlocks(i, handled);
         
         for (int j = 0; j < config.devices[i].registerCount; j++) {
             if (g_processingPaused) {
@@ -155,115 +721,59 @@ void readAllDevices() {
             // CRÍTICO: Yield antes de cada leitura para manter webserver responsivo
             yield();
             
-            // Determina se deve ler baseado no registerType
-            uint8_t registerType = config.devices[i].registers[j].registerType;
-            bool shouldRead = (registerType == 0 || registerType == 2); // Leitura ou Leitura e Escrita
-            
-            // Compatibilidade: se registerType não estiver definido, usa campos antigos
-            if (registerType == 0 && config.devices[i].registers[j].isOutput) {
-                shouldRead = false; // Se é somente escrita, não lê
-            } else if (registerType == 0 && config.devices[i].registers[j].isOutput == false && 
-                       config.devices[i].registers[j].readOnly == false && 
-                       config.devices[i].registers[j].isInput == true) {
-                shouldRead = true; // Leitura e Escrita
-            }
-            
-            // Pula registros que não devem ser lidos
-            if (!shouldRead) {
+            // Pula registros que não devem ser lidos e os já lidos com seu grupo ou bloco
+            if (handled[j] || config.devices[i].registers[j].sampleGroup != 0 || !shouldReadRegister(config.devices[i].registers[j])) {
                 continue;
             }
             
-            uint16_t regAddr = config.devices[i].registers[j].address;
-            uint8_t registerCount = config.devices[i].registers[j].registerCount;
-            if (registerCount == 0) registerCount = 1; // Garante mínimo de 1
-            
-            uint8_t result;
-            
-            // Lê registro Modbus usando função apropriada baseada no tipo
-            // Padrão Modbus:
-            // - Input Registers (0x04): somente leitura (registerType == 0)
-            // - Holding Registers (0x03): leitura/escrita (registerType == 2)
-            // Compatibilidade: se registerType não definido, usa isInput
-            if (registerType == 0 || (!config.devices[i].registers[j].isInput && registerType == 0)) {
-                // Input Register (0x04) - somente leitura, pode ler múltiplos registros
-                result = node.readInputRegisters(regAddr, registerCount);
-            } else {
-                // Holding Register (0x03) - leitura/escrita, pode ler múltiplos registros
-                result = node.readHoldingRegisters(regAddr, registerCount);
-            }
-            
-            // Verifica se a leitura foi bem-sucedida
-            if (result == node.ku8MBSuccess) {
-                // Armazena valor raw do Modbus (primeiro registrador)
-                // Para múltiplos registros, armazena apenas o primeiro (compatibilidade)
-                uint16_t rawValueModbus = node.getResponseBuffer(0);
-                
-                // Aplica filtro de Kalman se habilitado
-                float rawValue = (float)rawValueModbus;
-                if (config.devices[i].registers[j].kalmanEnabled) {
-                    // Aplica filtro de Kalman ao valor raw com parâmetros configuráveis
-                    float kalmanQ = config.devices[i].registers[j].kalmanQ;
-                    float kalmanR = config.devices[i].registers[j].kalmanR;
-                    rawValue = kalmanFilter(&kalmanStates[i][j], rawValue, kalmanQ, kalmanR);
-                    // Arredonda para uint16_t após filtro
-                    rawValueModbus = (uint16_t)round(rawValue);
-                } else {
-                    // Se filtro foi desabilitado, reseta o estado
-                    if (kalmanStates[i][j].initialized) {
-                        kalmanReset(&kalmanStates[i][j]);
-                    }
-                }
-                
-                // Armazena valor (raw ou filtrado) no registro
-                config.devices[i].registers[j].value = rawValueModbus;
-                
-                // Calcula valor processado (com gain e offset)
-                float processedValue = (rawValue * config.devices[i].registers[j].gain) + config.devices[i].registers[j].offset;
-                
-                // Mostra no console
-                String varName = strlen(config.devices[i].registers[j].variableName) > 0 
-                    ? String(config.devices[i].registers[j].variableName) 
-                    : "sem_nome";
-                
-                String msg = "[Modbus] Dev " + String(slaveAddr) + 
-                            " Reg " + String(regAddr) + 
-                            " (" + varName + "): " + 
-                            String(processedValue, 2) + 
-                            " (raw: " + String(config.devices[i].registers[j].value) + ")\r\n";
-                // consolePrint já imprime no Serial e no WebSocket, não precisa duplicar
-                consolePrint(msg);
-            } else {
-                // Em caso de erro, mantém o valor anterior ou zera
-                String varName = strlen(config.devices[i].registers[j].variableName) > 0 
-                    ? String(config.devices[i].registers[j].variableName) 
-                    : "sem_nome";
-                
-                // Obtém descrição do erro
-                String errorDesc = "Erro desconhecido";
-                switch(result) {
-                    case 0x01: errorDesc = "Funcao ilegal"; break;
-                    case 0x02: errorDesc = "Endereco de dados ilegal"; break;
-                    case 0x03: errorDesc = "Valor de dados ilegal"; break;
-                    case 0x04: errorDesc = "Falha no dispositivo escravo"; break;
-                    case 0xE1: errorDesc = "Timeout"; break;
-                    case 0xE2: errorDesc = "Resposta invalida"; break;
-                    case 0xE3: errorDesc = "Checksum invalido"; break;
-                    case 0xE4: errorDesc = "Excecao Modbus"; break;
-                    default: errorDesc = "Codigo: 0x" + String(result, HEX); break;
-                }
-                
-                String msg = "[Modbus ERRO] Dev " + String(slaveAddr) + 
-                            " Reg " + String(regAddr) + 
-                            " (" + varName + "): " + errorDesc + "\r\n";
-                // consolePrint já imprime no Serial e no WebSocket, não precisa duplicar
-                consolePrint(msg);
-            }
+            uint16_t words[2];
+            int64_t sampleTimeUs;
+            uint8_t result = transactRead(i, j, words, &sampleTimeUs);
+            handleReadResult(i, j, result, words, sampleTimeUs);
             
+            ruleFastPath();
             delay(50); // Delay para garantir resposta antes da próxima leitura
+            busFrameBoundary();
         }
     }
 }
 
+bool interpolatedSample(int deviceIndex, int registerIndex, int64_t atUs, float* value) {
+    const ModbusRegister& reg = config.devices[deviceIndex].registers[registerIndex];
+    const SampleTiming& timing = sampleTimings[deviceIndex][registerIndex];
+    if (reg.sampleTimeUs <= 0) {
+        return false;
+    }
+    
+    // Sem leitura anterior, ou instante fora do intervalo: mantém a amostra mais próxima (sem extrapolar)
+    if (timing.previousTimeUs <= 0 || atUs >= reg.sampleTimeUs) {
+        *value = timing.lastValue;
+    } else if (atUs <= timing.previousTimeUs) {
+        *value = timing.previousValue;
+    } else {
+        float fraction = (float)(atUs - timing.previousTimeUs) / (float)(reg.sampleTimeUs - timing.previousTimeUs);
+        *value = timing.previousValue + (timing.lastValue - timing.previousValue) * fraction;
+    }
+    return true;
+}
+
+int32_t sampleGroupSpreadUs(uint8_t group) {
+    int64_t first = 0;
+    int64_t last = 0;
+    for (int i = 0; i < config.deviceCount; i++) {
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            const ModbusRegister& reg = config.devices[i].registers[j];
+            // Só leituras bem-sucedidas do ciclo atual
+            if (reg.sampleGroup != group || reg.sampleTimeUs < g_cycleTickUs) {
+                continue;
+            }
+            if (first == 0 || reg.sampleTimeUs < first) first = reg.sampleTimeUs;
+            if (reg.sampleTimeUs > last) last = reg.sampleTimeUs;
+        }
+    }
+    return first == 0 ? -1 : (int32_t)(last - first);
+}
+
 void writeOutputRegisters() {
     if (g_processingPaused) {
         return;
@@ -279,9 +789,6 @@ void writeOutputRegisters() {
         
         uint8_t slaveAddr = config.devices[i].slaveAddress;
         
-        // Configura o endereço do escravo para este dispositivo
-        node.begin(slaveAddr, Serial2);
-        
         for (int j = 0; j < config.devices[i].registerCount; j++) {
             if (g_processingPaused) {
                 return;
@@ -289,6 +796,13 @@ void writeOutputRegisters() {
             // CRÍTICO: Yield antes de cada escrita para manter webserver responsivo
             yield();
             
+            // Registros de saída de blocos PID ativos são escritos pelo próprio bloco,
+            // e os retidos por uma regra disparada, pela regra
+            if (pidOwnsRegister(slaveAddr, config.devices[i].registers[j].address) ||
+                ruleHoldsRegister(slaveAddr, config.devices[i].registers[j].address)) {
+                continue;
+            }
+            
             // Determina se deve escrever baseado no registerType
             uint8_t registerType = config.devices[i].registers[j].registerType;
             bool shouldWrite = (registerType == 1 || registerType == 2); // Escrita ou Leitura e Escrita
@@ -313,9 +827,18 @@ void writeOutputRegisters() {
             
             uint8_t result;
             
+            // Configura o endereço do escravo (um bloco PID pode ter usado o barramento entre escritas)
+            node.begin(slaveAddr, busSerial);
+            
             // Determina função Modbus apropriada baseada na quantidade de registros
             // Padrão Modbus: 0x06 para 1 registrador, 0x10 para múltiplos
-            if (registerCount == 1) {
+            uint16_t words[2];
+            if (encodeRegisterWords(config.devices[i].registers[j].dataType, registerRawValue(config.devices[i].registers[j]), words) == 2) {
+                // Tipos de 32 bits: as 2 palavras do valor, na ordem do tipo
+                node.setTransmitBuffer(0, words[0]);
+                node.setTransmitBuffer(1, words[1]);
+                result = node.writeMultipleRegisters(regAddr, 2);
+            } else if (registerCount == 1) {
                 // Write Single Register (0x06)
                 uint16_t value = config.devices[i].registers[j].value;
                 result = node.writeSingleRegister(regAddr, value);
@@ -340,7 +863,87 @@ void writeOutputRegisters() {
             }
             
             delay(50); // Delay para garantir escrita antes da próxima operação
+            busFrameBoundary();
+        }
+        
+        // Bobinas alteradas pelos cálculos neste ciclo
+        writeBitOutputs(i);
+    }
+}
+
+bool readRegisterNow(int deviceIndex, int registerIndex, float* processedValue, int64_t* sampleTimeUs) {
+    ModbusRegister& reg = config.devices[deviceIndex].registers[registerIndex];
+    if (isBitRegister(reg)) {
+        // Um bit só, no mesmo formato dos blocos do ciclo
+        BitBlock block = { (uint8_t)(reg.registerType == REGISTER_TYPE_COIL ? 0x01 : 0x02), reg.address, 1, 0 };
+        uint8_t packed[1];
+        delayMicroseconds(interFrameDelayUs());
+        uint8_t result = bitReadBlock(config.devices[deviceIndex].slaveAddress, block, packed, sampleTimeUs);
+        bitCountRead(result);
+        if (result != node.ku8MBSuccess) {
+            return false;
         }
+        bitStore(deviceIndex, registerIndex, packed[0] & 1);
+        reg.value = packed[0] & 1;
+        reg.typedRaw = reg.value;
+        reg.sampleTimeUs = *sampleTimeUs;
+        sampleTimings[deviceIndex][registerIndex].lastValue = reg.value;
+        *processedValue = reg.value;
+        return true;
+    }
+    uint16_t words[2];
+    uint8_t result = transactRead(deviceIndex, registerIndex, words, sampleTimeUs);
+    handleReadResult(deviceIndex, registerIndex, result, words, *sampleTimeUs, false);
+    if (result != node.ku8MBSuccess) {
+        return false;
+    }
+    *processedValue = sampleTimings[deviceIndex][registerIndex].lastValue;
+    return true;
+}
+
+bool writeRegisterNow(int deviceIndex, int registerIndex, float rawValue) {
+    ModbusRegister& reg = config.devices[deviceIndex].registers[registerIndex];
+    uint16_t regAddr = reg.address;
+    uint8_t registerCount = reg.registerCount;
+    if (registerCount == 0) registerCount = 1; // Garante mínimo de 1
+    
+    // Escritas do operador têm prioridade sobre as saídas de controle
+    modbusQueueService();
+    
+    // Silêncio entre quadros (a leitura do bloco pode ter acabado de terminar)
+    delayMicroseconds(interFrameDelayUs());
+    node.begin(config.devices[deviceIndex].slaveAddress, busSerial);
+    
+    uint8_t result;
+    if (reg.registerType == REGISTER_TYPE_COIL) {
+        uint16_t coilValue = rawValue != 0.0f ? 1 : 0;
+        result = node.writeSingleCoil(regAddr, coilValue);
+        if (result != node.ku8MBSuccess) {
+            return false;
+        }
+        reg.value = coilValue;
+        reg.typedRaw = coilValue;
+        return true;
+    }
+    // Palavras no tipo de dado do registro, como em writeOutputRegisters()
+    uint16_t words[2];
+    if (encodeRegisterWords(reg.dataType, rawValue, words) == 2) {
+        node.setTransmitBuffer(0, words[0]);
+        node.setTransmitBuffer(1, words[1]);
+        result = node.writeMultipleRegisters(regAddr, 2);
+    } else if (registerCount == 1) {
+        result = node.writeSingleRegister(regAddr, words[0]);
+    } else {
+        // Mesmo valor em todos os registros, como em writeOutputRegisters()
+        for (uint8_t k = 0; k < registerCount && k < 125; k++) {
+            node.setTransmitBuffer(k, words[0]);
+        }
+        result = node.writeMultipleRegisters(regAddr, registerCount);
+    }
+    if (result != node.ku8MBSuccess) {
+        return false;
     }
+    setRegisterRawValue(reg, rawValue);
+    return true;
 }
 
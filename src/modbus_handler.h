@@ -17,6 +17,20 @@ extern uint32_t currentBaudRate;
 extern uint32_t currentSerialConfig;
 extern KalmanState kalmanStates[MAX_DEVICES][MAX_REGISTERS_PER_DEVICE];
 
+/**
+ * @struct SampleTiming
+ * @brief Instantes de amostragem de um registro em relação ao tick do ciclo
+ */
+struct SampleTiming {
+    int32_t offsetUs;          // Recepção da última leitura menos o tick do ciclo (desvio de aquisição, µs)
+    float lastValue;           // Valor processado da última leitura (gain/offset/Kalman)
+    float previousValue;       // Valor processado da leitura anterior
+    int64_t previousTimeUs;    // Instante da leitura anterior (monotonicMicros()); 0 = nenhuma
+};
+
+extern SampleTiming sampleTimings[MAX_DEVICES][MAX_REGISTERS_PER_DEVICE];
+extern int64_t g_cycleTickUs;  // Início do último ciclo de leitura (monotonicMicros())
+
 
 /**
  * @brief Callback antes da transmissão Modbus (habilita transmissão RS485)
@@ -43,15 +57,106 @@ void setupModbus(uint32_t baudRate = 0, uint32_t serialConfig = 0);
  */
 uint32_t buildSerialConfig(uint8_t dataBits, uint8_t parity, uint8_t stopBits);
 
+/**
+ * @brief Silêncio mínimo entre quadros RTU (3,5 caracteres; fixo em 1750 µs acima de 19200 baud)
+ */
+uint32_t interFrameDelayUs();
+
+/**
+ * @brief Quantidade de registradores de 16 bits ocupados por um tipo de dado (1 ou 2)
+ */
+uint8_t registerWordCount(uint8_t dataType);
+
+/**
+ * @brief Decodifica as palavras lidas conforme o tipo de dado (REGISTER_DATA_*)
+ * @param words Palavras na ordem recebida (registerWordCount(dataType) posições)
+ */
+float decodeRegisterWords(uint8_t dataType, const uint16_t* words);
+
+/**
+ * @brief Codifica um valor raw nas palavras a escrever, conforme o tipo de dado
+ *
+ * Limita ao intervalo do tipo e trunca para inteiro, como as escritas de 16 bits.
+ * @return Quantidade de palavras (1 ou 2)
+ */
+uint8_t encodeRegisterWords(uint8_t dataType, float value, uint16_t* words);
+
+/**
+ * @brief Atualiza value/typedRaw de um registro com um valor raw a escrever
+ */
+void setRegisterRawValue(ModbusRegister& reg, float value);
+
+/**
+ * @brief Valor raw de um registro (antes de gain/offset), respeitando o tipo de dado
+ *
+ * uint16/int16 vêm de value (que as escritas também atualizam); 32 bits vêm
+ * de typedRaw.
+ */
+float registerRawValue(const ModbusRegister& reg);
+
 /**
  * @brief Lê todos os registros de todos os dispositivos configurados
+ *
+ * Marca o tick do ciclo (g_cycleTickUs) e lê primeiro os grupos de amostragem
+ * (sampleGroup != 0), um grupo por vez e sem pausas entre as transações do
+ * grupo; depois os registros sem grupo, na ordem de configuração. Em
+ * dispositivos com perfil (device_profiles.h), os registros sem grupo que
+ * constam do perfil são lidos pelos blocos do plano compilado, uma transação
+ * por bloco. Bobinas e entradas discretas (modbus_bits.h) são lidas em blocos
+ * de bits por dispositivo, independente de grupo. Entre grupos e entre
+ * transações sem grupo executa as escritas da fila (modbusQueueService) e os
+ * blocos PID vencidos.
  */
 void readAllDevices();
 
+/**
+ * @brief Valor processado de um registro interpolado linearmente em um instante
+ *
+ * Usa as duas últimas leituras; fora do intervalo entre elas mantém a mais
+ * próxima (não extrapola).
+ * @param atUs Instante desejado (monotonicMicros()), normalmente g_cycleTickUs
+ * @return false se o registro ainda não foi lido
+ */
+bool interpolatedSample(int deviceIndex, int registerIndex, int64_t atUs, float* value);
+
+/**
+ * @brief Espalhamento das leituras de um grupo no último ciclo
+ * @return Diferença entre a última e a primeira recepção (µs) ou -1 se o grupo não teve leituras
+ */
+int32_t sampleGroupSpreadUs(uint8_t group);
+
 /**
  * @brief Escreve valores em registros de saída
+ *
+ * Registros de saída de blocos PID ativos (pidOwnsRegister) e de regras de
+ * reação disparadas (ruleHoldsRegister) são ignorados.
+ * Tipos de 32 bits são escritos com 0x10 nas 2 palavras codificadas de typedRaw.
+ * Bobinas só são escritas quando alteradas pelos cálculos (bitRequestWrite),
+ * com endereços consecutivos agrupados em um único 0x0F.
  */
 void writeOutputRegisters();
 
+/**
+ * @brief Lê um registro imediatamente, fora do ciclo (blocos PID)
+ *
+ * Mesmo processamento de readAllDevices() (Kalman, histórico, alarmes), sem
+ * mensagem no console.
+ * @param processedValue Valor com gain/offset/Kalman
+ * @param sampleTimeUs Recepção da resposta (monotonicMicros())
+ * @return false em erro de comunicação
+ */
+bool readRegisterNow(int deviceIndex, int registerIndex, float* processedValue, int64_t* sampleTimeUs);
+
+/**
+ * @brief Escreve um valor raw em um registro imediatamente (0x05, 0x06 ou 0x10)
+ *
+ * O valor é codificado no tipo de dado do registro (encodeRegisterWords());
+ * tipos de 32 bits vão sempre em 0x10 com as duas palavras. Executa antes as
+ * escritas do operador pendentes na fila (prioridade maior).
+ * @param rawValue Valor raw (antes de gain/offset); em bobinas, diferente de 0 liga
+ * @return false em erro de comunicação
+ */
+bool writeRegisterNow(int deviceIndex, int registerIndex, float rawValue);
+
 #endif // MODBUS_HANDLER_H
 
@@ -0,0 +1,240 @@
+/**
+ * @file modbus_queue.cpp
+ * @brief Implementação da fila de escritas Modbus
+ */
+
+#include "modbus_queue.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "rtc_manager.h"
+#include "bus_capture.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static ModbusWriteTicket s_tickets[MODBUS_QUEUE_SIZE];
+static uint32_t s_nextId = 1;
+static ModbusQueueStats s_stats = {};
+static bool s_servicing = false;   // Evita reentrada (a escrita pode ceder a CPU)
+
+static SemaphoreHandle_t s_queueMutex = nullptr;
+
+static inline bool lockQueue(TickType_t ticks) {
+    return xSemaphoreTake(s_queueMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockQueue() {
+    xSemaphoreGive(s_queueMutex);
+}
+
+void modbusQueueInit() {
+    if (s_queueMutex == nullptr) {
+        s_queueMutex = xSemaphoreCreateMutex();
+    }
+}
+
+uint32_t modbusQueueWrite(uint8_t priority, uint8_t slaveAddress, uint16_t registerAddress,
+                          uint8_t registerCount, uint32_t rawValue) {
+    if (priority >= MODBUS_PRIORITY_COUNT) {
+        priority = MODBUS_PRIORITY_CONTROL;
+    }
+    if (!lockQueue(pdMS_TO_TICKS(100))) {
+        return 0;
+    }
+
+    // Slot livre ou, na falta, a escrita concluída mais antiga
+    int slot = -1;
+    for (int k = 0; k < MODBUS_QUEUE_SIZE; k++) {
+        if (s_tickets[k].state == MODBUS_WRITE_FREE) {
+            slot = k;
+            break;
+        }
+        if (s_tickets[k].state == MODBUS_WRITE_DONE && (slot < 0 || s_tickets[k].id < s_tickets[slot].id)) {
+            slot = k;
+        }
+    }
+    if (slot < 0) {
+        s_stats.rejected++;
+        unlockQueue();
+        return 0;
+    }
+
+    ModbusWriteTicket& ticket = s_tickets[slot];
+    memset(&ticket, 0, sizeof(ticket));
+    ticket.id = s_nextId++;
+    ticket.priority = priority;
+    ticket.state = MODBUS_WRITE_PENDING;
+    ticket.slaveAddress = slaveAddress;
+    ticket.registerAddress = registerAddress;
+    ticket.registerCount = registerCount;
+    ticket.rawValue = rawValue;
+    ticket.queuedUs = monotonicMicros();
+    s_stats.pending++;
+    uint32_t id = ticket.id;
+
+    unlockQueue();
+    return id;
+}
+
+bool modbusQueueStatus(uint32_t id, ModbusWriteTicket* ticket) {
+    if (id == 0 || !lockQueue(pdMS_TO_TICKS(100))) {
+        return false;
+    }
+    bool found = false;
+    for (int k = 0; k < MODBUS_QUEUE_SIZE; k++) {
+        if (s_tickets[k].state != MODBUS_WRITE_FREE && s_tickets[k].id == id) {
+            *ticket = s_tickets[k];
+            found = true;
+            break;
+        }
+    }
+    unlockQueue();
+    return found;
+}
+
+// Transação de escrita (executada somente pelo loop)
+static uint8_t executeWrite(const ModbusWriteTicket& ticket) {
+    // Silêncio entre quadros: a fronteira pode ser logo após uma resposta
+    delayMicroseconds(interFrameDelayUs());
+    node.begin(ticket.slaveAddress, busSerial);
+
+    // Padrão Modbus: 0x05 para bobina, 0x06 para 1 registrador, 0x10 para múltiplos
+    if (ticket.registerCount == 0) {
+        return node.writeSingleCoil(ticket.registerAddress, ticket.rawValue != 0 ? 1 : 0);
+    }
+    if (ticket.registerCount == 1) {
+        return node.writeSingleRegister(ticket.registerAddress, (uint16_t)(ticket.rawValue & 0xFFFF));
+    }
+    // Divide o valor em palavras de 16 bits; a mais significativa vai no primeiro registrador
+    for (int i = ticket.registerCount - 1; i >= 0; i--) {
+        uint16_t regValue = i < 2 ? (uint16_t)((ticket.rawValue >> (i * 16)) & 0xFFFF) : 0;
+        node.setTransmitBuffer((ticket.registerCount - 1) - i, regValue);
+    }
+    return node.writeMultipleRegisters(ticket.registerAddress, ticket.registerCount);
+}
+
+// Mantém o valor do registro na configuração igual ao que foi escrito
+static void updateConfigValue(const ModbusWriteTicket& ticket) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (config.devices[i].slaveAddress != ticket.slaveAddress) {
+            continue;
+        }
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            ModbusRegister& reg = config.devices[i].registers[j];
+            if (reg.address != ticket.registerAddress) {
+                continue;
+            }
+            if (ticket.registerCount == 0) {
+                reg.value = ticket.rawValue ? 1 : 0;
+                reg.typedRaw = reg.value;
+                continue;
+            }
+            // Duas palavras (tipos de 32 bits) na ordem de executeWrite(); value guarda a
+            // primeira e typedRaw o valor no tipo do registro, como setRegisterRawValue()
+            uint16_t words[2];
+            if (ticket.registerCount == 2) {
+                words[0] = (uint16_t)(ticket.rawValue >> 16);
+                words[1] = (uint16_t)(ticket.rawValue & 0xFFFF);
+            } else {
+                words[0] = (uint16_t)(ticket.rawValue & 0xFFFF);
+                words[1] = 0;
+            }
+            reg.value = words[0];
+            reg.typedRaw = decodeRegisterWords(reg.dataType, words);
+        }
+    }
+}
+
+uint8_t modbusQueueService() {
+    if (s_servicing || g_processingPaused || s_stats.pending == 0) {
+        return 0;
+    }
+    s_servicing = true;
+
+    uint8_t executed = 0;
+    while (true) {
+        if (!lockQueue(pdMS_TO_TICKS(100))) {
+            break;
+        }
+        // Maior prioridade primeiro; dentro da prioridade, ordem de chegada
+        int slot = -1;
+        for (int k = 0; k < MODBUS_QUEUE_SIZE; k++) {
+            if (s_tickets[k].state != MODBUS_WRITE_PENDING) {
+                continue;
+            }
+            if (slot < 0 || s_tickets[k].priority < s_tickets[slot].priority ||
+                (s_tickets[k].priority == s_tickets[slot].priority && s_tickets[k].id < s_tickets[slot].id)) {
+                slot = k;
+            }
+        }
+        if (slot < 0) {
+            unlockQueue();
+            break;
+        }
+        s_tickets[slot].startedUs = monotonicMicros();
+        ModbusWriteTicket ticket = s_tickets[slot];
+        unlockQueue();
+
+        uint8_t result = executeWrite(ticket);
+        int64_t completedUs = monotonicMicros();
+        if (result == node.ku8MBSuccess) {
+            updateConfigValue(ticket);
+        }
+
+        lockQueue(portMAX_DELAY);
+        // O slot não é reutilizado enquanto está pendente
+        s_tickets[slot].result = result;
+        s_tickets[slot].completedUs = completedUs;
+        s_tickets[slot].state = MODBUS_WRITE_DONE;
+        s_stats.pending--;
+        s_stats.executed++;
+        if (result != node.ku8MBSuccess) {
+            s_stats.failed++;
+        }
+        s_stats.lastWaitUs = (uint32_t)(ticket.startedUs - ticket.queuedUs);
+        if (s_stats.lastWaitUs > s_stats.maxWaitUs) {
+            s_stats.maxWaitUs = s_stats.lastWaitUs;
+        }
+        unlockQueue();
+        executed++;
+
+        if (result == node.ku8MBSuccess) {
+            consolePrint("[Modbus] Escrito Dev " + String(ticket.slaveAddress) + " Reg " + String(ticket.registerAddress) +
+                         (ticket.registerCount > 1 ? " (funcao 0x10, " + String(ticket.registerCount) + " registros)" :
+                          String(ticket.registerCount == 0 ? " (funcao 0x05)" : " (funcao 0x06)")) +
+                         ": raw " + String(ticket.rawValue) + ", fila " + String((ticket.startedUs - ticket.queuedUs) / 1000.0f, 1) + " ms\r\n");
+        } else {
+            consolePrint("[Modbus ERRO] Escrita Dev " + String(ticket.slaveAddress) + " Reg " + String(ticket.registerAddress) +
+                         ": " + modbusResultDescription(result) + "\r\n");
+        }
+        yield();
+    }
+
+    s_servicing = false;
+    return executed;
+}
+
+void modbusQueueGetStats(ModbusQueueStats* stats) {
+    if (!lockQueue(pdMS_TO_TICKS(100))) {
+        memset(stats, 0, sizeof(ModbusQueueStats));
+        return;
+    }
+    *stats = s_stats;
+    unlockQueue();
+}
+
+String modbusResultDescription(uint8_t result) {
+    switch (result) {
+        case 0x00: return "Sucesso";
+        case 0x01: return "Funcao ilegal";
+        case 0x02: return "Endereco de dados ilegal";
+        case 0x03: return "Valor de dados ilegal";
+        case 0x04: return "Falha no dispositivo escravo";
+        case 0xE1: return "Timeout";
+        case 0xE2: return "Resposta invalida";
+        case 0xE3: return "Checksum invalido";
+        case 0xE4: return "Excecao Modbus";
+        default: return "Codigo: 0x" + String(result, HEX);
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * @file modbus_queue.h
+ * @brief Fila de escritas Modbus com prioridade (o loop é o único dono do barramento)
+ *
+ * Escritas pedidas por outras tasks (interface web) não acessam o Serial2:
+ * entram na fila e são executadas pelo loop na próxima fronteira entre
+ * quadros do ciclo de leitura (modbusQueueService()). Prioridades, da maior
+ * para a menor:
+ *
+ * 1. Regras de reação (MODBUS_PRIORITY_SAFETY: postas na fila no instante
+ *    em que a leitura é decodificada, saem na fronteira seguinte)
+ * 2. Escritas do operador (MODBUS_PRIORITY_OPERATOR)
+ * 3. Saídas de controle (MODBUS_PRIORITY_CONTROL: blocos PID e atribuições
+ *    do script, que rodam no próprio loop e drenam a fila antes de escrever)
+ * 4. Leituras dos grupos de amostragem (rápidas)
+ * 5. Leituras sem grupo (lentas)
+ *
+ * As leituras não passam pela fila: o ciclo de leitura é a prioridade mais
+ * baixa por construção e cede o barramento a cada fronteira. Um grupo de
+ * amostragem não é interrompido (as leituras do grupo precisam ficar juntas),
+ * então a espera máxima de uma escrita é uma transação (ou um grupo) mais o
+ * silêncio entre quadros.
+ *
+ * Cada escrita recebe um identificador; o estado fica disponível até o slot
+ * ser reutilizado, com os instantes de entrada na fila, início e conclusão.
+ */
+
+#ifndef MODBUS_QUEUE_H
+#define MODBUS_QUEUE_H
+
+#include <Arduino.h>
+
+#define MODBUS_QUEUE_SIZE 16
+// O handler HTTP não espera a escrita (roda na task do AsyncTCP): responde com o
+// id e o cliente consulta o resultado com modbusQueueStatus()
+
+/**
+ * @brief Prioridade de uma escrita (menor valor = maior prioridade)
+ */
+enum ModbusPriority {
+    MODBUS_PRIORITY_SAFETY = 0,
+    MODBUS_PRIORITY_OPERATOR,
+    MODBUS_PRIORITY_CONTROL,
+    MODBUS_PRIORITY_COUNT
+};
+
+/**
+ * @brief Estado de uma escrita
+ */
+enum ModbusWriteState {
+    MODBUS_WRITE_FREE = 0,
+    MODBUS_WRITE_PENDING,
+    MODBUS_WRITE_DONE
+};
+
+/**
+ * @struct ModbusWriteTicket
+ * @brief Escrita na fila e seu resultado
+ */
+struct ModbusWriteTicket {
+    uint32_t id;
+    uint8_t priority;          // ModbusPriority
+    uint8_t state;             // ModbusWriteState
+    uint8_t result;            // Código ModbusMaster (ku8MBSuccess = 0)
+    uint8_t slaveAddress;
+    uint16_t registerAddress;
+    uint8_t registerCount;     // 1 = 0x06; >1 = 0x10 com o valor dividido em palavras (mais significativa primeiro); 0 = bobina (0x05)
+    uint32_t rawValue;
+    int64_t queuedUs;          // monotonicMicros() ao entrar na fila
+    int64_t startedUs;         // Início da transação
+    int64_t completedUs;       // Resposta do escravo (ou erro)
+};
+
+/**
+ * @struct ModbusQueueStats
+ * @brief Contadores da fila
+ */
+struct ModbusQueueStats {
+    uint8_t pending;
+    uint32_t executed;
+    uint32_t failed;
+    uint32_t rejected;         // Fila cheia
+    uint32_t lastWaitUs;       // Entrada na fila até o início da transação
+    uint32_t maxWaitUs;
+};
+
+/**
+ * @brief Cria o mutex da fila (setup(), antes do servidor web e do loop)
+ */
+void modbusQueueInit();
+
+/**
+ * @brief Coloca uma escrita na fila (qualquer task)
+ * @return Identificador da escrita ou 0 se a fila está cheia
+ */
+uint32_t modbusQueueWrite(uint8_t priority, uint8_t slaveAddress, uint16_t registerAddress,
+                          uint8_t registerCount, uint32_t rawValue);
+
+/**
+ * @brief Copia o estado de uma escrita
+ * @return false se o identificador não existe mais (slot reutilizado)
+ */
+bool modbusQueueStatus(uint32_t id, ModbusWriteTicket* ticket);
+
+/**
+ * @brief Executa as escritas pendentes, por prioridade e ordem de chegada
+ *
+ * Somente o loop (dono do barramento) chama esta função, em fronteiras entre
+ * quadros. Não faz nada com o processamento pausado.
+ * @return Quantidade de escritas executadas
+ */
+uint8_t modbusQueueService();
+
+void modbusQueueGetStats(ModbusQueueStats* stats);
+
+/**
+ * @brief Descrição de um código de resultado do ModbusMaster
+ */
+String modbusResultDescription(uint8_t result);
+
+#endif // MODBUS_QUEUE_H
@@ -0,0 +1,130 @@
+/**
+ * @file modbus_rtu.cpp
+ * @brief Implementação das transações Modbus RTU diretas
+ */
+
+#include "modbus_rtu.h"
+#include "modbus_handler.h"
+#include "bus_capture.h"
+#include <HardwareSerial.h>
+
+uint16_t modbusCrc16(const uint8_t* data, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x0001) {
+                crc = (crc >> 1) ^ 0xA001;
+            } else {
+                crc >>= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+// Tamanho esperado da resposta a partir dos bytes já recebidos (0 = ainda não dá para saber)
+static uint16_t expectedLength(const uint8_t* frame, uint16_t received) {
+    if (received < 2) {
+        return 0;
+    }
+    uint8_t function = frame[1];
+    if (function & 0x80) {
+        return 5;                              // Endereço, função, código, CRC
+    }
+    switch (function) {
+        case 0x01:
+        case 0x02:
+        case 0x03:
+        case 0x04:
+            return received < 3 ? 0 : (uint16_t)(5 + frame[2]);   // Contagem de bytes no terceiro byte
+        case 0x05:
+        case 0x06:
+        case 0x0F:
+        case 0x10:
+            return 8;                          // Eco de endereço e valor/quantidade
+        default:
+            return 0;                          // Desconhecida: termina pelo silêncio na linha
+    }
+}
+
+void modbusRtuTransaction(const uint8_t* request, uint8_t length, uint32_t timeoutUs, ModbusRtuResult* result) {
+    result->status = MODBUS_RTU_NO_RESPONSE;
+    result->length = 0;
+    result->latencyUs = 0;
+
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];
+    if (length == 0 || length > MODBUS_RTU_MAX_FRAME - 2) {
+        return;
+    }
+    memcpy(frame, request, length);
+    uint16_t crc = modbusCrc16(frame, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+
+    // Descarta bytes atrasados de transações anteriores
+    while (Serial2.available()) {
+        Serial2.read();
+    }
+
+    preTransmission();
+    busSerial.write(frame, length + 2);
+    busSerial.flush();
+    postTransmission();
+
+    if (request[0] == 0) {
+        return;                                // Broadcast: nenhum escravo responde
+    }
+
+    // Silêncio que marca o fim de um quadro truncado (a UART entrega a FIFO em blocos)
+    uint32_t gapUs = interFrameDelayUs() * 2 + 2000;
+    uint32_t startUs = micros();
+    uint32_t lastByteUs = startUs;
+    uint16_t expected = 0;
+
+    while (true) {
+        if (busSerial.available()) {
+            int value = busSerial.read();
+            if (value < 0) {
+                continue;
+            }
+            if (result->length == 0) {
+                result->latencyUs = micros() - startUs;
+            }
+            if (result->length < MODBUS_RTU_MAX_FRAME) {
+                result->frame[result->length++] = (uint8_t)value;
+            }
+            lastByteUs = micros();
+            if (expected == 0) {
+                expected = expectedLength(result->frame, result->length);
+            }
+            if (expected > 0 && result->length >= expected) {
+                break;
+            }
+            continue;
+        }
+        uint32_t nowUs = micros();
+        if (result->length == 0) {
+            if (nowUs - startUs >= timeoutUs) {
+                return;                        // MODBUS_RTU_NO_RESPONSE
+            }
+        } else if (nowUs - lastByteUs >= gapUs) {
+            break;                             // Quadro terminou antes do esperado
+        }
+        yield();
+    }
+
+    bool complete = result->length >= 4 && (expected == 0 || result->length == expected);
+    if (complete) {
+        uint16_t received = result->frame[result->length - 2] | (result->frame[result->length - 1] << 8);
+        complete = received == modbusCrc16(result->frame, result->length - 2) && result->frame[0] == request[0];
+    }
+    result->status = complete ? MODBUS_RTU_OK : MODBUS_RTU_PARTIAL;
+}
+
+uint8_t modbusRtuException(const ModbusRtuResult* result) {
+    if (result->status != MODBUS_RTU_OK || result->length < 5 || !(result->frame[1] & 0x80)) {
+        return 0;
+    }
+    return result->frame[2];
+}
@@ -0,0 +1,62 @@
+/**
+ * @file modbus_rtu.h
+ * @brief Transações Modbus RTU diretas no Serial2 (sem ModbusMaster)
+ *
+ * O ModbusMaster espera a resposta por um tempo fixo de compilação (2 s) e não
+ * diferencia "ninguém respondeu" de "resposta truncada ou corrompida". Para a
+ * busca de dispositivos é preciso um tempo de espera curto, ajustável a cada
+ * transação, e essa distinção: um quadro incompleto ou com CRC errado indica
+ * que há alguém no endereço (colisão, ruído ou escravo lento) e vale repetir.
+ *
+ * Usa os mesmos pinos e controle DE/RE (preTransmission/postTransmission) do
+ * ModbusMaster e passa pela captura do barramento (busSerial); só deve ser
+ * chamado pelo dono do barramento (loop).
+ */
+
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <Arduino.h>
+
+#define MODBUS_RTU_MAX_FRAME 256
+
+/**
+ * @brief Resultado de uma transação
+ */
+enum ModbusRtuStatus {
+    MODBUS_RTU_OK = 0,             // Quadro completo, CRC válido, do escravo esperado
+    MODBUS_RTU_NO_RESPONSE,        // Nenhum byte dentro do tempo de espera
+    MODBUS_RTU_PARTIAL             // Bytes recebidos, mas quadro incompleto, CRC inválido ou de outro escravo
+};
+
+/**
+ * @struct ModbusRtuResult
+ * @brief Resposta de uma transação
+ */
+struct ModbusRtuResult {
+    uint8_t status;                // ModbusRtuStatus
+    uint16_t length;               // Bytes recebidos (incluindo CRC)
+    uint32_t latencyUs;            // Fim da transmissão até o primeiro byte da resposta
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];
+};
+
+/**
+ * @brief CRC-16 Modbus (polinômio 0xA001, valor inicial 0xFFFF)
+ */
+uint16_t modbusCrc16(const uint8_t* data, uint16_t length);
+
+/**
+ * @brief Envia uma requisição (endereço + PDU, sem CRC) e aguarda a resposta
+ *
+ * Broadcast (endereço 0) não espera resposta e retorna MODBUS_RTU_NO_RESPONSE.
+ * @param timeoutUs Espera máxima pelo primeiro byte da resposta
+ */
+void modbusRtuTransaction(const uint8_t* request, uint8_t length, uint32_t timeoutUs, ModbusRtuResult* result);
+
+/**
+ * @brief Indica se a resposta é uma exceção Modbus (função com bit 0x80)
+ * @return Código da exceção ou 0
+ */
+uint8_t modbusRtuException(const ModbusRtuResult* result);
+
+#endif // MODBUS_RTU_H
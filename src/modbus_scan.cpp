@@ -0,0 +1,291 @@
+/**
+ * @file modbus_scan.cpp
+ * @brief Implementação da busca de dispositivos Modbus
+ */
+
+#include "modbus_scan.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "modbus_rtu.h"
+#include "bus_capture.h"
+#include "rtc_manager.h"
+#include <HardwareSerial.h>
+
+static AsyncWebSocket* s_scanWebSocket = nullptr;
+
+static ModbusScanRequest s_request;
+static ModbusScanStatus s_status = {};
+static ModbusScanFound s_found[SCAN_MAX_RESULTS];
+static uint8_t s_baudIndex = 0;
+static bool s_retryPass = false;                 // Repetindo endereços com resposta parcial
+static uint8_t s_retryCount[256];                // Tentativas feitas por endereço (0 = não precisa repetir)
+static uint32_t s_maxLatencyUs = 0;
+static uint32_t s_startMs = 0;
+static volatile bool s_cancelRequested = false;
+
+static void scanSend(const String& message) {
+    if (s_scanWebSocket && s_scanWebSocket->count() > 0) {
+        s_scanWebSocket->textAll(message);
+    }
+}
+
+static String foundToJson(const ModbusScanFound& found) {
+    return "{\"type\":\"found\",\"address\":" + String(found.address) + ",\"baud\":" + String(found.baud) +
+           ",\"latencyUs\":" + String(found.latencyUs) + ",\"exception\":" + String(found.exception) +
+           ",\"configured\":" + String(found.configured ? "true" : "false") + "}";
+}
+
+static String progressToJson() {
+    return "{\"type\":\"progress\",\"baud\":" + String(s_status.baud) + ",\"address\":" + String(s_status.address) +
+           ",\"probed\":" + String(s_status.probed) + ",\"total\":" + String(s_status.total) +
+           ",\"retries\":" + String(s_status.retries) + ",\"timeoutMs\":" + String(s_status.timeoutUs / 1000.0f, 1) + "}";
+}
+
+// Quem se conecta no meio da busca recebe o que já foi encontrado
+static void onScanWebSocketEvent(AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type, void *, uint8_t *, size_t) {
+    if (type != WS_EVT_CONNECT) {
+        return;
+    }
+    for (uint8_t k = 0; k < s_status.foundCount; k++) {
+        client->text(foundToJson(s_found[k]));
+    }
+    client->text(s_status.running ? progressToJson() : String("{\"type\":\"idle\"}"));
+}
+
+void initScanWebSocket(AsyncWebSocket* ws) {
+    s_scanWebSocket = ws;
+    if (s_scanWebSocket) {
+        s_scanWebSocket->onEvent(onScanWebSocketEvent);
+    }
+}
+
+// Tempo para receber a resposta de 1 registro (7 bytes) mais margem de processamento do escravo
+static uint32_t frameFloorUs(uint32_t baud) {
+    return (uint32_t)(7.0f * 11.0f * 1000000.0f / baud) + 5000;
+}
+
+static uint32_t currentScanBaud() {
+    return s_request.baudCount > 0 ? s_request.bauds[s_baudIndex] : currentBaudRate;
+}
+
+bool modbusScanStart(const ModbusScanRequest* request) {
+    if (s_status.running) {
+        return false;
+    }
+    if (request->firstAddress < 1 || request->lastAddress > 247 || request->firstAddress > request->lastAddress) {
+        return false;
+    }
+    s_request = *request;
+    if (s_request.baudCount > SCAN_MAX_BAUDS) {
+        s_request.baudCount = SCAN_MAX_BAUDS;
+    }
+    if (s_request.timeoutMs == 0) {
+        s_request.timeoutMs = SCAN_DEFAULT_TIMEOUT_MS;
+    }
+
+    memset(&s_status, 0, sizeof(s_status));
+    memset(s_retryCount, 0, sizeof(s_retryCount));
+    s_baudIndex = 0;
+    s_retryPass = false;
+    s_maxLatencyUs = 0;
+    s_cancelRequested = false;
+    s_startMs = millis();
+    s_status.baud = currentScanBaud();
+    s_status.address = s_request.firstAddress;
+    s_status.total = (uint16_t)(s_request.lastAddress - s_request.firstAddress + 1) * (s_request.baudCount > 0 ? s_request.baudCount : 1);
+    s_status.timeoutUs = s_request.timeoutMs * 1000UL;
+    s_status.running = true;
+
+    consolePrint("[Scan] Busca iniciada: enderecos " + String(s_request.firstAddress) + "-" + String(s_request.lastAddress) +
+                 ", " + String(s_request.baudCount > 0 ? s_request.baudCount : 1) + " velocidade(s)\r\n");
+    scanSend("{\"type\":\"start\",\"total\":" + String(s_status.total) + "}");
+    return true;
+}
+
+void modbusScanCancel() {
+    s_cancelRequested = true;
+}
+
+static void finishScan(bool cancelled) {
+    s_status.running = false;
+    s_status.cancelled = cancelled;
+    s_status.elapsedMs = millis() - s_startMs;
+    consolePrint("[Scan] Busca " + String(cancelled ? "cancelada" : "concluida") + ": " + String(s_status.foundCount) +
+                 " dispositivo(s) em " + String(s_status.elapsedMs / 1000.0f, 1) + " s\r\n");
+    scanSend("{\"type\":\"done\",\"found\":" + String(s_status.foundCount) + ",\"elapsedMs\":" + String(s_status.elapsedMs) +
+             ",\"cancelled\":" + String(cancelled ? "true" : "false") + "}");
+}
+
+static bool isConfigured(uint8_t address, uint32_t baud) {
+    if (baud != config.baudRate) {
+        return false;
+    }
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (config.devices[i].slaveAddress == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Uma leitura de teste; registra o dispositivo ou marca o endereço para repetição
+static void probe(uint8_t address, uint32_t timeoutUs, uint32_t baud) {
+    uint8_t request[6] = { address, 0x03, (uint8_t)(s_request.probeRegister >> 8), (uint8_t)(s_request.probeRegister & 0xFF), 0x00, 0x01 };
+    static ModbusRtuResult result;
+    delayMicroseconds(interFrameDelayUs());
+    // Sondas sem resposta são esperadas: fora da captura do barramento
+    busCaptureSetSuspended(true);
+    modbusRtuTransaction(request, sizeof(request), timeoutUs, &result);
+    busCaptureSetSuspended(false);
+
+    if (result.status == MODBUS_RTU_PARTIAL) {
+        // Alguém respondeu, mas o quadro chegou incompleto ou corrompido: repetir depois
+        if (s_retryCount[address] < SCAN_MAX_RETRIES) {
+            s_retryCount[address]++;
+        }
+        return;
+    }
+    s_retryCount[address] = 0;
+    if (result.status != MODBUS_RTU_OK || s_status.foundCount >= SCAN_MAX_RESULTS) {
+        return;
+    }
+
+    ModbusScanFound& found = s_found[s_status.foundCount++];
+    found.address = address;
+    found.baud = baud;
+    found.latencyUs = result.latencyUs;
+    found.exception = modbusRtuException(&result);
+    found.configured = isConfigured(address, baud);
+    scanSend(foundToJson(found));
+    consolePrint("[Scan] Dispositivo " + String(address) + " a " + String(baud) + " baud (latencia " +
+                 String(result.latencyUs / 1000.0f, 1) + " ms" +
+                 (found.exception ? ", excecao " + String(found.exception) : String("")) + ")\r\n");
+
+    // Espera adaptativa: 3x a maior latência vista, sem passar da inicial nem ficar abaixo do quadro
+    if (result.latencyUs > s_maxLatencyUs) {
+        s_maxLatencyUs = result.latencyUs;
+    }
+    uint32_t adapted = s_maxLatencyUs * 3;
+    uint32_t floorUs = frameFloorUs(baud);
+    if (adapted < floorUs) adapted = floorUs;
+    if (adapted < s_request.timeoutMs * 1000UL) {
+        s_status.timeoutUs = adapted;
+    }
+}
+
+// Próximo endereço a repetir nesta velocidade (0 = nenhum)
+static uint8_t nextRetryAddress() {
+    for (uint16_t a = s_request.firstAddress; a <= s_request.lastAddress; a++) {
+        if (s_retryCount[a] > 0 && s_retryCount[a] <= SCAN_MAX_RETRIES) {
+            return (uint8_t)a;
+        }
+    }
+    return 0;
+}
+
+void modbusScanService(uint32_t budgetUs) {
+    if (!s_status.running || g_processingPaused) {
+        return;
+    }
+    if (s_cancelRequested) {
+        finishScan(true);
+        return;
+    }
+
+    // CRÍTICO: a velocidade da busca vale só durante a fatia. currentBaudRate
+    // acompanha para que o silêncio entre quadros seja calculado corretamente;
+    // os dois voltam ao valor configurado antes de a aquisição usar o barramento.
+    uint32_t configuredBaud = currentBaudRate;
+    uint32_t baud = currentScanBaud();
+    if (baud != configuredBaud) {
+        Serial2.updateBaudRate(baud);
+        currentBaudRate = baud;
+    }
+
+    int64_t sliceStartUs = monotonicMicros();
+    uint32_t frameUs = frameFloorUs(baud);
+    uint16_t probesInSlice = 0;
+    while (true) {
+        // Cada teste precisa caber no que resta da fatia (o primeiro sempre roda, para a busca avançar)
+        uint32_t usedUs = (uint32_t)(monotonicMicros() - sliceStartUs);
+        if (!s_retryPass) {
+            if (probesInSlice > 0 && usedUs + s_status.timeoutUs + frameUs > budgetUs) {
+                break;
+            }
+            probe(s_status.address, s_status.timeoutUs, baud);
+            s_status.probed++;
+            probesInSlice++;
+            if (s_status.address < s_request.lastAddress) {
+                s_status.address++;
+                continue;
+            }
+            s_retryPass = true;
+            continue;
+        }
+
+        uint8_t retry = nextRetryAddress();
+        if (retry != 0) {
+            // Repetição com o dobro da espera, limitada ao timeout configurado e à fatia
+            uint32_t retryTimeoutUs = s_status.timeoutUs << s_retryCount[retry];
+            uint32_t maxUs = (config.timeout > 0 ? config.timeout : 1000) * 1000UL;
+            if (maxUs > budgetUs) maxUs = budgetUs;
+            if (retryTimeoutUs > maxUs) retryTimeoutUs = maxUs;
+            if (probesInSlice > 0 && usedUs + retryTimeoutUs + frameUs > budgetUs) {
+                break;
+            }
+            uint8_t before = s_retryCount[retry];
+            probe(retry, retryTimeoutUs, baud);
+            s_status.retries++;
+            probesInSlice++;
+            if (s_retryCount[retry] == before && before >= SCAN_MAX_RETRIES) {
+                s_retryCount[retry] = SCAN_MAX_RETRIES + 1;   // Desiste do endereço
+            }
+            continue;
+        }
+
+        // Velocidade concluída
+        if (s_request.baudCount > 0 && s_baudIndex + 1 < s_request.baudCount) {
+            s_baudIndex++;
+            s_retryPass = false;
+            memset(s_retryCount, 0, sizeof(s_retryCount));
+            s_maxLatencyUs = 0;
+            s_status.timeoutUs = s_request.timeoutMs * 1000UL;
+            s_status.address = s_request.firstAddress;
+            s_status.baud = currentScanBaud();
+            break;                                     // Próxima velocidade na próxima fatia
+        }
+        if (baud != configuredBaud) {
+            Serial2.updateBaudRate(configuredBaud);
+            currentBaudRate = configuredBaud;
+        }
+        finishScan(false);
+        return;
+    }
+
+    if (baud != configuredBaud) {
+        // Descarta o que chegou na velocidade errada antes de devolver o barramento
+        Serial2.updateBaudRate(configuredBaud);
+        currentBaudRate = configuredBaud;
+        while (Serial2.available()) {
+            Serial2.read();
+        }
+    }
+    s_status.elapsedMs = millis() - s_startMs;
+    if (probesInSlice > 0) {
+        scanSend(progressToJson());
+    }
+}
+
+void modbusScanGetStatus(ModbusScanStatus* status) {
+    *status = s_status;
+    if (s_status.running) {
+        status->elapsedMs = millis() - s_startMs;
+    }
+}
+
+uint8_t modbusScanGetResults(ModbusScanFound* results, uint8_t maxCount) {
+    uint8_t count = s_status.foundCount < maxCount ? s_status.foundCount : maxCount;
+    memcpy(results, s_found, count * sizeof(ModbusScanFound));
+    return count;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file modbus_scan.h
+ * @brief Busca de dispositivos Modbus no barramento RS485 sem parar a aquisição
+ *
+ * A busca é um trabalho executado pelo loop nos intervalos livres entre ciclos
+ * de leitura (modbusScanService()), em fatias de tempo limitadas: os
+ * dispositivos configurados continuam sendo lidos normalmente.
+ *
+ * - Cada endereço recebe uma leitura de 1 holding register (0x03) com tempo
+ *   de espera curto, via transação RTU direta (modbus_rtu.h)
+ * - Resposta válida (inclusive exceção Modbus) = dispositivo encontrado
+ * - Resposta parcial ou com CRC inválido = há alguém no endereço: repetido
+ *   depois da varredura, com o dobro do tempo de espera (até SCAN_MAX_RETRIES)
+ * - Sem resposta = endereço livre, não é repetido
+ * - O tempo de espera se adapta: cai para 3x a maior latência observada nos
+ *   dispositivos encontrados (nunca abaixo do tempo do quadro de resposta)
+ * - Opcionalmente varre várias velocidades; a velocidade configurada é
+ *   restaurada ao fim de cada fatia
+ *
+ * Os resultados são enviados à medida que aparecem pelo WebSocket /ws/scan
+ * (mensagens JSON "start", "found", "progress" e "done").
+ */
+
+#ifndef MODBUS_SCAN_H
+#define MODBUS_SCAN_H
+
+#include <Arduino.h>
+#include <AsyncWebSocket.h>
+
+#define SCAN_MAX_BAUDS 8
+#define SCAN_MAX_RESULTS 64
+#define SCAN_MAX_RETRIES 2
+#define SCAN_DEFAULT_TIMEOUT_MS 30
+#define SCAN_SLOT_BUDGET_MS 60         // Fatia máxima do barramento por chamada do loop
+
+/**
+ * @struct ModbusScanRequest
+ * @brief Parâmetros de uma busca
+ */
+struct ModbusScanRequest {
+    uint8_t firstAddress;          // 1..247
+    uint8_t lastAddress;
+    uint32_t bauds[SCAN_MAX_BAUDS];
+    uint8_t baudCount;             // 0 = somente a velocidade configurada
+    uint16_t probeRegister;        // Registro lido em cada endereço
+    uint16_t timeoutMs;            // Espera inicial por resposta (0 = SCAN_DEFAULT_TIMEOUT_MS)
+};
+
+/**
+ * @struct ModbusScanFound
+ * @brief Dispositivo encontrado
+ */
+struct ModbusScanFound {
+    uint8_t address;
+    uint32_t baud;
+    uint32_t latencyUs;            // Fim da requisição até o primeiro byte da resposta
+    uint8_t exception;             // Código de exceção Modbus (0 = leitura aceita)
+    bool configured;               // Já existe na configuração (mesmo endereço e velocidade)
+};
+
+/**
+ * @struct ModbusScanStatus
+ * @brief Andamento da busca
+ */
+struct ModbusScanStatus {
+    bool running;
+    bool cancelled;
+    uint32_t baud;                 // Velocidade em varredura
+    uint8_t address;               // Próximo endereço
+    uint16_t probed;               // Endereços testados (todas as velocidades, sem contar repetições)
+    uint16_t total;
+    uint16_t retries;
+    uint8_t foundCount;
+    uint32_t timeoutUs;            // Tempo de espera atual (adaptativo)
+    uint32_t elapsedMs;
+};
+
+/**
+ * @brief Registra o WebSocket de resultados (/ws/scan)
+ */
+void initScanWebSocket(AsyncWebSocket* ws);
+
+/**
+ * @brief Inicia uma busca
+ * @return false se já há uma busca em andamento ou os parâmetros são inválidos
+ */
+bool modbusScanStart(const ModbusScanRequest* request);
+
+/**
+ * @brief Interrompe a busca em andamento (efetiva na próxima fatia)
+ */
+void modbusScanCancel();
+
+/**
+ * @brief Executa uma fatia da busca (somente o loop, com o barramento livre)
+ * @param budgetUs Tempo máximo desta fatia
+ */
+void modbusScanService(uint32_t budgetUs);
+
+void modbusScanGetStatus(ModbusScanStatus* status);
+uint8_t modbusScanGetResults(ModbusScanFound* results, uint8_t maxCount);
+
+#endif // MODBUS_SCAN_H
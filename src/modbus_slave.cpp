@@ -0,0 +1,489 @@
+/**
+ * @file modbus_slave.cpp
+ * @brief Implementação do escravo Modbus RTU na Serial1
+ */
+
+#include "modbus_slave.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "modbus_rtu.h"
+#include "alarm_engine.h"
+#include <HardwareSerial.h>
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define SLAVE_REPLY_MAX (5 + 2 * SLAVE_TABLE_WORDS)
+
+static SlaveConfig s_config = {};
+static float s_variableValues[SLAVE_MAX_MAP];
+static bool s_variableValid[SLAVE_MAX_MAP];
+static bool s_reopen = false;              // Configuração mudou: o loop reabre a porta
+static bool s_portOpen = false;
+static int8_t s_openDePin = -1;
+
+// Tabela publicada: escrita pelo loop, lida pelo callback da UART (task de eventos)
+static uint16_t s_table[SLAVE_TABLE_WORDS];
+static volatile uint16_t s_tableBase = 0;
+static volatile uint16_t s_tableWords = 0;
+static volatile uint8_t s_address = 0;
+static portMUX_TYPE s_tableMux = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile SlaveStats s_stats = {};
+
+static SemaphoreHandle_t s_slaveMutex = nullptr;
+
+static inline bool lockSlave(TickType_t ticks) {
+    return xSemaphoreTake(s_slaveMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockSlave() {
+    xSemaphoreGive(s_slaveMutex);
+}
+
+static void defaultConfig(SlaveConfig* slaveConfig) {
+    memset(slaveConfig, 0, sizeof(SlaveConfig));
+    slaveConfig->enabled = false;
+    slaveConfig->address = 1;
+    slaveConfig->baudRate = 9600;
+    slaveConfig->parity = MODBUS_PARITY_NONE;
+    slaveConfig->stopBits = 1;
+    slaveConfig->txPin = SLAVE_RS485_TX_PIN;
+    slaveConfig->rxPin = SLAVE_RS485_RX_PIN;
+    slaveConfig->dePin = SLAVE_RS485_DE_RE_PIN;
+}
+
+// ==================== RESPOSTAS ====================
+
+static uint16_t exceptionReply(uint8_t address, uint8_t function, uint8_t code, uint8_t* reply) {
+    reply[0] = address;
+    reply[1] = function | 0x80;
+    reply[2] = code;
+    uint16_t crc = modbusCrc16(reply, 3);
+    reply[3] = crc & 0xFF;
+    reply[4] = crc >> 8;
+    s_stats.exceptions++;
+    return 5;
+}
+
+uint16_t modbusSlaveHandleFrame(const uint8_t* frame, uint16_t length, uint8_t* reply) {
+    if (length < 4) {
+        s_stats.crcErrors++;
+        return 0;
+    }
+    uint16_t crc = modbusCrc16(frame, length - 2);
+    if (frame[length - 2] != (crc & 0xFF) || frame[length - 1] != (crc >> 8)) {
+        s_stats.crcErrors++;
+        return 0;
+    }
+    uint8_t address = s_address;
+    // Broadcast não tem resposta e só há funções de leitura
+    if (frame[0] != address || address == 0) {
+        s_stats.otherAddress++;
+        return 0;
+    }
+    s_stats.requests++;
+
+    uint8_t function = frame[1];
+    if (function != 0x03 && function != 0x04) {
+        return exceptionReply(address, function, 0x01, reply);
+    }
+    if (length != 8) {
+        return exceptionReply(address, function, 0x03, reply);
+    }
+    uint16_t start = ((uint16_t)frame[2] << 8) | frame[3];
+    uint16_t quantity = ((uint16_t)frame[4] << 8) | frame[5];
+    if (quantity == 0 || quantity > SLAVE_TABLE_WORDS) {
+        return exceptionReply(address, function, 0x03, reply);
+    }
+
+    // CRÍTICO: só a cópia das palavras pedidas fica na seção crítica
+    bool inRange;
+    portENTER_CRITICAL(&s_tableMux);
+    uint16_t base = s_tableBase;
+    inRange = s_tableWords > 0 && start >= base && (uint32_t)start + quantity <= (uint32_t)base + s_tableWords;
+    if (inRange) {
+        for (uint16_t k = 0; k < quantity; k++) {
+            uint16_t word = s_table[start - base + k];
+            reply[3 + 2 * k] = word >> 8;
+            reply[4 + 2 * k] = word & 0xFF;
+        }
+    }
+    portEXIT_CRITICAL(&s_tableMux);
+    if (!inRange) {
+        return exceptionReply(address, function, 0x02, reply);
+    }
+
+    reply[0] = address;
+    reply[1] = function;
+    reply[2] = (uint8_t)(quantity * 2);
+    uint16_t replyLength = 3 + quantity * 2;
+    crc = modbusCrc16(reply, replyLength);
+    reply[replyLength++] = crc & 0xFF;
+    reply[replyLength++] = crc >> 8;
+    s_stats.replies++;
+    return replyLength;
+}
+
+// Chamado pela task de eventos da UART após SLAVE_RX_TIMEOUT_SYMBOLS de silêncio.
+// Uma requisição de leitura cabe na FIFO (120 bytes), então chega inteira em uma
+// chamada; quadros longos de outros escravos podem chegar partidos e contam como
+// CRC inválido.
+static void onSlaveReceive() {
+    static uint8_t frame[MODBUS_RTU_MAX_FRAME];
+    static uint8_t reply[SLAVE_REPLY_MAX];
+    uint32_t startUs = micros();
+    uint16_t length = 0;
+    while (Serial1.available() > 0) {
+        int b = Serial1.read();
+        if (length < sizeof(frame)) {
+            frame[length++] = (uint8_t)b;
+        }
+    }
+    uint16_t replyLength = modbusSlaveHandleFrame(frame, length, reply);
+    if (replyLength == 0) {
+        return;
+    }
+
+    // O callback só roda após o silêncio de fim de quadro: a resposta já respeita o t3.5
+    int8_t dePin = s_openDePin;
+    if (dePin >= 0) {
+        digitalWrite(dePin, HIGH);
+    }
+    Serial1.write(reply, replyLength);
+    uint32_t elapsedUs = micros() - startUs;
+    Serial1.flush();
+    if (dePin >= 0) {
+        digitalWrite(dePin, LOW);
+    }
+    s_stats.lastReplyUs = elapsedUs;
+    if (elapsedUs > s_stats.maxReplyUs) {
+        s_stats.maxReplyUs = elapsedUs;
+    }
+}
+
+// CRÍTICO: roda no loop; fecha a porta antes de trocar pinos/velocidade
+static void openPort(const SlaveConfig* slaveConfig) {
+    if (s_portOpen) {
+        Serial1.end();
+        s_portOpen = false;
+        if (s_openDePin >= 0) {
+            digitalWrite(s_openDePin, LOW);
+        }
+    }
+    s_address = slaveConfig->enabled ? slaveConfig->address : 0;
+    if (!slaveConfig->enabled) {
+        s_openDePin = -1;
+        consolePrint("[Escravo] Porta desabilitada\r\n");
+        return;
+    }
+    s_openDePin = slaveConfig->dePin;
+    if (s_openDePin >= 0) {
+        pinMode(s_openDePin, OUTPUT);
+        digitalWrite(s_openDePin, LOW);    // Inicia em modo recepção
+    }
+    Serial1.begin(slaveConfig->baudRate, buildSerialConfig(8, slaveConfig->parity, slaveConfig->stopBits),
+                  slaveConfig->rxPin, slaveConfig->txPin);
+    Serial1.onReceive(onSlaveReceive, true);
+    Serial1.setRxTimeout(SLAVE_RX_TIMEOUT_SYMBOLS);
+    s_portOpen = true;
+    consolePrint("[Escravo] Endereco " + String(slaveConfig->address) + " @ " + String(slaveConfig->baudRate) +
+                 " baud, " + String(slaveConfig->mapCount) + " entradas no mapa\r\n");
+}
+
+// ==================== TABELA ====================
+
+static bool processedValue(uint8_t slaveAddress, uint16_t registerAddress, float* value) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (config.devices[i].slaveAddress != slaveAddress) {
+            continue;
+        }
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            if (config.devices[i].registers[j].address == registerAddress) {
+                if (config.devices[i].registers[j].sampleTimeUs <= 0) {
+                    return false;
+                }
+                *value = sampleTimings[i][j].lastValue;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool entryValue(uint8_t index, const SlaveMapEntry& entry, float* value) {
+    switch (entry.source) {
+        case SLAVE_SOURCE_REGISTER:
+            return processedValue(entry.slaveAddress, entry.registerAddress, value);
+        case SLAVE_SOURCE_VARIABLE:
+            *value = s_variableValues[index];
+            return s_variableValid[index];
+        case SLAVE_SOURCE_ALARM: {
+            uint16_t bits = 0;
+            for (uint8_t c = 0; c < ALARM_CONDITION_COUNT; c++) {
+                if (alarmIsActive(entry.alarm, c)) bits |= (1 << c);
+                if (alarmIsUnacknowledged(entry.alarm, c)) bits |= (1 << (c + 8));
+            }
+            *value = bits;
+            return true;
+        }
+        case SLAVE_SOURCE_ALARM_COUNT:
+            *value = alarmActiveCount();
+            return true;
+    }
+    return false;
+}
+
+static uint16_t mapBase(const SlaveConfig* slaveConfig, uint16_t* span) {
+    uint32_t first = 0xFFFF;
+    uint32_t end = 0;
+    for (uint8_t m = 0; m < slaveConfig->mapCount; m++) {
+        const SlaveMapEntry& entry = slaveConfig->map[m];
+        uint32_t entryEnd = (uint32_t)entry.address + registerWordCount(entry.dataType);
+        if (entry.address < first) first = entry.address;
+        if (entryEnd > end) end = entryEnd;
+    }
+    *span = slaveConfig->mapCount > 0 ? (uint16_t)(end - first) : 0;
+    return slaveConfig->mapCount > 0 ? (uint16_t)first : 0;
+}
+
+void modbusSlaveUpdate() {
+    if (!lockSlave(0)) {
+        return;
+    }
+    if (s_reopen) {
+        s_reopen = false;
+        openPort(&s_config);
+    }
+    if (!s_config.enabled) {
+        unlockSlave();
+        return;
+    }
+
+    // Sombra montada fora da seção crítica; endereços sem valor (ainda sem leitura) ficam 0
+    uint16_t shadow[SLAVE_TABLE_WORDS];
+    memset(shadow, 0, sizeof(shadow));
+    uint16_t span;
+    uint16_t base = mapBase(&s_config, &span);
+    for (uint8_t m = 0; m < s_config.mapCount; m++) {
+        const SlaveMapEntry& entry = s_config.map[m];
+        float value;
+        if (!entryValue(m, entry, &value)) {
+            continue;
+        }
+        value *= entry.scale;
+        // Inteiros arredondados (encodeRegisterWords trunca)
+        if ((entry.dataType & REGISTER_DATA_TYPE_MASK) != REGISTER_DATA_FLOAT32) {
+            value = roundf(value);
+        }
+        encodeRegisterWords(entry.dataType, value, &shadow[entry.address - base]);
+    }
+    unlockSlave();
+
+    portENTER_CRITICAL(&s_tableMux);
+    memcpy(s_table, shadow, span * sizeof(uint16_t));
+    s_tableBase = base;
+    s_tableWords = span;
+    portEXIT_CRITICAL(&s_tableMux);
+    s_stats.tableUpdates++;
+}
+
+void modbusSlavePublishVariables(const char (*names)[6], const double* values, int count) {
+    if (!lockSlave(0)) {
+        return;
+    }
+    for (uint8_t m = 0; m < s_config.mapCount; m++) {
+        if (s_config.map[m].source != SLAVE_SOURCE_VARIABLE) {
+            continue;
+        }
+        for (int k = 0; k < count; k++) {
+            if (strcmp(names[k], s_config.map[m].variable) == 0) {
+                s_variableValues[m] = (float)values[k];
+                s_variableValid[m] = true;
+                break;
+            }
+        }
+    }
+    unlockSlave();
+}
+
+// ==================== CONFIGURAÇÃO ====================
+
+bool modbusSlaveSetConfig(const SlaveConfig* slaveConfig, String* error) {
+    if (slaveConfig->address < 1 || slaveConfig->address > 247) {
+        *error = "Endereco do escravo deve estar entre 1 e 247";
+        return false;
+    }
+    if (slaveConfig->mapCount > SLAVE_MAX_MAP) {
+        *error = "Mapa com mais de " + String(SLAVE_MAX_MAP) + " entradas";
+        return false;
+    }
+    uint16_t span;
+    mapBase(slaveConfig, &span);
+    if (span > SLAVE_TABLE_WORDS) {
+        *error = "Mapa ocupa " + String(span) + " enderecos (maximo " + String(SLAVE_TABLE_WORDS) + ")";
+        return false;
+    }
+    for (uint8_t m = 0; m < slaveConfig->mapCount; m++) {
+        const SlaveMapEntry& a = slaveConfig->map[m];
+        for (uint8_t n = m + 1; n < slaveConfig->mapCount; n++) {
+            const SlaveMapEntry& b = slaveConfig->map[n];
+            if (a.address < b.address + registerWordCount(b.dataType) && b.address < a.address + registerWordCount(a.dataType)) {
+                *error = "Enderecos " + String(a.address) + " e " + String(b.address) + " sobrepostos";
+                return false;
+            }
+        }
+    }
+
+    if (!lockSlave(portMAX_DELAY)) {
+        *error = "Escravo ocupado";
+        return false;
+    }
+    s_config = *slaveConfig;
+    memset(s_variableValid, 0, sizeof(s_variableValid));
+    s_reopen = true;
+    unlockSlave();
+    return true;
+}
+
+void modbusSlaveGetConfig(SlaveConfig* slaveConfig) {
+    if (!lockSlave(pdMS_TO_TICKS(500))) {
+        defaultConfig(slaveConfig);
+        return;
+    }
+    *slaveConfig = s_config;
+    unlockSlave();
+}
+
+void modbusSlaveGetStats(SlaveStats* stats) {
+    // Cópia sem trava: no pior caso mistura contadores de duas requisições
+    memcpy(stats, (const void*)&s_stats, sizeof(SlaveStats));
+    stats->tableBase = s_tableBase;
+    stats->tableWords = s_tableWords;
+}
+
+uint16_t modbusSlaveGetTable(uint16_t* words, uint16_t maxWords) {
+    portENTER_CRITICAL(&s_tableMux);
+    uint16_t count = s_tableWords < maxWords ? s_tableWords : maxWords;
+    memcpy(words, s_table, count * sizeof(uint16_t));
+    portEXIT_CRITICAL(&s_tableMux);
+    return count;
+}
+
+void modbusSlaveConfigToJson(const SlaveConfig* slaveConfig, JsonObject obj) {
+    obj["enabled"] = slaveConfig->enabled;
+    obj["address"] = slaveConfig->address;
+    obj["baudRate"] = slaveConfig->baudRate;
+    obj["parity"] = slaveConfig->parity;
+    obj["stopBits"] = slaveConfig->stopBits;
+    obj["txPin"] = slaveConfig->txPin;
+    obj["rxPin"] = slaveConfig->rxPin;
+    obj["dePin"] = slaveConfig->dePin;
+    JsonArray map = obj.createNestedArray("map");
+    for (uint8_t m = 0; m < slaveConfig->mapCount; m++) {
+        const SlaveMapEntry& entry = slaveConfig->map[m];
+        JsonObject item = map.createNestedObject();
+        item["address"] = entry.address;
+        item["source"] = entry.source;
+        if (entry.source == SLAVE_SOURCE_REGISTER) {
+            item["slaveAddress"] = entry.slaveAddress;
+            item["registerAddress"] = entry.registerAddress;
+        } else if (entry.source == SLAVE_SOURCE_VARIABLE) {
+            item["variable"] = entry.variable;
+        } else if (entry.source == SLAVE_SOURCE_ALARM) {
+            item["alarm"] = entry.alarm;
+        }
+        item["dataType"] = entry.dataType;
+        item["scale"] = entry.scale;
+    }
+}
+
+bool modbusSlaveConfigFromJson(JsonObjectConst obj, SlaveConfig* slaveConfig) {
+    defaultConfig(slaveConfig);
+    slaveConfig->enabled = obj["enabled"] | false;
+    slaveConfig->address = obj["address"] | 1;
+    slaveConfig->baudRate = obj["baudRate"] | 9600;
+    slaveConfig->parity = obj["parity"] | MODBUS_PARITY_NONE;
+    slaveConfig->stopBits = obj["stopBits"] | 1;
+    slaveConfig->txPin = obj["txPin"] | SLAVE_RS485_TX_PIN;
+    slaveConfig->rxPin = obj["rxPin"] | SLAVE_RS485_RX_PIN;
+    slaveConfig->dePin = obj["dePin"] | SLAVE_RS485_DE_RE_PIN;
+    if (slaveConfig->parity > MODBUS_PARITY_ODD) {
+        slaveConfig->parity = MODBUS_PARITY_NONE;
+    }
+    if (slaveConfig->stopBits != 2) {
+        slaveConfig->stopBits = 1;
+    }
+
+    for (JsonObjectConst item : obj["map"].as<JsonArrayConst>()) {
+        if (slaveConfig->mapCount >= SLAVE_MAX_MAP) {
+            return false;
+        }
+        SlaveMapEntry& entry = slaveConfig->map[slaveConfig->mapCount];
+        entry.address = item["address"] | 0;
+        entry.source = item["source"] | SLAVE_SOURCE_REGISTER;
+        entry.slaveAddress = item["slaveAddress"] | 0;
+        entry.registerAddress = item["registerAddress"] | 0;
+        const char* variable = item["variable"] | "";
+        strncpy(entry.variable, variable, sizeof(entry.variable) - 1);
+        entry.variable[sizeof(entry.variable) - 1] = '\0';
+        entry.alarm = item["alarm"] | 0;
+        entry.dataType = item["dataType"] | REGISTER_DATA_UINT16;
+        entry.scale = item["scale"] | 1.0f;
+        if (entry.source > SLAVE_SOURCE_ALARM_COUNT || isnan(entry.scale) ||
+            (entry.dataType & REGISTER_DATA_TYPE_MASK) > REGISTER_DATA_FLOAT32) {
+            return false;
+        }
+        if (entry.source == SLAVE_SOURCE_VARIABLE && entry.variable[0] == '\0') {
+            return false;
+        }
+        slaveConfig->mapCount++;
+    }
+    return true;
+}
+
+bool modbusSlaveSave() {
+    SlaveConfig* slaveConfig = new SlaveConfig;
+    modbusSlaveGetConfig(slaveConfig);
+    DynamicJsonDocument doc(6144);
+    modbusSlaveConfigToJson(slaveConfig, doc.to<JsonObject>());
+    delete slaveConfig;
+
+    File file = LittleFS.open(SLAVE_CONFIG_FILE, "w");
+    if (!file) {
+        consolePrint("[Escravo] Erro ao gravar " SLAVE_CONFIG_FILE "\r\n");
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    return true;
+}
+
+void modbusSlaveInit() {
+    // Criado aqui, antes da task de eventos da UART e do servidor web usarem o escravo
+    if (s_slaveMutex == nullptr) {
+        s_slaveMutex = xSemaphoreCreateMutex();
+    }
+    defaultConfig(&s_config);
+    File file = LittleFS.open(SLAVE_CONFIG_FILE, "r");
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(6144);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        consolePrint("[Escravo] " SLAVE_CONFIG_FILE " invalido: " + String(error.c_str()) + "\r\n");
+        return;
+    }
+
+    SlaveConfig* slaveConfig = new SlaveConfig;
+    String reason;
+    if (!modbusSlaveConfigFromJson(doc.as<JsonObjectConst>(), slaveConfig)) {
+        consolePrint("[Escravo] " SLAVE_CONFIG_FILE " com entrada invalida no mapa\r\n");
+    } else if (!modbusSlaveSetConfig(slaveConfig, &reason)) {
+        consolePrint("[Escravo] " SLAVE_CONFIG_FILE " recusado: " + reason + "\r\n");
+    }
+    delete slaveConfig;
+}
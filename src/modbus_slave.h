@@ -0,0 +1,139 @@
+/**
+ * @file modbus_slave.h
+ * @brief Escravo Modbus RTU em uma segunda UART (Serial1) para sistemas a jusante
+ *
+ * Responde FC03 e FC04 (mesma tabela) a partir de um mapa configurável em
+ * SLAVE_CONFIG_FILE. Cada entrada do mapa publica um endereço com:
+ * - Valor processado de um registro lido (gain/offset/Kalman)
+ * - Variável de resultado dos cálculos (nome de até 5 caracteres)
+ * - Estado de uma definição de alarme (bits 0-5 ativos, bits 8-13 não reconhecidos)
+ * - Quantidade de alarmes ativos
+ * codificado com o tipo de dado da entrada (REGISTER_DATA_*) e um fator de escala.
+ *
+ * modbusSlaveUpdate() roda no loop após os cálculos: codifica os valores em uma
+ * tabela de sombra e a publica com uma cópia curta em seção crítica. A recepção
+ * usa o callback de fim de quadro da UART (onReceive com timeout de RX), que
+ * roda na task de eventos da UART: a resposta é montada da tabela publicada,
+ * sem mutex e sem tocar no barramento mestre, então o loop nunca é bloqueado
+ * por uma requisição e o escravo responde mesmo durante o ciclo de leitura.
+ */
+
+#ifndef MODBUS_SLAVE_H
+#define MODBUS_SLAVE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define SLAVE_MAX_MAP 32
+#define SLAVE_TABLE_WORDS 125              // Maior leitura FC03/FC04 permitida pelo Modbus
+#define SLAVE_RX_TIMEOUT_SYMBOLS 3         // Silêncio (caracteres) que fecha o quadro recebido
+#define SLAVE_CONFIG_FILE "/slave.json"
+
+/**
+ * @brief Origem do valor de uma entrada do mapa
+ */
+enum SlaveSource {
+    SLAVE_SOURCE_REGISTER = 0,             // Valor processado de slaveAddress/registerAddress
+    SLAVE_SOURCE_VARIABLE,                 // Resultado de um cálculo (variable)
+    SLAVE_SOURCE_ALARM,                    // Bits da definição de alarme (alarm)
+    SLAVE_SOURCE_ALARM_COUNT               // Quantidade de alarmes ativos
+};
+
+/**
+ * @struct SlaveMapEntry
+ * @brief Um endereço servido pelo escravo
+ */
+struct SlaveMapEntry {
+    uint16_t address;                      // Endereço na tabela (FC03 e FC04)
+    uint8_t source;                        // SlaveSource
+    uint8_t slaveAddress;                  // SLAVE_SOURCE_REGISTER
+    uint16_t registerAddress;
+    char variable[6];                      // SLAVE_SOURCE_VARIABLE (mesmo limite dos cálculos)
+    uint8_t alarm;                         // SLAVE_SOURCE_ALARM: índice da definição
+    uint8_t dataType;                      // REGISTER_DATA_* (32 bits ocupam dois endereços)
+    float scale;                           // Palavra = valor * scale (ex.: 10 = uma casa decimal)
+};
+
+/**
+ * @struct SlaveConfig
+ * @brief Configuração da porta e do mapa
+ */
+struct SlaveConfig {
+    bool enabled;
+    uint8_t address;                       // 1 a 247
+    uint32_t baudRate;
+    uint8_t parity;                        // MODBUS_PARITY_*
+    uint8_t stopBits;
+    int8_t txPin;
+    int8_t rxPin;
+    int8_t dePin;                          // Driver Enable / Receiver Enable do segundo transceptor
+    uint8_t mapCount;
+    SlaveMapEntry map[SLAVE_MAX_MAP];
+};
+
+/**
+ * @struct SlaveStats
+ * @brief Contadores da porta escrava
+ */
+struct SlaveStats {
+    uint32_t requests;                     // Quadros íntegros para este endereço
+    uint32_t replies;                      // Respostas normais
+    uint32_t exceptions;                   // Respostas de exceção (01, 02, 03)
+    uint32_t crcErrors;                    // Quadros com CRC inválido ou truncados
+    uint32_t otherAddress;                 // Quadros íntegros para outros endereços (e broadcast)
+    uint32_t lastReplyUs;                  // Callback até a resposta entregue à UART
+    uint32_t maxReplyUs;
+    uint32_t tableUpdates;
+    uint16_t tableBase;                    // Primeiro endereço da tabela publicada
+    uint16_t tableWords;
+};
+
+/**
+ * @brief Cria o mutex do escravo e carrega SLAVE_CONFIG_FILE (sem o arquivo ou sem
+ * LittleFS, fica a configuração padrão); a porta abre no primeiro modbusSlaveUpdate()
+ *
+ * Chamar no setup(), antes do servidor web e do loop.
+ */
+void modbusSlaveInit();
+
+/**
+ * @brief Reabre a porta se a configuração mudou e publica a tabela (loop, após os cálculos)
+ */
+void modbusSlaveUpdate();
+
+/**
+ * @brief Guarda os resultados dos cálculos referenciados pelo mapa (chamado por performCalculations)
+ */
+void modbusSlavePublishVariables(const char (*names)[6], const double* values, int count);
+
+/**
+ * @brief Valida e instala a configuração (a porta é reaberta pelo loop)
+ * @param error Motivo da recusa (endereço inválido, entradas sobrepostas, tabela grande demais)
+ */
+bool modbusSlaveSetConfig(const SlaveConfig* slaveConfig, String* error);
+
+void modbusSlaveGetConfig(SlaveConfig* slaveConfig);
+void modbusSlaveGetStats(SlaveStats* stats);
+
+/**
+ * @brief Copia a tabela publicada
+ * @return Quantidade de palavras (a partir de stats.tableBase)
+ */
+uint16_t modbusSlaveGetTable(uint16_t* words, uint16_t maxWords);
+
+/**
+ * @brief Grava a configuração atual em SLAVE_CONFIG_FILE
+ */
+bool modbusSlaveSave();
+
+void modbusSlaveConfigToJson(const SlaveConfig* slaveConfig, JsonObject obj);
+bool modbusSlaveConfigFromJson(JsonObjectConst obj, SlaveConfig* slaveConfig);
+
+/**
+ * @brief Trata um quadro recebido e monta a resposta (sem E/S), exposto para testes fora do alvo
+ * @param reply Buffer de ao menos 5 + 2 * SLAVE_TABLE_WORDS bytes
+ * @return Tamanho da resposta (0 = não responder)
+ */
+uint16_t modbusSlaveHandleFrame(const uint8_t* frame, uint16_t length, uint8_t* reply);
+
+#endif // MODBUS_SLAVE_H
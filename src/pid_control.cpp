@@ -0,0 +1,383 @@
+/**
+ * @file pid_control.cpp
+ * @brief Implementação dos blocos PID
+ */
+
+#include "pid_control.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "reactive_rules.h"
+#include "rtc_manager.h"
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/**
+ * @struct PidRuntime
+ * @brief Estado de execução de um bloco
+ */
+struct PidRuntime {
+    bool initialized;          // Integrador já inicializado (transferência sem salto)
+    bool wasManual;
+    int64_t nextRunUs;         // Próximo instante agendado
+    int64_t lastSampleUs;      // Recepção da medição anterior
+    float lastPv;
+    uint64_t jitterSumUs;
+    uint64_t latencySumUs;
+    PidStatus status;
+};
+
+static PidBlock s_blocks[PID_MAX_BLOCKS];
+static PidRuntime s_runtime[PID_MAX_BLOCKS];
+static uint8_t s_blockCount = 0;
+static bool s_running = false;   // Evita reentrada (pidService é chamado de dentro do ciclo)
+
+static SemaphoreHandle_t s_pidMutex = nullptr;
+
+static inline bool lockPid(TickType_t ticks) {
+    if (s_pidMutex == nullptr) {
+        s_pidMutex = xSemaphoreCreateMutex();
+    }
+    return s_pidMutex != nullptr && xSemaphoreTake(s_pidMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockPid() {
+    xSemaphoreGive(s_pidMutex);
+}
+
+// Localiza um registro configurado pelo endereço do escravo e do registro
+static bool findRegister(uint8_t slaveAddress, uint16_t registerAddress, int* deviceIndex, int* registerIndex) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (!config.devices[i].enabled || config.devices[i].slaveAddress != slaveAddress) {
+            continue;
+        }
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            if (config.devices[i].registers[j].address == registerAddress) {
+                *deviceIndex = i;
+                *registerIndex = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static inline float clampOutput(const PidBlock* block, float value) {
+    if (value > block->outMax) return block->outMax;
+    if (value < block->outMin) return block->outMin;
+    return value;
+}
+
+float pidStep(const PidBlock* block, float pv, float previousPv, float dt, float* integral) {
+    float error = block->setpoint - pv;
+    float p = block->kp * error;
+    // Derivada sobre a medição: sem pico quando o setpoint muda
+    float d = dt > 0.0f ? -block->kd * (pv - previousPv) / dt : 0.0f;
+
+    *integral += block->ki * error * dt;
+    float output = p + *integral + d;
+
+    // Anti-windup: integrador recalculado para manter a saída no limite
+    if (output > block->outMax) {
+        *integral -= output - block->outMax;
+        output = block->outMax;
+    } else if (output < block->outMin) {
+        *integral += block->outMin - output;
+        output = block->outMin;
+    }
+    return output;
+}
+
+// Integrador que reproduz 'output' com a medição atual (transferência sem salto)
+static inline float bumplessIntegral(const PidBlock* block, float pv, float output) {
+    return clampOutput(block, output) - block->kp * (block->setpoint - pv);
+}
+
+// Valor processado atual do registro de saída (ponto de partida sem salto)
+static float currentOutputValue(const PidBlock* block, int deviceIndex, int registerIndex) {
+    const ModbusRegister& reg = config.devices[deviceIndex].registers[registerIndex];
+    return clampOutput(block, registerRawValue(reg) * reg.gain + reg.offset);
+}
+
+static void runBlock(uint8_t index, int64_t scheduledUs, int64_t startUs) {
+    const PidBlock* block = &s_blocks[index];
+    PidRuntime* runtime = &s_runtime[index];
+    PidStatus* status = &runtime->status;
+
+    int inDevice, inRegister, outDevice, outRegister;
+    if (!findRegister(block->inputSlave, block->inputRegister, &inDevice, &inRegister) ||
+        !findRegister(block->outputSlave, block->outputRegister, &outDevice, &outRegister)) {
+        status->readErrors++;
+        return;
+    }
+
+    uint32_t jitterUs = (uint32_t)(startUs - scheduledUs);
+    status->lastJitterUs = jitterUs;
+    if (jitterUs > status->maxJitterUs) status->maxJitterUs = jitterUs;
+
+    float pv;
+    int64_t sampleUs;
+    if (!readRegisterNow(inDevice, inRegister, &pv, &sampleUs)) {
+        // Sem medição: mantém a última saída escrita
+        status->readErrors++;
+        return;
+    }
+
+    float output;
+    if (block->manual) {
+        output = clampOutput(block, block->manualOutput);
+        // Integrador acompanha a saída manual para a volta ao automático
+        status->integral = bumplessIntegral(block, pv, output);
+        runtime->wasManual = true;
+    } else {
+        if (!runtime->initialized || runtime->wasManual) {
+            if (!runtime->initialized) {
+                status->integral = bumplessIntegral(block, pv, currentOutputValue(block, outDevice, outRegister));
+            }
+            runtime->lastPv = pv;
+            runtime->lastSampleUs = sampleUs;
+            runtime->wasManual = false;
+        }
+        float dt = (float)(sampleUs - runtime->lastSampleUs) / 1000000.0f;
+        if (dt <= 0.0f) {
+            dt = block->periodMs / 1000.0f;
+        }
+        output = pidStep(block, pv, runtime->lastPv, dt, &status->integral);
+    }
+    runtime->initialized = true;
+    runtime->lastPv = pv;
+    runtime->lastSampleUs = sampleUs;
+    status->processValue = pv;
+    status->error = block->setpoint - pv;
+    status->output = output;
+
+    // Saída retida por uma regra de reação disparada: o bloco calcula mas não escreve
+    if (ruleHoldsRegister(block->outputSlave, block->outputRegister)) {
+        return;
+    }
+
+    // Saída no registro: raw = (valor - offset) / gain
+    const ModbusRegister& outReg = config.devices[outDevice].registers[outRegister];
+    // (limitado ao tipo de dado do registro em writeRegisterNow(); float32 não é arredondado)
+    float raw = outReg.gain != 0.0f ? (output - outReg.offset) / outReg.gain : 0.0f;
+    if ((outReg.dataType & REGISTER_DATA_TYPE_MASK) != REGISTER_DATA_FLOAT32) raw = round(raw);
+    if (!writeRegisterNow(outDevice, outRegister, raw)) {
+        status->writeErrors++;
+        return;
+    }
+
+    uint32_t latencyUs = (uint32_t)(monotonicMicros() - sampleUs);
+    status->lastLatencyUs = latencyUs;
+    if (latencyUs > status->maxLatencyUs) status->maxLatencyUs = latencyUs;
+
+    status->runs++;
+    runtime->jitterSumUs += jitterUs;
+    runtime->latencySumUs += latencyUs;
+    status->meanJitterUs = (uint32_t)(runtime->jitterSumUs / status->runs);
+    status->meanLatencyUs = (uint32_t)(runtime->latencySumUs / status->runs);
+}
+
+void pidService(int64_t nowUs) {
+    if (s_blockCount == 0 || s_running || g_processingPaused) {
+        return;
+    }
+    if (!lockPid(0)) {
+        return;
+    }
+    s_running = true;
+
+    for (uint8_t b = 0; b < s_blockCount; b++) {
+        if (!s_blocks[b].enabled) {
+            continue;
+        }
+        PidRuntime* runtime = &s_runtime[b];
+        int64_t periodUs = (int64_t)s_blocks[b].periodMs * 1000LL;
+        if (runtime->nextRunUs == 0) {
+            runtime->nextRunUs = nowUs;
+        }
+        if (nowUs < runtime->nextRunUs) {
+            continue;
+        }
+
+        int64_t scheduledUs = runtime->nextRunUs;
+        runBlock(b, scheduledUs, monotonicMicros());
+
+        // Grade fixa: o próximo instante não depende de quanto esta execução atrasou
+        runtime->nextRunUs = scheduledUs + periodUs;
+        int64_t afterUs = monotonicMicros();
+        if (afterUs >= runtime->nextRunUs) {
+            // Perdeu um ou mais períodos: realinha em vez de executar em rajada
+            runtime->status.overruns += (uint32_t)((afterUs - runtime->nextRunUs) / periodUs) + 1;
+            runtime->nextRunUs = afterUs + periodUs - ((afterUs - scheduledUs) % periodUs);
+        }
+        yield();
+    }
+
+    s_running = false;
+    unlockPid();
+}
+
+bool pidOwnsRegister(uint8_t slaveAddress, uint16_t registerAddress) {
+    for (uint8_t b = 0; b < s_blockCount; b++) {
+        if (s_blocks[b].enabled && s_blocks[b].outputSlave == slaveAddress &&
+            s_blocks[b].outputRegister == registerAddress) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t pidSetBlocks(const PidBlock* blocks, uint8_t count) {
+    if (count > PID_MAX_BLOCKS) {
+        count = PID_MAX_BLOCKS;
+    }
+    if (!lockPid(portMAX_DELAY)) {
+        return 0;
+    }
+
+    // Blocos que continuam com a mesma saída preservam estado; com sintonia nova
+    // o integrador é reinicializado a partir da última saída (sem salto)
+    PidRuntime* previous = new PidRuntime[PID_MAX_BLOCKS];
+    memcpy(previous, s_runtime, sizeof(s_runtime));
+    PidBlock* previousBlocks = new PidBlock[PID_MAX_BLOCKS];
+    memcpy(previousBlocks, s_blocks, sizeof(s_blocks));
+    uint8_t previousCount = s_blockCount;
+
+    memset(s_runtime, 0, sizeof(s_runtime));
+    for (uint8_t b = 0; b < count; b++) {
+        s_blocks[b] = blocks[b];
+        for (uint8_t p = 0; p < previousCount; p++) {
+            if (previousBlocks[p].outputSlave != blocks[b].outputSlave ||
+                previousBlocks[p].outputRegister != blocks[b].outputRegister ||
+                !previous[p].initialized) {
+                continue;
+            }
+            s_runtime[b] = previous[p];
+            s_runtime[b].status.integral = bumplessIntegral(&s_blocks[b], previous[p].lastPv, previous[p].status.output);
+            break;
+        }
+    }
+    s_blockCount = count;
+
+    delete[] previous;
+    delete[] previousBlocks;
+    unlockPid();
+    return count;
+}
+
+uint8_t pidGetBlocks(PidBlock* blocks, uint8_t maxCount) {
+    if (!lockPid(pdMS_TO_TICKS(500))) {
+        return 0;
+    }
+    uint8_t count = s_blockCount < maxCount ? s_blockCount : maxCount;
+    memcpy(blocks, s_blocks, count * sizeof(PidBlock));
+    unlockPid();
+    return count;
+}
+
+bool pidGetStatus(uint8_t index, PidStatus* status) {
+    if (index >= s_blockCount) {
+        return false;
+    }
+    // Cópia sem mutex: no pior caso mistura valores de duas execuções consecutivas
+    *status = s_runtime[index].status;
+    return true;
+}
+
+// ==================== CONFIGURAÇÃO ====================
+
+void pidBlockToJson(const PidBlock* block, JsonObject obj) {
+    obj["enabled"] = block->enabled;
+    obj["name"] = block->name;
+    obj["inputSlave"] = block->inputSlave;
+    obj["inputRegister"] = block->inputRegister;
+    obj["outputSlave"] = block->outputSlave;
+    obj["outputRegister"] = block->outputRegister;
+    obj["setpoint"] = block->setpoint;
+    obj["kp"] = block->kp;
+    obj["ki"] = block->ki;
+    obj["kd"] = block->kd;
+    obj["outMin"] = block->outMin;
+    obj["outMax"] = block->outMax;
+    obj["periodMs"] = block->periodMs;
+    obj["manual"] = block->manual;
+    obj["manualOutput"] = block->manualOutput;
+}
+
+bool pidBlockFromJson(JsonObjectConst obj, PidBlock* block) {
+    memset(block, 0, sizeof(PidBlock));
+    block->enabled = obj["enabled"] | true;
+    const char* name = obj["name"] | "";
+    strncpy(block->name, name, sizeof(block->name) - 1);
+    block->inputSlave = obj["inputSlave"] | 0;
+    block->inputRegister = obj["inputRegister"] | 0;
+    block->outputSlave = obj["outputSlave"] | 0;
+    block->outputRegister = obj["outputRegister"] | 0;
+    block->setpoint = obj["setpoint"] | 0.0f;
+    block->kp = obj["kp"] | 1.0f;
+    block->ki = obj["ki"] | 0.0f;
+    block->kd = obj["kd"] | 0.0f;
+    block->outMin = obj["outMin"] | 0.0f;
+    block->outMax = obj["outMax"] | 100.0f;
+    block->periodMs = obj["periodMs"] | 1000;
+    block->manual = obj["manual"] | false;
+    block->manualOutput = obj["manualOutput"] | 0.0f;
+
+    if (block->periodMs < PID_MIN_PERIOD_MS) {
+        block->periodMs = PID_MIN_PERIOD_MS;
+    }
+    if (isnan(block->kp) || isnan(block->ki) || isnan(block->kd) || isnan(block->setpoint)) {
+        return false;
+    }
+    if (!(block->outMax > block->outMin)) {
+        return false;
+    }
+    return block->inputSlave > 0 && block->outputSlave > 0;
+}
+
+bool pidSaveBlocks() {
+    PidBlock* blocks = new PidBlock[PID_MAX_BLOCKS];
+    uint8_t count = pidGetBlocks(blocks, PID_MAX_BLOCKS);
+
+    DynamicJsonDocument doc(4096);
+    JsonArray array = doc.createNestedArray("blocks");
+    for (uint8_t b = 0; b < count; b++) {
+        pidBlockToJson(&blocks[b], array.createNestedObject());
+    }
+    delete[] blocks;
+
+    File file = LittleFS.open(PID_CONFIG_FILE, "w");
+    if (!file) {
+        consolePrint("[PID] Erro ao gravar " PID_CONFIG_FILE "\r\n");
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    return true;
+}
+
+void pidEngineInit() {
+    File file = LittleFS.open(PID_CONFIG_FILE, "r");
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(4096);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        consolePrint("[PID] " PID_CONFIG_FILE " invalido: " + String(error.c_str()) + "\r\n");
+        return;
+    }
+
+    PidBlock* blocks = new PidBlock[PID_MAX_BLOCKS];
+    uint8_t count = 0;
+    for (JsonObjectConst obj : doc["blocks"].as<JsonArrayConst>()) {
+        if (count < PID_MAX_BLOCKS && pidBlockFromJson(obj, &blocks[count])) {
+            count++;
+        }
+    }
+    pidSetBlocks(blocks, count);
+    delete[] blocks;
+    consolePrint("[PID] " + String(count) + " blocos carregados\r\n");
+}
@@ -0,0 +1,125 @@
+/**
+ * @file pid_control.h
+ * @brief Blocos PID nativos com período próprio
+ *
+ * Cada bloco lê a variável de processo de um registro (valor processado,
+ * com gain/offset/Kalman), calcula a saída e a escreve em um registro de
+ * escrita (transformação inversa de gain/offset), tudo na mesma execução.
+ *
+ * - Forma paralela: u = Kp*e + I + D, com I += Ki*e*dt e derivada sobre a
+ *   medição (mudança de setpoint não gera pico na derivada)
+ * - Anti-windup por recálculo: em saturação o integrador é ajustado para que a
+ *   saída fique exatamente no limite, saindo da saturação assim que o erro inverte
+ * - Transferência sem salto: ao habilitar, passar de manual para automático ou
+ *   mudar a sintonia, o integrador é inicializado para manter a última saída
+ *
+ * pidService() é chamado no loop e entre as transações do ciclo de leitura
+ * (mesma task que usa o barramento); cada bloco roda quando seu período vence,
+ * independente do ciclo de CALCULATION_INTERVAL_MS. Jitter (atraso do início
+ * em relação ao instante agendado) e latência (recepção da medição até o fim
+ * da escrita da saída) são medidos a cada execução.
+ */
+
+#ifndef PID_CONTROL_H
+#define PID_CONTROL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define PID_MAX_BLOCKS 8
+#define PID_MIN_PERIOD_MS 100
+#define PID_CONFIG_FILE "/pid.json"
+
+/**
+ * @struct PidBlock
+ * @brief Configuração de um bloco PID
+ */
+struct PidBlock {
+    bool enabled;
+    char name[24];
+    uint8_t inputSlave;        // Variável de processo (registro de leitura)
+    uint16_t inputRegister;
+    uint8_t outputSlave;       // Saída (registro de escrita)
+    uint16_t outputRegister;
+    float setpoint;
+    float kp;
+    float ki;                  // 1/s
+    float kd;                  // s
+    float outMin;              // Limites da saída (unidade do valor processado do registro de saída)
+    float outMax;
+    uint32_t periodMs;         // Mínimo PID_MIN_PERIOD_MS
+    bool manual;               // true = escreve manualOutput (integrador acompanha)
+    float manualOutput;
+};
+
+/**
+ * @struct PidStatus
+ * @brief Estado e medições de um bloco
+ */
+struct PidStatus {
+    float processValue;
+    float output;
+    float error;
+    float integral;
+    uint32_t runs;
+    uint32_t overruns;         // Períodos perdidos (o bloco atrasou mais de um período)
+    uint32_t readErrors;
+    uint32_t writeErrors;
+    uint32_t lastJitterUs;
+    uint32_t maxJitterUs;
+    uint32_t meanJitterUs;
+    uint32_t lastLatencyUs;
+    uint32_t maxLatencyUs;
+    uint32_t meanLatencyUs;
+};
+
+/**
+ * @brief Carrega os blocos de PID_CONFIG_FILE (precisa do LittleFS montado)
+ */
+void pidEngineInit();
+
+/**
+ * @brief Substitui os blocos; blocos com a mesma saída mantêm o estado (sem salto)
+ * @return Quantidade de blocos válidos
+ */
+uint8_t pidSetBlocks(const PidBlock* blocks, uint8_t count);
+
+/**
+ * @brief Copia os blocos atuais
+ */
+uint8_t pidGetBlocks(PidBlock* blocks, uint8_t maxCount);
+
+/**
+ * @brief Copia o estado de um bloco
+ */
+bool pidGetStatus(uint8_t index, PidStatus* status);
+
+/**
+ * @brief Grava os blocos atuais em PID_CONFIG_FILE
+ */
+bool pidSaveBlocks();
+
+void pidBlockToJson(const PidBlock* block, JsonObject obj);
+bool pidBlockFromJson(JsonObjectConst obj, PidBlock* block);
+
+/**
+ * @brief Executa os blocos cujo período venceu
+ * @param nowUs monotonicMicros()
+ */
+void pidService(int64_t nowUs);
+
+/**
+ * @brief Indica se o registro é a saída de um bloco habilitado
+ */
+bool pidOwnsRegister(uint8_t slaveAddress, uint16_t registerAddress);
+
+/**
+ * @brief Passo do controlador (sem E/S), exposto para testes fora do alvo
+ * @param dt Intervalo desde o passo anterior (s)
+ * @param previousPv Medição anterior (derivada)
+ * @param integral Estado do integrador (atualizado)
+ * @return Saída limitada a [outMin, outMax]
+ */
+float pidStep(const PidBlock* block, float pv, float previousPv, float dt, float* integral);
+
+#endif // PID_CONTROL_H
@@ -0,0 +1,402 @@
+/**
+ * @file psychrometrics.cpp
+ * @brief Implementação da UR psicrométrica e do ajuste Levenberg-Marquardt
+ */
+
+#include "psychrometrics.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "rtc_manager.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <math.h>
+
+// Constantes padrão (Magnus + coeficiente psicrométrico), ponto de partida dos scripts
+static PsychroConstants s_constants = { 6.112, 17.67, 243.5, 1.8 };
+static PsychroSource s_source = { 0, 0, 0, 0 };
+static PsychroPoint s_points[PSYCHRO_MAX_POINTS];
+static uint8_t s_pointCount = 0;
+static PsychroFitResult s_lastFit = {};
+
+// Limites dos parâmetros (os mesmos de calibrar_constantes.py)
+static const double kLowerBounds[4] = { 0.01, 0.01, 1.0, 0.0008 };
+static const double kUpperBounds[4] = { 100.0, 100.0, 600.0, 5.0 };
+
+double psychroRelativeHumidity(double ts, double tu, const PsychroConstants* constants) {
+    double numerator = constants->a * exp((constants->b * tu) / (tu + constants->c)) - constants->d * (ts - tu);
+    double denominator = constants->a * exp((constants->b * ts) / (ts + constants->c));
+    return numerator / denominator * 100.0;
+}
+
+double psychroRelativeHumidityCurrent(double ts, double tu) {
+    PsychroConstants constants;
+    psychroGetConstants(&constants);
+    return psychroRelativeHumidity(ts, tu, &constants);
+}
+
+void psychroGetConstants(PsychroConstants* constants) {
+    // Cópia sem mutex: as constantes só mudam por ação do operador
+    *constants = s_constants;
+}
+
+void psychroSetConstants(const PsychroConstants* constants) {
+    s_constants = *constants;
+}
+
+// ==================== AJUSTE ====================
+
+// Modelo e derivadas parciais em relação a A, B, C, D para um ponto
+// UR = 100*(g - D*h), g = exp(B*(u - s)), h = (TS-TU)/(A*exp(B*s)),
+// u = TU/(TU+C), s = TS/(TS+C)
+static bool evaluatePoint(const double* x, const PsychroPoint& p, double* value, double* jacobian) {
+    double ts = p.ts;
+    double tu = p.tu;
+    if (fabs(ts + x[2]) < 1e-9 || fabs(tu + x[2]) < 1e-9) {
+        return false;
+    }
+    double u = tu / (tu + x[2]);
+    double s = ts / (ts + x[2]);
+    double g = exp(x[1] * (u - s));
+    double h = (ts - tu) / (x[0] * exp(x[1] * s));
+    *value = 100.0 * (g - x[3] * h);
+    if (jacobian) {
+        double du = -tu / ((tu + x[2]) * (tu + x[2]));
+        double ds = -ts / ((ts + x[2]) * (ts + x[2]));
+        jacobian[0] = 100.0 * x[3] * h / x[0];
+        jacobian[1] = 100.0 * (g * (u - s) + x[3] * h * s);
+        jacobian[2] = 100.0 * x[1] * (g * (du - ds) + x[3] * h * ds);
+        jacobian[3] = -100.0 * h;
+    }
+    return !isnan(*value) && !isinf(*value);
+}
+
+// Soma dos quadrados dos resíduos; infinito se algum ponto não pode ser avaliado
+static double sumSquares(const double* x, const PsychroPoint* points, uint8_t count) {
+    double cost = 0.0;
+    for (uint8_t k = 0; k < count; k++) {
+        double value;
+        if (!evaluatePoint(x, points[k], &value, nullptr)) {
+            return INFINITY;
+        }
+        double r = points[k].ur - value;
+        cost += r * r;
+    }
+    return cost;
+}
+
+// Resolve M*delta = v (4x4) por eliminação de Gauss com pivoteamento parcial
+static bool solve4(double m[4][4], double v[4], double delta[4]) {
+    for (int col = 0; col < 4; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < 4; row++) {
+            if (fabs(m[row][col]) > fabs(m[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(m[pivot][col]) < 1e-300) {
+            return false;
+        }
+        if (pivot != col) {
+            for (int k = 0; k < 4; k++) {
+                double t = m[col][k]; m[col][k] = m[pivot][k]; m[pivot][k] = t;
+            }
+            double t = v[col]; v[col] = v[pivot]; v[pivot] = t;
+        }
+        for (int row = col + 1; row < 4; row++) {
+            double factor = m[row][col] / m[col][col];
+            for (int k = col; k < 4; k++) {
+                m[row][k] -= factor * m[col][k];
+            }
+            v[row] -= factor * v[col];
+        }
+    }
+    for (int row = 3; row >= 0; row--) {
+        double sum = v[row];
+        for (int k = row + 1; k < 4; k++) {
+            sum -= m[row][k] * delta[k];
+        }
+        delta[row] = sum / m[row][row];
+    }
+    return true;
+}
+
+bool psychroFit(const PsychroPoint* points, uint8_t count, PsychroConstants* constants, PsychroFitResult* result) {
+    int64_t startUs = monotonicMicros();
+    memset(result, 0, sizeof(PsychroFitResult));
+    result->pointCount = count;
+    if (count < PSYCHRO_MIN_POINTS) {
+        return false;
+    }
+
+    double x[4] = { constants->a, constants->b, constants->c, constants->d };
+    for (int k = 0; k < 4; k++) {
+        x[k] = constrain(x[k], kLowerBounds[k], kUpperBounds[k]);
+    }
+    double cost = sumSquares(x, points, count);
+    if (isinf(cost)) {
+        return false;
+    }
+
+    double lambda = 1e-3;
+    uint8_t iteration = 0;
+    while (iteration < PSYCHRO_LM_MAX_ITERATIONS) {
+        iteration++;
+
+        // Equações normais: JtJ e Jt*r
+        double jtj[4][4] = {};
+        double jtr[4] = {};
+        for (uint8_t p = 0; p < count; p++) {
+            double value, jac[4];
+            evaluatePoint(x, points[p], &value, jac);
+            double r = points[p].ur - value;
+            for (int a = 0; a < 4; a++) {
+                jtr[a] += jac[a] * r;
+                for (int b = a; b < 4; b++) {
+                    jtj[a][b] += jac[a] * jac[b];
+                }
+            }
+        }
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < a; b++) {
+                jtj[a][b] = jtj[b][a];
+            }
+        }
+
+        // Parâmetros no limite com o gradiente apontando para fora ficam fixos
+        // neste passo (senão a projeção no limite anula o passo inteiro)
+        bool active[4];
+        for (int k = 0; k < 4; k++) {
+            active[k] = (x[k] <= kLowerBounds[k] && jtr[k] < 0.0) || (x[k] >= kUpperBounds[k] && jtr[k] > 0.0);
+        }
+        
+        // Tenta passos com amortecimento crescente até reduzir o custo
+        bool improved = false;
+        double candidateCost = cost;
+        double candidate[4];
+        while (lambda < 1e12) {
+            double m[4][4];
+            double v[4];
+            double delta[4];
+            for (int a = 0; a < 4; a++) {
+                for (int b = 0; b < 4; b++) {
+                    m[a][b] = jtj[a][b];
+                }
+                // Escala de Marquardt; o mínimo evita coluna nula quando um parâmetro não influencia
+                m[a][a] += lambda * (jtj[a][a] > 1e-12 ? jtj[a][a] : 1e-12);
+                v[a] = jtr[a];
+            }
+            for (int a = 0; a < 4; a++) {
+                if (!active[a]) {
+                    continue;
+                }
+                for (int b = 0; b < 4; b++) {
+                    m[a][b] = 0.0;
+                    m[b][a] = 0.0;
+                }
+                m[a][a] = 1.0;
+                v[a] = 0.0;
+            }
+            if (solve4(m, v, delta)) {
+                for (int k = 0; k < 4; k++) {
+                    candidate[k] = constrain(x[k] + delta[k], kLowerBounds[k], kUpperBounds[k]);
+                }
+                candidateCost = sumSquares(candidate, points, count);
+                if (candidateCost < cost) {
+                    improved = true;
+                    break;
+                }
+            }
+            lambda *= 10.0;
+        }
+        if (!improved) {
+            // Nenhum passo reduz o custo: mínimo (local) atingido
+            break;
+        }
+
+        double step = 0.0;
+        for (int k = 0; k < 4; k++) {
+            double rel = fabs(candidate[k] - x[k]) / (fabs(x[k]) + 1e-9);
+            if (rel > step) step = rel;
+            x[k] = candidate[k];
+        }
+        double reduction = (cost - candidateCost) / (cost > 0.0 ? cost : 1.0);
+        cost = candidateCost;
+        lambda = lambda / 10.0 < 1e-9 ? 1e-9 : lambda / 10.0;
+        if (reduction < 1e-12 || step < 1e-10) {
+            break;
+        }
+    }
+
+    // Erros finais por ponto (% UR)
+    double sumAbs = 0.0;
+    double maxAbs = 0.0;
+    for (uint8_t p = 0; p < count; p++) {
+        double value;
+        evaluatePoint(x, points[p], &value, nullptr);
+        double err = fabs(points[p].ur - value);
+        sumAbs += err;
+        if (err > maxAbs) maxAbs = err;
+    }
+    result->iterations = iteration;
+    result->rmsError = (float)sqrt(cost / count);
+    result->meanError = (float)(sumAbs / count);
+    result->maxError = (float)maxAbs;
+    result->success = !isnan(cost) && !isinf(cost);
+    result->elapsedUs = (uint32_t)(monotonicMicros() - startUs);
+
+    if (result->success) {
+        constants->a = x[0];
+        constants->b = x[1];
+        constants->c = x[2];
+        constants->d = x[3];
+    }
+    return result->success;
+}
+
+bool psychroCalibrate(PsychroFitResult* result) {
+    PsychroConstants constants = s_constants;
+    bool ok = psychroFit(s_points, s_pointCount, &constants, result);
+    s_lastFit = *result;
+    if (ok) {
+        psychroSetConstants(&constants);
+        consolePrint("[Psicrometria] Constantes ajustadas: A=" + String(constants.a, 6) + " B=" + String(constants.b, 6) +
+                     " C=" + String(constants.c, 6) + " D=" + String(constants.d, 6) +
+                     " (RMS " + String(result->rmsError, 3) + "%, " + String(result->iterations) + " iteracoes, " +
+                     String(result->elapsedUs) + " us)\r\n");
+    }
+    return ok;
+}
+
+void psychroGetLastFit(PsychroFitResult* result) {
+    *result = s_lastFit;
+}
+
+// ==================== PONTOS ====================
+
+void psychroGetSource(PsychroSource* source) {
+    *source = s_source;
+}
+
+void psychroSetSource(const PsychroSource* source) {
+    s_source = *source;
+}
+
+void psychroAddPoint(const PsychroPoint* point) {
+    if (s_pointCount >= PSYCHRO_MAX_POINTS) {
+        memmove(&s_points[0], &s_points[1], (PSYCHRO_MAX_POINTS - 1) * sizeof(PsychroPoint));
+        s_pointCount = PSYCHRO_MAX_POINTS - 1;
+    }
+    s_points[s_pointCount++] = *point;
+}
+
+// Valor processado da última leitura de um registro
+static bool latestValue(uint8_t slaveAddress, uint16_t registerAddress, float* value) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (config.devices[i].slaveAddress != slaveAddress) {
+            continue;
+        }
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            if (config.devices[i].registers[j].address == registerAddress) {
+                if (config.devices[i].registers[j].sampleTimeUs <= 0) {
+                    return false;
+                }
+                *value = sampleTimings[i][j].lastValue;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool psychroCapturePoint(float referenceUr, PsychroPoint* captured) {
+    PsychroPoint point;
+    if (!latestValue(s_source.tsSlave, s_source.tsRegister, &point.ts) ||
+        !latestValue(s_source.tuSlave, s_source.tuRegister, &point.tu)) {
+        return false;
+    }
+    point.ur = referenceUr;
+    psychroAddPoint(&point);
+    if (captured) {
+        *captured = point;
+    }
+    return true;
+}
+
+uint8_t psychroGetPoints(PsychroPoint* points, uint8_t maxCount) {
+    uint8_t count = s_pointCount < maxCount ? s_pointCount : maxCount;
+    memcpy(points, s_points, count * sizeof(PsychroPoint));
+    return count;
+}
+
+void psychroSetPoints(const PsychroPoint* points, uint8_t count) {
+    if (count > PSYCHRO_MAX_POINTS) {
+        count = PSYCHRO_MAX_POINTS;
+    }
+    memcpy(s_points, points, count * sizeof(PsychroPoint));
+    s_pointCount = count;
+}
+
+// ==================== CONFIGURAÇÃO ====================
+
+bool psychroSave() {
+    DynamicJsonDocument doc(2048);
+    doc["a"] = s_constants.a;
+    doc["b"] = s_constants.b;
+    doc["c"] = s_constants.c;
+    doc["d"] = s_constants.d;
+    doc["tsSlave"] = s_source.tsSlave;
+    doc["tsRegister"] = s_source.tsRegister;
+    doc["tuSlave"] = s_source.tuSlave;
+    doc["tuRegister"] = s_source.tuRegister;
+    JsonArray array = doc.createNestedArray("points");
+    for (uint8_t k = 0; k < s_pointCount; k++) {
+        JsonArray point = array.createNestedArray();
+        point.add(s_points[k].ts);
+        point.add(s_points[k].tu);
+        point.add(s_points[k].ur);
+    }
+
+    File file = LittleFS.open(PSYCHRO_CONFIG_FILE, "w");
+    if (!file) {
+        consolePrint("[Psicrometria] Erro ao gravar " PSYCHRO_CONFIG_FILE "\r\n");
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    return true;
+}
+
+void psychroInit() {
+    File file = LittleFS.open(PSYCHRO_CONFIG_FILE, "r");
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(2048);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        consolePrint("[Psicrometria] " PSYCHRO_CONFIG_FILE " invalido: " + String(error.c_str()) + "\r\n");
+        return;
+    }
+
+    s_constants.a = doc["a"] | s_constants.a;
+    s_constants.b = doc["b"] | s_constants.b;
+    s_constants.c = doc["c"] | s_constants.c;
+    s_constants.d = doc["d"] | s_constants.d;
+    s_source.tsSlave = doc["tsSlave"] | 0;
+    s_source.tsRegister = doc["tsRegister"] | 0;
+    s_source.tuSlave = doc["tuSlave"] | 0;
+    s_source.tuRegister = doc["tuRegister"] | 0;
+    s_pointCount = 0;
+    for (JsonArrayConst point : doc["points"].as<JsonArrayConst>()) {
+        if (s_pointCount >= PSYCHRO_MAX_POINTS || point.size() < 3) {
+            continue;
+        }
+        s_points[s_pointCount].ts = point[0] | 0.0f;
+        s_points[s_pointCount].tu = point[1] | 0.0f;
+        s_points[s_pointCount].ur = point[2] | 0.0f;
+        s_pointCount++;
+    }
+    consolePrint("[Psicrometria] Constantes carregadas, " + String(s_pointCount) + " pontos de referencia\r\n");
+}
@@ -0,0 +1,134 @@
+/**
+ * @file psychrometrics.h
+ * @brief Umidade relativa psicrométrica e calibração das constantes no dispositivo
+ *
+ * Fórmula (mesma de psicrometria_analise/calibrar_constantes.py):
+ *
+ *   UR = 100 * (A*exp(B*TU/(TU+C)) - D*(TS-TU)) / (A*exp(B*TS/(TS+C)))
+ *
+ * TS = bulbo seco, TU = bulbo úmido (°C). A função ur(ts, tu) das expressões
+ * de cálculo usa as constantes atuais.
+ *
+ * A calibração ajusta A, B, C e D por mínimos quadrados não lineares
+ * (Levenberg-Marquardt com escala de Marquardt, Jacobiano analítico 4 colunas,
+ * equações normais 4x4) sobre pontos de referência (TS, TU, UR) capturados das
+ * leituras atuais pela interface web. Não aloca memória; os parâmetros ficam
+ * dentro dos mesmos limites usados pelos scripts Python.
+ *
+ * A e D só aparecem na fórmula pela razão D/A: o ajuste determina D/A, B e C;
+ * A e D individualmente dependem do ponto de partida (as constantes atuais).
+ */
+
+#ifndef PSYCHROMETRICS_H
+#define PSYCHROMETRICS_H
+
+#include <Arduino.h>
+
+#define PSYCHRO_MAX_POINTS 16
+#define PSYCHRO_MIN_POINTS 4
+#define PSYCHRO_LM_MAX_ITERATIONS 100
+#define PSYCHRO_CONFIG_FILE "/psychro.json"
+
+/**
+ * @struct PsychroConstants
+ * @brief Constantes A, B, C, D da fórmula
+ */
+struct PsychroConstants {
+    double a;
+    double b;
+    double c;
+    double d;
+};
+
+/**
+ * @struct PsychroPoint
+ * @brief Ponto de referência de calibração
+ */
+struct PsychroPoint {
+    float ts;                  // Bulbo seco (°C)
+    float tu;                  // Bulbo úmido (°C)
+    float ur;                  // Umidade relativa de referência (%)
+};
+
+/**
+ * @struct PsychroFitResult
+ * @brief Resultado de um ajuste
+ */
+struct PsychroFitResult {
+    bool success;
+    uint8_t iterations;
+    uint8_t pointCount;
+    float rmsError;            // % UR
+    float maxError;
+    float meanError;
+    uint32_t elapsedUs;
+};
+
+/**
+ * @brief Carrega constantes, registros de origem e pontos de PSYCHRO_CONFIG_FILE
+ */
+void psychroInit();
+
+/**
+ * @brief Grava constantes, registros de origem e pontos em PSYCHRO_CONFIG_FILE
+ */
+bool psychroSave();
+
+/**
+ * @brief UR (%) pela fórmula com as constantes informadas
+ */
+double psychroRelativeHumidity(double ts, double tu, const PsychroConstants* constants);
+
+/**
+ * @brief UR (%) com as constantes atuais (função ur() das expressões)
+ */
+double psychroRelativeHumidityCurrent(double ts, double tu);
+
+void psychroGetConstants(PsychroConstants* constants);
+void psychroSetConstants(const PsychroConstants* constants);
+
+/**
+ * @brief Ajuste Levenberg-Marquardt das constantes
+ * @param constants Entrada: ponto de partida; saída: constantes ajustadas (só se success)
+ * @return false com menos de PSYCHRO_MIN_POINTS pontos ou se o ajuste divergiu
+ */
+bool psychroFit(const PsychroPoint* points, uint8_t count, PsychroConstants* constants, PsychroFitResult* result);
+
+/**
+ * @brief Registros de origem de TS e TU para a captura de pontos
+ */
+struct PsychroSource {
+    uint8_t tsSlave;
+    uint16_t tsRegister;
+    uint8_t tuSlave;
+    uint16_t tuRegister;
+};
+
+void psychroGetSource(PsychroSource* source);
+void psychroSetSource(const PsychroSource* source);
+
+/**
+ * @brief Acrescenta um ponto (substitui o mais antigo com a lista cheia)
+ */
+void psychroAddPoint(const PsychroPoint* point);
+
+/**
+ * @brief Captura TS e TU atuais dos registros de origem com a UR de referência
+ * @return false se algum registro de origem não foi encontrado ou ainda não foi lido
+ */
+bool psychroCapturePoint(float referenceUr, PsychroPoint* captured);
+
+uint8_t psychroGetPoints(PsychroPoint* points, uint8_t maxCount);
+void psychroSetPoints(const PsychroPoint* points, uint8_t count);
+
+/**
+ * @brief Ajusta com os pontos armazenados e, se convergiu, aplica as constantes
+ */
+bool psychroCalibrate(PsychroFitResult* result);
+
+/**
+ * @brief Resultado do último ajuste (pointCount = 0 se nenhum)
+ */
+void psychroGetLastFit(PsychroFitResult* result);
+
+#endif // PSYCHROMETRICS_H
@@ -0,0 +1,342 @@
+/**
+ * @file reactive_rules.cpp
+ * @brief Implementação das regras de reação rápida
+ */
+
+#include "reactive_rules.h"
+#include "config.h"
+#include "console.h"
+#include "modbus_handler.h"
+#include "modbus_queue.h"
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/**
+ * @struct RuleRuntime
+ * @brief Estado de execução de uma regra
+ */
+struct RuleRuntime {
+    bool hasSample;            // Estado inicial definido pela primeira leitura
+    bool retry;                // Escrita do estado atual falhou: repetir na próxima leitura
+    uint32_t writeId;          // Escrita em andamento na fila (0 = nenhuma)
+    int64_t sampleUs;          // Leitura que originou a escrita
+    uint64_t latencySumUs;
+    RuleStatus status;
+};
+
+static ReactiveRule s_rules[RULE_MAX_RULES];
+static RuleRuntime s_runtime[RULE_MAX_RULES];
+static uint8_t s_ruleCount = 0;
+
+static SemaphoreHandle_t s_rulesMutex = nullptr;
+
+static inline bool lockRules(TickType_t ticks) {
+    if (s_rulesMutex == nullptr) {
+        s_rulesMutex = xSemaphoreCreateMutex();
+    }
+    return s_rulesMutex != nullptr && xSemaphoreTake(s_rulesMutex, ticks) == pdTRUE;
+}
+
+static inline void unlockRules() {
+    xSemaphoreGive(s_rulesMutex);
+}
+
+// Localiza um registro configurado pelo endereço do escravo e do registro
+static bool findRegister(uint8_t slaveAddress, uint16_t registerAddress, int* deviceIndex, int* registerIndex) {
+    for (int i = 0; i < config.deviceCount; i++) {
+        if (!config.devices[i].enabled || config.devices[i].slaveAddress != slaveAddress) {
+            continue;
+        }
+        for (int j = 0; j < config.devices[i].registerCount; j++) {
+            if (config.devices[i].registers[j].address == registerAddress) {
+                *deviceIndex = i;
+                *registerIndex = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Disparo com histerese: a banda morta só vale para sair do estado disparado
+static inline bool testRule(const ReactiveRule* rule, bool tripped, float value) {
+    if (rule->below) {
+        return tripped ? value <= rule->threshold + rule->deadband : value <= rule->threshold;
+    }
+    return tripped ? value >= rule->threshold - rule->deadband : value >= rule->threshold;
+}
+
+// Coloca a escrita da saída na fila com a prioridade mais alta
+static void queueOutput(uint8_t index, float value, int64_t sampleTimeUs) {
+    const ReactiveRule* rule = &s_rules[index];
+    RuleRuntime* runtime = &s_runtime[index];
+    runtime->retry = false;
+
+    int outDevice, outRegister;
+    if (!findRegister(rule->outputSlave, rule->outputRegister, &outDevice, &outRegister)) {
+        runtime->status.writeErrors++;
+        return;
+    }
+    const ModbusRegister& outReg = config.devices[outDevice].registers[outRegister];
+
+    uint8_t registerCount;
+    uint32_t rawValue;
+    if (outReg.registerType == REGISTER_TYPE_COIL) {
+        // Bobina: 0x05 com o valor booleano (sem gain/offset)
+        registerCount = 0;
+        rawValue = value != 0.0f ? 1 : 0;
+    } else {
+        // Saída no registro: raw = (valor - offset) / gain, na codificação do tipo
+        float raw = outReg.gain != 0.0f ? (value - outReg.offset) / outReg.gain : 0.0f;
+        if ((outReg.dataType & REGISTER_DATA_TYPE_MASK) != REGISTER_DATA_FLOAT32) {
+            raw = round(raw);
+        }
+        uint16_t words[2];
+        registerCount = encodeRegisterWords(outReg.dataType, raw, words);
+        rawValue = registerCount == 2 ? ((uint32_t)words[0] << 16) | words[1] : words[0];
+    }
+
+    runtime->writeId = modbusQueueWrite(MODBUS_PRIORITY_SAFETY, rule->outputSlave, rule->outputRegister,
+                                        registerCount, rawValue);
+    runtime->sampleUs = sampleTimeUs;
+    if (runtime->writeId == 0) {
+        // Fila cheia: tenta de novo na próxima leitura
+        runtime->status.writeErrors++;
+        runtime->retry = true;
+    }
+}
+
+void ruleOnSample(uint8_t slaveAddress, uint16_t registerAddress, int64_t sampleTimeUs, float value) {
+    if (s_ruleCount == 0 || !lockRules(pdMS_TO_TICKS(10))) {
+        return;
+    }
+
+    for (uint8_t r = 0; r < s_ruleCount; r++) {
+        const ReactiveRule* rule = &s_rules[r];
+        if (!rule->enabled || rule->inputSlave != slaveAddress || rule->inputRegister != registerAddress) {
+            continue;
+        }
+        RuleRuntime* runtime = &s_runtime[r];
+        RuleStatus* status = &runtime->status;
+        status->lastValue = value;
+
+        bool tripped = testRule(rule, status->tripped, value);
+        if (!runtime->hasSample) {
+            // Primeira leitura: só dispara (nada é escrito na saída se a entrada já está normal)
+            runtime->hasSample = true;
+            if (!tripped) {
+                continue;
+            }
+        } else if (tripped == status->tripped) {
+            // Sem transição: repete a escrita do estado atual se a anterior falhou
+            if (runtime->retry && runtime->writeId == 0 && (tripped || rule->hasRelease)) {
+                queueOutput(r, tripped ? rule->tripValue : rule->releaseValue, sampleTimeUs);
+            }
+            continue;
+        }
+
+        status->tripped = tripped;
+        if (tripped) {
+            status->trips++;
+        }
+        consolePrint("[Regra] " + String(rule->name) + (tripped ? ": disparou" : ": liberada") +
+                     " (Dev " + String(slaveAddress) + " Reg " + String(registerAddress) + " = " + String(value, 2) + ")\r\n");
+
+        if (tripped || rule->hasRelease) {
+            queueOutput(r, tripped ? rule->tripValue : rule->releaseValue, sampleTimeUs);
+        } else {
+            runtime->retry = false;
+        }
+    }
+
+    unlockRules();
+}
+
+void ruleService() {
+    if (s_ruleCount == 0 || !lockRules(pdMS_TO_TICKS(10))) {
+        return;
+    }
+
+    for (uint8_t r = 0; r < s_ruleCount; r++) {
+        RuleRuntime* runtime = &s_runtime[r];
+        if (runtime->writeId == 0) {
+            continue;
+        }
+        RuleStatus* status = &runtime->status;
+        ModbusWriteTicket ticket;
+        if (!modbusQueueStatus(runtime->writeId, &ticket)) {
+            // Slot reutilizado antes de acompanharmos o resultado
+            runtime->writeId = 0;
+            status->writeErrors++;
+            runtime->retry = true;
+            continue;
+        }
+        if (ticket.state != MODBUS_WRITE_DONE) {
+            continue;
+        }
+        runtime->writeId = 0;
+        if (ticket.result != node.ku8MBSuccess) {
+            status->writeErrors++;
+            runtime->retry = true;
+            continue;
+        }
+
+        uint32_t latencyUs = (uint32_t)(ticket.completedUs - runtime->sampleUs);
+        status->lastLatencyUs = latencyUs;
+        if (latencyUs > status->maxLatencyUs) status->maxLatencyUs = latencyUs;
+        status->lastQueueWaitUs = (uint32_t)(ticket.startedUs - ticket.queuedUs);
+        status->writes++;
+        runtime->latencySumUs += latencyUs;
+        status->meanLatencyUs = (uint32_t)(runtime->latencySumUs / status->writes);
+        consolePrint("[Regra] " + String(s_rules[r].name) + ": saida Dev " + String(ticket.slaveAddress) +
+                     " Reg " + String(ticket.registerAddress) + " escrita, latencia " +
+                     String(latencyUs / 1000.0f, 1) + " ms\r\n");
+    }
+
+    unlockRules();
+}
+
+bool ruleWritePending() {
+    for (uint8_t r = 0; r < s_ruleCount; r++) {
+        if (s_runtime[r].writeId != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ruleHoldsRegister(uint8_t slaveAddress, uint16_t registerAddress) {
+    for (uint8_t r = 0; r < s_ruleCount; r++) {
+        if (s_rules[r].enabled && s_runtime[r].status.tripped && s_rules[r].outputSlave == slaveAddress &&
+            s_rules[r].outputRegister == registerAddress) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t ruleSetRules(const ReactiveRule* rules, uint8_t count) {
+    if (count > RULE_MAX_RULES) {
+        count = RULE_MAX_RULES;
+    }
+    if (!lockRules(portMAX_DELAY)) {
+        return 0;
+    }
+    memcpy(s_rules, rules, count * sizeof(ReactiveRule));
+    memset(s_runtime, 0, sizeof(s_runtime));
+    s_ruleCount = count;
+    unlockRules();
+    return count;
+}
+
+uint8_t ruleGetRules(ReactiveRule* rules, uint8_t maxCount) {
+    if (!lockRules(pdMS_TO_TICKS(500))) {
+        return 0;
+    }
+    uint8_t count = s_ruleCount < maxCount ? s_ruleCount : maxCount;
+    memcpy(rules, s_rules, count * sizeof(ReactiveRule));
+    unlockRules();
+    return count;
+}
+
+bool ruleGetStatus(uint8_t index, RuleStatus* status) {
+    if (index >= s_ruleCount) {
+        return false;
+    }
+    // Cópia sem mutex: no pior caso mistura valores de duas leituras consecutivas
+    *status = s_runtime[index].status;
+    return true;
+}
+
+// ==================== CONFIGURAÇÃO ====================
+
+void ruleToJson(const ReactiveRule* rule, JsonObject obj) {
+    obj["enabled"] = rule->enabled;
+    obj["name"] = rule->name;
+    obj["inputSlave"] = rule->inputSlave;
+    obj["inputRegister"] = rule->inputRegister;
+    obj[rule->below ? "below" : "above"] = rule->threshold;
+    obj["deadband"] = rule->deadband;
+    obj["outputSlave"] = rule->outputSlave;
+    obj["outputRegister"] = rule->outputRegister;
+    obj["trip"] = rule->tripValue;
+    if (rule->hasRelease) {
+        obj["release"] = rule->releaseValue;
+    }
+}
+
+bool ruleFromJson(JsonObjectConst obj, ReactiveRule* rule) {
+    memset(rule, 0, sizeof(ReactiveRule));
+    rule->enabled = obj["enabled"] | true;
+    const char* name = obj["name"] | "";
+    strncpy(rule->name, name, sizeof(rule->name) - 1);
+    rule->inputSlave = obj["inputSlave"] | 0;
+    rule->inputRegister = obj["inputRegister"] | 0;
+    rule->outputSlave = obj["outputSlave"] | 0;
+    rule->outputRegister = obj["outputRegister"] | 0;
+    rule->deadband = obj["deadband"] | 0.0f;
+    rule->tripValue = obj["trip"] | 0.0f;
+
+    // Limite: a chave presente define o sentido (uma das duas)
+    if (obj.containsKey("above") == obj.containsKey("below")) {
+        return false;
+    }
+    rule->below = obj.containsKey("below");
+    rule->threshold = rule->below ? (obj["below"] | NAN) : (obj["above"] | NAN);
+
+    // Liberação: só escreve se configurada
+    rule->hasRelease = obj.containsKey("release");
+    rule->releaseValue = obj["release"] | 0.0f;
+
+    if (isnan(rule->threshold) || isnan(rule->tripValue) || isnan(rule->releaseValue) || !(rule->deadband >= 0.0f)) {
+        return false;
+    }
+    return rule->inputSlave > 0 && rule->outputSlave > 0;
+}
+
+bool ruleSaveRules() {
+    ReactiveRule* rules = new ReactiveRule[RULE_MAX_RULES];
+    uint8_t count = ruleGetRules(rules, RULE_MAX_RULES);
+
+    DynamicJsonDocument doc(6144);
+    JsonArray array = doc.createNestedArray("rules");
+    for (uint8_t r = 0; r < count; r++) {
+        ruleToJson(&rules[r], array.createNestedObject());
+    }
+    delete[] rules;
+
+    File file = LittleFS.open(RULE_CONFIG_FILE, "w");
+    if (!file) {
+        consolePrint("[Regra] Erro ao gravar " RULE_CONFIG_FILE "\r\n");
+        return false;
+    }
+    serializeJson(doc, file);
+    file.close();
+    return true;
+}
+
+void reactiveRulesInit() {
+    File file = LittleFS.open(RULE_CONFIG_FILE, "r");
+    if (!file) {
+        return;
+    }
+    DynamicJsonDocument doc(6144);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        consolePrint("[Regra] " RULE_CONFIG_FILE " invalido: " + String(error.c_str()) + "\r\n");
+        return;
+    }
+
+    ReactiveRule* rules = new ReactiveRule[RULE_MAX_RULES];
+    uint8_t count = 0;
+    for (JsonObjectConst obj : doc["rules"].as<JsonArrayConst>()) {
+        if (count < RULE_MAX_RULES && ruleFromJson(obj, &rules[count])) {
+            count++;
+        }
+    }
+    ruleSetRules(rules, count);
+    delete[] rules;
+    consolePrint("[Regra] " + String(count) + " regras carregadas\r\n");
+}
@@ -0,0 +1,126 @@
+/**
+ * @file reactive_rules.h
+ * @brief Regras de reação rápida: mudança de uma entrada direto para uma saída
+ *
+ * Pelo caminho normal, uma mudança em um registro de entrada só chega às
+ * saídas depois do resto do ciclo de leitura, do código de cálculo e de
+ * writeOutputRegisters(). Uma regra é avaliada no instante em que a leitura
+ * do registro é decodificada (ruleOnSample(), ao lado dos alarmes) e, na
+ * transição, coloca a escrita da saída na fila com MODBUS_PRIORITY_SAFETY:
+ * o ciclo de leitura executa a fila logo depois da leitura (sem a pausa
+ * fixa entre leituras), e a escrita sai antes das do operador e das saídas
+ * de controle. Exemplo: sobretemperatura desliga o aquecedor.
+ *
+ * - Disparo: valor processado >= limite (above) ou <= limite (below)
+ * - Liberação: o valor volta além da banda morta; com release configurado,
+ *   o valor de liberação é escrito na saída
+ * - Enquanto disparada, a regra retém a saída: writeOutputRegisters(), os
+ *   blocos PID e as atribuições do script não escrevem nela
+ * - Escrita com erro (ou fila cheia) é repetida na leitura seguinte
+ *
+ * A latência é medida da recepção da leitura (sampleTimeUs) até a resposta
+ * do escravo à escrita. O limite dela é o intervalo entre leituras do
+ * registro de entrada: para reagir rápido, a entrada deve estar em um grupo
+ * de amostragem rápido.
+ */
+
+#ifndef REACTIVE_RULES_H
+#define REACTIVE_RULES_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define RULE_MAX_RULES 16
+#define RULE_CONFIG_FILE "/rules.json"
+
+/**
+ * @struct ReactiveRule
+ * @brief Configuração de uma regra
+ */
+struct ReactiveRule {
+    bool enabled;
+    char name[24];
+    uint8_t inputSlave;        // Registro observado (valor processado, com gain/offset/Kalman)
+    uint16_t inputRegister;
+    bool below;                // false = dispara acima do limite; true = abaixo
+    float threshold;
+    float deadband;            // Histerese da liberação
+    uint8_t outputSlave;       // Saída (registro configurado; bobina ou registro de escrita)
+    uint16_t outputRegister;
+    float tripValue;           // Unidade do valor processado da saída (transformação inversa de gain/offset)
+    bool hasRelease;           // Escreve releaseValue na liberação
+    float releaseValue;
+};
+
+/**
+ * @struct RuleStatus
+ * @brief Estado e medições de uma regra
+ */
+struct RuleStatus {
+    bool tripped;
+    float lastValue;           // Última leitura da entrada
+    uint32_t trips;
+    uint32_t writes;           // Escritas concluídas com sucesso (disparo e liberação)
+    uint32_t writeErrors;      // Erro do escravo, fila cheia ou escrita perdida
+    uint32_t lastLatencyUs;    // Recepção da leitura até a resposta da escrita
+    uint32_t maxLatencyUs;
+    uint32_t meanLatencyUs;
+    uint32_t lastQueueWaitUs;  // Parte da latência esperando o barramento
+};
+
+/**
+ * @brief Carrega as regras de RULE_CONFIG_FILE (precisa do LittleFS montado)
+ */
+void reactiveRulesInit();
+
+/**
+ * @brief Substitui as regras (o estado é zerado; a próxima leitura reavalia)
+ * @return Quantidade de regras válidas
+ */
+uint8_t ruleSetRules(const ReactiveRule* rules, uint8_t count);
+
+/**
+ * @brief Copia as regras atuais
+ */
+uint8_t ruleGetRules(ReactiveRule* rules, uint8_t maxCount);
+
+/**
+ * @brief Copia o estado de uma regra
+ */
+bool ruleGetStatus(uint8_t index, RuleStatus* status);
+
+/**
+ * @brief Grava as regras atuais em RULE_CONFIG_FILE
+ */
+bool ruleSaveRules();
+
+void ruleToJson(const ReactiveRule* rule, JsonObject obj);
+bool ruleFromJson(JsonObjectConst obj, ReactiveRule* rule);
+
+/**
+ * @brief Nova leitura de um registro: avalia as regras que o observam
+ *
+ * Chamado pelo ciclo de leitura logo após decodificar a resposta. Na
+ * transição, a escrita da saída entra na fila (não bloqueia).
+ */
+void ruleOnSample(uint8_t slaveAddress, uint16_t registerAddress, int64_t sampleTimeUs, float value);
+
+/**
+ * @brief Acompanha as escritas na fila (latência, erros); chamar depois de modbusQueueService()
+ */
+void ruleService();
+
+/**
+ * @brief Indica se alguma regra tem escrita na fila ainda não acompanhada
+ *
+ * O ciclo de leitura usa para executar a fila logo após a leitura, sem
+ * esperar a pausa fixa entre leituras.
+ */
+bool ruleWritePending();
+
+/**
+ * @brief Indica se o registro é a saída de uma regra disparada (ninguém mais escreve nele)
+ */
+bool ruleHoldsRegister(uint8_t slaveAddress, uint16_t registerAddress);
+
+#endif // REACTIVE_RULES_H
@@ -9,6 +9,8 @@
 #include "console.h"
 #include <WiFi.h>
 #include <time.h>
+#include <sys/time.h>
+#include "esp_timer.h"
 
 // Variáveis globais
 WiFiUDP ntpUDP;
@@ -16,18 +18,58 @@ bool rtcInitialized = false;
 unsigned long lastNtpSync = 0;
 const unsigned long NTP_SYNC_INTERVAL = 3600000;  // Sincronizar NTP a cada 1 hora
 
-uint32_t getCurrentEpochTime() {
+#define RTC_MAPPING_REFRESH_US 60000000LL  // Reajuste do mapeamento pelo relógio do sistema (1 min)
+
+// Mapeamento monotônico -> UTC: utcUs = monotonicUs + s_utcOffsetUs
+static int64_t s_utcOffsetUs = 0;
+static bool s_systemClockSynced = false;  // Relógio do sistema mantido pelo SNTP
+static int64_t s_lastMappingRefreshUs = 0;
+
+int64_t monotonicMicros() {
+    return esp_timer_get_time();
+}
+
+int64_t monotonicToUtcMicros(int64_t monotonicUs) {
     if (!config.rtc.enabled || !rtcInitialized || config.rtc.epochTime == 0) {
         return 0;
     }
-    
-    // Calcula tempo decorrido desde bootTime
-    unsigned long currentMillis = millis();
-    unsigned long elapsedMillis = currentMillis - config.rtc.bootTime;
-    unsigned long elapsedSeconds = elapsedMillis / 1000;
-    
-    // Retorna epoch time atual
-    return config.rtc.epochTime + elapsedSeconds;
+    return monotonicUs + s_utcOffsetUs;
+}
+
+uint32_t getCurrentEpochTime() {
+    int64_t utcUs = monotonicToUtcMicros(monotonicMicros());
+    if (utcUs <= 0) {
+        return 0;
+    }
+    return (uint32_t)(utcUs / 1000000LL);
+}
+
+void rtcSetEpoch(uint32_t epoch) {
+    config.rtc.epochTime = epoch;
+    config.rtc.bootTime = millis();
+    s_utcOffsetUs = (int64_t)epoch * 1000000LL - monotonicMicros();
+    rtcInitialized = true;
+}
+
+// Lê o relógio do sistema (resolução de µs) e recalcula o mapeamento
+static bool refreshMappingFromSystemClock() {
+    struct timeval now;
+    if (gettimeofday(&now, NULL) != 0 || now.tv_sec < 1000000000) {
+        return false;
+    }
+    int64_t monotonicUs = monotonicMicros();
+    s_utcOffsetUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec - monotonicUs;
+    s_lastMappingRefreshUs = monotonicUs;
+    return true;
+}
+
+void rtcService() {
+    if (!s_systemClockSynced || !config.rtc.enabled) {
+        return;
+    }
+    if (monotonicMicros() - s_lastMappingRefreshUs >= RTC_MAPPING_REFRESH_US) {
+        refreshMappingFromSystemClock();
+    }
 }
 
 void formatDateTime(uint32_t epoch, char* dateStr, char* timeStr, int8_t timezone) {
@@ -91,13 +133,14 @@ bool syncNTP() {
     
     if (now > 1000000000) {
         // Sincronização bem-sucedida
-        config.rtc.epochTime = (uint32_t)now;
-        config.rtc.bootTime = millis();
+        rtcSetEpoch((uint32_t)now);
+        
+        // A partir daqui o SNTP mantém o relógio do sistema; o mapeamento usa seus µs
+        s_systemClockSynced = refreshMappingFromSystemClock();
         
         // Salva na configuração
         saveConfig();
         
-        rtcInitialized = true;
         lastNtpSync = millis();
         
         Serial.print("NTP sincronizado: ");
@@ -22,6 +22,39 @@ extern const unsigned long NTP_SYNC_INTERVAL;
  */
 uint32_t getCurrentEpochTime();
 
+/**
+ * @brief Tempo monotônico de alta resolução (esp_timer), em µs desde o boot
+ *
+ * 64 bits: não dá a volta (millis() volta a zero após ~49 dias) e não salta
+ * quando o relógio de parede é ajustado. Use para carimbar amostras e medir
+ * intervalos; converta para UTC com monotonicToUtcMicros().
+ */
+int64_t monotonicMicros();
+
+/**
+ * @brief Define o relógio de parede (NTP, ajuste manual ou data salva)
+ *
+ * Atualiza config.rtc.epochTime/bootTime, marca o RTC como inicializado e
+ * recalcula o mapeamento monotônico -> UTC.
+ * @param epoch Unix timestamp (UTC) do instante atual
+ */
+void rtcSetEpoch(uint32_t epoch);
+
+/**
+ * @brief Reajusta o mapeamento monotônico -> UTC pelo relógio do sistema
+ *
+ * Após a primeira sincronização NTP o cliente SNTP do sistema corrige o
+ * relógio periodicamente; chamar no loop mantém o mapeamento atualizado.
+ * Sem NTP sincronizado não faz nada.
+ */
+void rtcService();
+
+/**
+ * @brief Converte um instante monotônico (monotonicMicros) em UTC
+ * @return µs desde 1970 (UTC) ou 0 se o RTC não está inicializado
+ */
+int64_t monotonicToUtcMicros(int64_t monotonicUs);
+
 /**
  * @brief Formata epoch time em data e hora
  * @param epoch Epoch time (Unix timestamp)
@@ -0,0 +1,931 @@
+/**
+ * @file script_compiler.cpp
+ * @brief Implementação da compilação do código de cálculo
+ */
+
+#include "script_compiler.h"
+#include "psychrometrics.h"
+#include <math.h>
+#include <ctype.h>
+#include <string.h>
+
+enum ScriptOpCode {
+    OP_CONST = 0,
+    OP_DEVICE,                             // args: dispositivo, registro
+    OP_LOAD,                               // args: variável, linha da atribuição que a alcança + 1 (0 = nenhuma)
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,                                // Divisão por zero é erro
+    OP_MOD,
+    OP_POW,
+    OP_GT,
+    OP_LT,
+    OP_GE,
+    OP_LE,
+    OP_EQ,                                 // Tolerância de 0.000001, como no interpretador
+    OP_NE,
+    OP_IF,
+    OP_SIN,
+    OP_COS,
+    OP_TAN,
+    OP_SQRT,                               // sqrt(): argumento negativo é erro
+    OP_ROOT,                               // x^0.5: sem a verificação (pow dava NaN)
+    OP_ABS,
+    OP_LOG,
+    OP_EXP,
+    OP_UR,                                 // ur(ts, tu): constantes da calibração, não é dobrada
+    OP_DISPLAY,                            // Efeitos colaterais: nunca compartilhadas nem dobradas
+    OP_BCAST
+};
+
+/**
+ * @brief Uma operação; os operandos vêm antes na lista
+ */
+struct ScriptOp {
+    uint8_t code;
+    bool fallible;                         // Pode falhar na execução (ela ou um operando)
+    uint8_t argCount;
+    union {
+        uint16_t args[4];
+        double constant;                   // OP_CONST
+    };
+};
+
+struct ScriptProgram {
+    ScriptOp* ops;
+    uint16_t opCount;
+    CompiledLine* lines;
+    uint16_t lineCount;
+    char (*varNames)[6];
+    uint8_t varCount;
+    ScriptCompileStats stats;
+};
+
+struct ScriptProgramState {
+    uint8_t* done;                         // Operação já calculada nesta execução
+    double* values;
+    int8_t* varSlots;                      // Índice da variável em tempVariables (-1 = ainda não achada)
+};
+
+// ==================== COMPILAÇÃO ====================
+
+static const int NO_OP = -1;
+
+struct Compiler {
+    ScriptProgram* program;
+    uint16_t capacity;
+    const DeviceValues* shape;
+    const char* pos;
+    int16_t lastDef[SCRIPT_COMPILER_MAX_VARS];       // Linha da última atribuição (-1 = nenhuma)
+    bool readSinceDef[SCRIPT_COMPILER_MAX_VARS];     // Lida depois dela
+};
+
+static int compileExpression(Compiler* compiler);
+
+// Mesmo critério do interpretador (só espaço e tab)
+static void skipSpaces(Compiler* compiler) {
+    while (*compiler->pos == ' ' || *compiler->pos == '\t') {
+        compiler->pos++;
+    }
+}
+
+static inline bool isConst(const Compiler* compiler, int index, double* value = nullptr) {
+    const ScriptOp& op = compiler->program->ops[index];
+    if (op.code != OP_CONST) {
+        return false;
+    }
+    if (value != nullptr) {
+        *value = op.constant;
+    }
+    return true;
+}
+
+static inline bool isFallible(const Compiler* compiler, int index) {
+    return compiler->program->ops[index].fallible;
+}
+
+static inline bool hasSideEffects(uint8_t code) {
+    return code == OP_DISPLAY || code == OP_BCAST;
+}
+
+// Acrescenta a operação ou devolve a igual já existente (CSE)
+static int intern(Compiler* compiler, const ScriptOp& op) {
+    ScriptProgram* program = compiler->program;
+    if (!hasSideEffects(op.code)) {
+        for (uint16_t k = 0; k < program->opCount; k++) {
+            const ScriptOp& other = program->ops[k];
+            if (other.code != op.code || other.argCount != op.argCount) {
+                continue;
+            }
+            bool same = op.code == OP_CONST ? memcmp(&other.constant, &op.constant, sizeof(double)) == 0
+                                            : memcmp(other.args, op.args, sizeof(op.args)) == 0;
+            if (same) {
+                if (op.code != OP_CONST && op.code != OP_DEVICE && op.code != OP_LOAD) {
+                    program->stats.shared++;
+                }
+                return k;
+            }
+        }
+    }
+    if (program->opCount >= compiler->capacity) {
+        return NO_OP;
+    }
+    program->ops[program->opCount] = op;
+    return program->opCount++;
+}
+
+static int makeConst(Compiler* compiler, double value) {
+    ScriptOp op;
+    memset(&op, 0, sizeof(op));
+    op.code = OP_CONST;
+    op.constant = value;
+    return intern(compiler, op);
+}
+
+static int makeOp(Compiler* compiler, uint8_t code, bool fallible, uint8_t argCount, int a, int b = 0, int c = 0, int d = 0) {
+    if (a < 0 || b < 0 || c < 0 || d < 0) {
+        return NO_OP;
+    }
+    ScriptOp op;
+    memset(&op, 0, sizeof(op));
+    op.code = code;
+    op.argCount = argCount;
+    op.args[0] = (uint16_t)a;
+    op.args[1] = (uint16_t)b;
+    op.args[2] = (uint16_t)c;
+    op.args[3] = (uint16_t)d;
+    op.fallible = fallible;
+    for (uint8_t k = 0; k < argCount && code != OP_DEVICE && code != OP_LOAD; k++) {
+        op.fallible = op.fallible || isFallible(compiler, op.args[k]);
+    }
+    return intern(compiler, op);
+}
+
+static double applyUnary(uint8_t code, double a) {
+    switch (code) {
+        case OP_NEG: return -a;
+        case OP_SIN: return sin(a);
+        case OP_COS: return cos(a);
+        case OP_TAN: return tan(a);
+        case OP_SQRT:
+        case OP_ROOT: return sqrt(a);
+        case OP_ABS: return fabs(a);
+        case OP_LOG: return log(a);
+        case OP_EXP: return exp(a);
+    }
+    return 0.0;
+}
+
+static double applyBinary(uint8_t code, double a, double b) {
+    switch (code) {
+        case OP_ADD: return a + b;
+        case OP_SUB: return a - b;
+        case OP_MUL: return a * b;
+        case OP_DIV: return a / b;
+        case OP_MOD: return fmod(a, b);
+        case OP_POW: return pow(a, b);
+        case OP_GT: return a > b ? 1.0 : 0.0;
+        case OP_LT: return a < b ? 1.0 : 0.0;
+        case OP_GE: return a >= b ? 1.0 : 0.0;
+        case OP_LE: return a <= b ? 1.0 : 0.0;
+        case OP_EQ: return fabs(a - b) < 0.000001 ? 1.0 : 0.0;
+        case OP_NE: return fabs(a - b) >= 0.000001 ? 1.0 : 0.0;
+    }
+    return 0.0;
+}
+
+static int makeUnary(Compiler* compiler, uint8_t code, int a) {
+    if (a < 0) {
+        return NO_OP;
+    }
+    double value = 0.0;
+    bool constant = isConst(compiler, a, &value);
+    // sqrt() e log() de constante fora do domínio ficam para a execução (mensagem de erro)
+    bool error = (code == OP_SQRT && value < 0) || (code == OP_LOG && value <= 0);
+    if (constant && !error) {
+        compiler->program->stats.folded++;
+        return makeConst(compiler, applyUnary(code, value));
+    }
+    return makeOp(compiler, code, code == OP_SQRT || code == OP_LOG, 1, a);
+}
+
+static bool isPowerOfTwo(double value) {
+    int exponent;
+    return value != 0.0 && isfinite(value) && fabs(frexp(value, &exponent)) == 0.5;
+}
+
+static int makeBinary(Compiler* compiler, uint8_t code, int a, int b) {
+    if (a < 0 || b < 0) {
+        return NO_OP;
+    }
+    ScriptCompileStats& stats = compiler->program->stats;
+    double left = 0.0, right = 0.0;
+    bool leftConst = isConst(compiler, a, &left);
+    bool rightConst = isConst(compiler, b, &right);
+    if (leftConst && rightConst && !(code == OP_DIV && right == 0.0)) {
+        stats.folded++;
+        return makeConst(compiler, applyBinary(code, left, right));
+    }
+
+    // Identidades com constante (o outro operando continua sendo avaliado)
+    if ((code == OP_ADD || code == OP_SUB) && rightConst && right == 0.0) {
+        stats.folded++;
+        return a;
+    }
+    if (code == OP_ADD && leftConst && left == 0.0) {
+        stats.folded++;
+        return b;
+    }
+    if ((code == OP_MUL || code == OP_DIV) && rightConst && right == 1.0) {
+        stats.folded++;
+        return a;
+    }
+    if (code == OP_MUL && leftConst && left == 1.0) {
+        stats.folded++;
+        return b;
+    }
+    // Divisão por potência de 2: o inverso é exato
+    if (code == OP_DIV && rightConst && isPowerOfTwo(right)) {
+        stats.reduced++;
+        return makeBinary(compiler, OP_MUL, a, makeConst(compiler, 1.0 / right));
+    }
+
+    // Operações comutativas em ordem fixa (mais CSE); só sem erro possível, que
+    // depende da ordem de avaliação
+    if ((code == OP_ADD || code == OP_MUL || code == OP_EQ || code == OP_NE) && a > b &&
+        !isFallible(compiler, a) && !isFallible(compiler, b)) {
+        int swap = a;
+        a = b;
+        b = swap;
+    }
+    bool fallible = code == OP_DIV && !(rightConst && right != 0.0);
+    return makeOp(compiler, code, fallible, 2, a, b);
+}
+
+// x^e e pow(x, e)
+static int makePower(Compiler* compiler, int base, int exponent) {
+    if (base < 0 || exponent < 0) {
+        return NO_OP;
+    }
+    ScriptCompileStats& stats = compiler->program->stats;
+    double value;
+    if (!isConst(compiler, base) && isConst(compiler, exponent, &value)) {
+        if (value == 1.0) {
+            stats.reduced++;
+            return base;
+        }
+        if (value == 2.0) {
+            stats.reduced++;
+            return makeBinary(compiler, OP_MUL, base, base);
+        }
+        if (value == 3.0) {
+            stats.reduced++;
+            return makeBinary(compiler, OP_MUL, makeBinary(compiler, OP_MUL, base, base), base);
+        }
+        if (value == 4.0) {
+            stats.reduced++;
+            int square = makeBinary(compiler, OP_MUL, base, base);
+            return makeBinary(compiler, OP_MUL, square, square);
+        }
+        if (value == 0.5) {
+            stats.reduced++;
+            return makeUnary(compiler, OP_ROOT, base);
+        }
+        if (value == 0.0 && !isFallible(compiler, base)) {
+            stats.folded++;
+            return makeConst(compiler, 1.0);
+        }
+    }
+    return makeBinary(compiler, OP_POW, base, exponent);
+}
+
+static int makeIf(Compiler* compiler, int condition, int whenTrue, int whenFalse) {
+    if (condition < 0 || whenTrue < 0 || whenFalse < 0) {
+        return NO_OP;
+    }
+    double value;
+    // Os três argumentos são avaliados (como no interpretador): o descartado só sai se não pode falhar
+    if (isConst(compiler, condition, &value)) {
+        int taken = fabs(value) > 0.000001 ? whenTrue : whenFalse;
+        int discarded = taken == whenTrue ? whenFalse : whenTrue;
+        if (!isFallible(compiler, discarded)) {
+            compiler->program->stats.folded++;
+            return taken;
+        }
+    } else if (whenTrue == whenFalse && !isFallible(compiler, condition)) {
+        compiler->program->stats.folded++;
+        return whenTrue;
+    }
+    return makeOp(compiler, OP_IF, false, 3, condition, whenTrue, whenFalse);
+}
+
+static int findVariable(const ScriptProgram* program, const char* name) {
+    for (uint8_t k = 0; k < program->varCount; k++) {
+        if (strcmp(program->varNames[k], name) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static int addVariable(Compiler* compiler, const char* name) {
+    ScriptProgram* program = compiler->program;
+    int index = findVariable(program, name);
+    if (index >= 0 || program->varCount >= SCRIPT_COMPILER_MAX_VARS) {
+        return index;
+    }
+    strncpy(program->varNames[program->varCount], name, 5);
+    program->varNames[program->varCount][5] = '\0';
+    compiler->lastDef[program->varCount] = -1;
+    compiler->readSinceDef[program->varCount] = false;
+    return program->varCount++;
+}
+
+// Leitura de variável: a expressão da última atribuição, se ela sempre executa (SSA);
+// senão o valor guardado, versionado pela atribuição que alcança a leitura
+static int readVariable(Compiler* compiler, const char* name) {
+    int variable = addVariable(compiler, name);
+    if (variable < 0) {
+        return NO_OP;
+    }
+    ScriptProgram* program = compiler->program;
+    compiler->readSinceDef[variable] = true;
+    int16_t definition = compiler->lastDef[variable];
+    if (definition >= 0 && program->lines[definition].mode == SCRIPT_LINE_COMPILED &&
+        !isFallible(compiler, program->lines[definition].root)) {
+        program->stats.forwarded++;
+        return program->lines[definition].root;
+    }
+    return makeOp(compiler, OP_LOAD, true, 2, variable, definition + 1);
+}
+
+// {d[i][j]}: mesmo formato aceito pela substituição (sem espaços), índices válidos
+static int compileDevice(Compiler* compiler) {
+    const char* pos = compiler->pos;
+    if (strncmp(pos, "{d[", 3) != 0) {
+        return NO_OP;
+    }
+    pos += 3;
+    int indices[2];
+    for (int k = 0; k < 2; k++) {
+        if (k == 1) {
+            if (*pos != '[') {
+                return NO_OP;
+            }
+            pos++;
+        }
+        if (!isdigit(*pos)) {
+            return NO_OP;
+        }
+        indices[k] = 0;
+        while (isdigit(*pos)) {
+            indices[k] = indices[k] * 10 + (*pos - '0');
+            if (indices[k] > 9999) {
+                return NO_OP;
+            }
+            pos++;
+        }
+        if (*pos != ']') {
+            return NO_OP;
+        }
+        pos++;
+    }
+    if (*pos != '}') {
+        return NO_OP;
+    }
+    const DeviceValues* shape = compiler->shape;
+    if (indices[0] >= shape->deviceCount || indices[1] >= shape->registerCounts[indices[0]]) {
+        return NO_OP;                      // O interpretador mostra o erro
+    }
+    compiler->pos = pos + 1;
+    return makeOp(compiler, OP_DEVICE, false, 2, indices[0], indices[1]);
+}
+
+// Argumentos de função separados por vírgula até ')'; false se a quantidade não confere
+static bool compileArguments(Compiler* compiler, int* args, int minimum, int maximum, int* count) {
+    *count = 0;
+    while (true) {
+        skipSpaces(compiler);
+        int arg = compileExpression(compiler);
+        if (arg < 0) {
+            return false;
+        }
+        args[(*count)++] = arg;
+        skipSpaces(compiler);
+        if (*compiler->pos == ',' && *count < maximum) {
+            compiler->pos++;
+            continue;
+        }
+        if (*compiler->pos != ')' || *count < minimum) {
+            return false;
+        }
+        compiler->pos++;
+        return true;
+    }
+}
+
+static int compileFunction(Compiler* compiler, const char* name) {
+    int args[4];
+    int count;
+    if (strcmp(name, "if") == 0) {
+        if (!compileArguments(compiler, args, 3, 3, &count)) {
+            return NO_OP;
+        }
+        return makeIf(compiler, args[0], args[1], args[2]);
+    }
+    if (strcmp(name, "display") == 0 || strcmp(name, "disp") == 0) {
+        if (!compileArguments(compiler, args, 3, 4, &count)) {
+            return NO_OP;
+        }
+        int decimal = count == 4 ? args[3] : makeConst(compiler, 0.0);
+        return makeOp(compiler, OP_DISPLAY, true, 4, args[0], args[1], args[2], decimal);
+    }
+    if (strcmp(name, "bcast") == 0) {
+        if (!compileArguments(compiler, args, 2, 2, &count)) {
+            return NO_OP;
+        }
+        return makeOp(compiler, OP_BCAST, true, 2, args[0], args[1]);
+    }
+    if (strcmp(name, "pow") == 0) {
+        if (!compileArguments(compiler, args, 2, 2, &count)) {
+            return NO_OP;
+        }
+        return makePower(compiler, args[0], args[1]);
+    }
+    if (strcmp(name, "ur") == 0) {
+        if (!compileArguments(compiler, args, 2, 2, &count)) {
+            return NO_OP;
+        }
+        return makeOp(compiler, OP_UR, false, 2, args[0], args[1]);
+    }
+
+    static const struct {
+        const char* name;
+        uint8_t code;
+    } unary[] = {
+        { "sin", OP_SIN }, { "cos", OP_COS }, { "tan", OP_TAN }, { "sqrt", OP_SQRT },
+        { "abs", OP_ABS }, { "log", OP_LOG }, { "exp", OP_EXP }
+    };
+    for (size_t k = 0; k < sizeof(unary) / sizeof(unary[0]); k++) {
+        if (strcmp(name, unary[k].name) == 0) {
+            if (!compileArguments(compiler, args, 1, 1, &count)) {
+                return NO_OP;
+            }
+            return makeUnary(compiler, unary[k].code, args[0]);
+        }
+    }
+    return NO_OP;                          // Função desconhecida: o interpretador mostra o erro
+}
+
+// Identificador: função (seguido de '(') ou variável temporária
+static int compileIdentifier(Compiler* compiler) {
+    const char* start = compiler->pos;
+    const char* end = start;
+    while (isalnum(*end) || *end == '_') {
+        end++;
+    }
+    size_t length = end - start;
+    char name[32];
+    if (length >= sizeof(name)) {
+        return NO_OP;
+    }
+    memcpy(name, start, length);
+    name[length] = '\0';
+    compiler->pos = end;
+
+    if (*compiler->pos == '(') {
+        compiler->pos++;
+        return compileFunction(compiler, name);
+    }
+    // "nome (" só é função no interpretador se não há variável com o nome
+    skipSpaces(compiler);
+    if (*compiler->pos == '(' || length > 5) {
+        return NO_OP;                      // Variáveis têm até 5 caracteres
+    }
+    return readVariable(compiler, name);
+}
+
+// Primário, potência e a cadeia de * / % (evalTerm: a direita de cada operador é outro termo)
+static int compileTerm(Compiler* compiler) {
+    int result;
+    skipSpaces(compiler);
+    char c = *compiler->pos;
+
+    if (isdigit(c) || c == '.' || c == '-' || c == '+') {
+        char* end;
+        double value = strtod(compiler->pos, &end);
+        if (end != compiler->pos) {
+            compiler->pos = end;
+            result = makeConst(compiler, value);
+        } else if ((c == '-' || c == '+') && (compiler->pos[1] == '{' || isalpha(compiler->pos[1]) || compiler->pos[1] == '_')) {
+            // Sinal colado em um valor ("2*-x"): no interpretador, o número substituído
+            compiler->pos++;
+            if (compiler->pos[0] == '{') {
+                result = compileDevice(compiler);
+            } else {
+                const char* end = compiler->pos;
+                while (isalnum(*end) || *end == '_') {
+                    end++;
+                }
+                if (*end == '(') {
+                    return NO_OP;          // Função após o sinal: erro no interpretador
+                }
+                result = compileIdentifier(compiler);
+            }
+            if (c == '-') {
+                result = makeUnary(compiler, OP_NEG, result);
+            }
+        } else {
+            return NO_OP;
+        }
+    } else if (c == '(') {
+        compiler->pos++;
+        result = compileExpression(compiler);
+        skipSpaces(compiler);
+        if (result < 0 || *compiler->pos != ')') {
+            return NO_OP;
+        }
+        compiler->pos++;
+    } else if (c == '{') {
+        result = compileDevice(compiler);
+    } else if (isalpha(c) || c == '_') {
+        result = compileIdentifier(compiler);
+    } else {
+        return NO_OP;
+    }
+    if (result < 0) {
+        return NO_OP;
+    }
+
+    skipSpaces(compiler);
+    if (*compiler->pos == '^') {
+        compiler->pos++;
+        result = makePower(compiler, result, compileTerm(compiler));
+        if (result < 0) {
+            return NO_OP;
+        }
+    }
+
+    while (true) {
+        skipSpaces(compiler);
+        char op = *compiler->pos;
+        if (op != '*' && op != '/' && op != '%') {
+            return result;
+        }
+        compiler->pos++;
+        result = makeBinary(compiler, op == '*' ? OP_MUL : op == '/' ? OP_DIV : OP_MOD, result, compileTerm(compiler));
+        if (result < 0) {
+            return NO_OP;
+        }
+    }
+}
+
+// Sinal opcional, termo e a cadeia de + -
+static int compileSum(Compiler* compiler) {
+    skipSpaces(compiler);
+    bool negative = *compiler->pos == '-';
+    if (negative || *compiler->pos == '+') {
+        compiler->pos++;
+    }
+    int result = compileTerm(compiler);
+    if (negative) {
+        result = makeUnary(compiler, OP_NEG, result);
+    }
+    while (result >= 0) {
+        skipSpaces(compiler);
+        char op = *compiler->pos;
+        if (op != '+' && op != '-') {
+            break;
+        }
+        compiler->pos++;
+        result = makeBinary(compiler, op == '+' ? OP_ADD : OP_SUB, result, compileTerm(compiler));
+    }
+    return result;
+}
+
+// Soma com no máximo uma comparação (evalComparison)
+static int compileExpression(Compiler* compiler) {
+    int left = compileSum(compiler);
+    if (left < 0) {
+        return NO_OP;
+    }
+    skipSpaces(compiler);
+    char op1 = *compiler->pos;
+    if (op1 != '>' && op1 != '<' && op1 != '=' && op1 != '!') {
+        return left;
+    }
+    compiler->pos++;
+    bool orEqual = *compiler->pos == '=';
+    if (orEqual) {
+        compiler->pos++;
+    }
+    uint8_t code;
+    if (op1 == '>') {
+        code = orEqual ? OP_GE : OP_GT;
+    } else if (op1 == '<') {
+        code = orEqual ? OP_LE : OP_LT;
+    } else if (orEqual) {
+        code = op1 == '=' ? OP_EQ : OP_NE;
+    } else {
+        return NO_OP;                      // "=" ou "!" sozinho: erro no interpretador
+    }
+    return makeBinary(compiler, code, left, compileSum(compiler));
+}
+
+// Compila a expressão de uma linha; NO_OP se a linha fica com o interpretador
+static int compileLine(Compiler* compiler, const char* expression) {
+    ScriptProgram* program = compiler->program;
+    uint16_t opCount = program->opCount;
+    ScriptCompileStats stats = program->stats;
+    bool readSinceDef[SCRIPT_COMPILER_MAX_VARS];
+    memcpy(readSinceDef, compiler->readSinceDef, sizeof(readSinceDef));
+
+    compiler->pos = expression;
+    int root = compileExpression(compiler);
+    skipSpaces(compiler);
+    if (root >= 0 && *compiler->pos == '\0') {
+        return root;
+    }
+    // Desfaz as operações e contagens da linha
+    program->opCount = opCount;
+    program->stats = stats;
+    memcpy(compiler->readSinceDef, readSinceDef, sizeof(readSinceDef));
+    return NO_OP;
+}
+
+static void defineVariable(Compiler* compiler, int variable, uint16_t lineIndex) {
+    ScriptProgram* program = compiler->program;
+    CompiledLine& line = program->lines[lineIndex];
+    int16_t previous = compiler->lastDef[variable];
+    // Atribuição anterior sobrescrita sem leitura por uma que sempre executa: não precisa calcular
+    if (previous >= 0 && !compiler->readSinceDef[variable] && line.mode == SCRIPT_LINE_COMPILED &&
+        !isFallible(compiler, line.root) && program->lines[previous].mode == SCRIPT_LINE_COMPILED &&
+        !isFallible(compiler, program->lines[previous].root)) {
+        program->lines[previous].mode = SCRIPT_LINE_DEAD;
+        program->stats.compiledLines--;
+        program->stats.deadAssignments++;
+    }
+    compiler->lastDef[variable] = lineIndex;
+    compiler->readSinceDef[variable] = false;
+}
+
+static void compileSourceLine(Compiler* compiler, uint16_t lineIndex, char* text) {
+    ScriptProgram* program = compiler->program;
+    CompiledLine& line = program->lines[lineIndex];
+
+    AssignmentInfo assignmentInfo;
+    if (strlen(text) > 1023 || !parseAssignment(text, &assignmentInfo, nullptr, 0)) {
+        // Erro no destino: o interpretador mostra e a linha não faz nada
+        line.mode = SCRIPT_LINE_INTERPRETED;
+        program->stats.interpretedLines++;
+        return;
+    }
+    line.hasAssignment = assignmentInfo.hasAssignment;
+    line.isVariableAssignment = assignmentInfo.isVariableAssignment;
+    line.targetDeviceIndex = (int16_t)assignmentInfo.targetDeviceIndex;
+    line.targetRegisterIndex = (int16_t)assignmentInfo.targetRegisterIndex;
+    strncpy(line.targetVariable, assignmentInfo.targetVariable, 5);
+    line.targetVariable[5] = '\0';
+    const char* expression = assignmentInfo.hasAssignment ? assignmentInfo.expression : text;
+    line.expressionOffset = (uint16_t)(strlen(text) - strlen(expression));
+
+    int variable = line.isVariableAssignment ? addVariable(compiler, line.targetVariable) : -1;
+    int root = NO_OP;
+    if (!line.isVariableAssignment || variable >= 0) {
+        root = compileLine(compiler, expression);
+    }
+    freeAssignmentInfo(&assignmentInfo);
+
+    if (root >= 0) {
+        line.mode = SCRIPT_LINE_COMPILED;
+        line.root = (uint16_t)root;
+        program->stats.compiledLines++;
+    } else {
+        // O interpretador pode ler qualquer variável
+        line.mode = SCRIPT_LINE_INTERPRETED;
+        program->stats.interpretedLines++;
+        memset(compiler->readSinceDef, true, sizeof(compiler->readSinceDef));
+    }
+    if (variable >= 0) {
+        defineVariable(compiler, variable, lineIndex);
+    }
+}
+
+ScriptProgram* scriptCompile(const char* code, const DeviceValues* shape) {
+    size_t codeLength = strlen(code);
+    uint16_t lineCount = 1;
+    for (const char* p = code; *p; p++) {
+        lineCount += *p == '\n';
+    }
+
+    ScriptProgram* program = new ScriptProgram();
+    Compiler* compiler = new Compiler();
+    char* text = new char[codeLength + 1];
+    // Cada operação consome ao menos um caractere, exceto as das reduções (x^4: duas)
+    compiler->capacity = (uint16_t)(codeLength < 30000 ? codeLength * 2 + 16 : 60000);
+    program->ops = new ScriptOp[compiler->capacity];
+    program->lines = new CompiledLine[lineCount];
+    program->lineCount = lineCount;
+    program->varNames = new char[SCRIPT_COMPILER_MAX_VARS][6];
+    memset(program->lines, 0, sizeof(CompiledLine) * lineCount);
+    compiler->program = program;
+    compiler->shape = shape;
+
+    // Mesma divisão em linhas da execução (runSlice): trim nas pontas, vazias e '#' ignoradas
+    const char* start = code;
+    for (uint16_t k = 0; k < lineCount; k++) {
+        const char* end = strchr(start, '\n');
+        if (end == nullptr) {
+            end = code + codeLength;
+        }
+        const char* first = start;
+        const char* last = end;
+        while (first < last && isspace((unsigned char)*first)) {
+            first++;
+        }
+        while (last > first && isspace((unsigned char)last[-1])) {
+            last--;
+        }
+        if (last > first && *first != '#') {
+            memcpy(text, first, last - first);
+            text[last - first] = '\0';
+            compileSourceLine(compiler, k, text);
+        }
+        start = end + 1;
+    }
+    program->stats.ops = program->opCount;
+
+    // Só o que foi usado fica alocado
+    ScriptOp* ops = new ScriptOp[program->opCount > 0 ? program->opCount : 1];
+    memcpy(ops, program->ops, sizeof(ScriptOp) * program->opCount);
+    delete[] program->ops;
+    program->ops = ops;
+
+    delete[] text;
+    delete compiler;
+    return program;
+}
+
+void scriptProgramFree(ScriptProgram* program) {
+    if (program == nullptr) {
+        return;
+    }
+    delete[] program->ops;
+    delete[] program->lines;
+    delete[] program->varNames;
+    delete program;
+}
+
+void scriptProgramStats(const ScriptProgram* program, ScriptCompileStats* stats) {
+    *stats = program->stats;
+}
+
+const CompiledLine* scriptProgramLine(const ScriptProgram* program, int sourceLine) {
+    if (sourceLine < 1 || sourceLine > program->lineCount) {
+        return nullptr;
+    }
+    return &program->lines[sourceLine - 1];
+}
+
+// ==================== EXECUÇÃO ====================
+
+ScriptProgramState* scriptProgramBegin(const ScriptProgram* program) {
+    ScriptProgramState* state = new ScriptProgramState;
+    uint16_t count = program->opCount > 0 ? program->opCount : 1;
+    state->done = new uint8_t[count];
+    state->values = new double[count];
+    state->varSlots = new int8_t[SCRIPT_COMPILER_MAX_VARS];
+    memset(state->done, 0, count);
+    memset(state->varSlots, -1, SCRIPT_COMPILER_MAX_VARS);
+    return state;
+}
+
+void scriptProgramEnd(ScriptProgramState* state) {
+    if (state == nullptr) {
+        return;
+    }
+    delete[] state->done;
+    delete[] state->values;
+    delete[] state->varSlots;
+    delete state;
+}
+
+struct Evaluation {
+    const ScriptProgram* program;
+    ScriptProgramState* state;
+    const DeviceValues* deviceValues;
+    const Variable* tempVariables;
+    int tempVarCount;
+    char* errorMsg;
+    size_t errorMsgSize;
+};
+
+static bool fail(Evaluation* evaluation, const char* message, const char* detail = nullptr) {
+    if (evaluation->errorMsg && evaluation->errorMsgSize > 0) {
+        snprintf(evaluation->errorMsg, evaluation->errorMsgSize, message, detail);
+    }
+    return false;
+}
+
+// Calcula a operação (uma vez por execução); um erro não fica guardado e
+// se repete, com a mesma mensagem, em quem usar a operação depois
+static bool evaluate(Evaluation* evaluation, uint16_t index, double* result) {
+    ScriptProgramState* state = evaluation->state;
+    if (state->done[index]) {
+        *result = state->values[index];
+        return true;
+    }
+    const ScriptOp& op = evaluation->program->ops[index];
+    double args[4];
+    if (op.code != OP_DEVICE && op.code != OP_LOAD && op.code != OP_CONST) {
+        for (uint8_t k = 0; k < op.argCount; k++) {
+            if (!evaluate(evaluation, op.args[k], &args[k])) {
+                return false;
+            }
+        }
+    }
+
+    double value;
+    switch (op.code) {
+        case OP_CONST:
+            value = op.constant;
+            break;
+        case OP_DEVICE:
+            // 6 casas, como no texto do interpretador: o valor processado vem de float
+            // (0.1 * 603 = 60.2999992...) e a escrita trunca
+            value = evaluation->deviceValues->values[op.args[0]][op.args[1]];
+            if (fabs(value) < 1e9) {
+                value = round(value * 1e6) / 1e6;
+            }
+            break;
+        case OP_LOAD: {
+            int8_t& slot = state->varSlots[op.args[0]];
+            const char* name = evaluation->program->varNames[op.args[0]];
+            if (slot < 0) {
+                for (int k = 0; k < evaluation->tempVarCount; k++) {
+                    if (strcmp(evaluation->tempVariables[k].name, name) == 0) {
+                        slot = (int8_t)k;
+                        break;
+                    }
+                }
+            }
+            if (slot < 0) {
+                return fail(evaluation, "Variavel ou funcao desconhecida: %s", name);
+            }
+            value = evaluation->tempVariables[slot].value;
+            break;
+        }
+        case OP_DIV:
+            if (args[1] == 0.0) {
+                return fail(evaluation, "Divisao por zero");
+            }
+            value = args[0] / args[1];
+            break;
+        case OP_SQRT:
+            if (args[0] < 0) {
+                return fail(evaluation, "Raiz quadrada de numero negativo");
+            }
+            value = sqrt(args[0]);
+            break;
+        case OP_LOG:
+            if (args[0] <= 0) {
+                return fail(evaluation, "Log de numero <= 0");
+            }
+            value = log(args[0]);
+            break;
+        case OP_IF:
+            value = fabs(args[0]) > 0.000001 ? args[1] : args[2];
+            break;
+        case OP_UR:
+            value = psychroRelativeHumidityCurrent(args[0], args[1]);
+            break;
+        case OP_DISPLAY:
+            if (!expressionDisplay(args[0], args[1], args[2], args[3], evaluation->errorMsg, evaluation->errorMsgSize)) {
+                return false;
+            }
+            value = args[0];
+            break;
+        case OP_BCAST:
+            if (!expressionBroadcast(args[0], args[1], evaluation->errorMsg, evaluation->errorMsgSize)) {
+                return false;
+            }
+            value = args[1];
+            break;
+        default:
+            value = op.argCount == 1 ? applyUnary(op.code, args[0]) : applyBinary(op.code, args[0], args[1]);
+            break;
+    }
+    state->values[index] = value;
+    state->done[index] = 1;
+    *result = value;
+    return true;
+}
+
+bool scriptProgramEvaluate(const ScriptProgram* program, ScriptProgramState* state, const CompiledLine* line,
+                           const DeviceValues* deviceValues, const Variable* tempVariables, int tempVarCount,
+                           double* result, char* errorMsg, size_t errorMsgSize) {
+    Evaluation evaluation = { program, state, deviceValues, tempVariables, tempVarCount, errorMsg, errorMsgSize };
+    return evaluate(&evaluation, line->root, result);
+}
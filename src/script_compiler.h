@@ -0,0 +1,121 @@
+/**
+ * @file script_compiler.h
+ * @brief Compilação do código de cálculo: dobra de constantes, subexpressões comuns e redução de custo
+ *
+ * O interpretador (expression_parser.h) refaz a cada execução, em cada linha,
+ * a substituição textual de {d[i][j]} e das variáveis temporárias e a leitura
+ * da expressão resultante. O compilador lê o código uma vez (quando o código
+ * ou a quantidade de dispositivos/registros muda) e gera uma lista de
+ * operações compartilhada pelas linhas:
+ *
+ * - Dobra de constantes: operações só com constantes são calculadas na
+ *   compilação (A = 6.112 e depois A*B viram um número)
+ * - Subexpressões comuns (CSE): a mesma operação sobre os mesmos operandos é
+ *   calculada uma vez por execução, inclusive entre linhas. As variáveis
+ *   temporárias são versionadas (SSA): a leitura de uma variável aponta para
+ *   a expressão da última atribuição a ela; exp((B*ts)/(ts+C)) repetido em
+ *   várias linhas é calculado uma vez
+ * - Redução de custo: x^2 e pow(x, 2) viram x*x (também 3 e 4), x^0.5 vira
+ *   raiz e a divisão por potência de 2 constante vira multiplicação
+ * - Atribuições mortas: uma variável sobrescrita antes de ser lida não é
+ *   calculada (a última atribuição de cada variável sempre é, pois é
+ *   publicada no escravo Modbus)
+ *
+ * A gramática é a do interpretador (inclusive precedência e associatividade)
+ * e as mensagens de erro são as mesmas; if() continua avaliando os três
+ * argumentos. Os valores dos registros entram com 6 casas, como no texto do
+ * interpretador. Diferenças: as variáveis temporárias guardam a precisão
+ * total (o interpretador as reescreve com 6 casas a cada uso) e cada valor é
+ * um operando, então x^2 com x negativo dá o quadrado também no início da
+ * expressão.
+ * Uma linha que o compilador não trata (função desconhecida, destino
+ * inválido, sintaxe que só o texto substituído aceita, ...) é executada pelo
+ * interpretador, como antes.
+ */
+
+#ifndef SCRIPT_COMPILER_H
+#define SCRIPT_COMPILER_H
+
+#include <Arduino.h>
+#include "expression_parser.h"
+
+#define SCRIPT_COMPILER_MAX_VARS 50        // Mesmo limite das variáveis temporárias do interpretador
+
+/**
+ * @brief Como uma linha do código é executada
+ */
+enum ScriptLineMode {
+    SCRIPT_LINE_NONE = 0,                  // Vazia ou comentário
+    SCRIPT_LINE_COMPILED,                  // Expressão compilada
+    SCRIPT_LINE_INTERPRETED,               // O compilador não trata: interpretador
+    SCRIPT_LINE_DEAD                       // Atribuição sobrescrita antes de ser lida: não executa
+};
+
+/**
+ * @struct CompiledLine
+ * @brief Destino e expressão de uma linha compilada
+ */
+struct CompiledLine {
+    uint8_t mode;                          // ScriptLineMode
+    bool hasAssignment;
+    bool isVariableAssignment;
+    char targetVariable[6];                // Variável temporária (5 caracteres, como no interpretador)
+    int16_t targetDeviceIndex;
+    int16_t targetRegisterIndex;
+    uint16_t root;                         // Operação com o valor da expressão
+    uint16_t expressionOffset;             // Início da expressão na linha (mensagens do console)
+};
+
+/**
+ * @struct ScriptCompileStats
+ * @brief Resultado da compilação de um código
+ */
+struct ScriptCompileStats {
+    uint16_t compiledLines;
+    uint16_t interpretedLines;
+    uint16_t deadAssignments;              // Linhas que não executam
+    uint16_t ops;                          // Operações executadas (após as otimizações)
+    uint16_t folded;                       // Operações calculadas na compilação
+    uint16_t shared;                       // Operações reaproveitadas (CSE)
+    uint16_t reduced;                      // Potências e divisões trocadas por multiplicação/raiz
+    uint16_t forwarded;                    // Leituras de variável ligadas direto à expressão atribuída
+};
+
+struct ScriptProgram;
+struct ScriptProgramState;
+
+/**
+ * @brief Compila o código para os dispositivos de shape (quantidade de registros de cada um)
+ * @return Programa (liberar com scriptProgramFree), ou nullptr sem memória
+ */
+ScriptProgram* scriptCompile(const char* code, const DeviceValues* shape);
+
+void scriptProgramFree(ScriptProgram* program);
+
+void scriptProgramStats(const ScriptProgram* program, ScriptCompileStats* stats);
+
+/**
+ * @brief Linha do código (1 = primeira, contando vazias e comentários)
+ * @return nullptr fora do código
+ */
+const CompiledLine* scriptProgramLine(const ScriptProgram* program, int sourceLine);
+
+/**
+ * @brief Estado de uma execução (valores já calculados); um por execução
+ */
+ScriptProgramState* scriptProgramBegin(const ScriptProgram* program);
+void scriptProgramEnd(ScriptProgramState* state);
+
+/**
+ * @brief Avalia a expressão de uma linha compilada
+ *
+ * As variáveis temporárias são lidas de tempVariables (o chamador guarda o
+ * resultado das atribuições, como no interpretador). Os valores dos
+ * dispositivos devem ser os da execução inteira (mesmo snapshot).
+ * @return false com a mensagem em errorMsg (a mesma do interpretador)
+ */
+bool scriptProgramEvaluate(const ScriptProgram* program, ScriptProgramState* state, const CompiledLine* line,
+                           const DeviceValues* deviceValues, const Variable* tempVariables, int tempVarCount,
+                           double* result, char* errorMsg, size_t errorMsgSize);
+
+#endif // SCRIPT_COMPILER_H
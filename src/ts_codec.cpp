@@ -0,0 +1,347 @@
+/**
+ * @file ts_codec.cpp
+ * @brief Implementação da codificação compacta de séries temporais
+ */
+
+#include "ts_codec.h"
+
+// ==================== FLUXO DE BITS (MSB primeiro) ====================
+
+// Grava os n bits menos significativos de value; false se não couber
+static bool writeBits(uint8_t* buffer, uint16_t capacityBits, uint16_t* bitPos, uint32_t value, uint8_t n) {
+    if ((uint32_t)*bitPos + n > capacityBits) {
+        return false;
+    }
+    while (n > 0) {
+        uint16_t byteIndex = *bitPos >> 3;
+        uint8_t bitOffset = *bitPos & 7;
+        uint8_t room = 8 - bitOffset;
+        uint8_t take = (n < room) ? n : room;
+        uint8_t chunk = (uint8_t)((value >> (n - take)) & ((1u << take) - 1));
+        uint8_t shift = room - take;
+        uint8_t mask = (uint8_t)(((1u << take) - 1) << shift);
+        // Sobrescreve os bits (não depende do buffer estar zerado)
+        buffer[byteIndex] = (uint8_t)((buffer[byteIndex] & ~mask) | (chunk << shift));
+        *bitPos += take;
+        n -= take;
+    }
+    return true;
+}
+
+static bool readBits(const uint8_t* buffer, uint16_t sizeBits, uint16_t* bitPos, uint8_t n, uint32_t* value) {
+    if ((uint32_t)*bitPos + n > sizeBits) {
+        return false;
+    }
+    uint32_t result = 0;
+    while (n > 0) {
+        uint16_t byteIndex = *bitPos >> 3;
+        uint8_t bitOffset = *bitPos & 7;
+        uint8_t room = 8 - bitOffset;
+        uint8_t take = (n < room) ? n : room;
+        uint8_t chunk = (uint8_t)((buffer[byteIndex] >> (room - take)) & ((1u << take) - 1));
+        result = (result << take) | chunk;
+        *bitPos += take;
+        n -= take;
+    }
+    *value = result;
+    return true;
+}
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Varint em grupos de 7 bits (bit de continuação antes de cada grupo)
+static bool writeVarint(uint8_t* buffer, uint16_t capacityBits, uint16_t* bitPos, uint32_t value) {
+    do {
+        uint32_t group = value & 0x7F;
+        value >>= 7;
+        if (!writeBits(buffer, capacityBits, bitPos, (value ? 0x80 : 0) | group, 8)) {
+            return false;
+        }
+    } while (value);
+    return true;
+}
+
+static bool readVarint(const uint8_t* buffer, uint16_t sizeBits, uint16_t* bitPos, uint32_t* value) {
+    uint32_t result = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        uint32_t group;
+        if (!readBits(buffer, sizeBits, bitPos, 8, &group)) {
+            return false;
+        }
+        result |= (group & 0x7F) << shift;
+        if ((group & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// ==================== TIMESTAMPS ====================
+
+/**
+ * Delta-of-delta:
+ *   0                      -> '0'
+ *   [-63, 64]              -> '10'   + 7 bits
+ *   [-255, 256]            -> '110'  + 9 bits
+ *   [-2047, 2048]          -> '1110' + 12 bits
+ *   demais (32 bits)       -> '1111' + 32 bits
+ */
+static bool writeTimestamp(TsEncoder* e, uint8_t* buffer, uint16_t capacityBits, int64_t timeMs) {
+    int64_t delta = timeMs - e->prevTimeMs;
+    int64_t dod = delta - e->prevDelta;
+    bool ok;
+
+    if (dod == 0) {
+        ok = writeBits(buffer, capacityBits, &e->bitPos, 0x0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        ok = writeBits(buffer, capacityBits, &e->bitPos, 0x2, 2) &&
+             writeBits(buffer, capacityBits, &e->bitPos, (uint32_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        ok = writeBits(buffer, capacityBits, &e->bitPos, 0x6, 3) &&
+             writeBits(buffer, capacityBits, &e->bitPos, (uint32_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        ok = writeBits(buffer, capacityBits, &e->bitPos, 0xE, 4) &&
+             writeBits(buffer, capacityBits, &e->bitPos, (uint32_t)(dod + 2047), 12);
+    } else if (dod >= INT32_MIN && dod <= INT32_MAX) {
+        ok = writeBits(buffer, capacityBits, &e->bitPos, 0xF, 4) &&
+             writeBits(buffer, capacityBits, &e->bitPos, (uint32_t)(int32_t)dod, 32);
+    } else {
+        ok = false;  // Salto grande demais: o chamador abre um bloco novo
+    }
+
+    if (ok) {
+        e->prevDelta = delta;
+        e->prevTimeMs = timeMs;
+    }
+    return ok;
+}
+
+static bool readTimestamp(TsDecoder* d, const uint8_t* buffer, uint16_t sizeBits, int64_t* timeMs) {
+    uint32_t bit;
+    uint8_t ones = 0;
+    while (ones < 4) {
+        if (!readBits(buffer, sizeBits, &d->bitPos, 1, &bit)) return false;
+        if (bit == 0) break;
+        ones++;
+    }
+
+    int64_t dod = 0;
+    uint32_t raw;
+    switch (ones) {
+        case 0: dod = 0; break;
+        case 1:
+            if (!readBits(buffer, sizeBits, &d->bitPos, 7, &raw)) return false;
+            dod = (int64_t)raw - 63;
+            break;
+        case 2:
+            if (!readBits(buffer, sizeBits, &d->bitPos, 9, &raw)) return false;
+            dod = (int64_t)raw - 255;
+            break;
+        case 3:
+            if (!readBits(buffer, sizeBits, &d->bitPos, 12, &raw)) return false;
+            dod = (int64_t)raw - 2047;
+            break;
+        default:
+            if (!readBits(buffer, sizeBits, &d->bitPos, 32, &raw)) return false;
+            dod = (int32_t)raw;
+            break;
+    }
+
+    d->prevDelta += dod;
+    d->prevTimeMs += d->prevDelta;
+    *timeMs = d->prevTimeMs;
+    return true;
+}
+
+// ==================== VALORES ====================
+
+/**
+ * XOR float (32 bits):
+ *   igual ao anterior                 -> '0'
+ *   cabe na janela anterior           -> '10' + bits significativos
+ *   janela nova                       -> '11' + 5 bits zeros à esquerda
+ *                                        + 5 bits (tamanho - 1) + bits significativos
+ */
+static bool writeFloat(TsEncoder* e, uint8_t* buffer, uint16_t capacityBits, float value) {
+    uint32_t bits = floatBits(value);
+    uint32_t x = bits ^ e->prevBits;
+
+    if (x == 0) {
+        if (!writeBits(buffer, capacityBits, &e->bitPos, 0x0, 1)) return false;
+    } else {
+        uint8_t leading = (uint8_t)__builtin_clz(x);
+        uint8_t trailing = (uint8_t)__builtin_ctz(x);
+        if (leading > 31) leading = 31;
+
+        if (e->prevLeading != 0xFF && leading >= e->prevLeading && trailing >= e->prevTrailing) {
+            uint8_t meaningful = 32 - e->prevLeading - e->prevTrailing;
+            if (!writeBits(buffer, capacityBits, &e->bitPos, 0x2, 2) ||
+                !writeBits(buffer, capacityBits, &e->bitPos, x >> e->prevTrailing, meaningful)) {
+                return false;
+            }
+        } else {
+            uint8_t meaningful = 32 - leading - trailing;
+            if (!writeBits(buffer, capacityBits, &e->bitPos, 0x3, 2) ||
+                !writeBits(buffer, capacityBits, &e->bitPos, leading, 5) ||
+                !writeBits(buffer, capacityBits, &e->bitPos, meaningful - 1, 5) ||
+                !writeBits(buffer, capacityBits, &e->bitPos, x >> trailing, meaningful)) {
+                return false;
+            }
+            e->prevLeading = leading;
+            e->prevTrailing = trailing;
+        }
+    }
+
+    e->prevBits = bits;
+    return true;
+}
+
+static bool readFloat(TsDecoder* d, const uint8_t* buffer, uint16_t sizeBits, float* value) {
+    uint32_t control;
+    if (!readBits(buffer, sizeBits, &d->bitPos, 1, &control)) return false;
+
+    if (control != 0) {
+        if (!readBits(buffer, sizeBits, &d->bitPos, 1, &control)) return false;
+        if (control != 0) {
+            uint32_t leading;
+            uint32_t meaningfulMinusOne;
+            if (!readBits(buffer, sizeBits, &d->bitPos, 5, &leading) ||
+                !readBits(buffer, sizeBits, &d->bitPos, 5, &meaningfulMinusOne)) {
+                return false;
+            }
+            uint32_t meaningful = meaningfulMinusOne + 1;
+            if (leading + meaningful > 32) return false;
+            d->leading = (uint8_t)leading;
+            d->trailing = (uint8_t)(32 - leading - meaningful);
+        } else if (d->leading == 0xFF) {
+            return false;  // Janela reutilizada sem ter sido definida
+        }
+
+        uint8_t meaningful = 32 - d->leading - d->trailing;
+        uint32_t x;
+        if (!readBits(buffer, sizeBits, &d->bitPos, meaningful, &x)) return false;
+        d->prevBits ^= x << d->trailing;
+    }
+
+    *value = bitsFloat(d->prevBits);
+    return true;
+}
+
+// ==================== API ====================
+
+bool tsIsIntegral(float value) {
+    return value >= -2147483520.0f && value <= 2147483520.0f && value == (float)(int32_t)value;
+}
+
+void tsEncoderInit(TsEncoder* encoder, uint8_t encoding, int64_t firstTimeMs) {
+    memset(encoder, 0, sizeof(TsEncoder));
+    encoder->encoding = encoding;
+    encoder->prevLeading = 0xFF;
+    encoder->prevTimeMs = firstTimeMs;
+}
+
+bool tsEncoderAppend(TsEncoder* encoder, uint8_t* buffer, uint16_t capacityBytes, int64_t timeMs, float value) {
+    uint16_t capacityBits = capacityBytes * 8;
+    TsEncoder saved = *encoder;
+    bool ok;
+
+    if (encoder->count == 0) {
+        // Primeira amostra: timestamp é o firstTimeMs do cabeçalho; valor completo
+        ok = (timeMs == encoder->prevTimeMs);
+        if (ok && encoder->encoding == TS_ENCODING_DELTA_VARINT) {
+            int32_t v = (int32_t)value;
+            ok = writeVarint(buffer, capacityBits, &encoder->bitPos, zigzag(v));
+            encoder->prevInt = v;
+        } else if (ok) {
+            encoder->prevBits = floatBits(value);
+            ok = writeBits(buffer, capacityBits, &encoder->bitPos, encoder->prevBits, 32);
+        }
+    } else {
+        ok = writeTimestamp(encoder, buffer, capacityBits, timeMs);
+        if (ok && encoder->encoding == TS_ENCODING_DELTA_VARINT) {
+            int32_t v = (int32_t)value;
+            uint32_t delta = zigzag((int32_t)((uint32_t)v - (uint32_t)encoder->prevInt));
+            if (delta == 0) {
+                ok = writeBits(buffer, capacityBits, &encoder->bitPos, 0x0, 1);
+            } else {
+                ok = writeBits(buffer, capacityBits, &encoder->bitPos, 0x1, 1) &&
+                     writeVarint(buffer, capacityBits, &encoder->bitPos, delta);
+            }
+            encoder->prevInt = v;
+        } else if (ok) {
+            ok = writeFloat(encoder, buffer, capacityBits, value);
+        }
+    }
+
+    if (!ok) {
+        *encoder = saved;
+        return false;
+    }
+    encoder->count++;
+    return true;
+}
+
+void tsDecoderInit(TsDecoder* decoder, uint8_t encoding, int64_t firstTimeMs) {
+    memset(decoder, 0, sizeof(TsDecoder));
+    decoder->encoding = encoding;
+    decoder->leading = 0xFF;
+    decoder->prevTimeMs = firstTimeMs;
+}
+
+bool tsDecoderNext(TsDecoder* decoder, const uint8_t* buffer, uint16_t sizeBytes, int64_t* timeMs, float* value) {
+    uint16_t sizeBits = sizeBytes * 8;
+
+    if (decoder->count == 0) {
+        *timeMs = decoder->prevTimeMs;
+        if (decoder->encoding == TS_ENCODING_DELTA_VARINT) {
+            uint32_t raw;
+            if (!readVarint(buffer, sizeBits, &decoder->bitPos, &raw)) return false;
+            decoder->prevInt = unzigzag(raw);
+            *value = (float)decoder->prevInt;
+        } else {
+            if (!readBits(buffer, sizeBits, &decoder->bitPos, 32, &decoder->prevBits)) return false;
+            *value = bitsFloat(decoder->prevBits);
+        }
+        decoder->count++;
+        return true;
+    }
+
+    if (!readTimestamp(decoder, buffer, sizeBits, timeMs)) {
+        return false;
+    }
+
+    if (decoder->encoding == TS_ENCODING_DELTA_VARINT) {
+        uint32_t flag;
+        if (!readBits(buffer, sizeBits, &decoder->bitPos, 1, &flag)) return false;
+        if (flag) {
+            uint32_t raw;
+            if (!readVarint(buffer, sizeBits, &decoder->bitPos, &raw)) return false;
+            decoder->prevInt = (int32_t)((uint32_t)decoder->prevInt + (uint32_t)unzigzag(raw));
+        }
+        *value = (float)decoder->prevInt;
+    } else if (!readFloat(decoder, buffer, sizeBits, value)) {
+        return false;
+    }
+
+    decoder->count++;
+    return true;
+}
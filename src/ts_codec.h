@@ -0,0 +1,88 @@
+/**
+ * @file ts_codec.h
+ * @brief Codificação compacta de séries temporais (timestamp + valor)
+ *
+ * Timestamps: delta-of-delta em ms com prefixos de tamanho variável.
+ * Valores float: XOR com o valor anterior (bits significativos apenas).
+ * Valores inteiros: delta com o valor anterior em varint zigzag.
+ *
+ * O fluxo de bits é gravado diretamente no payload do bloco do logger. O
+ * estado por canal tem tamanho fixo e a decodificação é amostra a amostra.
+ */
+
+#ifndef TS_CODEC_H
+#define TS_CODEC_H
+
+#include <Arduino.h>
+
+#define TS_ENCODING_GORILLA 1       // Delta-of-delta + XOR float
+#define TS_ENCODING_DELTA_VARINT 2  // Delta-of-delta + delta inteiro em varint
+
+/**
+ * @struct TsEncoder
+ * @brief Estado do codificador de um bloco (tamanho constante)
+ */
+struct TsEncoder {
+    uint8_t encoding;          // TS_ENCODING_*
+    uint8_t prevLeading;       // Janela XOR anterior (0xFF = nenhuma)
+    uint8_t prevTrailing;
+    uint16_t count;            // Amostras codificadas
+    uint16_t bitPos;           // Bits usados no buffer
+    int64_t prevTimeMs;
+    int64_t prevDelta;
+    uint32_t prevBits;         // Float anterior (bits IEEE-754)
+    int32_t prevInt;           // Inteiro anterior
+};
+
+/**
+ * @struct TsDecoder
+ * @brief Estado do decodificador de um bloco (tamanho constante)
+ */
+struct TsDecoder {
+    uint8_t encoding;
+    uint8_t leading;
+    uint8_t trailing;
+    uint16_t count;
+    uint16_t bitPos;
+    int64_t prevTimeMs;
+    int64_t prevDelta;
+    uint32_t prevBits;
+    int32_t prevInt;
+};
+
+/**
+ * @brief Inicia a codificação de um bloco novo
+ * @param firstTimeMs Timestamp da primeira amostra (gravado no cabeçalho do bloco)
+ */
+void tsEncoderInit(TsEncoder* encoder, uint8_t encoding, int64_t firstTimeMs);
+
+/**
+ * @brief Codifica uma amostra no buffer
+ * @return false se a amostra não cabe (estado e contagem ficam inalterados)
+ */
+bool tsEncoderAppend(TsEncoder* encoder, uint8_t* buffer, uint16_t capacityBytes, int64_t timeMs, float value);
+
+/**
+ * @brief Bytes do buffer ocupados pelas amostras codificadas
+ */
+inline uint16_t tsEncoderBytes(const TsEncoder* encoder) {
+    return (encoder->bitPos + 7) / 8;
+}
+
+/**
+ * @brief Inicia a decodificação de um bloco
+ */
+void tsDecoderInit(TsDecoder* decoder, uint8_t encoding, int64_t firstTimeMs);
+
+/**
+ * @brief Decodifica a próxima amostra
+ * @return false se o fluxo terminou ou está corrompido
+ */
+bool tsDecoderNext(TsDecoder* decoder, const uint8_t* buffer, uint16_t sizeBytes, int64_t* timeMs, float* value);
+
+/**
+ * @brief Verifica se um valor pode usar TS_ENCODING_DELTA_VARINT sem perda
+ */
+bool tsIsIntegral(float value);
+
+#endif // TS_CODEC_H
@@ -11,6 +11,20 @@
 #include "console.h"
 #include "expression_parser.h"
 #include "wireguard_manager.h"
+#include "data_logger.h"
+#include "data_rollup.h"
+#include "lttb.h"
+#include "alarm_engine.h"
+#include "pid_control.h"
+#include "reactive_rules.h"
+#include "modbus_queue.h"
+#include "psychrometrics.h"
+#include "modbus_scan.h"
+#include "modbus_autodetect.h"
+#include "device_profiles.h"
+#include "modbus_slave.h"
+#include "bus_capture.h"
+#include "calculations.h"
 #include <ArduinoJson.h>
 #include <ESP.h>
 #include <HardwareSerial.h>
@@ -23,6 +37,7 @@
 // Variáveis globais
 AsyncWebServer server(WEB_SERVER_PORT);
 AsyncWebSocket* consoleWebSocket = nullptr;
+AsyncWebSocket* scanWebSocket = nullptr;
 
 // Controle de conexões simultâneas
 #define MAX_CONCURRENT_CONNECTIONS 4  // Limite de conexões simultâneas (recomendado: 4-5 para ESP32)
@@ -77,6 +92,11 @@ void setupWebServer() {
     initConsoleWebSocket(consoleWebSocket);
     server.addHandler(consoleWebSocket);
     
+    // WebSocket de resultados da busca de dispositivos Modbus
+    scanWebSocket = new AsyncWebSocket("/ws/scan");
+    initScanWebSocket(scanWebSocket);
+    server.addHandler(scanWebSocket);
+    
     // Rota para página principal (interface de configuração)
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
         if (!tryAcquireConnection()) {
@@ -339,6 +359,11 @@ void setupWebServer() {
         releaseConnection();
     });
     
+    // Rota para consultar uma escrita na fila (antes de /api/variable/write, que também casaria com ela)
+    server.on("/api/variable/write/status", HTTP_GET, [](AsyncWebServerRequest *request){
+        handleWriteStatus(request);
+    });
+    
     // Rota para escrever valor de variável
     server.on("/api/variable/write", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
         [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
@@ -395,6 +420,358 @@ void setupWebServer() {
             }
         });
     
+    // Rota para exportação CSV/NDJSON do histórico (antes de /api/history, que também casaria com ela)
+    server.on("/api/history/export", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleHistoryExport(request);
+        releaseConnection();
+    });
+    
+    // Rota para histórico reduzido (LTTB) de um registro
+    server.on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleHistory(request);
+        releaseConnection();
+    });
+    
+    // Rotas de alarmes (as mais específicas antes de /api/alarms, que também casaria com elas)
+    server.on("/api/alarms/events", HTTP_GET, [](AsyncWebServerRequest *request){
+        handleGetAlarmEvents(request);
+    });
+    
+    server.on("/api/alarms/ack", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            handleAckAlarms(request, data, len);
+        });
+    
+    server.on("/api/alarms", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetAlarms(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/alarms", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSaveAlarms(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Rotas dos blocos PID
+    server.on("/api/pid", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetPid(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/pid", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSavePid(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Rotas das regras de reação
+    server.on("/api/rules", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetRules(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/rules", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSaveRules(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Rotas da calibração psicrométrica (as mais específicas antes de /api/psychro)
+    server.on("/api/psychro/capture", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            handlePsychroCapture(request, data, len);
+        });
+    
+    server.on("/api/psychro/fit", HTTP_POST, [](AsyncWebServerRequest *request){
+        handlePsychroFit(request);
+    });
+    
+    server.on("/api/psychro", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetPsychro(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/psychro", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSavePsychro(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Rotas da busca de dispositivos Modbus (a mais específica antes de /api/modbus/scan)
+    server.on("/api/modbus/scan/cancel", HTTP_POST, [](AsyncWebServerRequest *request){
+        handleCancelModbusScan(request);
+    });
+    
+    server.on("/api/modbus/scan", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetModbusScan(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/modbus/scan", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            handleStartModbusScan(request, data, len);
+        });
+    
+    // Rotas da detecção automática de velocidade e enquadramento
+    server.on("/api/modbus/autodetect", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetModbusAutodetect(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/modbus/autodetect", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            handleStartModbusAutodetect(request, data, len);
+        });
+    
+    // Rotas dos perfis de dispositivo (as mais específicas antes de /api/profiles)
+    server.on("/api/profiles/get", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetProfile(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/profiles/delete", HTTP_POST, [](AsyncWebServerRequest *request){
+        handleDeleteProfile(request);
+    });
+    
+    server.on("/api/profiles", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetProfiles(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/profiles", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSaveProfile(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Rotas do escravo Modbus (segunda UART)
+    server.on("/api/modbus/slave", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetModbusSlave(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/modbus/slave", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSaveModbusSlave(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Rotas da captura do barramento (diagnóstico)
+    server.on("/api/capture", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetBusCapture(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/capture/pcap", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleBusCapturePcap(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/capture", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSaveBusCapture(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Scripts nomeados (período, leitura de registro ou alarme)
+    server.on("/api/scripts", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetScripts(request);
+        releaseConnection();
+    });
+    
+    server.on("/api/scripts", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+            // Acumula o body, que pode chegar em partes
+            if (index == 0) {
+                request->_tempObject = new String();
+                ((String*)request->_tempObject)->reserve(total + 1);
+            }
+            String* bodyBuffer = (String*)request->_tempObject;
+            if (!bodyBuffer) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                *bodyBuffer += (char)data[i];
+            }
+            if (index + len >= total) {
+                handleSaveScripts(request, (uint8_t*)bodyBuffer->c_str(), bodyBuffer->length());
+                delete bodyBuffer;
+                request->_tempObject = nullptr;
+            }
+        });
+    
+    // Custo do código de cálculo por linha (aviso de script que não cabe no ciclo)
+    server.on("/api/script/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!tryAcquireConnection()) {
+            request->send(503, "application/json", "{\"error\":\"Servidor ocupado. Limite de " + String(MAX_CONCURRENT_CONNECTIONS) + " conexoes simultaneas atingido. Tente novamente em alguns instantes.\"}");
+            return;
+        }
+        handleGetScriptStats(request);
+        releaseConnection();
+    });
+    
     // Inicia o servidor web
     server.begin();
     
@@ -463,6 +840,9 @@ void handleGetConfig(AsyncWebServerRequest *request) {
     
     // Adiciona código de cálculo
     doc["calculationCode"] = String(config.calculationCode);
+    doc["alignSamples"] = config.alignSamples;
+    doc["syncWrites"] = config.syncWrites;
+    doc["scriptSliceMs"] = config.scriptSliceMs;
     
     JsonArray devicesArray = doc.createNestedArray("devices");
     
@@ -471,6 +851,7 @@ void handleGetConfig(AsyncWebServerRequest *request) {
         deviceObj["slaveAddress"] = config.devices[i].slaveAddress;
         deviceObj["enabled"] = config.devices[i].enabled;
         deviceObj["deviceName"] = String(config.devices[i].deviceName);
+        deviceObj["profile"] = String(config.devices[i].profile);
         
         JsonArray registersArray = deviceObj.createNestedArray("registers");
         
@@ -492,6 +873,8 @@ void handleGetConfig(AsyncWebServerRequest *request) {
             regObj["writeRegisterCount"] = config.devices[i].registers[j].writeRegisterCount;
             regObj["registerType"] = config.devices[i].registers[j].registerType;
             regObj["registerCount"] = config.devices[i].registers[j].registerCount;
+            regObj["sampleGroup"] = config.devices[i].registers[j].sampleGroup;
+            regObj["dataType"] = config.devices[i].registers[j].dataType;
         }
         
         // IMPORTANTE: registerCount baseado no tamanho real do array
@@ -788,6 +1171,15 @@ void handleSaveConfig(AsyncWebServerRequest *request, uint8_t *data, size_t len)
         strncpy(config.calculationCode, code, sizeof(config.calculationCode) - 1);
         config.calculationCode[sizeof(config.calculationCode) - 1] = '\0';
     }
+    if (doc.containsKey("alignSamples")) {
+        config.alignSamples = doc["alignSamples"] | false;
+    }
+    if (doc.containsKey("syncWrites")) {
+        config.syncWrites = doc["syncWrites"] | false;
+    }
+    if (doc.containsKey("scriptSliceMs")) {
+        config.scriptSliceMs = (uint16_t)constrain((int)(doc["scriptSliceMs"] | 0), 0, CALCULATION_INTERVAL_MS);
+    }
     
     config.deviceCount = doc["deviceCount"] | 0;
     if (config.deviceCount > MAX_DEVICES) {
@@ -824,6 +1216,11 @@ void handleSaveConfig(AsyncWebServerRequest *request, uint8_t *data, size_t len)
         strncpy(config.devices[i].deviceName, devName, sizeof(config.devices[i].deviceName) - 1);
         config.devices[i].deviceName[sizeof(config.devices[i].deviceName) - 1] = '\0';
         
+        // Perfil de dispositivo (vazio = sem perfil)
+        const char* profileName = deviceObj["profile"] | "";
+        strncpy(config.devices[i].profile, profileName, sizeof(config.devices[i].profile) - 1);
+        config.devices[i].profile[sizeof(config.devices[i].profile) - 1] = '\0';
+        
         // Verifica se há array de registros
         if (!deviceObj.containsKey("registers") || !deviceObj["registers"].is<JsonArray>()) {
             Serial.print("[Config] AVISO: Array de registros nao encontrado para dispositivo ");
@@ -868,6 +1265,8 @@ void handleSaveConfig(AsyncWebServerRequest *request, uint8_t *data, size_t len)
             // IMPORTANTE: Inicializa valor com 0 mesmo sem leitura do dispositivo
             // Isso garante que a variável existe e pode ser usada nas expressões
             config.devices[i].registers[j].value = 0;
+            config.devices[i].registers[j].typedRaw = 0.0f;
+            config.devices[i].registers[j].sampleTimeUs = 0;
             
             // Carrega nome da variável
             const char* varName = regObj["variableName"] | "";
@@ -955,6 +1354,12 @@ void handleSaveConfig(AsyncWebServerRequest *request, uint8_t *data, size_t len)
                 config.devices[i].registers[j].registerCount = config.devices[i].registers[j].writeRegisterCount;
             }
             
+            // Carrega sampleGroup (padrão: 0 - sem grupo)
+            config.devices[i].registers[j].sampleGroup = regObj["sampleGroup"] | 0;
+            
+            // Carrega dataType (padrão: uint16)
+            config.devices[i].registers[j].dataType = regObj["dataType"] | REGISTER_DATA_UINT16;
+            
             Serial.print("[Config]   Registro ");
             Serial.print(j);
             Serial.print(": endereco=");
@@ -1074,6 +1479,9 @@ void handleReboot(AsyncWebServerRequest *request) {
         Serial.println("AVISO: Falha ao salvar configuração antes do reboot");
     }
     
+    // Grava blocos do histórico ainda em RAM
+    dataLoggerFlush();
+    
     // Envia resposta imediata para o cliente
     request->send(200, "application/json", "{\"status\":\"ok\",\"message\":\"Configuracao salva! Reiniciando em 10 segundos...\"}");
     
@@ -1202,14 +1610,11 @@ void handleSetTime(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
         }
         
         if (epochTime > 0) {
-            config.rtc.epochTime = epochTime;
-            config.rtc.bootTime = millis();
+            rtcSetEpoch(epochTime);
             
             // Salva na configuração
             (void)saveConfig(); // Ignora retorno neste contexto
             
-            rtcInitialized = true;
-            
             Serial.print("Data/hora configurada: ");
             Serial.println(epochTime);
             
@@ -1726,6 +2131,7 @@ void handleGetVariables(AsyncWebServerRequest *request) {
     for (int i = 0; i < config.deviceCount && i < MAX_DEVICES; i++) {
         JsonObject deviceObj = devicesArray.createNestedObject();
         deviceObj["deviceName"] = String(config.devices[i].deviceName);
+        deviceObj["profile"] = String(config.devices[i].profile);
         deviceObj["slaveAddress"] = config.devices[i].slaveAddress;
         
         JsonArray registersArray = deviceObj.createNestedArray("registers");
@@ -1733,10 +2139,10 @@ void handleGetVariables(AsyncWebServerRequest *request) {
         for (int j = 0; j < config.devices[i].registerCount && j < MAX_REGISTERS_PER_DEVICE; j++) {
             JsonObject reg = registersArray.createNestedObject();
             
-            reg["valueRaw"] = config.devices[i].registers[j].value;  // Valor raw do Modbus
+            reg["valueRaw"] = registerRawValue(config.devices[i].registers[j]);  // Valor raw do Modbus (decodificado conforme dataType)
             
             // Calcula valor processado (com gain e offset)
-            float rawValue = (float)config.devices[i].registers[j].value;
+            float rawValue = registerRawValue(config.devices[i].registers[j]);
             float processedValue = (rawValue * config.devices[i].registers[j].gain) + config.devices[i].registers[j].offset;
             
             // Se o filtro de Kalman está habilitado e inicializado, usa o valor do Kalman
@@ -1749,6 +2155,23 @@ void handleGetVariables(AsyncWebServerRequest *request) {
             reg["value"] = processedValue;  // Valor processado usado nas expressões (com Kalman se habilitado)
             reg["kalmanEnabled"] = config.devices[i].registers[j].kalmanEnabled;
             
+            // Instante da recepção: µs monotônicos e, com RTC válido, ms UTC (double é exato até 2^53)
+            int64_t sampleTimeUs = config.devices[i].registers[j].sampleTimeUs;
+            int64_t sampleUtcUs = sampleTimeUs > 0 ? monotonicToUtcMicros(sampleTimeUs) : 0;
+            reg["sampleTimeUs"] = (double)sampleTimeUs;
+            reg["sampleUtcMs"] = (double)(sampleUtcUs / 1000);
+            
+            // Desvio de aquisição em relação ao tick do ciclo e grupo de amostragem
+            reg["sampleGroup"] = config.devices[i].registers[j].sampleGroup;
+            reg["dataType"] = config.devices[i].registers[j].dataType;
+            reg["sampleOffsetUs"] = sampleTimeUs > 0 ? sampleTimings[i][j].offsetUs : 0;
+            if (config.alignSamples) {
+                float alignedValue;
+                if (interpolatedSample(i, j, g_cycleTickUs, &alignedValue)) {
+                    reg["alignedValue"] = alignedValue;
+                }
+            }
+            
             reg["gain"] = config.devices[i].registers[j].gain;
             reg["offset"] = config.devices[i].registers[j].offset;
             reg["address"] = config.devices[i].registers[j].address;
@@ -1765,6 +2188,8 @@ void handleGetVariables(AsyncWebServerRequest *request) {
     // Adiciona informações sobre a estrutura
     doc["structure"] = "d[deviceIndex][registerIndex]";
     doc["deviceCount"] = config.deviceCount;
+    doc["cycleTickUs"] = (double)g_cycleTickUs;
+    doc["alignSamples"] = config.alignSamples;
     
     String response;
     serializeJson(doc, response);
@@ -1830,6 +2255,9 @@ void handleExportConfig(AsyncWebServerRequest *request) {
     
     // Adiciona código de cálculo
     doc["calculationCode"] = String(config.calculationCode);
+    doc["alignSamples"] = config.alignSamples;
+    doc["syncWrites"] = config.syncWrites;
+    doc["scriptSliceMs"] = config.scriptSliceMs;
     
     JsonArray devicesArray = doc.createNestedArray("devices");
     
@@ -1838,6 +2266,7 @@ void handleExportConfig(AsyncWebServerRequest *request) {
         deviceObj["slaveAddress"] = config.devices[i].slaveAddress;
         deviceObj["enabled"] = config.devices[i].enabled;
         deviceObj["deviceName"] = String(config.devices[i].deviceName);
+        deviceObj["profile"] = String(config.devices[i].profile);
         
         JsonArray registersArray = deviceObj.createNestedArray("registers");
         
@@ -1858,6 +2287,8 @@ void handleExportConfig(AsyncWebServerRequest *request) {
             regObj["writeRegisterCount"] = config.devices[i].registers[j].writeRegisterCount;
             regObj["registerType"] = config.devices[i].registers[j].registerType;
             regObj["registerCount"] = config.devices[i].registers[j].registerCount;
+            regObj["sampleGroup"] = config.devices[i].registers[j].sampleGroup;
+            regObj["dataType"] = config.devices[i].registers[j].dataType;
         }
         
         // IMPORTANTE: registerCount baseado no tamanho real do array
@@ -2049,6 +2480,9 @@ void handleImportConfig(AsyncWebServerRequest *request, uint8_t *data, size_t le
             strncpy(config.calculationCode, code, sizeof(config.calculationCode) - 1);
             config.calculationCode[sizeof(config.calculationCode) - 1] = '\0';
         }
+        config.alignSamples = doc["alignSamples"] | false;
+        config.syncWrites = doc["syncWrites"] | false;
+        config.scriptSliceMs = (uint16_t)constrain((int)(doc["scriptSliceMs"] | 0), 0, CALCULATION_INTERVAL_MS);
         
         config.deviceCount = doc["deviceCount"] | 0;
         if (config.deviceCount > MAX_DEVICES) {
@@ -2076,6 +2510,11 @@ void handleImportConfig(AsyncWebServerRequest *request, uint8_t *data, size_t le
             strncpy(config.devices[i].deviceName, devName, sizeof(config.devices[i].deviceName) - 1);
             config.devices[i].deviceName[sizeof(config.devices[i].deviceName) - 1] = '\0';
             
+            // Perfil de dispositivo (vazio = sem perfil)
+            const char* profileName = deviceObj["profile"] | "";
+            strncpy(config.devices[i].profile, profileName, sizeof(config.devices[i].profile) - 1);
+            config.devices[i].profile[sizeof(config.devices[i].profile) - 1] = '\0';
+            
             // Verifica se há array de registros
             if (!deviceObj.containsKey("registers") || !deviceObj["registers"].is<JsonArray>()) {
                 Serial.print("AVISO: Array de registros nao encontrado para dispositivo ");
@@ -2107,6 +2546,8 @@ void handleImportConfig(AsyncWebServerRequest *request, uint8_t *data, size_t le
                 // IMPORTANTE: Inicializa valor com 0 mesmo sem leitura do dispositivo
                 // Isso garante que a variável existe e pode ser usada nas expressões
                 config.devices[i].registers[j].value = 0;
+                config.devices[i].registers[j].typedRaw = 0.0f;
+                config.devices[i].registers[j].sampleTimeUs = 0;
                 
                 const char* varName = regObj["variableName"] | "";
                 strncpy(config.devices[i].registers[j].variableName, varName, sizeof(config.devices[i].registers[j].variableName) - 1);
@@ -2192,6 +2633,12 @@ void handleImportConfig(AsyncWebServerRequest *request, uint8_t *data, size_t le
                     // Usa writeRegisterCount se registerCount não existir (migração)
                     config.devices[i].registers[j].registerCount = config.devices[i].registers[j].writeRegisterCount;
                 }
+                
+                // Carrega sampleGroup (padrão: 0 - sem grupo)
+                config.devices[i].registers[j].sampleGroup = regObj["sampleGroup"] | 0;
+                
+                // Carrega dataType (padrão: uint16)
+                config.devices[i].registers[j].dataType = regObj["dataType"] | REGISTER_DATA_UINT16;
             }
         }
         
@@ -2296,7 +2743,7 @@ void handleTestCalculation(AsyncWebServerRequest *request, uint8_t *data, size_t
             
             for (int j = 0; j < config.devices[i].registerCount; j++) {
                 // Aplica gain e offset: valor_processado = (valor_raw * gain) + offset
-                float rawValue = (float)config.devices[i].registers[j].value;
+                float rawValue = registerRawValue(config.devices[i].registers[j]);
                 float processedValue = (rawValue * config.devices[i].registers[j].gain) + config.devices[i].registers[j].offset;
                 deviceValues.values[i][j] = (double)processedValue;
             }
@@ -2493,6 +2940,34 @@ void handleTestCalculation(AsyncWebServerRequest *request, uint8_t *data, size_t
     }
 }
 
+// Resultado de uma escrita concluída, com os instantes em que chegou ao escravo
+static void sendWriteTicket(AsyncWebServerRequest *request, const ModbusWriteTicket& ticket) {
+    DynamicJsonDocument doc(512);
+    doc["id"] = ticket.id;
+    doc["queueWaitMs"] = (ticket.startedUs - ticket.queuedUs) / 1000.0;
+    doc["transactionMs"] = (ticket.completedUs - ticket.startedUs) / 1000.0;
+    // Instante da resposta do escravo (UTC, ms); null sem relógio ajustado
+    int64_t completedUtcUs = monotonicToUtcMicros(ticket.completedUs);
+    if (completedUtcUs > 0) {
+        doc["completedAt"] = (double)(completedUtcUs / 1000);
+    } else {
+        doc["completedAt"] = nullptr;
+    }
+    
+    int status;
+    if (ticket.result == node.ku8MBSuccess) {
+        doc["status"] = "ok";
+        doc["message"] = "Valor escrito com sucesso";
+        status = 200;
+    } else {
+        doc["error"] = modbusResultDescription(ticket.result);
+        status = 500;
+    }
+    String response;
+    serializeJson(doc, response);
+    request->send(status, "application/json", response);
+}
+
 void handleWriteVariable(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
     if (!data || len == 0) {
         request->send(400, "application/json", "{\"error\":\"Dados não fornecidos\"}");
@@ -2530,7 +3005,7 @@ void handleWriteVariable(AsyncWebServerRequest *request, uint8_t *data, size_t l
     
     // Verifica se o registro pode ser escrito baseado no registerType
     uint8_t registerType = config.devices[deviceIndex].registers[registerIndex].registerType;
-    bool canWrite = (registerType == 1 || registerType == 2); // Escrita ou Leitura e Escrita
+    bool canWrite = (registerType == 1 || registerType == 2 || registerType == REGISTER_TYPE_COIL); // Escrita, Leitura e Escrita ou Bobina
     
     // Compatibilidade: verifica campos antigos se registerType não estiver definido
     if (registerType == 0) {
@@ -2548,6 +3023,13 @@ void handleWriteVariable(AsyncWebServerRequest *request, uint8_t *data, size_t l
         return;
     }
     
+    // Saída de um bloco PID habilitado: o bloco reescreveria o valor no próximo período
+    // (para fixar a saída, use o modo manual do bloco ou desabilite-o)
+    if (pidOwnsRegister(config.devices[deviceIndex].slaveAddress, config.devices[deviceIndex].registers[registerIndex].address)) {
+        request->send(409, "application/json", "{\"error\":\"Registro controlado por bloco PID habilitado\"}");
+        return;
+    }
+    
     // Calcula valor raw (transformação inversa: raw = (value - offset) / gain)
     float gain = config.devices[deviceIndex].registers[registerIndex].gain;
     float offset = config.devices[deviceIndex].registers[registerIndex].offset;
@@ -2557,83 +3039,57 @@ void handleWriteVariable(AsyncWebServerRequest *request, uint8_t *data, size_t l
         return;
     }
     
+    const ModbusRegister& reg = config.devices[deviceIndex].registers[registerIndex];
     float rawValue = (value - offset) / gain;
-    uint32_t rawValueInt = (uint32_t)round(rawValue);  // Mudado para uint32_t para suportar valores maiores
+    if ((reg.dataType & REGISTER_DATA_TYPE_MASK) != REGISTER_DATA_FLOAT32) rawValue = round(rawValue);
+    
+    // Palavras no tipo de dado do registro (tipos de 32 bits sempre em 0x10 com as duas palavras)
+    uint16_t words[2];
+    uint8_t wordCount = encodeRegisterWords(reg.dataType, rawValue, words);
+    uint32_t rawValueInt = wordCount == 2 ? ((uint32_t)words[0] << 16) | words[1] : words[0];
     
-    // Escreve no Modbus
+    // Escreve no Modbus pela fila: o loop executa na próxima fronteira entre quadros
     uint8_t slaveAddr = config.devices[deviceIndex].slaveAddress;
-    uint16_t regAddr = config.devices[deviceIndex].registers[registerIndex].address;
-    uint8_t registerCount = config.devices[deviceIndex].registers[registerIndex].registerCount;
+    uint16_t regAddr = reg.address;
+    uint8_t registerCount = wordCount == 2 ? 2 : reg.registerCount;
     if (registerCount == 0) registerCount = 1; // Garante mínimo de 1
+    if (registerType == REGISTER_TYPE_COIL) {
+        // Bobina: 0x05 com o valor booleano (sem gain/offset)
+        registerCount = 0;
+        rawValueInt = value != 0.0f ? 1 : 0;
+    }
     
-    // CRÍTICO: Yield antes de operação Modbus para manter webserver responsivo
-    yield();
-    
-    node.begin(slaveAddr, Serial2);
-    uint8_t result = node.ku8MBSuccess;
+    uint32_t writeId = modbusQueueWrite(MODBUS_PRIORITY_OPERATOR, slaveAddr, regAddr, registerCount, rawValueInt);
+    if (writeId == 0) {
+        request->send(503, "application/json", "{\"error\":\"Fila de escrita cheia. Tente novamente em alguns instantes.\"}");
+        return;
+    }
     
-    // Determina função Modbus automaticamente baseado na quantidade de registros
-    // Padrão Modbus: 0x06 para 1 registrador, 0x10 para múltiplos
-    if (registerCount == 1) {
-        // Write Single Register (0x06)
-        result = node.writeSingleRegister(regAddr, (uint16_t)(rawValueInt & 0xFFFF));
-    } else {
-        // Write Multiple Registers (0x10)
-        // Divide o valor inteiro em múltiplos registros (16 bits cada)
-        // O valor mais significativo vai no primeiro registrador
-        for (int i = registerCount - 1; i >= 0; i--) {
-            uint16_t regValue = (rawValueInt >> (i * 16)) & 0xFFFF;
-            node.setTransmitBuffer((registerCount - 1) - i, regValue);
-        }
-        result = node.writeMultipleRegisters(regAddr, registerCount);
+    // Resultado em /api/variable/write/status: esperar aqui travaria o AsyncTCP
+    request->send(202, "application/json", "{\"status\":\"queued\",\"id\":" + String(writeId) +
+                  ",\"message\":\"Escrita na fila; consulte /api/variable/write/status?id=" + String(writeId) + "\"}");
+}
+
+void handleWriteStatus(AsyncWebServerRequest *request) {
+    uint32_t writeId = 0;
+    if (request->hasParam("id")) {
+        writeId = (uint32_t)strtoul(request->getParam("id")->value().c_str(), nullptr, 10);
+    }
+    ModbusWriteTicket ticket;
+    if (!modbusQueueStatus(writeId, &ticket)) {
+        request->send(404, "application/json", "{\"error\":\"Escrita desconhecida ou expirada\"}");
+        return;
+    }
+    if (ticket.state == MODBUS_WRITE_PENDING) {
+        request->send(202, "application/json", "{\"status\":\"queued\",\"id\":" + String(writeId) +
+                      ",\"queuedMs\":" + String((uint32_t)((monotonicMicros() - ticket.queuedUs) / 1000)) + "}");
+        return;
     }
-    
-    // CRÍTICO: Yield após operação Modbus para manter webserver responsivo
-    yield();
-    
-    if (result == node.ku8MBSuccess) {
-        // Atualiza valor na configuração (armazena apenas os 16 bits menos significativos)
-        config.devices[deviceIndex].registers[registerIndex].value = (uint16_t)(rawValueInt & 0xFFFF);
-        
-        String logMsg = "[Modbus] Escrito Dev " + String(slaveAddr) + 
-                       " Reg " + String(regAddr);
-        
-        if (registerCount > 1) {
-            logMsg += " (funcao 0x10, " + String(registerCount) + " registros)";
-        } else {
-            logMsg += " (funcao 0x06)";
-        }
-        
-        logMsg += ": " + String(value, 2) + 
-                  " (raw: " + String(rawValueInt) + ")\r\n";
-        consolePrint(logMsg);
-        
-        request->send(200, "application/json", "{\"status\":\"ok\",\"message\":\"Valor escrito com sucesso\"}");
-    } else {
-        String errorDesc = "Erro desconhecido";
-        switch(result) {
-            case 0x01: errorDesc = "Funcao ilegal"; break;
-            case 0x02: errorDesc = "Endereco de dados ilegal"; break;
-            case 0x03: errorDesc = "Valor de dados ilegal"; break;
-            case 0x04: errorDesc = "Falha no dispositivo escravo"; break;
-            case 0xE1: errorDesc = "Timeout"; break;
-            case 0xE2: errorDesc = "Resposta invalida"; break;
-            case 0xE3: errorDesc = "Checksum invalido"; break;
-            case 0xE4: errorDesc = "Excecao Modbus"; break;
-            default: errorDesc = "Codigo: 0x" + String(result, HEX); break;
-        }
-        
-        String logMsg = "[Modbus ERRO] Escrita Dev " + String(slaveAddr) + 
-                       " Reg " + String(regAddr) + 
-                       ": " + errorDesc + "\r\n";
-        consolePrint(logMsg);
-        
-        request->send(500, "application/json", "{\"error\":\"" + errorDesc + "\"}");
-    }
-}
-
-void handleListFiles(AsyncWebServerRequest *request) {
-    Serial.println("[Filesystem] Listando arquivos...");
+    sendWriteTicket(request, ticket);
+}
+
+void handleListFiles(AsyncWebServerRequest *request) {
+    Serial.println("[Filesystem] Listando arquivos...");
     
     if (!LittleFS.begin(true)) {
         Serial.println("[Filesystem] ERRO: Falha ao montar LittleFS");
@@ -2845,3 +3301,1498 @@ void handleDeleteFile(AsyncWebServerRequest *request, uint8_t *data, size_t len)
         request->send(500, "application/json", "{\"error\":\"Falha ao deletar arquivo\"}");
     }
 }
+
+/**
+ * @struct StreamLine
+ * @brief Trecho formatado de uma resposta gerada em partes (buffer de tamanho fixo)
+ */
+struct StreamLine {
+    char text[192];
+    uint16_t length;
+    uint16_t position;
+};
+
+// Formata o próximo trecho em line; false quando a resposta terminou
+typedef bool (*StreamNextLineFn)(void* context, StreamLine* line);
+
+static inline void streamLineSet(StreamLine* line, int length) {
+    line->length = length > 0 ? (uint16_t)(length < (int)sizeof(line->text) ? length : sizeof(line->text) - 1) : 0;
+    line->position = 0;
+}
+
+// Copia trechos para o buffer da resposta até enchê-lo ou a resposta terminar
+static size_t streamFill(StreamLine* line, StreamNextLineFn nextLine, void* context, uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (line->position >= line->length && !nextLine(context, line)) {
+            break;
+        }
+        size_t chunk = line->length - line->position;
+        if (chunk > maxLen - written) {
+            chunk = maxLen - written;
+        }
+        memcpy(buffer + written, line->text + line->position, chunk);
+        line->position += chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+/**
+ * @struct HistoryCursor
+ * @brief Leitura do histórico entregue ao LTTB
+ *
+ * Registros de rollup viram dois pontos (mínimo e máximo do intervalo) para
+ * que picos sobrevivam à redução; a média sozinha os apagaria.
+ */
+struct HistoryCursor {
+    DataLogReader reader;
+    uint32_t halfResolutionMs;  // 0 = amostras brutas
+    bool hasPending;
+    LttbPoint pending;
+};
+
+/**
+ * @struct HistoryStream
+ * @brief Estado da resposta de /api/history entre chamadas do preenchimento em partes
+ */
+struct HistoryStream {
+    HistoryCursor mainCursor;
+    HistoryCursor leadCursor;
+    LttbState lttb;
+    StreamLine line;
+    uint8_t stage;             // 0 = cabeçalho, 1 = pontos, 2 = rodapé, 3 = fim
+    uint32_t points;
+    uint8_t store;
+    int64_t fromMs;
+    int64_t toMs;
+    int16_t slaveAddress;
+    int32_t registerAddress;
+};
+
+static bool historyReadPoint(void* context, LttbPoint* point) {
+    HistoryCursor* cursor = (HistoryCursor*)context;
+    if (cursor->hasPending) {
+        cursor->hasPending = false;
+        *point = cursor->pending;
+        return true;
+    }
+
+    DataLogSample sample;
+    if (!dataLogReaderNext(&cursor->reader, &sample)) {
+        return false;
+    }
+    point->timeMs = sample.timeMs;
+    point->value = sample.value;
+
+    if (cursor->halfResolutionMs > 0) {
+        // A ordem real de mínimo e máximo no intervalo não é registrada
+        point->value = sample.minValue;
+        if (sample.maxValue != sample.minValue) {
+            cursor->pending.timeMs = sample.timeMs + cursor->halfResolutionMs;
+            cursor->pending.value = sample.maxValue;
+            cursor->hasPending = true;
+        }
+    }
+    return true;
+}
+
+static void historyCursorBegin(HistoryCursor* cursor, HistoryStream* stream, uint32_t resolutionMs) {
+    dataLogReaderBegin(&cursor->reader, stream->fromMs, stream->toMs, stream->slaveAddress, stream->registerAddress, stream->store);
+    cursor->halfResolutionMs = resolutionMs / 2;
+    cursor->hasPending = false;
+}
+
+static uint32_t historyResolutionMs(uint8_t store) {
+    return store == DATALOG_STORE_RAW ? 0 : ROLLUP_LEVELS[store - DATALOG_STORE_ROLLUP_FIRST].resolutionMs;
+}
+
+// Formata o próximo trecho do JSON de /api/history
+static bool historyNextLine(void* context, StreamLine* line) {
+    HistoryStream* stream = (HistoryStream*)context;
+    int length = 0;
+    if (stream->stage == 0) {
+        uint32_t resolutionMs = historyResolutionMs(stream->store);
+        length = snprintf(line->text, sizeof(line->text),
+                          "{\"slave\":%d,\"register\":%ld,\"store\":%u,\"resolutionMs\":%lu,\"from\":%lld,\"to\":%lld,\"points\":[",
+                          stream->slaveAddress, (long)stream->registerAddress, stream->store, (unsigned long)resolutionMs,
+                          (long long)stream->fromMs, (long long)stream->toMs);
+        stream->stage = 1;
+    } else if (stream->stage == 1) {
+        LttbPoint point;
+        if (lttbNext(&stream->lttb, &point)) {
+            const char* separator = stream->points > 0 ? "," : "";
+            if (isnan(point.value) || isinf(point.value)) {
+                length = snprintf(line->text, sizeof(line->text), "%s[%lld,null]", separator, (long long)point.timeMs);
+            } else {
+                length = snprintf(line->text, sizeof(line->text), "%s[%lld,%.7g]", separator, (long long)point.timeMs, point.value);
+            }
+            stream->points++;
+        } else {
+            stream->stage = 2;
+            return historyNextLine(context, line);
+        }
+    } else if (stream->stage == 2) {
+        length = snprintf(line->text, sizeof(line->text), "],\"count\":%lu}", (unsigned long)stream->points);
+        stream->stage = 3;
+    } else {
+        return false;
+    }
+
+    streamLineSet(line, length);
+    return true;
+}
+
+void handleHistory(AsyncWebServerRequest *request) {
+    if (!request->hasParam("slave") || !request->hasParam("register")) {
+        request->send(400, "application/json", "{\"error\":\"Parâmetros 'slave' e 'register' são obrigatórios\"}");
+        return;
+    }
+
+    bool utc = false;
+    int64_t toMs = request->hasParam("to") ? strtoll(request->getParam("to")->value().c_str(), NULL, 10) : dataLoggerNowMs(&utc);
+    int64_t spanMs = request->hasParam("span") ? strtoll(request->getParam("span")->value().c_str(), NULL, 10) : 3600000LL;
+    int64_t fromMs = request->hasParam("from") ? strtoll(request->getParam("from")->value().c_str(), NULL, 10) : toMs - spanMs;
+    uint32_t maxPoints = request->hasParam("maxPoints") ? request->getParam("maxPoints")->value().toInt() : 500;
+    if (fromMs >= toMs) {
+        request->send(400, "application/json", "{\"error\":\"Período inválido (from >= to)\"}");
+        return;
+    }
+    if (maxPoints < LTTB_MIN_POINTS) maxPoints = LTTB_MIN_POINTS;
+    if (maxPoints > LTTB_MAX_POINTS) maxPoints = LTTB_MAX_POINTS;
+
+    // Períodos longos leem o nível de rollup mais grosso que ainda entrega maxPoints
+    uint8_t store = DATALOG_STORE_RAW;
+    if (!request->hasParam("store") || request->getParam("store")->value() != "raw") {
+        store = rollupChooseStore(fromMs, toMs, maxPoints);
+    }
+
+    HistoryStream* stream = new HistoryStream();
+    stream->stage = 0;
+    stream->points = 0;
+    stream->line.length = 0;
+    stream->line.position = 0;
+    stream->store = store;
+    stream->fromMs = fromMs;
+    stream->toMs = toMs;
+    stream->slaveAddress = request->getParam("slave")->value().toInt();
+    stream->registerAddress = request->getParam("register")->value().toInt();
+    historyCursorBegin(&stream->mainCursor, stream, historyResolutionMs(store));
+    historyCursorBegin(&stream->leadCursor, stream, historyResolutionMs(store));
+    lttbBegin(&stream->lttb, historyReadPoint, &stream->mainCursor, &stream->leadCursor, fromMs, toMs, maxPoints);
+
+    // CRÍTICO: a resposta é gerada em partes; o estado vive até a desconexão do cliente
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return streamFill(&stream->line, historyNextLine, stream, buffer, maxLen);
+        });
+    request->onDisconnect([stream]() {
+        dataLogReaderEnd(&stream->mainCursor.reader);
+        dataLogReaderEnd(&stream->leadCursor.reader);
+        delete stream;
+    });
+    request->send(response);
+}
+
+// ==================== EXPORTAÇÃO DO HISTÓRICO ====================
+
+#define EXPORT_FORMAT_CSV 0
+#define EXPORT_FORMAT_NDJSON 1
+#define EXPORT_MEASURE_SLICE_MS 20     // Contagem do tamanho por chamada de historyExportService()
+
+/**
+ * @struct ExportStream
+ * @brief Estado da exportação CSV/NDJSON entre chamadas do preenchimento em partes
+ */
+struct ExportStream {
+    DataLogReader reader;
+    StreamLine line;
+    uint8_t format;            // EXPORT_FORMAT_*
+    uint8_t stage;             // 0 = cabeçalho, 1 = amostras, 2 = fim
+    uint8_t store;
+    uint32_t skipBytes;        // Início do Range: bytes gerados e descartados
+    uint32_t remainingBytes;   // Fim do Range (UINT32_MAX = até o fim)
+    uint32_t producedBytes;    // Total gerado (tamanho completo ao final)
+    uint32_t etag;
+    bool fullExport;           // Resposta 200 completa (tamanho pode ir para o cache)
+    uint8_t nameSlave;         // Última variável procurada em config
+    uint16_t nameRegister;
+    bool nameValid;
+    char name[32];
+};
+
+// Tamanho da última exportação completa, evita repetir a contagem em Range
+// (gravar s_exportLength antes de s_exportLengthEtag: lidos por outra task)
+static volatile uint32_t s_exportLengthEtag = 0;
+static volatile uint32_t s_exportLength = 0;
+
+/**
+ * @struct ExportMeasureJob
+ * @brief Exportação cujo tamanho o loop está contando (historyExportService)
+ */
+struct ExportMeasureJob {
+    uint8_t format;
+    uint8_t store;
+    int64_t fromMs;
+    int64_t toMs;
+    int16_t slaveAddress;
+    int32_t registerAddress;
+    uint32_t etag;
+};
+static ExportMeasureJob s_measureJob;
+static volatile bool s_measurePending = false;
+static ExportStream* s_measureStream = nullptr;  // Somente o loop usa
+static uint32_t s_measureTotal = 0;
+
+static const char* exportVariableName(ExportStream* stream, uint8_t slaveAddress, uint16_t registerAddress) {
+    if (stream->nameValid && stream->nameSlave == slaveAddress && stream->nameRegister == registerAddress) {
+        return stream->name;
+    }
+    stream->nameValid = true;
+    stream->nameSlave = slaveAddress;
+    stream->nameRegister = registerAddress;
+    stream->name[0] = '\0';
+    for (uint8_t d = 0; d < config.deviceCount && d < MAX_DEVICES; d++) {
+        if (config.devices[d].slaveAddress != slaveAddress) continue;
+        for (uint8_t r = 0; r < config.devices[d].registerCount && r < MAX_REGISTERS_PER_DEVICE; r++) {
+            if (config.devices[d].registers[r].address == registerAddress) {
+                strncpy(stream->name, config.devices[d].registers[r].variableName, sizeof(stream->name) - 1);
+                stream->name[sizeof(stream->name) - 1] = '\0';
+                return stream->name;
+            }
+        }
+    }
+    return stream->name;
+}
+
+static bool exportNextLine(void* context, StreamLine* line) {
+    ExportStream* stream = (ExportStream*)context;
+    bool rollup = stream->store != DATALOG_STORE_RAW;
+    int length = 0;
+
+    if (stream->stage == 0) {
+        stream->stage = 1;
+        if (stream->format == EXPORT_FORMAT_CSV) {
+            length = snprintf(line->text, sizeof(line->text), "time_ms,time_utc,slave,register,variable,value%s\r\n",
+                              rollup ? ",min,max,count" : "");
+            streamLineSet(line, length);
+            return true;
+        }
+    }
+
+    if (stream->stage == 1) {
+        DataLogSample sample;
+        if (!dataLogReaderNext(&stream->reader, &sample)) {
+            stream->stage = 2;
+            return false;
+        }
+
+        // Horário legível apenas quando a amostra foi registrada com RTC válido
+        char utcText[28] = "";
+        if (sample.utc) {
+            time_t seconds = (time_t)(sample.timeMs / 1000);
+            struct tm parts;
+            gmtime_r(&seconds, &parts);
+            size_t used = strftime(utcText, sizeof(utcText), "%Y-%m-%dT%H:%M:%S", &parts);
+            snprintf(utcText + used, sizeof(utcText) - used, ".%03dZ", (int)(sample.timeMs % 1000));
+        }
+        const char* name = exportVariableName(stream, sample.slaveAddress, sample.registerAddress);
+
+        if (stream->format == EXPORT_FORMAT_CSV) {
+            length = snprintf(line->text, sizeof(line->text), "%lld,%s,%u,%u,%s,%.7g",
+                              (long long)sample.timeMs, utcText, sample.slaveAddress, sample.registerAddress, name, sample.value);
+            if (rollup && length > 0) {
+                length += snprintf(line->text + length, sizeof(line->text) - length, ",%.7g,%.7g,%u",
+                                   sample.minValue, sample.maxValue, sample.count);
+            }
+            if (length > 0) {
+                length += snprintf(line->text + length, sizeof(line->text) - length, "\r\n");
+            }
+        } else {
+            // NaN/Inf não existem em JSON
+            char valueText[16] = "null";
+            if (!isnan(sample.value) && !isinf(sample.value)) {
+                snprintf(valueText, sizeof(valueText), "%.7g", sample.value);
+            }
+            length = snprintf(line->text, sizeof(line->text), "{\"t\":%lld,%s%s%s\"slave\":%u,\"register\":%u,\"variable\":\"%s\",\"value\":%s",
+                              (long long)sample.timeMs, sample.utc ? "\"utc\":\"" : "", utcText, sample.utc ? "\"," : "",
+                              sample.slaveAddress, sample.registerAddress, name, valueText);
+            if (rollup && length > 0 && !isnan(sample.minValue) && !isnan(sample.maxValue)) {
+                length += snprintf(line->text + length, sizeof(line->text) - length, ",\"min\":%.7g,\"max\":%.7g,\"count\":%u",
+                                   sample.minValue, sample.maxValue, sample.count);
+            }
+            if (length > 0) {
+                length += snprintf(line->text + length, sizeof(line->text) - length, "}\n");
+            }
+        }
+        streamLineSet(line, length);
+        return true;
+    }
+    return false;
+}
+
+static void exportStreamBegin(ExportStream* stream, uint8_t format, uint8_t store, int64_t fromMs, int64_t toMs,
+                              int16_t slaveAddress, int32_t registerAddress) {
+    stream->format = format;
+    stream->stage = 0;
+    stream->store = store;
+    stream->skipBytes = 0;
+    stream->remainingBytes = UINT32_MAX;
+    stream->producedBytes = 0;
+    stream->etag = 0;
+    stream->fullExport = false;
+    stream->nameValid = false;
+    stream->line.length = 0;
+    stream->line.position = 0;
+    dataLogReaderBegin(&stream->reader, fromMs, toMs, slaveAddress, registerAddress, store);
+}
+
+static size_t exportFill(ExportStream* stream, uint8_t* buffer, size_t maxLen) {
+    // Range: gera e descarta o trecho anterior ao início pedido (memória constante)
+    while (stream->skipBytes > 0) {
+        size_t skip = stream->skipBytes < maxLen ? stream->skipBytes : maxLen;
+        size_t generated = streamFill(&stream->line, exportNextLine, stream, buffer, skip);
+        if (generated == 0) {
+            stream->skipBytes = 0;
+            return 0;
+        }
+        stream->skipBytes -= generated;
+        stream->producedBytes += generated;
+    }
+
+    if (maxLen > stream->remainingBytes) {
+        maxLen = stream->remainingBytes;
+    }
+    size_t written = streamFill(&stream->line, exportNextLine, stream, buffer, maxLen);
+    if (stream->remainingBytes != UINT32_MAX) {
+        stream->remainingBytes -= written;
+    }
+    stream->producedBytes += written;
+    if (written == 0 && stream->stage == 2 && stream->fullExport) {
+        // Exportação completa: guarda o tamanho para pedidos Range seguintes
+        s_exportLength = stream->producedBytes;
+        s_exportLengthEtag = stream->etag;
+    }
+    return written;
+}
+
+// Pede ao loop a contagem do tamanho; uma por vez (a próxima retomada pede de novo)
+static void exportScheduleMeasure(uint8_t format, uint8_t store, int64_t fromMs, int64_t toMs, int16_t slaveAddress,
+                                  int32_t registerAddress, uint32_t etag) {
+    if (s_measurePending || etag == 0 || s_exportLengthEtag == etag) {
+        return;
+    }
+    s_measureJob.format = format;
+    s_measureJob.store = store;
+    s_measureJob.fromMs = fromMs;
+    s_measureJob.toMs = toMs;
+    s_measureJob.slaveAddress = slaveAddress;
+    s_measureJob.registerAddress = registerAddress;
+    s_measureJob.etag = etag;
+    s_measurePending = true;
+}
+
+// FNV-1a: validador (ETag) da exportação
+static uint32_t exportHash(const char* text) {
+    uint32_t hash = 2166136261UL;
+    while (*text) {
+        hash ^= (uint8_t)*text++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+void historyExportService() {
+    if (!s_measurePending) {
+        return;
+    }
+    if (s_measureStream == nullptr) {
+        s_measureStream = new ExportStream();
+        exportStreamBegin(s_measureStream, s_measureJob.format, s_measureJob.store, s_measureJob.fromMs, s_measureJob.toMs,
+                          s_measureJob.slaveAddress, s_measureJob.registerAddress);
+        s_measureTotal = 0;
+    }
+
+    // Gera a exportação sem enviá-la, em fatias: o loop segue com leitura e cálculos
+    uint8_t scratch[512];
+    unsigned long startMs = millis();
+    while (millis() - startMs < EXPORT_MEASURE_SLICE_MS) {
+        size_t generated = streamFill(&s_measureStream->line, exportNextLine, s_measureStream, scratch, sizeof(scratch));
+        if (generated == 0) {
+            dataLogReaderEnd(&s_measureStream->reader);
+            delete s_measureStream;
+            s_measureStream = nullptr;
+            s_exportLength = s_measureTotal;
+            s_exportLengthEtag = s_measureJob.etag;
+            s_measurePending = false;
+            return;
+        }
+        s_measureTotal += generated;
+    }
+}
+
+// Interpreta "bytes=a-b", "bytes=a-" e "bytes=-n"; false se inválido ou com vários intervalos
+static bool parseByteRange(const String& header, uint32_t total, uint32_t* start, uint32_t* end, bool* satisfiable) {
+    if (!header.startsWith("bytes=") || header.indexOf(',') >= 0) {
+        return false;
+    }
+    String spec = header.substring(6);
+    spec.trim();
+    int dash = spec.indexOf('-');
+    if (dash < 0) {
+        return false;
+    }
+    String first = spec.substring(0, dash);
+    String last = spec.substring(dash + 1);
+    *satisfiable = true;
+
+    if (first.length() == 0) {
+        uint32_t suffix = strtoul(last.c_str(), NULL, 10);
+        if (last.length() == 0 || suffix == 0 || total == 0) {
+            *satisfiable = false;
+            return true;
+        }
+        *start = suffix >= total ? 0 : total - suffix;
+        *end = total - 1;
+        return true;
+    }
+
+    *start = strtoul(first.c_str(), NULL, 10);
+    *end = last.length() > 0 ? strtoul(last.c_str(), NULL, 10) : total - 1;
+    if (*end >= total) {
+        *end = total - 1;
+    }
+    if (*start >= total || *start > *end) {
+        *satisfiable = false;
+    }
+    return true;
+}
+
+void handleHistoryExport(AsyncWebServerRequest *request) {
+    uint8_t format = EXPORT_FORMAT_CSV;
+    if (request->hasParam("format")) {
+        String value = request->getParam("format")->value();
+        if (value == "ndjson") {
+            format = EXPORT_FORMAT_NDJSON;
+        } else if (value != "csv") {
+            request->send(400, "application/json", "{\"error\":\"Formato inválido (use csv ou ndjson)\"}");
+            return;
+        }
+    }
+    uint8_t store = DATALOG_STORE_RAW;
+    if (request->hasParam("store")) {
+        long value = request->getParam("store")->value().toInt();
+        if (value < 0 || value >= DATALOG_STORE_COUNT) {
+            request->send(400, "application/json", "{\"error\":\"Store inválido\"}");
+            return;
+        }
+        store = (uint8_t)value;
+    }
+    int16_t slaveAddress = request->hasParam("slave") ? request->getParam("slave")->value().toInt() : -1;
+    int32_t registerAddress = request->hasParam("register") ? request->getParam("register")->value().toInt() : -1;
+
+    // Sem 'to' explícito: congela o período no que já está em flash e redireciona,
+    // assim a retomada por Range pede exatamente os mesmos bytes
+    if (!request->hasParam("to")) {
+        int64_t toMs = dataLoggerPersistedUntilMs(store);
+        if (toMs == INT64_MIN) {
+            request->send(503, "application/json", "{\"error\":\"Logger ocupado. Tente novamente.\"}");
+            return;
+        }
+        int64_t spanMs = request->hasParam("span") ? strtoll(request->getParam("span")->value().c_str(), NULL, 10) : 86400000LL;
+        int64_t fromMs = request->hasParam("from") ? strtoll(request->getParam("from")->value().c_str(), NULL, 10) : toMs - spanMs;
+        char url[192];
+        int length = snprintf(url, sizeof(url), "/api/history/export?format=%s&store=%u&from=%lld&to=%lld",
+                              format == EXPORT_FORMAT_CSV ? "csv" : "ndjson", store, (long long)fromMs, (long long)toMs);
+        if (slaveAddress >= 0) {
+            length += snprintf(url + length, sizeof(url) - length, "&slave=%d", slaveAddress);
+        }
+        if (registerAddress >= 0) {
+            snprintf(url + length, sizeof(url) - length, "&register=%ld", (long)registerAddress);
+        }
+        request->redirect(url);
+        return;
+    }
+
+    int64_t toMs = strtoll(request->getParam("to")->value().c_str(), NULL, 10);
+    int64_t fromMs = request->hasParam("from") ? strtoll(request->getParam("from")->value().c_str(), NULL, 10) : toMs - 86400000LL;
+    if (fromMs > toMs) {
+        request->send(400, "application/json", "{\"error\":\"Período inválido (from > to)\"}");
+        return;
+    }
+
+    // Conteúdo estável: tudo até 'to' já está em flash; a rotação muda o dado mais antigo
+    bool resumable = toMs <= dataLoggerPersistedUntilMs(store);
+    uint32_t etag = 0;
+    char etagText[16] = "";
+    if (resumable) {
+        char key[160];
+        snprintf(key, sizeof(key), "%u|%u|%lld|%lld|%d|%ld|%lld", format, store, (long long)fromMs, (long long)toMs,
+                 slaveAddress, (long)registerAddress, (long long)dataLogStoreOldestMs(store));
+        etag = exportHash(key);
+        if (etag == 0) etag = 1;
+        snprintf(etagText, sizeof(etagText), "\"%08lx\"", (unsigned long)etag);
+    }
+
+    const char* contentType = format == EXPORT_FORMAT_CSV ? "text/csv" : "application/x-ndjson";
+    char disposition[96];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"historico_%lld_%lld.%s\"",
+             (long long)fromMs, (long long)toMs, format == EXPORT_FORMAT_CSV ? "csv" : "ndjson");
+
+    // Range só vale para conteúdo estável e com If-Range (se enviado) igual ao ETag atual
+    bool useRange = resumable && request->hasHeader("Range");
+    if (useRange && request->hasHeader("If-Range") && request->getHeader("If-Range")->value() != etagText) {
+        useRange = false;
+    }
+
+    // Sem o tamanho completo, Range não é atendido aqui: contar exigiria gerar a
+    // exportação inteira dentro do AsyncTCP. Responde 200 completo e o loop conta
+    // o tamanho para a próxima retomada
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t total = 0;
+    if (useRange && s_exportLengthEtag != etag) {
+        exportScheduleMeasure(format, store, fromMs, toMs, slaveAddress, registerAddress, etag);
+        useRange = false;
+    }
+    if (useRange) {
+        total = s_exportLength;
+        bool satisfiable = false;
+        if (!parseByteRange(request->getHeader("Range")->value(), total, &start, &end, &satisfiable)) {
+            useRange = false;
+        } else if (!satisfiable) {
+            AsyncWebServerResponse *response = request->beginResponse(416, "application/json", "{\"error\":\"Intervalo fora do conteúdo\"}");
+            response->addHeader("Content-Range", "bytes */" + String(total));
+            response->addHeader("ETag", etagText);
+            request->send(response);
+            return;
+        }
+    }
+
+    ExportStream* stream = new ExportStream();
+    exportStreamBegin(stream, format, store, fromMs, toMs, slaveAddress, registerAddress);
+    stream->etag = etag;
+
+    AsyncWebServerResponse *response;
+    AwsResponseFiller filler = [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        return exportFill(stream, buffer, maxLen);
+    };
+    if (useRange) {
+        stream->skipBytes = start;
+        stream->remainingBytes = end - start + 1;
+        response = request->beginResponse(contentType, end - start + 1, filler);
+        response->setCode(206);
+        response->addHeader("Content-Range", "bytes " + String(start) + "-" + String(end) + "/" + String(total));
+    } else if (resumable && s_exportLengthEtag == etag) {
+        // Tamanho já conhecido: Content-Length permite ao navegador mostrar o progresso
+        response = request->beginResponse(contentType, s_exportLength, filler);
+    } else {
+        stream->fullExport = resumable;
+        response = request->beginChunkedResponse(contentType, filler);
+    }
+    if (resumable) {
+        response->addHeader("Accept-Ranges", "bytes");
+        response->addHeader("ETag", etagText);
+    }
+    response->addHeader("Content-Disposition", disposition);
+
+    request->onDisconnect([stream]() {
+        if (stream->fullExport && stream->stage != 2) {
+            // Download interrompido: o tamanho fica pronto para a retomada por Range
+            exportScheduleMeasure(stream->format, stream->store, stream->reader.fromMs, stream->reader.toMs,
+                                  stream->reader.slaveAddress, stream->reader.registerAddress, stream->etag);
+        }
+        dataLogReaderEnd(&stream->reader);
+        delete stream;
+    });
+    request->send(response);
+}
+
+// ==================== ALARMES ====================
+
+void handleGetAlarms(AsyncWebServerRequest *request) {
+    AlarmDefinition* definitions = new AlarmDefinition[ALARM_MAX_DEFINITIONS];
+    uint8_t count = alarmGetDefinitions(definitions, ALARM_MAX_DEFINITIONS);
+    
+    DynamicJsonDocument doc(12288);
+    JsonArray array = doc.createNestedArray("alarms");
+    for (uint8_t d = 0; d < count; d++) {
+        JsonObject obj = array.createNestedObject();
+        alarmDefinitionToJson(&definitions[d], obj);
+        
+        // Estado atual de cada condição
+        JsonArray active = obj.createNestedArray("active");
+        JsonArray unacked = obj.createNestedArray("unacknowledged");
+        for (uint8_t c = 0; c < ALARM_CONDITION_COUNT; c++) {
+            if (alarmIsActive(d, c)) active.add(c);
+            if (alarmIsUnacknowledged(d, c)) unacked.add(c);
+        }
+    }
+    delete[] definitions;
+    
+    doc["activeCount"] = alarmActiveCount();
+    doc["nextEventSeq"] = alarmNextEventSeq();
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleGetAlarmEvents(AsyncWebServerRequest *request) {
+    uint32_t cursor = 0;
+    if (request->hasParam("since")) {
+        cursor = (uint32_t)strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+    }
+    
+    DynamicJsonDocument doc(6144);
+    JsonArray events = doc.createNestedArray("events");
+    AlarmEvent event;
+    while (alarmReadEvent(&cursor, &event)) {
+        JsonObject obj = events.createNestedObject();
+        obj["seq"] = event.seq;
+        obj["timeMs"] = (double)event.timeMs;
+        obj["definition"] = event.definition;
+        obj["condition"] = event.condition;
+        obj["conditionName"] = alarmConditionName(event.condition);
+        obj["kind"] = event.kind == ALARM_EVENT_RAISED ? "raised" :
+                      event.kind == ALARM_EVENT_CLEARED ? "cleared" : "acknowledged";
+        obj["value"] = event.value;
+    }
+    // Próximo 'since' a usar
+    doc["next"] = cursor;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSaveAlarms(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(12288);
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error || !doc["alarms"].is<JsonArray>()) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido (esperado {\\\"alarms\\\":[...]})\"}");
+        return;
+    }
+    
+    AlarmDefinition* definitions = new AlarmDefinition[ALARM_MAX_DEFINITIONS];
+    uint8_t count = 0;
+    uint8_t rejected = 0;
+    for (JsonObjectConst obj : doc["alarms"].as<JsonArrayConst>()) {
+        if (count < ALARM_MAX_DEFINITIONS && alarmDefinitionFromJson(obj, &definitions[count])) {
+            count++;
+        } else {
+            rejected++;
+        }
+    }
+    alarmSetDefinitions(definitions, count);
+    delete[] definitions;
+    
+    bool saved = alarmSaveDefinitions();
+    consolePrint("[Alarme] " + String(count) + " definicoes salvas" +
+                 (rejected > 0 ? " (" + String(rejected) + " ignoradas)" : String("")) + "\r\n");
+    
+    request->send(saved ? 200 : 500, "application/json",
+                  "{\"status\":\"" + String(saved ? "ok" : "erro") + "\",\"count\":" + String(count) +
+                  ",\"rejected\":" + String(rejected) + "}");
+}
+
+void handleAckAlarms(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(256);
+    if (data && len > 0 && deserializeJson(doc, (const char*)data, len)) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    uint8_t acked;
+    if (doc.containsKey("definition") && doc.containsKey("condition")) {
+        acked = alarmAcknowledge(doc["definition"] | 0, doc["condition"] | 0, monotonicMicros()) ? 1 : 0;
+    } else {
+        // Sem definição/condição: reconhece todos
+        acked = alarmAcknowledgeAll(monotonicMicros());
+    }
+    request->send(200, "application/json", "{\"status\":\"ok\",\"acknowledged\":" + String(acked) + "}");
+}
+
+// ==================== PID ====================
+
+void handleGetPid(AsyncWebServerRequest *request) {
+    PidBlock* blocks = new PidBlock[PID_MAX_BLOCKS];
+    uint8_t count = pidGetBlocks(blocks, PID_MAX_BLOCKS);
+    
+    DynamicJsonDocument doc(8192);
+    JsonArray array = doc.createNestedArray("blocks");
+    for (uint8_t b = 0; b < count; b++) {
+        JsonObject obj = array.createNestedObject();
+        pidBlockToJson(&blocks[b], obj);
+        
+        PidStatus status;
+        pidGetStatus(b, &status);
+        JsonObject st = obj.createNestedObject("status");
+        st["pv"] = status.processValue;
+        st["output"] = status.output;
+        st["error"] = status.error;
+        st["integral"] = status.integral;
+        st["runs"] = status.runs;
+        st["overruns"] = status.overruns;
+        st["readErrors"] = status.readErrors;
+        st["writeErrors"] = status.writeErrors;
+        st["jitterUs"] = status.lastJitterUs;
+        st["jitterMeanUs"] = status.meanJitterUs;
+        st["jitterMaxUs"] = status.maxJitterUs;
+        st["latencyUs"] = status.lastLatencyUs;
+        st["latencyMeanUs"] = status.meanLatencyUs;
+        st["latencyMaxUs"] = status.maxLatencyUs;
+    }
+    delete[] blocks;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSavePid(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(6144);
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error || !doc["blocks"].is<JsonArray>()) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido (esperado {\\\"blocks\\\":[...]})\"}");
+        return;
+    }
+    
+    PidBlock* blocks = new PidBlock[PID_MAX_BLOCKS];
+    uint8_t count = 0;
+    uint8_t rejected = 0;
+    for (JsonObjectConst obj : doc["blocks"].as<JsonArrayConst>()) {
+        if (count < PID_MAX_BLOCKS && pidBlockFromJson(obj, &blocks[count])) {
+            count++;
+        } else {
+            rejected++;
+        }
+    }
+    pidSetBlocks(blocks, count);
+    delete[] blocks;
+    
+    bool saved = pidSaveBlocks();
+    consolePrint("[PID] " + String(count) + " blocos salvos" +
+                 (rejected > 0 ? " (" + String(rejected) + " ignorados)" : String("")) + "\r\n");
+    
+    request->send(saved ? 200 : 500, "application/json",
+                  "{\"status\":\"" + String(saved ? "ok" : "erro") + "\",\"count\":" + String(count) +
+                  ",\"rejected\":" + String(rejected) + "}");
+}
+
+// ==================== REGRAS DE REAÇÃO ====================
+
+void handleGetRules(AsyncWebServerRequest *request) {
+    ReactiveRule* rules = new ReactiveRule[RULE_MAX_RULES];
+    uint8_t count = ruleGetRules(rules, RULE_MAX_RULES);
+    
+    DynamicJsonDocument doc(12288);
+    JsonArray array = doc.createNestedArray("rules");
+    for (uint8_t r = 0; r < count; r++) {
+        JsonObject obj = array.createNestedObject();
+        ruleToJson(&rules[r], obj);
+        
+        RuleStatus status;
+        ruleGetStatus(r, &status);
+        JsonObject st = obj.createNestedObject("status");
+        st["tripped"] = status.tripped;
+        st["value"] = status.lastValue;
+        st["trips"] = status.trips;
+        st["writes"] = status.writes;
+        st["writeErrors"] = status.writeErrors;
+        st["latencyUs"] = status.lastLatencyUs;
+        st["latencyMeanUs"] = status.meanLatencyUs;
+        st["latencyMaxUs"] = status.maxLatencyUs;
+        st["queueWaitUs"] = status.lastQueueWaitUs;
+    }
+    delete[] rules;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSaveRules(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(8192);
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error || !doc["rules"].is<JsonArray>()) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido (esperado {\\\"rules\\\":[...]})\"}");
+        return;
+    }
+    
+    ReactiveRule* rules = new ReactiveRule[RULE_MAX_RULES];
+    uint8_t count = 0;
+    uint8_t rejected = 0;
+    for (JsonObjectConst obj : doc["rules"].as<JsonArrayConst>()) {
+        if (count < RULE_MAX_RULES && ruleFromJson(obj, &rules[count])) {
+            count++;
+        } else {
+            rejected++;
+        }
+    }
+    ruleSetRules(rules, count);
+    delete[] rules;
+    
+    bool saved = ruleSaveRules();
+    consolePrint("[Regra] " + String(count) + " regras salvas" +
+                 (rejected > 0 ? " (" + String(rejected) + " ignoradas)" : String("")) + "\r\n");
+    
+    request->send(saved ? 200 : 500, "application/json",
+                  "{\"status\":\"" + String(saved ? "ok" : "erro") + "\",\"count\":" + String(count) +
+                  ",\"rejected\":" + String(rejected) + "}");
+}
+
+// ==================== PSICROMETRIA ====================
+
+// Resultado de um ajuste em JSON
+static void psychroFitToJson(const PsychroFitResult& fit, JsonObject obj) {
+    obj["success"] = fit.success;
+    obj["pointCount"] = fit.pointCount;
+    obj["iterations"] = fit.iterations;
+    obj["rmsError"] = fit.rmsError;
+    obj["meanError"] = fit.meanError;
+    obj["maxError"] = fit.maxError;
+    obj["elapsedUs"] = fit.elapsedUs;
+}
+
+void handleGetPsychro(AsyncWebServerRequest *request) {
+    PsychroConstants constants;
+    psychroGetConstants(&constants);
+    PsychroSource source;
+    psychroGetSource(&source);
+    PsychroPoint points[PSYCHRO_MAX_POINTS];
+    uint8_t count = psychroGetPoints(points, PSYCHRO_MAX_POINTS);
+    
+    DynamicJsonDocument doc(3072);
+    doc["a"] = constants.a;
+    doc["b"] = constants.b;
+    doc["c"] = constants.c;
+    doc["d"] = constants.d;
+    doc["tsSlave"] = source.tsSlave;
+    doc["tsRegister"] = source.tsRegister;
+    doc["tuSlave"] = source.tuSlave;
+    doc["tuRegister"] = source.tuRegister;
+    // Cada ponto: [TS, TU, UR de referência, UR calculada com as constantes atuais]
+    JsonArray array = doc.createNestedArray("points");
+    for (uint8_t k = 0; k < count; k++) {
+        JsonArray point = array.createNestedArray();
+        point.add(points[k].ts);
+        point.add(points[k].tu);
+        point.add(points[k].ur);
+        point.add(psychroRelativeHumidity(points[k].ts, points[k].tu, &constants));
+    }
+    PsychroFitResult fit;
+    psychroGetLastFit(&fit);
+    if (fit.pointCount > 0) {
+        psychroFitToJson(fit, doc.createNestedObject("lastFit"));
+    }
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSavePsychro(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(3072);
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    // Só altera o que veio no body
+    PsychroConstants constants;
+    psychroGetConstants(&constants);
+    constants.a = doc["a"] | constants.a;
+    constants.b = doc["b"] | constants.b;
+    constants.c = doc["c"] | constants.c;
+    constants.d = doc["d"] | constants.d;
+    if (!(constants.a > 0.0) || isnan(constants.b) || isnan(constants.c) || isnan(constants.d)) {
+        request->send(400, "application/json", "{\"error\":\"Constantes invalidas (A deve ser > 0)\"}");
+        return;
+    }
+    psychroSetConstants(&constants);
+    
+    PsychroSource source;
+    psychroGetSource(&source);
+    source.tsSlave = doc["tsSlave"] | source.tsSlave;
+    source.tsRegister = doc["tsRegister"] | source.tsRegister;
+    source.tuSlave = doc["tuSlave"] | source.tuSlave;
+    source.tuRegister = doc["tuRegister"] | source.tuRegister;
+    psychroSetSource(&source);
+    
+    if (doc["points"].is<JsonArray>()) {
+        PsychroPoint points[PSYCHRO_MAX_POINTS];
+        uint8_t count = 0;
+        for (JsonArrayConst point : doc["points"].as<JsonArrayConst>()) {
+            if (count >= PSYCHRO_MAX_POINTS || point.size() < 3) {
+                continue;
+            }
+            points[count].ts = point[0] | 0.0f;
+            points[count].tu = point[1] | 0.0f;
+            points[count].ur = point[2] | 0.0f;
+            count++;
+        }
+        psychroSetPoints(points, count);
+    }
+    
+    bool saved = psychroSave();
+    request->send(saved ? 200 : 500, "application/json", "{\"status\":\"" + String(saved ? "ok" : "erro") + "\"}");
+}
+
+void handlePsychroCapture(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(256);
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error || !doc.containsKey("ur")) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido (esperado {\\\"ur\\\": valor})\"}");
+        return;
+    }
+    
+    PsychroPoint point;
+    if (!psychroCapturePoint(doc["ur"] | 0.0f, &point)) {
+        request->send(400, "application/json", "{\"error\":\"Registros de TS/TU nao configurados ou ainda sem leitura\"}");
+        return;
+    }
+    psychroSave();
+    consolePrint("[Psicrometria] Ponto capturado: TS=" + String(point.ts, 2) + " TU=" + String(point.tu, 2) +
+                 " UR=" + String(point.ur, 2) + "\r\n");
+    request->send(200, "application/json", "{\"status\":\"ok\",\"ts\":" + String(point.ts, 3) +
+                  ",\"tu\":" + String(point.tu, 3) + ",\"ur\":" + String(point.ur, 3) + "}");
+}
+
+void handlePsychroFit(AsyncWebServerRequest *request) {
+    PsychroFitResult fit;
+    bool ok = psychroCalibrate(&fit);
+    if (ok) {
+        psychroSave();
+    }
+    
+    PsychroConstants constants;
+    psychroGetConstants(&constants);
+    DynamicJsonDocument doc(512);
+    psychroFitToJson(fit, doc.createNestedObject("fit"));
+    doc["a"] = constants.a;
+    doc["b"] = constants.b;
+    doc["c"] = constants.c;
+    doc["d"] = constants.d;
+    if (!ok) {
+        doc["error"] = fit.pointCount < PSYCHRO_MIN_POINTS
+            ? "Sao necessarios pelo menos " + String(PSYCHRO_MIN_POINTS) + " pontos"
+            : String("Ajuste nao convergiu");
+    }
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(ok ? 200 : 400, "application/json", response);
+}
+
+// ==================== Busca de dispositivos Modbus ====================
+
+void handleStartModbusScan(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    ModbusScanRequest scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.firstAddress = 1;
+    scan.lastAddress = 247;
+    
+    if (len > 0) {
+        DynamicJsonDocument doc(512);
+        DeserializationError error = deserializeJson(doc, (const char*)data, len);
+        if (error) {
+            request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+            return;
+        }
+        scan.firstAddress = doc["from"] | 1;
+        scan.lastAddress = doc["to"] | 247;
+        scan.probeRegister = doc["register"] | 0;
+        scan.timeoutMs = doc["timeoutMs"] | 0;
+        JsonArray bauds = doc["bauds"].as<JsonArray>();
+        for (JsonVariant baud : bauds) {
+            if (scan.baudCount >= SCAN_MAX_BAUDS) {
+                break;
+            }
+            uint32_t value = baud.as<uint32_t>();
+            if (value >= 1200 && value <= 115200) {
+                scan.bauds[scan.baudCount++] = value;
+            }
+        }
+    }
+    
+    ModbusScanStatus status;
+    modbusScanGetStatus(&status);
+    if (status.running) {
+        request->send(409, "application/json", "{\"error\":\"Busca ja em andamento\"}");
+        return;
+    }
+    if (!modbusScanStart(&scan)) {
+        request->send(400, "application/json", "{\"error\":\"Faixa de enderecos invalida (1-247)\"}");
+        return;
+    }
+    request->send(202, "application/json", "{\"status\":\"started\",\"websocket\":\"/ws/scan\"}");
+}
+
+void handleGetModbusScan(AsyncWebServerRequest *request) {
+    ModbusScanStatus status;
+    modbusScanGetStatus(&status);
+    ModbusScanFound* found = new ModbusScanFound[SCAN_MAX_RESULTS];
+    uint8_t count = modbusScanGetResults(found, SCAN_MAX_RESULTS);
+    
+    DynamicJsonDocument doc(1024 + count * 128);
+    doc["running"] = status.running;
+    doc["cancelled"] = status.cancelled;
+    doc["baud"] = status.baud;
+    doc["address"] = status.address;
+    doc["probed"] = status.probed;
+    doc["total"] = status.total;
+    doc["retries"] = status.retries;
+    doc["timeoutMs"] = status.timeoutUs / 1000.0f;
+    doc["elapsedMs"] = status.elapsedMs;
+    JsonArray devices = doc.createNestedArray("devices");
+    for (uint8_t k = 0; k < count; k++) {
+        JsonObject device = devices.createNestedObject();
+        device["address"] = found[k].address;
+        device["baud"] = found[k].baud;
+        device["latencyUs"] = found[k].latencyUs;
+        device["exception"] = found[k].exception;
+        device["configured"] = found[k].configured;
+    }
+    delete[] found;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleCancelModbusScan(AsyncWebServerRequest *request) {
+    modbusScanCancel();
+    request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// ==================== Detecção automática de velocidade ====================
+
+void handleStartModbusAutodetect(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    AutodetectRequest detect;
+    memset(&detect, 0, sizeof(detect));
+    
+    if (len > 0) {
+        DynamicJsonDocument doc(512);
+        DeserializationError error = deserializeJson(doc, (const char*)data, len);
+        if (error) {
+            request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+            return;
+        }
+        JsonArray slaves = doc["slaves"].as<JsonArray>();
+        for (JsonVariant slave : slaves) {
+            uint8_t address = slave.as<uint8_t>();
+            if (address >= 1 && address <= 247 && detect.slaveCount < AUTODETECT_MAX_SLAVES) {
+                detect.slaves[detect.slaveCount++] = address;
+            }
+        }
+        uint32_t budgetMs = doc["budgetMs"] | 0;
+        detect.budgetMs = budgetMs > 30000 ? 30000 : budgetMs;
+        uint32_t turnaroundMs = doc["turnaroundMs"] | 0;
+        detect.turnaroundMs = turnaroundMs > 1000 ? 1000 : turnaroundMs;
+        detect.apply = doc["apply"] | false;
+    }
+    
+    if (!modbusAutodetectRequest(&detect)) {
+        request->send(409, "application/json", "{\"error\":\"Deteccao ja agendada ou nenhum escravo para testar\"}");
+        return;
+    }
+    request->send(202, "application/json", "{\"status\":\"scheduled\"}");
+}
+
+void handleGetModbusAutodetect(AsyncWebServerRequest *request) {
+    AutodetectResult* result = new AutodetectResult;
+    modbusAutodetectGetResult(result);
+    
+    DynamicJsonDocument doc(1024 + result->candidateCount * 128);
+    doc["pending"] = result->pending;
+    doc["done"] = result->done;
+    doc["found"] = result->found;
+    doc["applied"] = result->applied;
+    doc["timedOut"] = result->timedOut;
+    doc["elapsedMs"] = result->elapsedMs;
+    doc["slaveCount"] = result->slaveCount;
+    if (result->found) {
+        doc["baudRate"] = result->baudRate;
+        doc["dataBits"] = result->dataBits;
+        doc["parity"] = result->parity;
+        doc["stopBits"] = result->stopBits;
+    }
+    JsonArray candidates = doc.createNestedArray("candidates");
+    for (uint8_t k = 0; k < result->candidateCount; k++) {
+        JsonObject candidate = candidates.createNestedObject();
+        candidate["baudRate"] = result->candidates[k].baudRate;
+        candidate["parity"] = result->candidates[k].parity;
+        candidate["stopBits"] = result->candidates[k].stopBits;
+        candidate["valid"] = result->candidates[k].valid;
+        candidate["probes"] = result->candidates[k].probes;
+        candidate["noise"] = result->candidates[k].noise;
+    }
+    delete result;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+// ==================== PERFIS DE DISPOSITIVO ====================
+
+void handleGetProfiles(AsyncWebServerRequest *request) {
+    DeviceProfile* profile = new DeviceProfile;
+    DynamicJsonDocument doc(2048);
+    JsonArray array = doc.createNestedArray("profiles");
+    for (uint8_t p = 0; profileGetAt(p, profile); p++) {
+        JsonObject obj = array.createNestedObject();
+        obj["name"] = profile->name;
+        obj["description"] = profile->description;
+        obj["registers"] = profile->registerCount;
+        obj["blocks"] = profile->plan.blockCount;
+    }
+    delete profile;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleGetProfile(AsyncWebServerRequest *request) {
+    String name = request->hasParam("name") ? request->getParam("name")->value() : "";
+    DeviceProfile* profile = new DeviceProfile;
+    if (!profileGet(name.c_str(), profile)) {
+        delete profile;
+        request->send(404, "application/json", "{\"error\":\"Perfil nao encontrado\"}");
+        return;
+    }
+    DynamicJsonDocument doc(8192);
+    profileToJson(profile, doc.to<JsonObject>(), true);
+    delete profile;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSaveProfile(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(8192);
+    DeserializationError jsonError = deserializeJson(doc, (const char*)data, len);
+    if (jsonError) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    DeviceProfile* profile = new DeviceProfile;
+    String error;
+    if (!profileFromJson(doc.as<JsonObjectConst>(), profile, &error)) {
+        delete profile;
+        request->send(400, "application/json", "{\"error\":\"" + error + "\"}");
+        return;
+    }
+    bool saved = profileSave(profile);
+    String response = "{\"status\":\"" + String(saved ? "ok" : "erro") + "\",\"name\":\"" + String(profile->name) +
+                      "\",\"registers\":" + String(profile->registerCount) + ",\"blocks\":" + String(profile->plan.blockCount) + "}";
+    if (saved) {
+        consolePrint("[Perfis] " + String(profile->name) + " salvo: " + String(profile->registerCount) + " registros em " +
+                     String(profile->plan.blockCount) + " blocos de leitura\r\n");
+    }
+    delete profile;
+    request->send(saved ? 200 : 500, "application/json", response);
+}
+
+void handleDeleteProfile(AsyncWebServerRequest *request) {
+    String name = request->hasParam("name") ? request->getParam("name")->value() : "";
+    if (!profileDelete(name.c_str())) {
+        request->send(404, "application/json", "{\"error\":\"Perfil nao encontrado\"}");
+        return;
+    }
+    consolePrint("[Perfis] " + name + " removido\r\n");
+    request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// ==================== ESCRAVO MODBUS ====================
+
+void handleGetModbusSlave(AsyncWebServerRequest *request) {
+    SlaveConfig* slaveConfig = new SlaveConfig;
+    modbusSlaveGetConfig(slaveConfig);
+    SlaveStats stats;
+    modbusSlaveGetStats(&stats);
+    
+    DynamicJsonDocument doc(8192);
+    modbusSlaveConfigToJson(slaveConfig, doc.createNestedObject("config"));
+    delete slaveConfig;
+    JsonObject statsObj = doc.createNestedObject("stats");
+    statsObj["requests"] = stats.requests;
+    statsObj["replies"] = stats.replies;
+    statsObj["exceptions"] = stats.exceptions;
+    statsObj["crcErrors"] = stats.crcErrors;
+    statsObj["otherAddress"] = stats.otherAddress;
+    statsObj["lastReplyUs"] = stats.lastReplyUs;
+    statsObj["maxReplyUs"] = stats.maxReplyUs;
+    statsObj["tableUpdates"] = stats.tableUpdates;
+    // Tabela publicada: palavras a partir de tableBase, como vistas pelo mestre a jusante
+    doc["tableBase"] = stats.tableBase;
+    uint16_t words[SLAVE_TABLE_WORDS];
+    uint16_t count = modbusSlaveGetTable(words, SLAVE_TABLE_WORDS);
+    JsonArray table = doc.createNestedArray("table");
+    for (uint16_t k = 0; k < count; k++) {
+        table.add(words[k]);
+    }
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSaveModbusSlave(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(6144);
+    DeserializationError jsonError = deserializeJson(doc, (const char*)data, len);
+    if (jsonError) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    SlaveConfig* slaveConfig = new SlaveConfig;
+    if (!modbusSlaveConfigFromJson(doc.as<JsonObjectConst>(), slaveConfig)) {
+        delete slaveConfig;
+        request->send(400, "application/json", "{\"error\":\"Entrada invalida no mapa (origem, tipo de dado, variavel ou mais de " + String(SLAVE_MAX_MAP) + " entradas)\"}");
+        return;
+    }
+    String error;
+    bool accepted = modbusSlaveSetConfig(slaveConfig, &error);
+    delete slaveConfig;
+    if (!accepted) {
+        request->send(400, "application/json", "{\"error\":\"" + error + "\"}");
+        return;
+    }
+    bool saved = modbusSlaveSave();
+    request->send(saved ? 200 : 500, "application/json", "{\"status\":\"" + String(saved ? "ok" : "erro") + "\"}");
+}
+
+// ==================== CAPTURA DO BARRAMENTO ====================
+
+void handleGetBusCapture(AsyncWebServerRequest *request) {
+    BusCaptureStatus status;
+    busCaptureGetStatus(&status);
+    
+    DynamicJsonDocument doc(6144);
+    doc["enabled"] = status.enabled;
+    doc["trigger"] = status.trigger;
+    doc["frozen"] = status.frozen;
+    doc["suspended"] = status.suspended;
+    doc["triggerFlags"] = status.triggerFlags;
+    doc["frames"] = status.frames;
+    doc["bytesUsed"] = status.bytesUsed;
+    doc["ringBytes"] = CAPTURE_RING_BYTES;
+    doc["captured"] = status.captured;
+    doc["overwritten"] = status.overwritten;
+    doc["crcErrors"] = status.crcErrors;
+    doc["noReply"] = status.noReply;
+    doc["spanMs"] = status.frames > 0 ? (double)(status.newestUs - status.oldestUs) / 1000.0 : 0.0;
+    
+    // Quadros mais recentes (mais novo primeiro) em hexadecimal
+    uint16_t recent = 16;
+    if (request->hasParam("frames")) {
+        recent = (uint16_t)constrain(request->getParam("frames")->value().toInt(), 0, 32);
+    }
+    BusCaptureFrame* frame = new BusCaptureFrame;
+    JsonArray frames = doc.createNestedArray("recent");
+    for (uint16_t k = 0; k < recent && busCaptureGetFrame(k, frame); k++) {
+        JsonObject item = frames.createNestedObject();
+        item["ageMs"] = (double)(monotonicMicros() - frame->timeUs) / 1000.0;
+        item["dir"] = frame->direction == BUS_CAPTURE_DIR_TX ? "tx" : "rx";
+        item["flags"] = frame->flags;
+        item["length"] = frame->length;
+        char hex[3 * 64 + 4];
+        uint16_t stored = frame->length < CAPTURE_MAX_FRAME ? frame->length : CAPTURE_MAX_FRAME;
+        uint16_t shown = stored < 64 ? stored : 64;
+        int used = 0;
+        for (uint16_t b = 0; b < shown; b++) {
+            used += snprintf(hex + used, sizeof(hex) - used, b == 0 ? "%02X" : " %02X", frame->data[b]);
+        }
+        if (shown < stored) {
+            snprintf(hex + used, sizeof(hex) - used, " ..");
+        }
+        item["hex"] = hex;
+    }
+    delete frame;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleSaveBusCapture(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(256);
+    DeserializationError jsonError = deserializeJson(doc, (const char*)data, len);
+    if (jsonError) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido\"}");
+        return;
+    }
+    
+    BusCaptureStatus status;
+    busCaptureGetStatus(&status);
+    busCaptureConfigure(doc["enabled"] | status.enabled, doc["trigger"] | status.trigger);
+    // Limpar também rearma o gatilho
+    if (doc["clear"] | false) {
+        busCaptureClear();
+    }
+    request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+void handleBusCapturePcap(AsyncWebServerRequest *request) {
+    size_t length = 0;
+    uint8_t* pcap = busCaptureBuildPcap(&length);
+    if (pcap == nullptr) {
+        request->send(503, "application/json", "{\"error\":\"Memoria insuficiente para exportar a captura\"}");
+        return;
+    }
+    
+    AwsResponseFiller filler = [pcap, length](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        if (index >= length) {
+            return 0;
+        }
+        size_t count = length - index < maxLen ? length - index : maxLen;
+        memcpy(buffer, pcap + index, count);
+        return count;
+    };
+    AsyncWebServerResponse *response = request->beginResponse("application/vnd.tcpdump.pcap", length, filler);
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"rs485_%lu.pcap\"", (unsigned long)getCurrentEpochTime());
+    response->addHeader("Content-Disposition", disposition);
+    request->onDisconnect([pcap]() {
+        delete[] pcap;
+    });
+    request->send(response);
+}
+
+void handleGetScriptStats(AsyncWebServerRequest *request) {
+    // index: 0 = código principal, 1..SCRIPT_MAX_SCRIPTS = scripts nomeados
+    int index = request->hasParam("index") ? request->getParam("index")->value().toInt() : 0;
+    ScriptDefinition* definition = new ScriptDefinition;
+    uint32_t cycleMs = CALCULATION_INTERVAL_MS;
+    if (index > 0) {
+        ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+        uint8_t count = scriptGetDefinitions(definitions, SCRIPT_MAX_SCRIPTS);
+        if (index <= count) {
+            *definition = definitions[index - 1];
+        }
+        delete[] definitions;
+        if (index > count) {
+            delete definition;
+            request->send(404, "application/json", "{\"error\":\"Script inexistente\"}");
+            return;
+        }
+        // Disparo por leitura ou alarme: sem período para comparar
+        cycleMs = definition->trigger == SCRIPT_TRIGGER_PERIOD ? definition->periodMs : 0;
+    }
+    delete definition;
+    ScriptStats* stats = new ScriptStats;
+    scriptGetStats(index, stats);
+    
+    DynamicJsonDocument doc(6144);
+    doc["index"] = index;
+    doc["sliceMs"] = config.scriptSliceMs;
+    doc["cycleMs"] = cycleMs;
+    doc["running"] = stats->running;
+    doc["runs"] = stats->runs;
+    doc["lateTicks"] = stats->lateTicks;
+    doc["lastRunMs"] = stats->lastRunUs / 1000.0;
+    doc["maxRunMs"] = stats->maxRunUs / 1000.0;
+    doc["lastSpanMs"] = stats->lastSpanMs;
+    doc["lastSlices"] = stats->lastSlices;
+    doc["maxSlices"] = stats->maxSlices;
+    doc["maxSliceMs"] = stats->maxSliceUs / 1000.0;
+    doc["lastWaitMs"] = stats->lastWaitUs / 1000.0;
+    doc["maxWaitMs"] = stats->maxWaitUs / 1000.0;
+    doc["preemptions"] = stats->preemptions;
+    // Não cabe: já atravessou um disparo ou a execução sozinha leva mais que o período
+    doc["fitsCycle"] = stats->lateTicks == 0 && (cycleMs == 0 || stats->maxRunUs < cycleMs * 1000UL);
+    
+    JsonObject compileObj = doc.createNestedObject("compile");
+    compileObj["compiledLines"] = stats->compile.compiledLines;
+    compileObj["interpretedLines"] = stats->compile.interpretedLines;
+    compileObj["deadAssignments"] = stats->compile.deadAssignments;
+    compileObj["ops"] = stats->compile.ops;
+    compileObj["folded"] = stats->compile.folded;
+    compileObj["shared"] = stats->compile.shared;
+    compileObj["reduced"] = stats->compile.reduced;
+    compileObj["forwarded"] = stats->compile.forwarded;
+    
+    JsonArray lines = doc.createNestedArray("lines");
+    for (uint8_t k = 0; k < stats->lineCount; k++) {
+        JsonObject item = lines.createNestedObject();
+        item["line"] = stats->lines[k].line;
+        item["lastMs"] = stats->lines[k].lastUs / 1000.0;
+        item["maxMs"] = stats->lines[k].maxUs / 1000.0;
+        item["mode"] = stats->lines[k].mode == SCRIPT_LINE_COMPILED ? "compiled" :
+                       stats->lines[k].mode == SCRIPT_LINE_DEAD ? "dead" : "interpreted";
+        // Linha que sozinha passa da fatia (não é dividida)
+        item["overSlice"] = config.scriptSliceMs > 0 && stats->lines[k].maxUs > config.scriptSliceMs * 1000UL;
+    }
+    delete stats;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+void handleGetScripts(AsyncWebServerRequest *request) {
+    ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    uint8_t count = scriptGetDefinitions(definitions, SCRIPT_MAX_SCRIPTS);
+    ScriptStats* stats = new ScriptStats;
+    
+    DynamicJsonDocument doc(6144 + SCRIPT_MAX_SCRIPTS * SCRIPT_MAX_CODE);
+    JsonArray array = doc.createNestedArray("scripts");
+    for (uint8_t k = 0; k < count; k++) {
+        JsonObject obj = array.createNestedObject();
+        scriptDefinitionToJson(&definitions[k], obj);
+        
+        scriptGetStats(k + 1, stats);
+        JsonObject st = obj.createNestedObject("status");
+        st["running"] = stats->running;
+        st["runs"] = stats->runs;
+        st["lateTicks"] = stats->lateTicks;
+        st["preemptions"] = stats->preemptions;
+        st["lastRunMs"] = stats->lastRunUs / 1000.0;
+        st["maxRunMs"] = stats->maxRunUs / 1000.0;
+        st["lastWaitMs"] = stats->lastWaitUs / 1000.0;
+        st["maxWaitMs"] = stats->maxWaitUs / 1000.0;
+    }
+    delete stats;
+    
+    // Definições referenciadas pelo documento (nome e código): serializa antes de liberar
+    String response;
+    serializeJson(doc, response);
+    delete[] definitions;
+    request->send(200, "application/json", response);
+}
+
+void handleSaveScripts(AsyncWebServerRequest *request, uint8_t *data, size_t len) {
+    DynamicJsonDocument doc(6144 + SCRIPT_MAX_SCRIPTS * SCRIPT_MAX_CODE);
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error || !doc["scripts"].is<JsonArray>()) {
+        request->send(400, "application/json", "{\"error\":\"JSON inválido (esperado {\\\"scripts\\\":[...]})\"}");
+        return;
+    }
+    
+    ScriptDefinition* definitions = new ScriptDefinition[SCRIPT_MAX_SCRIPTS];
+    uint8_t count = 0;
+    uint8_t rejected = 0;
+    for (JsonObjectConst obj : doc["scripts"].as<JsonArrayConst>()) {
+        if (count < SCRIPT_MAX_SCRIPTS && scriptDefinitionFromJson(obj, &definitions[count])) {
+            count++;
+        } else {
+            rejected++;
+        }
+    }
+    scriptSetDefinitions(definitions, count);
+    delete[] definitions;
+    
+    bool saved = scriptSaveDefinitions();
+    consolePrint("[Script] " + String(count) + " scripts salvos" +
+                 (rejected > 0 ? " (" + String(rejected) + " ignorados)" : String("")) + "\r\n");
+    
+    request->send(saved ? 200 : 500, "application/json",
+                  "{\"status\":\"" + String(saved ? "ok" : "erro") + "\",\"count\":" + String(count) +
+                  ",\"rejected\":" + String(rejected) + "}");
+}
@@ -16,6 +16,7 @@
 // Variáveis globais externas
 extern AsyncWebServer server;
 extern AsyncWebSocket* consoleWebSocket;
+extern AsyncWebSocket* scanWebSocket;
 
 /**
  * @brief Inicializa o sistema de arquivos LittleFS
@@ -123,9 +124,20 @@ void handleResetConfig(AsyncWebServerRequest *request);
 
 /**
  * @brief Handler para escrever valor de variável (POST /api/variable/write)
+ *
+ * A escrita entra na fila com prioridade de operador e é executada pelo loop
+ * na próxima fronteira entre quadros. Não espera o barramento (a task do
+ * AsyncTCP atende todos os clientes): responde 202 com o id da escrita, e o
+ * resultado e os instantes (queueWaitMs, transactionMs, completedAt) vêm de
+ * handleWriteStatus().
  */
 void handleWriteVariable(AsyncWebServerRequest *request, uint8_t *data, size_t len);
 
+/**
+ * @brief Handler do estado de uma escrita na fila (GET /api/variable/write/status?id=N)
+ */
+void handleWriteStatus(AsyncWebServerRequest *request);
+
 /**
  * @brief Handler para listar arquivos do filesystem (GET /api/filesystem/list)
  */
@@ -141,5 +153,176 @@ void handleDownloadFile(AsyncWebServerRequest *request);
  */
 void handleDeleteFile(AsyncWebServerRequest *request, uint8_t *data, size_t len);
 
+/**
+ * @brief Handler do histórico reduzido por LTTB (GET /api/history)
+ *
+ * Parâmetros: slave, register, from/to (ms; padrão: to = agora e from = to - span,
+ * span padrão 1 h), maxPoints (padrão 500) e store=raw para ignorar os rollups.
+ */
+void handleHistory(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler da exportação do histórico em CSV ou NDJSON (GET /api/history/export)
+ *
+ * Parâmetros: format (csv|ndjson), from/to (ms), slave, register, store. Sem 'to'
+ * redireciona para a URL com o período congelado no que já está em flash;
+ * esse conteúdo aceita Range (206) e é validado por ETag.
+ * Range só é atendido com o tamanho completo já conhecido; sem ele a resposta
+ * é 200 completa e o tamanho é contado por historyExportService().
+ */
+void handleHistoryExport(AsyncWebServerRequest *request);
+
+/**
+ * @brief Conta o tamanho de uma exportação pedida por Range (chamar no loop)
+ *
+ * Gera a exportação sem enviá-la, no máximo EXPORT_MEASURE_SLICE_MS por
+ * chamada, fora das tasks do servidor: a contagem de um dia de amostras leva
+ * segundos e não pode travar o AsyncTCP.
+ */
+void historyExportService();
+
+/**
+ * @brief Handler das definições e estado dos alarmes (GET /api/alarms)
+ */
+void handleGetAlarms(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler dos eventos de alarme (GET /api/alarms/events?since=N)
+ *
+ * Devolve os eventos com seq >= since e o próximo valor de 'since' em 'next'.
+ */
+void handleGetAlarmEvents(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para substituir e gravar as definições de alarme (POST /api/alarms)
+ */
+void handleSaveAlarms(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler de reconhecimento (POST /api/alarms/ack, {definition, condition} ou {} para todos)
+ */
+void handleAckAlarms(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler dos blocos PID com estado, jitter e latência (GET /api/pid)
+ */
+void handleGetPid(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para substituir e gravar os blocos PID (POST /api/pid, {"blocks":[...]})
+ */
+void handleSavePid(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler das regras de reação com estado e latência entrada-saída (GET /api/rules)
+ */
+void handleGetRules(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para substituir e gravar as regras de reação (POST /api/rules, {"rules":[...]})
+ */
+void handleSaveRules(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler das constantes psicrométricas, pontos de referência e último ajuste (GET /api/psychro)
+ */
+void handleGetPsychro(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para alterar constantes, registros de origem e/ou pontos (POST /api/psychro)
+ */
+void handleSavePsychro(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler de captura de ponto com as leituras atuais (POST /api/psychro/capture, {"ur": 55.0})
+ */
+void handlePsychroCapture(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler do ajuste Levenberg-Marquardt com os pontos armazenados (POST /api/psychro/fit)
+ */
+void handlePsychroFit(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para iniciar a busca de dispositivos (POST /api/modbus/scan, {"from","to","bauds","timeoutMs","register"})
+ */
+void handleStartModbusScan(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler do andamento e dos dispositivos encontrados (GET /api/modbus/scan)
+ */
+void handleGetModbusScan(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para interromper a busca (POST /api/modbus/scan/cancel)
+ */
+void handleCancelModbusScan(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para agendar a detecção de velocidade/enquadramento (POST /api/modbus/autodetect, {"slaves","budgetMs","turnaroundMs","apply"})
+ */
+void handleStartModbusAutodetect(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler do resultado da última detecção com a pontuação de cada combinação (GET /api/modbus/autodetect)
+ */
+void handleGetModbusAutodetect(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler da lista de perfis de dispositivo com o tamanho do plano compilado (GET /api/profiles)
+ */
+void handleGetProfiles(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler de um perfil com registros, blocos e decodificadores (GET /api/profiles/get?name=)
+ */
+void handleGetProfile(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para criar/substituir um perfil; compila antes de gravar (POST /api/profiles)
+ */
+void handleSaveProfile(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler para remover um perfil (POST /api/profiles/delete?name=)
+ */
+void handleDeleteProfile(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler da configuração, mapa e contadores do escravo Modbus na Serial1 (GET /api/modbus/slave)
+ */
+void handleGetModbusSlave(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para substituir a configuração do escravo; valida o mapa e grava (POST /api/modbus/slave)
+ */
+void handleSaveModbusSlave(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler do estado da captura do barramento e dos quadros recentes (GET /api/capture?frames=)
+ */
+void handleGetBusCapture(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler para ligar a captura, o modo gatilho ou limpar o anel (POST /api/capture)
+ */
+void handleSaveBusCapture(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
+/**
+ * @brief Handler que exporta o anel de captura como arquivo pcap (GET /api/capture/pcap)
+ */
+void handleBusCapturePcap(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handler do custo de um script: execuções, fatias, espera e custo por linha (GET /api/script/stats?index=N)
+ */
+void handleGetScriptStats(AsyncWebServerRequest *request);
+
+/**
+ * @brief Handlers dos scripts nomeados com o estado de cada um (GET/POST /api/scripts)
+ */
+void handleGetScripts(AsyncWebServerRequest *request);
+void handleSaveScripts(AsyncWebServerRequest *request, uint8_t *data, size_t len);
+
 #endif // WEB_SERVER_H
 
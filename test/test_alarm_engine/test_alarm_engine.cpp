@@ -0,0 +1,315 @@
+/**
+ * @file test_alarm_engine.cpp
+ * @brief Máquina de estados dos alarmes (pio test -e native_test)
+ *
+ * O motor não lê o relógio: os instantes das amostras e do service são
+ * passados pelo teste, a partir do instante em que as definições são aplicadas.
+ * Os estados internos são observados pelos eventos e por alarmIsActive().
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "alarm_engine.h"
+#include "rtc_manager.h"
+
+#define SLAVE 3
+#define REG 10
+#define MS 1000LL                          // µs por ms
+
+static int64_t s_t0;                       // Instante de alarmSetDefinitions()
+static uint32_t s_cursor;                  // Eventos ainda não conferidos
+
+static AlarmDefinition baseDefinition(uint8_t conditions) {
+    AlarmDefinition def;
+    memset(&def, 0, sizeof(def));
+    def.slaveAddress = SLAVE;
+    def.registerAddress = REG;
+    def.enabledMask = conditions;
+    return def;
+}
+
+static void apply(const AlarmDefinition& def) {
+    TEST_ASSERT_EQUAL_UINT8(1, alarmSetDefinitions(&def, 1));
+    s_t0 = monotonicMicros();
+    s_cursor = alarmNextEventSeq();
+}
+
+static void sample(int64_t atMs, float value) {
+    alarmOnSample(SLAVE, REG, s_t0 + atMs * MS, value);
+}
+
+static void service(int64_t atMs) {
+    alarmService(s_t0 + atMs * MS);
+}
+
+// Confere o próximo evento e avança o cursor
+static void expectEvent(uint8_t condition, uint8_t kind, float value) {
+    AlarmEvent event;
+    TEST_ASSERT_TRUE_MESSAGE(alarmReadEvent(&s_cursor, &event), "evento esperado");
+    TEST_ASSERT_EQUAL_UINT8(0, event.definition);
+    TEST_ASSERT_EQUAL_UINT8(condition, event.condition);
+    TEST_ASSERT_EQUAL_UINT8(kind, event.kind);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, value, event.value);
+}
+
+static void expectNoEvent() {
+    AlarmEvent event;
+    TEST_ASSERT_FALSE_MESSAGE(alarmReadEvent(&s_cursor, &event), "nenhum evento esperado");
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+    alarmSetDefinitions(nullptr, 0);
+}
+
+// IDLE -> PENDING_ON -> ACTIVE -> PENDING_OFF -> IDLE, com os atrasos do service
+static void test_delays_walk_the_state_machine(void) {
+    AlarmDefinition def = baseDefinition(1 << ALARM_HI);
+    def.hi = 80.0f;
+    def.onDelayMs = 5000;
+    def.offDelayMs = 3000;
+    apply(def);
+
+    sample(0, 50.0f);
+    expectNoEvent();
+
+    // PENDING_ON: presente, mas antes do atraso
+    sample(1000, 85.0f);
+    service(5999);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+    expectNoEvent();
+
+    // ACTIVE ao completar onDelayMs
+    service(6000);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HI));
+    TEST_ASSERT_TRUE(alarmIsUnacknowledged(0, ALARM_HI));
+    TEST_ASSERT_EQUAL_UINT16(1, alarmActiveCount());
+    expectEvent(ALARM_HI, ALARM_EVENT_RAISED, 85.0f);
+
+    // PENDING_OFF: ausente, continua ativo durante offDelayMs
+    sample(7000, 70.0f);
+    service(9999);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HI));
+    expectNoEvent();
+
+    // Condição volta dentro do atraso: continua ACTIVE, sem evento
+    sample(9500, 90.0f);
+    service(12000);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HI));
+    expectNoEvent();
+
+    // IDLE após offDelayMs inteiro sem a condição
+    sample(13000, 70.0f);
+    service(15999);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HI));
+    service(16000);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+    TEST_ASSERT_EQUAL_UINT16(0, alarmActiveCount());
+    expectEvent(ALARM_HI, ALARM_EVENT_CLEARED, 70.0f);
+}
+
+// PENDING_ON interrompido volta a IDLE sem evento
+static void test_pending_on_aborts(void) {
+    AlarmDefinition def = baseDefinition(1 << ALARM_HI);
+    def.hi = 80.0f;
+    def.onDelayMs = 5000;
+    apply(def);
+
+    sample(0, 85.0f);
+    service(4000);
+    sample(4500, 75.0f);
+    service(10000);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+    expectNoEvent();
+
+    // O atraso recomeça do zero na volta da condição
+    sample(11000, 85.0f);
+    service(15999);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+    service(16000);
+    expectEvent(ALARM_HI, ALARM_EVENT_RAISED, 85.0f);
+}
+
+// Desativação só abaixo de hi - deadband (acima de lo + deadband)
+static void test_deadband_hysteresis(void) {
+    AlarmDefinition def = baseDefinition((1 << ALARM_HI) | (1 << ALARM_LO));
+    def.hi = 80.0f;
+    def.lo = 20.0f;
+    def.deadband = 2.0f;
+    apply(def);
+
+    sample(0, 79.9f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+    sample(1000, 80.0f);
+    expectEvent(ALARM_HI, ALARM_EVENT_RAISED, 80.0f);
+    sample(2000, 79.0f);
+    sample(3000, 78.1f);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HI));
+    expectNoEvent();
+    sample(4000, 78.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+    expectEvent(ALARM_HI, ALARM_EVENT_CLEARED, 78.0f);
+
+    // Reativa só no limite, não no limite de desativação
+    sample(5000, 79.5f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HI));
+
+    sample(6000, 20.0f);
+    expectEvent(ALARM_LO, ALARM_EVENT_RAISED, 20.0f);
+    sample(7000, 21.9f);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_LO));
+    sample(8000, 22.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_LO));
+    expectEvent(ALARM_LO, ALARM_EVENT_CLEARED, 22.0f);
+    expectNoEvent();
+}
+
+// Retentivo: fica ativo sem a condição até o reconhecimento
+static void test_latch_and_acknowledge(void) {
+    AlarmDefinition def = baseDefinition(1 << ALARM_HIHI);
+    def.hihi = 100.0f;
+    def.latch = true;
+    apply(def);
+
+    sample(0, 105.0f);
+    expectEvent(ALARM_HIHI, ALARM_EVENT_RAISED, 105.0f);
+    sample(1000, 50.0f);
+    service(60000);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HIHI));
+    TEST_ASSERT_TRUE(alarmIsUnacknowledged(0, ALARM_HIHI));
+    expectNoEvent();
+
+    // Reconhecer com a condição ausente libera o alarme
+    TEST_ASSERT_TRUE(alarmAcknowledge(0, ALARM_HIHI, s_t0 + 61000 * MS));
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HIHI));
+    TEST_ASSERT_FALSE(alarmIsUnacknowledged(0, ALARM_HIHI));
+    expectEvent(ALARM_HIHI, ALARM_EVENT_ACKED, 50.0f);
+    expectEvent(ALARM_HIHI, ALARM_EVENT_CLEARED, 50.0f);
+    TEST_ASSERT_FALSE(alarmAcknowledge(0, ALARM_HIHI, s_t0 + 62000 * MS));
+
+    // Reconhecido com a condição presente: desativa normalmente quando ela some
+    sample(63000, 110.0f);
+    expectEvent(ALARM_HIHI, ALARM_EVENT_RAISED, 110.0f);
+    TEST_ASSERT_EQUAL_UINT8(1, alarmAcknowledgeAll(s_t0 + 64000 * MS));
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HIHI));
+    expectEvent(ALARM_HIHI, ALARM_EVENT_ACKED, 110.0f);
+    sample(65000, 50.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_HIHI));
+    expectEvent(ALARM_HIHI, ALARM_EVENT_CLEARED, 50.0f);
+
+    // Retido que volta antes do reconhecimento segue ativo sem novo evento
+    sample(66000, 120.0f);
+    expectEvent(ALARM_HIHI, ALARM_EVENT_RAISED, 120.0f);
+    sample(67000, 50.0f);
+    sample(68000, 130.0f);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_HIHI));
+    expectNoEvent();
+}
+
+// Taxa em unidades por segundo, com o valor do evento sendo a taxa
+static void test_rate_of_change(void) {
+    AlarmDefinition def = baseDefinition(1 << ALARM_RATE);
+    def.rateLimit = 5.0f;
+    apply(def);
+
+    sample(0, 10.0f);
+    sample(1000, 14.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_RATE));
+    sample(2000, 24.0f);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_RATE));
+    expectEvent(ALARM_RATE, ALARM_EVENT_RAISED, 10.0f);
+
+    // Mesma variação em 4 s: 2.5/s
+    sample(6000, 34.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_RATE));
+    expectEvent(ALARM_RATE, ALARM_EVENT_CLEARED, 2.5f);
+
+    // Queda também conta (módulo) e valor repetido zera a taxa
+    sample(6500, 30.0f);
+    expectEvent(ALARM_RATE, ALARM_EVENT_RAISED, 8.0f);
+    sample(7500, 30.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_RATE));
+    expectEvent(ALARM_RATE, ALARM_EVENT_CLEARED, 0.0f);
+    expectNoEvent();
+}
+
+// Dado parado: conta desde a última leitura (ou da aplicação das definições)
+static void test_stale_data(void) {
+    AlarmDefinition def = baseDefinition(1 << ALARM_STALE);
+    def.staleMs = 10000;
+    apply(def);
+
+    service(9999);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_STALE));
+    service(10000);
+    TEST_ASSERT_TRUE(alarmIsActive(0, ALARM_STALE));
+    expectEvent(ALARM_STALE, ALARM_EVENT_RAISED, 0.0f);
+
+    // Leitura chega: normaliza na hora
+    sample(12000, 42.0f);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_STALE));
+    expectEvent(ALARM_STALE, ALARM_EVENT_CLEARED, 42.0f);
+
+    // Leituras com valor igual também contam como dado novo
+    sample(20000, 42.0f);
+    service(29999);
+    TEST_ASSERT_FALSE(alarmIsActive(0, ALARM_STALE));
+    service(30000);
+    expectEvent(ALARM_STALE, ALARM_EVENT_RAISED, 42.0f);
+    expectNoEvent();
+}
+
+// Fila circular: sequência contínua e consumidor atrasado vai para o mais antigo
+static void test_event_ring_overflow(void) {
+    AlarmDefinition def = baseDefinition(1 << ALARM_HI);
+    def.hi = 80.0f;
+    apply(def);
+
+    uint32_t first = alarmNextEventSeq();
+    const uint32_t events = ALARM_EVENT_QUEUE_SIZE + 10;
+    for (uint32_t k = 0; k < events; k++) {
+        sample(1000 * (int64_t)k, k % 2 == 0 ? 90.0f : 70.0f);
+    }
+    TEST_ASSERT_EQUAL_UINT32(first + events, alarmNextEventSeq());
+
+    // Atrasado: começa no evento mais antigo ainda na fila, sem buracos
+    uint32_t cursor = first;
+    AlarmEvent event;
+    uint32_t expectedSeq = first + events - ALARM_EVENT_QUEUE_SIZE;
+    uint32_t count = 0;
+    while (alarmReadEvent(&cursor, &event)) {
+        TEST_ASSERT_EQUAL_UINT32(expectedSeq, event.seq);
+        uint32_t k = event.seq - first;
+        TEST_ASSERT_EQUAL_UINT8(k % 2 == 0 ? ALARM_EVENT_RAISED : ALARM_EVENT_CLEARED, event.kind);
+        expectedSeq++;
+        count++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(ALARM_EVENT_QUEUE_SIZE, count);
+    TEST_ASSERT_EQUAL_UINT32(first + events, cursor);
+
+    // Cursor 0 também começa no mais antigo; cursor em dia não lê nada
+    cursor = 0;
+    TEST_ASSERT_TRUE(alarmReadEvent(&cursor, &event));
+    TEST_ASSERT_EQUAL_UINT32(first + events - ALARM_EVENT_QUEUE_SIZE, event.seq);
+    cursor = alarmNextEventSeq();
+    TEST_ASSERT_FALSE(alarmReadEvent(&cursor, &event));
+
+    // Eventos novos continuam a sequência
+    sample(1000 * (int64_t)events, 90.0f);
+    TEST_ASSERT_TRUE(alarmReadEvent(&cursor, &event));
+    TEST_ASSERT_EQUAL_UINT32(first + events, event.seq);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_delays_walk_the_state_machine);
+    RUN_TEST(test_pending_on_aborts);
+    RUN_TEST(test_deadband_hysteresis);
+    RUN_TEST(test_latch_and_acknowledge);
+    RUN_TEST(test_rate_of_change);
+    RUN_TEST(test_stale_data);
+    RUN_TEST(test_event_ring_overflow);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+/**
+ * @file test_data_logger.cpp
+ * @brief Vazão do logger e recuperação após queda de energia (pio test -e native_test)
+ *
+ * Grava N amostras de um canal no LittleFS simulado (um diretório temporário
+ * do PC novo para cada teste), corta o último segmento no meio de um bloco
+ * como uma queda de energia durante o append e reinicializa o logger: a
+ * gravação deve continuar em um segmento novo e todas as amostras anteriores
+ * ao bloco cortado devem ser lidas.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "data_logger.h"
+
+#define TEST_SAMPLES 50000                 // Enche alguns segmentos de 64KB
+#define TEST_SLAVE 7
+#define TEST_REGISTER 100
+#define TEST_PERIOD_US 1000000LL           // Uma amostra por segundo
+#define TEST_MIN_SAMPLES_PER_S 20000.0     // Piso folgado no PC (o ESP32 grava ~1 amostra/s por canal)
+
+static char s_root[32];
+
+// Valor de uma amostra: rampa lenta com ruído, como um sensor
+static float sampleValue(uint32_t index) {
+    return 25.0f + (float)(index % 600) * 0.01f + (float)((index * 7919) % 13) * 0.1f;
+}
+
+static int64_t sampleTimeUs(uint32_t index) {
+    return 10000000LL + (int64_t)index * TEST_PERIOD_US;
+}
+
+static std::string segmentFile(uint32_t seq) {
+    char name[32];
+    snprintf(name, sizeof(name), "%s%06lu%s", DATALOG_FILE_PREFIX, (unsigned long)seq, DATALOG_FILE_SUFFIX);
+    return std::string(s_root) + name;
+}
+
+static long fileSize(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (long)info.st_size : -1;
+}
+
+// Grava as amostras [first, first + count) com o service a cada amostra, como no loop
+static void appendSamples(uint32_t first, uint32_t count) {
+    for (uint32_t k = first; k < first + count; k++) {
+        dataLoggerAppend(TEST_SLAVE, TEST_REGISTER, sampleTimeUs(k), sampleValue(k));
+        dataLoggerService();
+    }
+}
+
+// Lê todas as amostras brutas do canal; confere a sequência a partir de first
+static uint32_t readBack(uint32_t first, uint32_t* mismatches) {
+    DataLogReader* reader = new DataLogReader;
+    DataLogSample sample;
+    uint32_t count = 0;
+    *mismatches = 0;
+    dataLogReaderBegin(reader, INT64_MIN, INT64_MAX, TEST_SLAVE, TEST_REGISTER);
+    while (dataLogReaderNext(reader, &sample)) {
+        uint32_t index = first + count;
+        if (sample.timeMs != sampleTimeUs(index) / 1000 || sample.value != sampleValue(index)) {
+            (*mismatches)++;
+        }
+        count++;
+    }
+    dataLogReaderEnd(reader);
+    delete reader;
+    return count;
+}
+
+// Cada teste começa com o LittleFS vazio (diretório temporário novo) e o logger reiniciado
+void setUp(void) {
+    strcpy(s_root, "/tmp/test_dl_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(s_root));
+    simFsSetRoot(s_root);
+    TEST_ASSERT_TRUE(dataLoggerInit());
+}
+
+void tearDown(void) {
+    std::string command = std::string("rm -rf ") + s_root;
+    system(command.c_str());
+}
+
+static void test_throughput_and_round_trip(void) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    appendSamples(0, TEST_SAMPLES);
+    dataLoggerFlush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = TEST_SAMPLES / seconds;
+    printf("[Logger] %d amostras em %.3f s (%.0f amostras/s)\n", TEST_SAMPLES, seconds, rate);
+
+    DataLogStats stats;
+    dataLoggerGetStats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(TEST_SAMPLES, stats.samplesLogged);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.blocksDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.writeErrors);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.queuedBlocks);
+    TEST_ASSERT_GREATER_THAN(stats.firstSegment, stats.currentSegment);
+    TEST_ASSERT_TRUE(rate >= TEST_MIN_SAMPLES_PER_S);
+
+    uint32_t mismatches = 0;
+    TEST_ASSERT_EQUAL_UINT32(TEST_SAMPLES, readBack(0, &mismatches));
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+}
+
+static void test_torn_segment_recovery(void) {
+    // Segmentos próprios: o último fica com pelo menos dois blocos
+    appendSamples(0, TEST_SAMPLES);
+    dataLoggerFlush();
+    DataLogStats before;
+    dataLoggerGetStats(&before);
+    std::string lastPath = segmentFile(before.currentSegment);
+    long size = fileSize(lastPath);
+    TEST_ASSERT_TRUE(size >= 2 * DATALOG_BLOCK_SIZE);
+
+    // Amostras dos blocos inteiros que sobram após o corte (o último bloco perde metade)
+    FILE* file = fopen(lastPath.c_str(), "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    DataLogBlockHeader header;
+    TEST_ASSERT_EQUAL(0, fseek(file, size - DATALOG_BLOCK_SIZE, SEEK_SET));
+    TEST_ASSERT_EQUAL(1, fread(&header, sizeof(header), 1, file));
+    fclose(file);
+    uint32_t tornSamples = header.sampleCount;
+    TEST_ASSERT_EQUAL(0, truncate(lastPath.c_str(), size - DATALOG_BLOCK_SIZE / 2));
+
+    // Reinício: scanSegments() encontra o bloco incompleto
+    TEST_ASSERT_TRUE(dataLoggerInit());
+    DataLogStats after;
+    dataLoggerGetStats(&after);
+    TEST_ASSERT_TRUE(after.recoveredTornSegment);
+    TEST_ASSERT_EQUAL_UINT32(before.firstSegment, after.firstSegment);
+    TEST_ASSERT_EQUAL_UINT32(before.currentSegment + 1, after.currentSegment);
+    TEST_ASSERT_EQUAL_UINT32(0, after.currentSegmentBytes);
+
+    // Tudo antes do bloco cortado continua legível, na ordem
+    uint32_t expected = TEST_SAMPLES - tornSamples;
+    uint32_t mismatches = 0;
+    TEST_ASSERT_EQUAL_UINT32(expected, readBack(0, &mismatches));
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+
+    // A gravação continua no segmento novo; o segmento cortado não é reescrito
+    appendSamples(TEST_SAMPLES, 1000);
+    dataLoggerFlush();
+    TEST_ASSERT_EQUAL(size - DATALOG_BLOCK_SIZE / 2, fileSize(lastPath));
+    long newSize = fileSize(segmentFile(after.currentSegment));
+    TEST_ASSERT_TRUE(newSize > 0);
+    TEST_ASSERT_EQUAL(0, newSize % DATALOG_BLOCK_SIZE);
+
+    DataLogReader* reader = new DataLogReader;
+    DataLogSample sample;
+    uint32_t total = 0;
+    int64_t lastTimeMs = INT64_MIN;
+    bool ordered = true;
+    dataLogReaderBegin(reader, INT64_MIN, INT64_MAX, TEST_SLAVE, TEST_REGISTER);
+    while (dataLogReaderNext(reader, &sample)) {
+        ordered = ordered && sample.timeMs > lastTimeMs;
+        lastTimeMs = sample.timeMs;
+        total++;
+    }
+    dataLogReaderEnd(reader);
+    delete reader;
+    TEST_ASSERT_EQUAL_UINT32(expected + 1000, total);
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_INT64(sampleTimeUs(TEST_SAMPLES + 999) / 1000, lastTimeMs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_throughput_and_round_trip);
+    RUN_TEST(test_torn_segment_recovery);
+    return UNITY_END();
+}
@@ -0,0 +1,141 @@
+/**
+ * @file test_psychrometrics.cpp
+ * @brief Ajuste das constantes psicrométricas contra os scripts Python (pio test -e native_test)
+ *
+ * Os pontos são os de psicrometria_analise/pontos_calibracao.txt (4 pontos) e
+ * os 8 pontos de psicrometria_analise/constantes_lm.txt; os valores esperados
+ * são os da saída de calibrar_constantes.py partindo das constantes padrão.
+ * Além disso, uma busca em grade sobre B e C (D/A ótimo em forma fechada para
+ * cada par, pois a UR é linear em D/A) confere que o ajuste não parou em um
+ * mínimo pior que o melhor ponto da grade dentro dos limites.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <math.h>
+#include "psychrometrics.h"
+
+// Limites de calibrar_constantes.py (também em psychrometrics.cpp)
+#define B_MIN 0.01
+#define B_MAX 100.0
+#define C_MIN 1.0
+#define C_MAX 600.0
+#define RATIO_MIN (0.0008 / 100.0)         // D/A: D mínimo sobre A máximo
+#define RATIO_MAX (5.0 / 0.01)
+
+// psicrometria_analise/pontos_calibracao.txt
+static const PsychroPoint kFilePoints[] = {
+    { 25.6f, 23.1f, 46.0f },
+    { 27.70f, 24.30f, 51.42f },
+    { 18.00f, 24.90f, 51.0f },
+    { 29.5f, 28.00f, 65.02f },
+};
+
+// psicrometria_analise/constantes_lm.txt (pontos de calibração utilizados)
+static const PsychroPoint kLmPoints[] = {
+    { 28.5f, 27.5f, 65.0f },
+    { 25.2f, 23.4f, 50.0f },
+    { 28.67f, 25.33f, 60.1f },
+    { 27.7f, 23.69f, 45.1f },
+    { 26.85f, 23.19f, 41.1f },
+    { 25.4f, 22.1f, 49.5f },
+    { 30.8f, 27.63f, 53.6f },
+    { 31.1f, 28.3f, 59.5f },
+};
+
+static const PsychroConstants kDefaults = { 6.112, 17.67, 243.5, 1.8 };
+
+// Menor erro RMS da grade B x C, com D/A ótimo (limitado) em cada par
+static double gridBestRms(const PsychroPoint* points, uint8_t count) {
+    const int steps = 240;
+    double best = INFINITY;
+    for (int i = 0; i <= steps; i++) {
+        double b = B_MIN + (B_MAX - B_MIN) * i / steps;
+        for (int j = 0; j <= steps; j++) {
+            double c = C_MIN + (C_MAX - C_MIN) * j / steps;
+            // UR = 100*g - k*100*h: mínimos quadrados em k = D/A
+            double num = 0.0, den = 0.0;
+            for (uint8_t p = 0; p < count; p++) {
+                double g = exp(b * (points[p].tu / (points[p].tu + c) - points[p].ts / (points[p].ts + c)));
+                double h = (points[p].ts - points[p].tu) / exp(b * points[p].ts / (points[p].ts + c));
+                num += (100.0 * g - points[p].ur) * 100.0 * h;
+                den += 100.0 * h * 100.0 * h;
+            }
+            double k = den > 0.0 ? num / den : RATIO_MIN;
+            k = k < RATIO_MIN ? RATIO_MIN : (k > RATIO_MAX ? RATIO_MAX : k);
+            PsychroConstants constants = { 1.0, b, c, k };
+            double sum = 0.0;
+            for (uint8_t p = 0; p < count; p++) {
+                double error = psychroRelativeHumidity(points[p].ts, points[p].tu, &constants) - points[p].ur;
+                sum += error * error;
+            }
+            double rms = sqrt(sum / count);
+            if (rms < best) {
+                best = rms;
+            }
+        }
+    }
+    return best;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// 4 pontos: o mínimo fica no canto B mínimo / C máximo dos limites
+static void test_fit_calibration_file(void) {
+    PsychroConstants constants = kDefaults;
+    PsychroFitResult result;
+    TEST_ASSERT_TRUE(psychroFit(kFilePoints, 4, &constants, &result));
+    printf("[Psicrometria] 4 pontos: RMS %.4f%% em %u iteracoes, B=%.6f C=%.6f D/A=%.6g\n", result.rmsError,
+           result.iterations, constants.b, constants.c, constants.d / constants.a);
+
+    TEST_ASSERT_EQUAL_UINT8(4, result.pointCount);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 47.163, result.rmsError);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, B_MIN, constants.b);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, C_MAX, constants.c);
+    TEST_ASSERT_TRUE(result.rmsError <= gridBestRms(kFilePoints, 4) + 1e-3);
+}
+
+// 8 pontos: mesmo erro e mesmos B e C de constantes_lm.txt
+static void test_fit_lm_points(void) {
+    PsychroConstants constants = kDefaults;
+    PsychroFitResult result;
+    TEST_ASSERT_TRUE(psychroFit(kLmPoints, 8, &constants, &result));
+    printf("[Psicrometria] 8 pontos: RMS %.4f%% em %u iteracoes, B=%.6f C=%.6f D/A=%.6g\n", result.rmsError,
+           result.iterations, constants.b, constants.c, constants.d / constants.a);
+
+    TEST_ASSERT_EQUAL_UINT8(8, result.pointCount);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 9.1434, result.rmsError);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 16.6815, result.maxError);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 6.8977, result.meanError);
+    TEST_ASSERT_DOUBLE_WITHIN(0.005, 24.906075, constants.b);
+    TEST_ASSERT_DOUBLE_WITHIN(0.005, 15.065311, constants.c);
+    TEST_ASSERT_TRUE(result.rmsError <= gridBestRms(kLmPoints, 8) + 1e-3);
+
+    // Cada ponto calculado com as constantes ajustadas bate com a tabela do script
+    static const double kScriptUr[] = { 81.681525, 64.657284, 49.195894, 40.339830,
+                                        42.466859, 43.896514, 54.476286, 59.168128 };
+    for (uint8_t p = 0; p < 8; p++) {
+        TEST_ASSERT_DOUBLE_WITHIN(0.01, kScriptUr[p], psychroRelativeHumidity(kLmPoints[p].ts, kLmPoints[p].tu, &constants));
+    }
+}
+
+// Poucos pontos: não ajusta e não mexe nas constantes
+static void test_fit_needs_min_points(void) {
+    PsychroConstants constants = kDefaults;
+    PsychroFitResult result;
+    TEST_ASSERT_FALSE(psychroFit(kLmPoints, PSYCHRO_MIN_POINTS - 1, &constants, &result));
+    TEST_ASSERT_EQUAL_DOUBLE(kDefaults.b, constants.b);
+    TEST_ASSERT_EQUAL_DOUBLE(kDefaults.c, constants.c);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fit_calibration_file);
+    RUN_TEST(test_fit_lm_points);
+    RUN_TEST(test_fit_needs_min_points);
+    return UNITY_END();
+}
@@ -0,0 +1,295 @@
+/**
+ * @file test_ts_codec.cpp
+ * @brief Compressão e ida e volta do codificador de séries (pio test -e native_test)
+ *
+ * Lê um histórico no formato de /api/history/export?format=csv, codifica
+ * cada canal em blocos do logger (DATALOG_PAYLOAD_SIZE) e decodifica de
+ * volta: mostra a taxa de compressão em relação a timestamp (8) + float (4)
+ * por amostra e o custo de codificação/decodificação em ns por amostra no PC,
+ * e confere que todas as amostras voltam idênticas (bit a bit).
+ *
+ * O arquivo padrão (historico_umidade.csv, ao lado deste) é o histórico
+ * gravado pela simulação de sim/scenarios/umidade.sim em 30 min (TS e TU em
+ * décimos de °C com gain 0.1, e a bobina do umidificador). Para medir outro
+ * histórico, aponte TS_CODEC_CSV para um CSV exportado do equipamento.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <map>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "data_logger.h"
+#include "ts_codec.h"
+
+#define BENCH_RUNS 20                      // Repetições de cada passada (tempo por amostra estável)
+#define MIN_COMPRESSION_RATIO 3.0          // Piso para o histórico de exemplo
+
+/**
+ * @brief Amostras de um canal, na ordem do arquivo
+ */
+struct Channel {
+    uint8_t encoding;
+    std::vector<int64_t> times;
+    std::vector<float> values;
+};
+
+/**
+ * @brief Um bloco codificado (payload e amostras que ele contém)
+ */
+struct EncodedBlock {
+    size_t first;
+    size_t count;
+    uint16_t bytes;
+    uint8_t payload[DATALOG_PAYLOAD_SIZE];
+};
+
+static std::map<uint32_t, Channel> s_channels;
+static size_t s_samples = 0;
+
+static std::string csvPath() {
+    const char* path = getenv("TS_CODEC_CSV");
+    if (path != nullptr && path[0] != '\0') {
+        return path;
+    }
+    std::string file = __FILE__;
+    size_t slash = file.find_last_of('/');
+    return (slash == std::string::npos ? std::string() : file.substr(0, slash + 1)) + "historico_umidade.csv";
+}
+
+// time_ms,time_utc,slave,register,variable,value[,min,max,count]
+static bool loadCsv(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[256];
+    bool header = true;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (header) {
+            header = false;
+            continue;
+        }
+        std::vector<std::string> fields;
+        std::string field;
+        for (const char* c = line; *c != '\0' && *c != '\r' && *c != '\n'; c++) {
+            if (*c == ',') {
+                fields.push_back(field);
+                field.clear();
+            } else {
+                field += *c;
+            }
+        }
+        fields.push_back(field);
+        if (fields.size() < 6) {
+            continue;
+        }
+        uint32_t key = ((uint32_t)atoi(fields[2].c_str()) << 16) | (uint16_t)atoi(fields[3].c_str());
+        Channel& channel = s_channels[key];
+        channel.times.push_back(strtoll(fields[0].c_str(), nullptr, 10));
+        channel.values.push_back(strtof(fields[5].c_str(), nullptr));
+        s_samples++;
+    }
+    fclose(file);
+
+    // Inteiro só se todas as amostras do canal são inteiras (como um registro sem gain/offset)
+    for (std::map<uint32_t, Channel>::iterator it = s_channels.begin(); it != s_channels.end(); ++it) {
+        Channel& channel = it->second;
+        channel.encoding = DATALOG_ENCODING_DELTA_VARINT;
+        for (size_t k = 0; k < channel.values.size(); k++) {
+            if (!tsIsIntegral(channel.values[k])) {
+                channel.encoding = DATALOG_ENCODING_GORILLA;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// Codifica o canal em blocos cheios, como o logger (a amostra que não cabe abre o bloco seguinte)
+static void encodeChannel(const Channel& channel, std::vector<EncodedBlock>* blocks) {
+    blocks->clear();
+    size_t start = 0;
+    while (start < channel.times.size()) {
+        blocks->push_back(EncodedBlock());
+        EncodedBlock& block = blocks->back();
+        TsEncoder encoder;
+        tsEncoderInit(&encoder, channel.encoding, channel.times[start]);
+        size_t end = start;
+        while (end < channel.times.size() &&
+               tsEncoderAppend(&encoder, block.payload, DATALOG_PAYLOAD_SIZE, channel.times[end], channel.values[end])) {
+            end++;
+        }
+        block.first = start;
+        block.count = end - start;
+        block.bytes = tsEncoderBytes(&encoder);
+        if (end == start) {
+            return;                        // Não deveria ocorrer: a primeira amostra sempre cabe
+        }
+        start = end;
+    }
+}
+
+// Decodifica os blocos (block.count amostras, como sampleCount no cabeçalho do logger);
+// conta as amostras diferentes das originais
+static size_t decodeChannel(const Channel& channel, const std::vector<EncodedBlock>& blocks, size_t* decoded) {
+    size_t mismatches = 0;
+    *decoded = 0;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        const EncodedBlock& block = blocks[b];
+        TsDecoder decoder;
+        tsDecoderInit(&decoder, channel.encoding, channel.times[block.first]);
+        int64_t timeMs;
+        float value;
+        for (size_t k = 0; k < block.count; k++) {
+            if (!tsDecoderNext(&decoder, block.payload, block.bytes, &timeMs, &value)) {
+                mismatches += block.count - k;
+                break;
+            }
+            size_t index = block.first + k;
+            if (timeMs != channel.times[index] || memcmp(&value, &channel.values[index], sizeof(float)) != 0) {
+                mismatches++;
+            }
+            (*decoded)++;
+        }
+    }
+    return mismatches;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void test_recorded_history(void) {
+    TEST_ASSERT_TRUE(s_samples > 0);
+    size_t totalBytes = 0;
+    double totalEncodeNs = 0.0, totalDecodeNs = 0.0;
+
+    for (std::map<uint32_t, Channel>::iterator it = s_channels.begin(); it != s_channels.end(); ++it) {
+        const Channel& channel = it->second;
+        std::vector<EncodedBlock> blocks;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            encodeChannel(channel, &blocks);
+        }
+        double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        size_t decoded = 0;
+        size_t mismatches = 0;
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            mismatches += decodeChannel(channel, blocks, &decoded);
+        }
+        double decodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        size_t bytes = blocks.size() * DATALOG_BLOCK_SIZE;
+        size_t samples = channel.times.size();
+        printf("[Codec] escravo %u reg %u (%s): %u amostras em %u blocos, %.2f bytes/amostra (%.1fx), "
+               "codifica %.1f ns/amostra, decodifica %.1f ns/amostra\n",
+               (unsigned)(it->first >> 16), (unsigned)(it->first & 0xFFFF),
+               channel.encoding == DATALOG_ENCODING_GORILLA ? "XOR float" : "varint", (unsigned)samples,
+               (unsigned)blocks.size(), (double)bytes / samples, 12.0 * samples / bytes,
+               encodeNs / BENCH_RUNS / samples, decodeNs / BENCH_RUNS / samples);
+
+        TEST_ASSERT_EQUAL_UINT32(samples, decoded);
+        TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+        totalBytes += bytes;
+        totalEncodeNs += encodeNs;
+        totalDecodeNs += decodeNs;
+    }
+
+    // Blocos inteiros (cabeçalho incluído), como ocupam o flash
+    double ratio = 12.0 * s_samples / totalBytes;
+    printf("[Codec] total: %u amostras, %u bytes (%.1fx), codifica %.1f ns/amostra, decodifica %.1f ns/amostra\n",
+           (unsigned)s_samples, (unsigned)totalBytes, ratio, totalEncodeNs / BENCH_RUNS / s_samples,
+           totalDecodeNs / BENCH_RUNS / s_samples);
+    if (getenv("TS_CODEC_CSV") == nullptr) {
+        TEST_ASSERT_TRUE(ratio >= MIN_COMPRESSION_RATIO);
+    }
+}
+
+// Valores especiais e saltos de tempo em todas as faixas de delta-of-delta
+static void test_edge_values(void) {
+    Channel channel;
+    channel.encoding = DATALOG_ENCODING_GORILLA;
+    const float values[] = { 0.0f, -0.0f, 1.0f, NAN, INFINITY, -INFINITY, 1e-40f, -3.4e38f, 3.4e38f, 25.5f, 25.5f };
+    const int64_t steps[] = { 0, 1000, 1000, 1001, 937, 1250, 3000, 60000, 1, 86400000, 1000 };
+    int64_t timeMs = 1700000000000LL;
+    for (size_t k = 0; k < sizeof(values) / sizeof(values[0]); k++) {
+        timeMs += steps[k];
+        channel.times.push_back(timeMs);
+        channel.values.push_back(values[k]);
+    }
+    std::vector<EncodedBlock> blocks;
+    encodeChannel(channel, &blocks);
+    size_t decoded = 0;
+    TEST_ASSERT_EQUAL_UINT32(0, decodeChannel(channel, blocks, &decoded));
+    TEST_ASSERT_EQUAL_UINT32(channel.times.size(), decoded);
+
+    // Inteiros nos extremos do delta em varint
+    Channel integers;
+    integers.encoding = DATALOG_ENCODING_DELTA_VARINT;
+    const float counts[] = { 0.0f, 65535.0f, 0.0f, -32768.0f, 32767.0f, 1.0f, 1.0f, 16777216.0f, -16777216.0f };
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        integers.times.push_back(1700000000000LL + (int64_t)k * 1000);
+        integers.values.push_back(counts[k]);
+    }
+    encodeChannel(integers, &blocks);
+    TEST_ASSERT_EQUAL_UINT32(0, decodeChannel(integers, blocks, &decoded));
+    TEST_ASSERT_EQUAL_UINT32(integers.times.size(), decoded);
+}
+
+// Amostra que não cabe: estado e contagem do codificador ficam como antes
+static void test_full_block_rollback(void) {
+    uint8_t payload[DATALOG_PAYLOAD_SIZE];
+    TsEncoder encoder;
+    tsEncoderInit(&encoder, DATALOG_ENCODING_GORILLA, 0);
+    uint32_t seed = 12345;
+    int64_t timeMs = 0;
+    uint16_t accepted = 0;
+    while (true) {
+        // Ruído em todos os bits da mantissa: pior caso do XOR
+        seed = seed * 1103515245u + 12345u;
+        float value = 20.0f + (float)(seed >> 8) / 16777216.0f;
+        timeMs += 1000 + (int64_t)(seed % 7);
+        TsEncoder before = encoder;
+        if (!tsEncoderAppend(&encoder, payload, DATALOG_PAYLOAD_SIZE, timeMs, value)) {
+            TEST_ASSERT_EQUAL_MEMORY(&before, &encoder, sizeof(TsEncoder));
+            break;
+        }
+        accepted++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(accepted, encoder.count);
+    TEST_ASSERT_TRUE(tsEncoderBytes(&encoder) <= DATALOG_PAYLOAD_SIZE);
+
+    TsDecoder decoder;
+    tsDecoderInit(&decoder, DATALOG_ENCODING_GORILLA, 0);
+    int64_t decodedTime;
+    float decodedValue;
+    uint16_t decoded = 0;
+    while (tsDecoderNext(&decoder, payload, tsEncoderBytes(&encoder), &decodedTime, &decodedValue)) {
+        decoded++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(accepted, decoded);
+}
+
+int main(int argc, char** argv) {
+    std::string path = csvPath();
+    if (!loadCsv(path)) {
+        printf("[Codec] Nao foi possivel ler %s\n", path.c_str());
+        return 1;
+    }
+    printf("[Codec] %s: %u amostras em %u canais\n", path.c_str(), (unsigned)s_samples, (unsigned)s_channels.size());
+
+    UNITY_BEGIN();
+    RUN_TEST(test_recorded_history);
+    RUN_TEST(test_edge_values);
+    RUN_TEST(test_full_block_rollback);
+    return UNITY_END();
+}